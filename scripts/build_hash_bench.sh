@@ -0,0 +1,27 @@
+#!/bin/sh
+# Builds hash_bench (see hash_bench.cpp) from the portable sources with the
+# system C++ compiler. Output: build/hash_bench next to the repository root.
+set -e
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+out="$root/build"
+mkdir -p "$out"
+
+${CXX:-c++} -O2 -std=c++17 -pthread -o "$out/hash_bench" \
+  "$root/scripts/hash_bench.cpp" \
+  "$root/src/AsyncFileReader.cpp" \
+  "$root/src/Blake3.cpp" \
+  "$root/src/CpuFeatures.cpp" \
+  "$root/src/Crc32c.cpp" \
+  "$root/src/Digest.cpp" \
+  "$root/src/FuzzyHash.cpp" \
+  "$root/src/HashBenchmark.cpp" \
+  "$root/src/HashCheckpoint.cpp" \
+  "$root/src/HashEngine.cpp" \
+  "$root/src/PEChecksum.cpp" \
+  "$root/src/PageCacheIo.cpp" \
+  "$root/src/Sha256Tree.cpp" \
+  "$root/src/StringsScanner.cpp" \
+  "$root/src/Xxh3.cpp"
+
+echo "$out/hash_bench"
@@ -0,0 +1,237 @@
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+from typing import Dict, List, Optional
+
+# 需要生成序号表的 DLL。mfc*.dll 按参考目录中实际存在的文件展开。
+TARGET_DLLS = ["ws2_32.dll", "wsock32.dll", "oleaut32.dll", "comctl32.dll"]
+TARGET_GLOBS = ["mfc*.dll"]
+
+# 与 src/OrdinalNames.h 中 OrdinalTableHash 保持一致。
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+
+def table_hash(seed: int, name: str) -> int:
+    h = (FNV_OFFSET ^ seed) & 0xFFFFFFFF
+    for b in name.lower().encode("ascii"):
+        h ^= b
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def read_exports(path: str) -> Dict[int, str]:
+    """返回 {ordinal: name}，只包含带名称的导出。"""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    def u16(off: int) -> int:
+        return struct.unpack_from("<H", data, off)[0]
+
+    def u32(off: int) -> int:
+        return struct.unpack_from("<I", data, off)[0]
+
+    if len(data) < 0x40 or data[:2] != b"MZ":
+        return {}
+    pe = u32(0x3C)
+    if data[pe:pe + 4] != b"PE\0\0":
+        return {}
+    num_sections = u16(pe + 6)
+    opt_size = u16(pe + 20)
+    opt = pe + 24
+    magic = u16(opt)
+    dd = opt + (96 if magic == 0x10B else 112)
+    export_rva = u32(dd)
+    if export_rva == 0:
+        return {}
+
+    sections = []
+    sec = opt + opt_size
+    for i in range(num_sections):
+        s = sec + i * 40
+        vsize, va, rawsize, rawptr = struct.unpack_from("<IIII", data, s + 8)
+        sections.append((va, max(vsize, rawsize), rawptr))
+
+    def rva_to_off(rva: int) -> Optional[int]:
+        for va, size, rawptr in sections:
+            if va <= rva < va + size:
+                return rva - va + rawptr
+        return None
+
+    def read_cstr(rva: int) -> str:
+        off = rva_to_off(rva)
+        if off is None:
+            return ""
+        end = data.find(b"\0", off)
+        return data[off:end].decode("ascii", "replace")
+
+    exp = rva_to_off(export_rva)
+    if exp is None:
+        return {}
+    base, _nfuncs, nnames, _funcs, names, ords = struct.unpack_from("<IIIIII", data, exp + 16)
+    names_off = rva_to_off(names)
+    ords_off = rva_to_off(ords)
+    out: Dict[int, str] = {}
+    if names_off is None or ords_off is None:
+        return out
+    for i in range(nnames):
+        name_rva = u32(names_off + i * 4)
+        idx = u16(ords_off + i * 2)
+        out[base + idx] = read_cstr(name_rva)
+    return out
+
+
+DEF_EXPORT_RE = re.compile(r"^\s*([^\s=]+)(?:\s*=\s*\S+)?\s+@\s*(\d+)")
+
+
+def read_def(path: str) -> Dict[int, str]:
+    """读取 .def 文件中的 "name @ordinal [NONAME]" 条目（MFC 的导出全是 NONAME）。"""
+    out: Dict[int, str] = {}
+    in_exports = False
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        for line in f:
+            stripped = line.strip()
+            if not stripped or stripped.startswith(";"):
+                continue
+            keyword = stripped.split()[0].upper()
+            if keyword == "EXPORTS":
+                in_exports = True
+                continue
+            if keyword in ("LIBRARY", "NAME", "SECTIONS", "HEAPSIZE", "STACKSIZE", "VERSION", "DESCRIPTION"):
+                in_exports = False
+                continue
+            if not in_exports:
+                continue
+            m = DEF_EXPORT_RE.match(line)
+            if m:
+                out[int(m.group(2))] = m.group(1)
+    return out
+
+
+def read_baseline(path: str) -> Dict[str, Dict[int, str]]:
+    out: Dict[str, Dict[int, str]] = {}
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            dll, ordinal, name = line.split()
+            out.setdefault(dll.lower(), {})[int(ordinal)] = name
+    return out
+
+
+def find_seed(names: List[str], slot_count: int) -> int:
+    for seed in range(1 << 20):
+        used = set()
+        for n in names:
+            slot = table_hash(seed, n) & (slot_count - 1)
+            if slot in used:
+                break
+            used.add(slot)
+        else:
+            return seed
+    raise RuntimeError("no perfect hash seed found")
+
+
+def c_string(s: str) -> str:
+    # MFC 的修饰名里有 "??"，转义掉以免被当成三字符组。
+    return '"%s"' % s.replace("\\", "\\\\").replace('"', '\\"').replace("??", "?\\?")
+
+
+def ident(dll: str) -> str:
+    return re.sub(r"[^0-9A-Za-z]", "_", dll[:-4] if dll.endswith(".dll") else dll)
+
+
+def emit(tables: Dict[str, Dict[int, str]]) -> str:
+    dlls = sorted(d for d in tables if tables[d])
+    slot_count = 1
+    while slot_count < max(1, len(dlls)) * 2:
+        slot_count *= 2
+    seed = find_seed(dlls, slot_count)
+
+    lines = [
+        "// Generated by scripts/gen_ordinal_tables.py. Do not edit by hand.",
+        "#pragma once",
+        "",
+        "namespace ordinal_tables {",
+        "",
+        "constexpr uint32_t kHashSeed = %du;" % seed,
+        "constexpr uint32_t kSlotCount = %du;" % slot_count,
+        "",
+    ]
+    for dll in dlls:
+        entries = tables[dll]
+        first = min(entries)
+        last = max(entries)
+        lines.append("constexpr const char* const kNames_%s[] = {" % ident(dll))
+        for ordinal in range(first, last + 1):
+            name = entries.get(ordinal)
+            lines.append("    %s," % (c_string(name) if name else "nullptr"))
+        lines.append("};")
+        lines.append("")
+
+    lines.append("constexpr OrdinalNameTable kTables[] = {")
+    for dll in dlls:
+        entries = tables[dll]
+        lines.append('    {"%s", %du, sizeof(kNames_%s) / sizeof(kNames_%s[0]), kNames_%s},'
+                     % (dll, min(entries), ident(dll), ident(dll), ident(dll)))
+    lines.append("};")
+    lines.append("")
+
+    slots = [-1] * slot_count
+    for i, dll in enumerate(dlls):
+        slots[table_hash(seed, dll) & (slot_count - 1)] = i
+    lines.append("constexpr int8_t kSlots[kSlotCount] = {%s};" % ", ".join(str(s) for s in slots))
+    lines.append("")
+    lines.append("} // namespace ordinal_tables")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--dll-dir", default=None, help="参考 DLL 目录（例如拷贝出的 System32）")
+    ap.add_argument("--def-dir", default=None, help="包含 mfc*.def 等模块定义文件的目录，用于 NONAME 导出")
+    ap.add_argument("--baseline", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "ordinal_names_baseline.txt"))
+    ap.add_argument("--out", required=True, help="输出的头文件路径")
+    args = ap.parse_args()
+
+    tables = read_baseline(args.baseline) if args.baseline and os.path.isfile(args.baseline) else {}
+
+    if args.dll_dir:
+        if not os.path.isdir(args.dll_dir):
+            print(f"目录不存在: {args.dll_dir}", file=sys.stderr)
+            return 2
+        paths = [os.path.join(args.dll_dir, d) for d in TARGET_DLLS]
+        for pattern in TARGET_GLOBS:
+            paths.extend(glob.glob(os.path.join(args.dll_dir, pattern)))
+        for path in paths:
+            if os.path.isfile(path):
+                exports = read_exports(path)
+                if exports:
+                    tables[os.path.basename(path).lower()] = exports
+
+    if args.def_dir:
+        for path in glob.glob(os.path.join(args.def_dir, "*.def")):
+            dll = os.path.splitext(os.path.basename(path))[0].lower() + ".dll"
+            if not dll.startswith("mfc"):
+                continue
+            entries = read_def(path)
+            if entries:
+                tables.setdefault(dll, {}).update(entries)
+
+    text = emit(tables)
+    if os.path.isfile(args.out):
+        with open(args.out, "rb") as f:
+            if f.read() == text.encode("utf-8"):
+                return 0
+    with open(args.out, "wb") as f:
+        f.write(text.encode("utf-8"))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,338 @@
+// Command-line driver for the portable hashing code, so that digests, the
+// async read pipeline and the strings scanner can be measured on Linux as
+// well. Build with scripts/build_hash_bench.sh.
+//
+//   hash_bench digest [megabytes]
+//   hash_bench async <file> [algorithm] [backend]
+//   hash_bench engine <file> [algorithm[,algorithm...]] [cachepolicy]
+//   hash_bench pagecache <file> [algorithm]
+//   hash_bench sweep [--json <out>] [--dir <directory>]... [--algorithms a,b]
+//                    [--chunks 0,64K,1M] [--policies sync,mapped,async]
+//                    [--backends io_uring,threadpool] [--sizes 1M,64M]
+//                    [--rounds n] [--warm]
+//   hash_bench strings [megabytes]
+
+#include "../src/AsyncFileReader.h"
+#include "../src/Digest.h"
+#include "../src/HashBenchmark.h"
+#include "../src/HashEngine.h"
+#include "../src/StringsScanner.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool ParseAlgorithm(const char* name, HashAlgorithm& out) {
+    const HashAlgorithm all[] = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256,
+                                 HashAlgorithm::BLAKE3, HashAlgorithm::SHA256Tree,
+                                 HashAlgorithm::SSDEEP, HashAlgorithm::TLSH,
+                                 HashAlgorithm::XXH3_64, HashAlgorithm::XXH3_128, HashAlgorithm::CRC32C};
+    for (HashAlgorithm algorithm : all) {
+        if (strcasecmp(name, GetDigestAlgorithmName(algorithm)) == 0) {
+            out = algorithm;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "64K", "1M", "2G" or plain bytes.
+bool ParseSize(const std::string& text, uint64_t& out) {
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) {
+        return false;
+    }
+    int shift = 0;
+    if (*end == 'K' || *end == 'k') {
+        shift = 10;
+    } else if (*end == 'M' || *end == 'm') {
+        shift = 20;
+    } else if (*end == 'G' || *end == 'g') {
+        shift = 30;
+    } else if (*end != '\0') {
+        return false;
+    }
+    if (shift != 0 && end[1] != '\0') {
+        return false;
+    }
+    out = static_cast<uint64_t>(value) << shift;
+    return true;
+}
+
+// Applies parse to every item of a comma-separated list.
+template <typename T, typename Parse>
+bool ParseList(const char* text, std::vector<T>& out, Parse parse) {
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        T value;
+        if (!parse(item, value)) {
+            return false;
+        }
+        out.push_back(value);
+    }
+    return !out.empty();
+}
+
+int Usage() {
+    fprintf(stderr, "usage: hash_bench digest [megabytes]\n"
+                    "       hash_bench async <file> [algorithm] [backend]\n"
+                    "       hash_bench engine <file> [algorithm[,algorithm...]] [cachepolicy]\n"
+                    "       hash_bench pagecache <file> [algorithm]\n"
+                    "       hash_bench sweep [--json <out>] [--dir <directory>]... [--algorithms a,b]\n"
+                    "                        [--chunks 0,64K,1M] [--policies sync,mapped,async]\n"
+                    "                        [--backends io_uring,threadpool] [--sizes 1M,64M]\n"
+                    "                        [--rounds n] [--warm]\n"
+                    "       hash_bench strings [megabytes]\n");
+    return 2;
+}
+
+int RunDigest(int argc, char** argv) {
+    size_t megabytes = argc >= 3 ? static_cast<size_t>(atoi(argv[2])) : 256;
+    std::wstring error;
+    if (!RunDigestSelfTest(error)) {
+        fprintf(stderr, "self-test failed: %ls\n", error.c_str());
+        return 2;
+    }
+    printf("%-12s %-14s %10s\n", "algorithm", "impl", "MB/s");
+    for (const auto& r : RunDigestBenchmark(megabytes << 20, 3)) {
+        printf("%-12s %-14s %10.1f\n", r.algorithm.c_str(), r.impl.c_str(), r.megabytesPerSecond);
+    }
+    return 0;
+}
+
+int RunStrings(int argc, char** argv) {
+    size_t megabytes = argc >= 3 ? static_cast<size_t>(atoi(argv[2])) : 64;
+    std::wstring error;
+    if (!RunStringsScannerSelfTest(error)) {
+        fprintf(stderr, "self-test failed: %ls\n", error.c_str());
+        return 2;
+    }
+    printf("%-8s %-10s %10s %10s\n", "input", "impl", "hits", "MB/s");
+    for (const auto& r : RunStringsScanBenchmark(megabytes << 20, 3)) {
+        printf("%-8s %-10s %10zu %10.1f\n", r.input.c_str(), r.impl.c_str(), r.hits, r.megabytesPerSecond);
+    }
+    return 0;
+}
+
+int RunAsync(int argc, char** argv) {
+    if (argc < 3) {
+        return Usage();
+    }
+    std::string path8 = argv[2];
+    std::wstring path(path8.begin(), path8.end());
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    if (argc >= 4 && !ParseAlgorithm(argv[3], algorithm)) {
+        return Usage();
+    }
+    const std::vector<std::pair<size_t, size_t>> fixed = {
+        {64u << 10, 1}, {256u << 10, 4}, {1u << 20, 4}, {1u << 20, 16}, {2u << 20, 8},
+    };
+    std::vector<AsyncReadBenchmarkResult> results = RunAsyncReadBenchmark(path, algorithm, fixed);
+
+    int status = 0;
+    printf("%-11s %-6s %9s %6s %8s %10s  %s\n", "backend", "tuned", "chunk", "depth", "reads", "MB/s", "digest");
+    for (const auto& r : results) {
+        if (argc >= 5 && r.backend != argv[4]) {
+            continue;
+        }
+        bool tuned = r.chunkSize == 0 && r.queueDepth == 0;
+        printf("%-11s %-6s %9zu %6zu %8llu %10.1f  %s\n", r.backend.c_str(), tuned ? "yes" : "no", r.stats.chunkSize,
+               r.stats.queueDepth, static_cast<unsigned long long>(r.stats.reads), r.megabytesPerSecond,
+               r.error.empty() ? r.digest.c_str() : r.error.c_str());
+        if (!r.error.empty() || r.digest != results.front().digest) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// Hashes the file once per I/O policy with all the given algorithms in one
+// pass, under the given page-cache policy; every policy must agree.
+int RunEngine(int argc, char** argv) {
+    if (argc < 3) {
+        return Usage();
+    }
+    std::string path8 = argv[2];
+    std::wstring path(path8.begin(), path8.end());
+    std::vector<HashAlgorithm> algorithms;
+    std::stringstream names(argc >= 4 ? argv[3] : "SHA256");
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        HashAlgorithm algorithm = HashAlgorithm::SHA256;
+        if (!ParseAlgorithm(name.c_str(), algorithm)) {
+            return Usage();
+        }
+        algorithms.push_back(algorithm);
+    }
+    PageCachePolicy cachePolicy = PageCachePolicy::Cached;
+    if (argc >= 5 && !ParsePageCachePolicyName(argv[4], cachePolicy)) {
+        return Usage();
+    }
+
+    int status = 0;
+    std::vector<HashResult> first;
+    printf("%-8s %-12s %10s  %s\n", "policy", "algorithm", "MB/s", "digest");
+    for (HashIoPolicy policy : {HashIoPolicy::Sync, HashIoPolicy::Async, HashIoPolicy::Mapped}) {
+        HashEngineOptions options;
+        options.policy = policy;
+        options.cachePolicy = cachePolicy;
+        uint64_t bytes = 0;
+        options.progress = [&](uint64_t processed, uint64_t) { bytes = processed; };
+        std::vector<HashResult> results = HashEngine(options).Hash(HashSource::FromPath(path), algorithms);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const HashResult& r = results[i];
+            double mbps = r.calculationTime > 0.0 ? bytes / r.calculationTime / (1024.0 * 1024.0) : 0.0;
+            printf("%-8s %-12ls %10.1f  %ls\n", GetHashIoPolicyName(policy), r.algorithm.c_str(), mbps,
+                   r.success ? r.result.c_str() : r.errorMessage.c_str());
+            if (!r.success || (!first.empty() && r.result != first[i].result)) {
+                status = 1;
+            }
+        }
+        if (first.empty()) {
+            first = results;
+        }
+    }
+    return status;
+}
+
+// Hashes the file from an evicted state under every cache and I/O policy;
+// shows throughput and how much of the file each run left in the page cache.
+int RunPageCache(int argc, char** argv) {
+    if (argc < 3) {
+        return Usage();
+    }
+    std::string path8 = argv[2];
+    std::wstring path(path8.begin(), path8.end());
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    if (argc >= 4 && !ParseAlgorithm(argv[3], algorithm)) {
+        return Usage();
+    }
+    std::vector<PageCacheBenchmarkResult> results = RunPageCacheBenchmark(path, algorithm);
+
+    int status = 0;
+    printf("%-11s %-7s %10s %12s  %s\n", "cache", "io", "MB/s", "cached MB", "digest");
+    for (const auto& r : results) {
+        printf("%-11s %-7s %10.1f %12.1f  %s\n", r.cachePolicy.c_str(), r.ioPolicy.c_str(), r.megabytesPerSecond,
+               r.cacheGrowthBytes / 1e6, r.error.empty() ? r.digest.c_str() : r.error.c_str());
+        if (!r.error.empty() || r.digest != results.front().digest) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// Sweeps algorithms, chunk sizes, I/O policies and backends, and file sizes
+// over inputs generated in each directory; prints a table as it goes and
+// writes the JSON report if asked.
+int RunSweep(int argc, char** argv) {
+    HashSweepOptions options;
+    std::string jsonPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (arg == "--warm") {
+            options.coldCache = false;
+            continue;
+        }
+        if (value == nullptr) {
+            return Usage();
+        }
+        ++i;
+        if (arg == "--json") {
+            jsonPath = value;
+        } else if (arg == "--dir") {
+            std::string dir = value;
+            options.directories.push_back(std::wstring(dir.begin(), dir.end()));
+        } else if (arg == "--algorithms") {
+            ok = ParseList(value, options.algorithms, [](const std::string& s, HashAlgorithm& a) { return ParseAlgorithm(s.c_str(), a); });
+        } else if (arg == "--chunks") {
+            ok = ParseList(value, options.chunkSizes, [](const std::string& s, size_t& n) {
+                uint64_t v = 0;
+                return ParseSize(s, v) && (n = static_cast<size_t>(v), true);
+            });
+        } else if (arg == "--policies") {
+            ok = ParseList(value, options.policies, [](const std::string& s, HashIoPolicy& p) { return ParseHashIoPolicyName(s, p); });
+        } else if (arg == "--backends") {
+            ok = ParseList(value, options.backends, [](const std::string& s, AsyncIoBackend& b) { return ParseAsyncIoBackendName(s, b); });
+        } else if (arg == "--sizes") {
+            ok = ParseList(value, options.fileSizes, [](const std::string& s, uint64_t& n) { return ParseSize(s, n) && n != 0; });
+        } else if (arg == "--rounds") {
+            options.rounds = atoi(value);
+            ok = options.rounds > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return Usage();
+        }
+    }
+
+    int status = 0;
+    printf("%-6s %-8s %-10s %-7s %8s %10s %8s %8s %9s %9s\n", "medium", "policy", "backend", "algo", "chunk", "size", "GB/s",
+           "cpu s", "reads", "ctxsw");
+    auto print = [&](const HashSweepResult& r) {
+        const HashSweepCase& c = r.sweepCase;
+        const char* backend = c.policy == HashIoPolicy::Async ? GetAsyncIoBackendName(c.backend) : "-";
+        if (!r.error.empty()) {
+            printf("%-6s %-8s %-10s %-7s %8zu %10llu  %s\n", c.medium.c_str(), GetHashIoPolicyName(c.policy), backend,
+                   GetDigestAlgorithmName(c.algorithm), c.chunkSize, static_cast<unsigned long long>(c.fileSize), r.error.c_str());
+            status = 1;
+            return;
+        }
+        printf("%-6s %-8s %-10s %-7s %8zu %10llu %8.3f %8.3f %9lld %9lld\n", c.medium.c_str(), GetHashIoPolicyName(c.policy), backend,
+               GetDigestAlgorithmName(c.algorithm), c.chunkSize, static_cast<unsigned long long>(c.fileSize), r.gigabytesPerSecond,
+               r.cpuSeconds, static_cast<long long>(r.readCalls), static_cast<long long>(r.contextSwitches));
+        fflush(stdout);
+    };
+    std::vector<HashSweepResult> results;
+    std::wstring error;
+    if (!RunHashSweep(options, print, results, error)) {
+        fprintf(stderr, "%ls\n", error.c_str());
+        return 2;
+    }
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath.c_str(), std::ios::binary);
+        out << BuildJsonHashSweep(options, results) << "\n";
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", jsonPath.c_str());
+            return 2;
+        }
+    }
+    return status;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return Usage();
+    }
+    if (strcmp(argv[1], "digest") == 0) {
+        return RunDigest(argc, argv);
+    }
+    if (strcmp(argv[1], "async") == 0) {
+        return RunAsync(argc, argv);
+    }
+    if (strcmp(argv[1], "engine") == 0) {
+        return RunEngine(argc, argv);
+    }
+    if (strcmp(argv[1], "pagecache") == 0) {
+        return RunPageCache(argc, argv);
+    }
+    if (strcmp(argv[1], "sweep") == 0) {
+        return RunSweep(argc, argv);
+    }
+    if (strcmp(argv[1], "strings") == 0) {
+        return RunStrings(argc, argv);
+    }
+    return Usage();
+}
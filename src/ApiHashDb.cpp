@@ -0,0 +1,415 @@
+#include "stdafx.h"
+#include "ApiHashDb.h"
+
+#include "PEParser.h"
+#include "ReportUtil.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <unordered_map>
+
+namespace {
+
+const char kApiHashDbMagic[8] = {'P', 'E', 'A', 'P', 'I', 'H', 'S', 'H'};
+const uint32_t kApiHashDbVersion = 1;
+
+#pragma pack(push, 1)
+struct ApiHashDbHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t recordsOffset;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+struct PendingRecord {
+    uint32_t hash;
+    uint16_t algorithm;
+    uint32_t nameIndex;
+};
+
+struct FileHashes {
+    std::string moduleName;
+    std::vector<std::string> names;
+    std::vector<PendingRecord> records;
+};
+
+uint32_t Ror32(uint32_t v, unsigned n) {
+    return (v >> n) | (v << (32 - n));
+}
+
+const uint32_t* Crc32Table() {
+    static const struct Table {
+        uint32_t v[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                v[i] = c;
+            }
+        }
+    } table;
+    return table.v;
+}
+
+std::string ToLowerAscii(std::string s) {
+    for (char& ch : s) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+    return s;
+}
+
+std::string ModuleNameFromPath(const std::wstring& path) {
+    size_t slash = path.find_last_of(L"\\/");
+    return ToLowerAscii(WStringToUtf8((slash == std::wstring::npos) ? path : path.substr(slash + 1)));
+}
+
+} // namespace
+
+std::vector<ApiHashAlgorithm> AllApiHashAlgorithms() {
+    return {ApiHashAlgorithm::Ror13, ApiHashAlgorithm::Djb2, ApiHashAlgorithm::Crc32, ApiHashAlgorithm::Fnv1_32, ApiHashAlgorithm::Fnv1a32};
+}
+
+std::string ApiHashAlgorithmName(uint16_t algorithm) {
+    std::string suffix = (algorithm & kApiHashWithModule) ? "+module" : "";
+    switch (static_cast<ApiHashAlgorithm>(algorithm & ~kApiHashWithModule)) {
+        case ApiHashAlgorithm::Ror13: return "ror13" + suffix;
+        case ApiHashAlgorithm::Djb2: return "djb2" + suffix;
+        case ApiHashAlgorithm::Crc32: return "crc32" + suffix;
+        case ApiHashAlgorithm::Fnv1_32: return "fnv1-32" + suffix;
+        case ApiHashAlgorithm::Fnv1a32: return "fnv1a-32" + suffix;
+    }
+    return "unknown" + suffix;
+}
+
+uint32_t ComputeApiHash(ApiHashAlgorithm algorithm, const char* s, size_t len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    uint32_t h = 0;
+    switch (algorithm) {
+        case ApiHashAlgorithm::Ror13:
+            for (size_t i = 0; i < len; ++i) {
+                h = Ror32(h, 13) + p[i];
+            }
+            return h;
+        case ApiHashAlgorithm::Djb2:
+            h = 5381;
+            for (size_t i = 0; i < len; ++i) {
+                h = h * 33 + p[i];
+            }
+            return h;
+        case ApiHashAlgorithm::Crc32: {
+            const uint32_t* table = Crc32Table();
+            h = 0xFFFFFFFFu;
+            for (size_t i = 0; i < len; ++i) {
+                h = table[(h ^ p[i]) & 0xFF] ^ (h >> 8);
+            }
+            return ~h;
+        }
+        case ApiHashAlgorithm::Fnv1_32:
+            h = 2166136261u;
+            for (size_t i = 0; i < len; ++i) {
+                h = (h * 16777619u) ^ p[i];
+            }
+            return h;
+        case ApiHashAlgorithm::Fnv1a32:
+            h = 2166136261u;
+            for (size_t i = 0; i < len; ++i) {
+                h = (h ^ p[i]) * 16777619u;
+            }
+            return h;
+    }
+    return 0;
+}
+
+uint32_t ComputeApiHashWithModule(ApiHashAlgorithm algorithm, const std::string& moduleName, const std::string& function) {
+    if (algorithm == ApiHashAlgorithm::Ror13) {
+        uint32_t moduleHash = 0;
+        for (char ch : moduleName) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            if (c >= 'a' && c <= 'z') {
+                c = static_cast<unsigned char>(c - 'a' + 'A');
+            }
+            moduleHash = Ror32(moduleHash, 13) + c;
+            moduleHash = Ror32(moduleHash, 13);
+        }
+        moduleHash = Ror32(Ror32(moduleHash, 13), 13);
+        uint32_t functionHash = ComputeApiHash(algorithm, function.c_str(), function.size() + 1);
+        return moduleHash + functionHash;
+    }
+    std::string lower = ToLowerAscii(moduleName);
+    return ComputeApiHash(algorithm, lower.data(), lower.size()) + ComputeApiHash(algorithm, function.data(), function.size());
+}
+
+bool BuildApiHashDb(const std::vector<std::wstring>& dllFiles,
+                    const ApiHashBuildOptions& opt,
+                    const std::wstring& outPath,
+                    size_t& recordCount,
+                    std::wstring& error) {
+    recordCount = 0;
+    std::vector<ApiHashAlgorithm> algorithms = opt.algorithms.empty() ? AllApiHashAlgorithms() : opt.algorithms;
+
+    std::vector<FileHashes> files(dllFiles.size());
+    RunParallel(dllFiles.size(), opt.threadCount, [&](size_t i) {
+        PEParser parser;
+        if (!parser.LoadFile(dllFiles[i])) {
+            return;
+        }
+        FileHashes& fh = files[i];
+        fh.moduleName = ModuleNameFromPath(dllFiles[i]);
+        for (const auto& e : parser.GetExports()) {
+            if (!e.hasName || e.name.empty()) {
+                continue;
+            }
+            uint32_t nameIndex = static_cast<uint32_t>(fh.names.size());
+            fh.names.push_back(e.name);
+            for (ApiHashAlgorithm alg : algorithms) {
+                fh.records.push_back(PendingRecord{ComputeApiHash(alg, e.name.data(), e.name.size()), static_cast<uint16_t>(alg), nameIndex});
+                if (opt.withModule) {
+                    fh.records.push_back(PendingRecord{ComputeApiHashWithModule(alg, fh.moduleName, e.name),
+                                                       static_cast<uint16_t>(static_cast<uint16_t>(alg) | kApiHashWithModule),
+                                                       nameIndex});
+                }
+            }
+        }
+    });
+
+    // String pool: module and export names are shared across the corpus.
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+    auto intern = [&](const std::string& s) -> uint32_t {
+        auto it = stringOffsets.find(s);
+        if (it != stringOffsets.end()) {
+            return it->second;
+        }
+        uint32_t off = static_cast<uint32_t>(strings.size());
+        strings.append(s);
+        strings.push_back('\0');
+        stringOffsets.emplace(s, off);
+        return off;
+    };
+
+    std::vector<ApiHashRecord> records;
+    size_t total = 0;
+    for (const auto& fh : files) {
+        total += fh.records.size();
+    }
+    records.reserve(total);
+    for (const auto& fh : files) {
+        if (fh.records.empty()) {
+            continue;
+        }
+        uint32_t moduleOffset = intern(fh.moduleName);
+        std::vector<uint32_t> nameOffsets(fh.names.size());
+        for (size_t n = 0; n < fh.names.size(); ++n) {
+            nameOffsets[n] = intern(fh.names[n]);
+        }
+        for (const auto& r : fh.records) {
+            records.push_back(ApiHashRecord{r.hash, r.algorithm, 0, moduleOffset, nameOffsets[r.nameIndex]});
+        }
+    }
+    std::sort(records.begin(), records.end(), [](const ApiHashRecord& a, const ApiHashRecord& b) {
+        if (a.hash != b.hash) return a.hash < b.hash;
+        if (a.algorithm != b.algorithm) return a.algorithm < b.algorithm;
+        if (a.moduleOffset != b.moduleOffset) return a.moduleOffset < b.moduleOffset;
+        return a.nameOffset < b.nameOffset;
+    });
+    records.erase(std::unique(records.begin(), records.end(), [](const ApiHashRecord& a, const ApiHashRecord& b) {
+                      return a.hash == b.hash && a.algorithm == b.algorithm && a.moduleOffset == b.moduleOffset &&
+                             a.nameOffset == b.nameOffset;
+                  }),
+                  records.end());
+
+    ApiHashDbHeader header = {};
+    memcpy(header.magic, kApiHashDbMagic, sizeof(header.magic));
+    header.version = kApiHashDbVersion;
+    header.recordCount = static_cast<uint32_t>(records.size());
+    header.recordsOffset = sizeof(ApiHashDbHeader);
+    header.stringsOffset = header.recordsOffset + static_cast<uint32_t>(records.size() * sizeof(ApiHashRecord));
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    std::string bytes;
+    bytes.reserve(header.stringsOffset + strings.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(ApiHashRecord));
+    bytes.append(strings);
+    if (!WriteAllBytes(outPath, bytes)) {
+        error = L"Failed to write hash database";
+        return false;
+    }
+    recordCount = records.size();
+    return true;
+}
+
+ApiHashDb::ApiHashDb()
+    : m_file(INVALID_HANDLE_VALUE),
+      m_mapping(nullptr),
+      m_view(nullptr),
+      m_viewSize(0),
+      m_records(nullptr),
+      m_recordCount(0),
+      m_strings(nullptr),
+      m_stringsSize(0) {
+}
+
+ApiHashDb::~ApiHashDb() {
+    Close();
+}
+
+bool ApiHashDb::Open(const std::wstring& path, std::wstring& error) {
+    Close();
+
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        error = L"Failed to open hash database";
+        return false;
+    }
+    LARGE_INTEGER li = {};
+    if (!GetFileSizeEx(m_file, &li) || li.QuadPart < static_cast<LONGLONG>(sizeof(ApiHashDbHeader))) {
+        error = L"Hash database is truncated";
+        Close();
+        return false;
+    }
+    m_viewSize = static_cast<size_t>(li.QuadPart);
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr) {
+        error = L"Failed to map hash database";
+        Close();
+        return false;
+    }
+    m_view = static_cast<const BYTE*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_view == nullptr) {
+        error = L"Failed to map hash database";
+        Close();
+        return false;
+    }
+
+    ApiHashDbHeader header = {};
+    memcpy(&header, m_view, sizeof(header));
+    uint64_t recordsEnd = static_cast<uint64_t>(header.recordsOffset) + static_cast<uint64_t>(header.recordCount) * sizeof(ApiHashRecord);
+    uint64_t stringsEnd = static_cast<uint64_t>(header.stringsOffset) + header.stringsSize;
+    if (memcmp(header.magic, kApiHashDbMagic, sizeof(header.magic)) != 0 || header.version != kApiHashDbVersion ||
+        recordsEnd > m_viewSize || stringsEnd > m_viewSize || header.recordsOffset % 4 != 0 ||
+        (header.stringsSize != 0 && m_view[stringsEnd - 1] != '\0')) {
+        error = L"Not a valid hash database";
+        Close();
+        return false;
+    }
+
+    m_records = reinterpret_cast<const ApiHashRecord*>(m_view + header.recordsOffset);
+    m_recordCount = header.recordCount;
+    m_strings = reinterpret_cast<const char*>(m_view + header.stringsOffset);
+    m_stringsSize = header.stringsSize;
+    return true;
+}
+
+void ApiHashDb::Close() {
+    if (m_view != nullptr) {
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_viewSize = 0;
+    m_records = nullptr;
+    m_recordCount = 0;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+size_t ApiHashDb::Lookup(uint32_t hash, const ApiHashRecord** first) const {
+    const ApiHashRecord* begin = m_records;
+    const ApiHashRecord* end = m_records + m_recordCount;
+    const ApiHashRecord* lo = std::lower_bound(begin, end, hash, [](const ApiHashRecord& r, uint32_t h) { return r.hash < h; });
+    const ApiHashRecord* hi = lo;
+    while (hi != end && hi->hash == hash) {
+        ++hi;
+    }
+    if (first != nullptr) {
+        *first = lo;
+    }
+    return static_cast<size_t>(hi - lo);
+}
+
+const char* ApiHashDb::GetString(uint32_t offset) const {
+    if (offset >= m_stringsSize) {
+        return "";
+    }
+    return m_strings + offset;
+}
+
+std::vector<std::wstring> ListDllFiles(const std::wstring& directory) {
+    std::vector<std::wstring> out;
+    std::wstring dir = directory;
+    if (!dir.empty() && dir.back() != L'\\' && dir.back() != L'/') {
+        dir.push_back(L'\\');
+    }
+    WIN32_FIND_DATAW fd = {};
+    HANDLE h = FindFirstFileW((dir + L"*.dll").c_str(), &fd);
+    if (h == INVALID_HANDLE_VALUE) {
+        return out;
+    }
+    do {
+        if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            out.push_back(dir + fd.cFileName);
+        }
+    } while (FindNextFileW(h, &fd));
+    FindClose(h);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+size_t AppendApiHashMatches(const ApiHashDb& db, const std::string& label, uint32_t hash, std::string& out) {
+    const ApiHashRecord* first = nullptr;
+    size_t count = db.Lookup(hash, &first);
+    for (size_t i = 0; i < count; ++i) {
+        char hex[16] = {};
+        sprintf_s(hex, "0x%08X", hash);
+        out += label;
+        out += "  ";
+        out += hex;
+        out += "  ";
+        out += ApiHashAlgorithmName(first[i].algorithm);
+        out += "  ";
+        out += db.GetString(first[i].moduleOffset);
+        out += "!";
+        out += db.GetString(first[i].nameOffset);
+        out += "\r\n";
+    }
+    return count;
+}
+
+bool ParseApiHashConstant(const std::wstring& text, uint32_t& value) {
+    std::wstring s = text;
+    if (s.size() > 2 && s[0] == L'0' && (s[1] == L'x' || s[1] == L'X')) {
+        s = s.substr(2);
+    } else if (!s.empty() && (s.back() == L'h' || s.back() == L'H')) {
+        s.pop_back();
+    }
+    if (s.empty() || s.size() > 8) {
+        return false;
+    }
+    uint32_t v = 0;
+    for (wchar_t ch : s) {
+        if (!std::iswxdigit(ch)) {
+            return false;
+        }
+        v = (v << 4) | static_cast<uint32_t>((ch <= L'9') ? (ch - L'0') : (std::towlower(ch) - L'a' + 10));
+    }
+    value = v;
+    return true;
+}
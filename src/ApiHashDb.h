@@ -0,0 +1,90 @@
+#pragma once
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ApiHashAlgorithm : uint16_t {
+    Ror13 = 0,
+    Djb2 = 1,
+    Crc32 = 2,
+    Fnv1_32 = 3,
+    Fnv1a32 = 4,
+};
+
+// Set on ApiHashRecord::algorithm when the hash also covers the module name.
+const uint16_t kApiHashWithModule = 0x8000;
+
+#pragma pack(push, 1)
+struct ApiHashRecord {
+    uint32_t hash;
+    uint16_t algorithm;
+    uint16_t reserved;
+    uint32_t moduleOffset;
+    uint32_t nameOffset;
+};
+#pragma pack(pop)
+
+struct ApiHashBuildOptions {
+    std::vector<ApiHashAlgorithm> algorithms;
+    // Also store module+function hashes. ror13 follows the common shellcode
+    // convention (UTF-16 upper-case module name with terminator, added to the
+    // function hash); the other algorithms add the lower-case module hash.
+    bool withModule = false;
+    size_t threadCount = 0;
+};
+
+std::vector<ApiHashAlgorithm> AllApiHashAlgorithms();
+std::string ApiHashAlgorithmName(uint16_t algorithm);
+
+uint32_t ComputeApiHash(ApiHashAlgorithm algorithm, const char* s, size_t len);
+uint32_t ComputeApiHashWithModule(ApiHashAlgorithm algorithm, const std::string& moduleName, const std::string& function);
+
+// Hashes every exported name of the given DLLs and writes a table sorted by
+// hash value. Parsing and hashing run in parallel, one file per work item.
+bool BuildApiHashDb(const std::vector<std::wstring>& dllFiles,
+                    const ApiHashBuildOptions& opt,
+                    const std::wstring& outPath,
+                    size_t& recordCount,
+                    std::wstring& error);
+
+// Read-only view of a table produced by BuildApiHashDb. The file is mapped, not
+// read, and lookups are a binary search over the mapped records.
+class ApiHashDb {
+public:
+    ApiHashDb();
+    ~ApiHashDb();
+    ApiHashDb(const ApiHashDb&) = delete;
+    ApiHashDb& operator=(const ApiHashDb&) = delete;
+
+    bool Open(const std::wstring& path, std::wstring& error);
+    void Close();
+
+    size_t GetRecordCount() const { return m_recordCount; }
+
+    // Returns the number of records with this hash; *first points at the first
+    // of them. Does not allocate.
+    size_t Lookup(uint32_t hash, const ApiHashRecord** first) const;
+    const char* GetString(uint32_t offset) const;
+
+private:
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const BYTE* m_view;
+    size_t m_viewSize;
+    const ApiHashRecord* m_records;
+    size_t m_recordCount;
+    const char* m_strings;
+    size_t m_stringsSize;
+};
+
+bool ParseApiHashConstant(const std::wstring& text, uint32_t& value);
+
+// Lists the *.dll files directly inside a directory.
+std::vector<std::wstring> ListDllFiles(const std::wstring& directory);
+
+// Appends one "label  0xHASH  algorithm  module!name" line per match.
+size_t AppendApiHashMatches(const ApiHashDb& db, const std::string& label, uint32_t hash, std::string& out);
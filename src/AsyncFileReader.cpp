@@ -0,0 +1,1008 @@
+#include "AsyncFileReader.h"
+
+#include "Digest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define PEINFO_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace {
+
+const size_t kAlignment = 4096;
+const size_t kMinChunk = 256u << 10;
+const size_t kMaxChunk = 2u << 20;
+const size_t kStartChunk = 512u << 10;
+const size_t kMaxDepth = 16;
+const size_t kStartDepth = 2;
+
+uint8_t* AlignedAlloc(size_t bytes) {
+#if defined(_WIN32)
+    return static_cast<uint8_t*>(_aligned_malloc(bytes, kAlignment));
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, kAlignment, bytes) != 0) {
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(p);
+#endif
+}
+
+void AlignedFree(uint8_t* p) {
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+size_t AlignUp(uint64_t value, size_t alignment) {
+    return static_cast<size_t>((value + alignment - 1) / alignment * alignment);
+}
+
+#if !defined(_WIN32)
+} // namespace
+
+std::string ToNativePath(const std::wstring& path) {
+    std::string out;
+    for (wchar_t wc : path) {
+        uint32_t c = static_cast<uint32_t>(wc);
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return out;
+}
+
+namespace {
+
+bool OpenPosix(const std::wstring& path, int& fd, uint64_t& size, std::wstring& error) {
+    fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = L"Failed to open file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = L"Failed to get file size";
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+#endif
+
+#if defined(_WIN32)
+class IocpReader : public AsyncFileReader {
+public:
+    IocpReader() : AsyncFileReader(AsyncIoBackend::Iocp) {}
+
+    ~IocpReader() override {
+        if (m_outstanding != 0) {
+            CancelIoEx(m_file, nullptr);
+            size_t slot = 0;
+            size_t bytes = 0;
+            std::wstring ignored;
+            while (m_outstanding != 0 && Wait(slot, bytes, ignored)) {
+            }
+        }
+        if (m_port != nullptr) {
+            CloseHandle(m_port);
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+    }
+
+    bool Submit(size_t slot, uint64_t fileOffset, size_t bufferOffset, size_t bytes, std::wstring& error) override {
+        SlotIo& io = m_io[slot];
+        std::memset(&io.ov, 0, sizeof(io.ov));
+        io.ov.Offset = static_cast<DWORD>(fileOffset & 0xFFFFFFFF);
+        io.ov.OffsetHigh = static_cast<DWORD>(fileOffset >> 32);
+        if (!ReadFile(m_file, GetSlotData(slot) + bufferOffset, static_cast<DWORD>(bytes), nullptr, &io.ov)) {
+            DWORD err = GetLastError();
+            if (err == ERROR_HANDLE_EOF) {
+                // Nothing was queued; deliver the empty read ourselves.
+                PostQueuedCompletionStatus(m_port, 0, 0, &io.ov);
+            } else if (err != ERROR_IO_PENDING) {
+                error = L"Failed to read file";
+                return false;
+            }
+        }
+        ++m_outstanding;
+        return true;
+    }
+
+    bool Wait(size_t& slot, size_t& bytes, std::wstring& error) override {
+        DWORD transferred = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED pov = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(m_port, &transferred, &key, &pov, INFINITE);
+        if (pov == nullptr) {
+            error = L"IOCP failure";
+            return false;
+        }
+        --m_outstanding;
+        // The OVERLAPPED is the first member of its slot record.
+        slot = static_cast<size_t>(CONTAINING_RECORD(pov, SlotIo, ov) - m_io.data());
+        bytes = transferred;
+        if (!ok) {
+            DWORD err = GetLastError();
+            if (err != ERROR_HANDLE_EOF && err != ERROR_OPERATION_ABORTED) {
+                error = L"Failed to read file";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void CancelAll() override {
+        CancelIoEx(m_file, nullptr);
+    }
+
+protected:
+    bool OpenFile(const std::wstring& path, std::wstring& error) override {
+        m_file = CreateFileW(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                             nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            error = L"Failed to open file";
+            return false;
+        }
+        LARGE_INTEGER li = {};
+        if (!GetFileSizeEx(m_file, &li)) {
+            error = L"Failed to get file size";
+            return false;
+        }
+        m_fileSize = static_cast<uint64_t>(li.QuadPart);
+        m_port = CreateIoCompletionPort(m_file, nullptr, 0, 1);
+        if (m_port == nullptr) {
+            error = L"Failed to create IOCP";
+            return false;
+        }
+        return true;
+    }
+
+    bool RegisterSlots(std::wstring&) override {
+        m_io.resize(m_slotCount);
+        return true;
+    }
+
+private:
+    struct SlotIo {
+        OVERLAPPED ov;
+    };
+
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_port = nullptr;
+    std::vector<SlotIo> m_io;
+    size_t m_outstanding = 0;
+};
+#endif
+
+#if defined(PEINFO_HAVE_IO_URING)
+int IoUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int IoUringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Containers and seccomp profiles often disable io_uring; probe once.
+bool IsIoUringUsable() {
+    static const bool usable = []() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = IoUringSetup(2, &params);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return true;
+    }();
+    return usable;
+}
+
+class IoUringReader : public AsyncFileReader {
+public:
+    IoUringReader() : AsyncFileReader(AsyncIoBackend::IoUring) {}
+
+    ~IoUringReader() override {
+        size_t slot = 0;
+        size_t bytes = 0;
+        std::wstring ignored;
+        while (m_outstanding != 0 && Wait(slot, bytes, ignored)) {
+        }
+        if (m_sqes != nullptr) {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqMap != nullptr && m_cqMap != m_sqMap) {
+            munmap(m_cqMap, m_cqMapSize);
+        }
+        if (m_sqMap != nullptr) {
+            munmap(m_sqMap, m_sqMapSize);
+        }
+        if (m_ring >= 0) {
+            close(m_ring);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool Submit(size_t slot, uint64_t fileOffset, size_t bufferOffset, size_t bytes, std::wstring& error) override {
+        unsigned tail = *m_sqTail;
+        if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) > *m_sqMask) {
+            error = L"io_uring submission queue full";
+            return false;
+        }
+        unsigned index = tail & *m_sqMask;
+        io_uring_sqe* sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = m_fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe->fd = m_fd;
+        sqe->off = fileOffset;
+        sqe->addr = reinterpret_cast<uint64_t>(GetSlotData(slot) + bufferOffset);
+        sqe->len = static_cast<uint32_t>(bytes);
+        sqe->buf_index = static_cast<uint16_t>(slot);
+        sqe->user_data = slot;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        // Entered lazily from Wait, so a burst of submissions costs one call.
+        ++m_toSubmit;
+        ++m_outstanding;
+        return true;
+    }
+
+    bool Wait(size_t& slot, size_t& bytes, std::wstring& error) override {
+        for (;;) {
+            unsigned head = *m_cqHead;
+            if (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+                slot = static_cast<size_t>(cqe.user_data);
+                int res = cqe.res;
+                __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+                --m_outstanding;
+                if (res < 0 && res != -ECANCELED) {
+                    error = L"Failed to read file";
+                    return false;
+                }
+                bytes = res < 0 ? 0 : static_cast<size_t>(res);
+                return true;
+            }
+            int ret = IoUringEnter(m_ring, m_toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error = L"io_uring_enter failed";
+                return false;
+            }
+            m_toSubmit -= std::min<unsigned>(m_toSubmit, static_cast<unsigned>(ret));
+        }
+    }
+
+    // Reads of regular files finish quickly; they are simply drained.
+    void CancelAll() override {}
+
+protected:
+    bool OpenFile(const std::wstring& path, std::wstring& error) override {
+        return OpenPosix(path, m_fd, m_fileSize, error);
+    }
+
+    bool RegisterSlots(std::wstring& error) override {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_ring = IoUringSetup(static_cast<unsigned>(m_slotCount), &params);
+        if (m_ring < 0) {
+            error = L"io_uring_setup failed";
+            return false;
+        }
+        m_sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            m_sqMapSize = m_cqMapSize = std::max<size_t>(m_sqMapSize, m_cqMapSize);
+        }
+        void* sq = mmap(nullptr, m_sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) {
+            error = L"io_uring mmap failed";
+            return false;
+        }
+        m_sqMap = sq;
+        if (single) {
+            m_cqMap = m_sqMap;
+        } else {
+            void* cq = mmap(nullptr, m_cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) {
+                error = L"io_uring mmap failed";
+                return false;
+            }
+            m_cqMap = cq;
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            error = L"io_uring mmap failed";
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        uint8_t* sqBase = static_cast<uint8_t*>(m_sqMap);
+        uint8_t* cqBase = static_cast<uint8_t*>(m_cqMap);
+        m_sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+        m_sqMask = reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+        m_cqMask = reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+        // Registered buffers skip the per-read page pinning. The kernel may
+        // refuse them (locked-memory limit); plain reads work the same.
+        std::vector<iovec> iov(m_slotCount);
+        for (size_t i = 0; i < m_slotCount; ++i) {
+            iov[i].iov_base = GetSlotData(i);
+            iov[i].iov_len = m_slotBytes;
+        }
+        m_fixedBuffers = IoUringRegister(m_ring, IORING_REGISTER_BUFFERS, iov.data(), static_cast<unsigned>(iov.size())) == 0;
+        return true;
+    }
+
+private:
+    int m_fd = -1;
+    int m_ring = -1;
+    void* m_sqMap = nullptr;
+    size_t m_sqMapSize = 0;
+    void* m_cqMap = nullptr;
+    size_t m_cqMapSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+    unsigned m_toSubmit = 0;
+    size_t m_outstanding = 0;
+    bool m_fixedBuffers = false;
+};
+#endif
+
+// Blocking positioned reads on one thread per slot; works wherever the
+// native backend does not.
+class ThreadPoolReader : public AsyncFileReader {
+public:
+    ThreadPoolReader() : AsyncFileReader(AsyncIoBackend::ThreadPool) {}
+
+    ~ThreadPoolReader() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cancelled = true;
+        }
+        m_requestCv.notify_all();
+        for (auto& t : m_threads) {
+            t.join();
+        }
+#if defined(_WIN32)
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+#else
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+#endif
+    }
+
+    bool Submit(size_t slot, uint64_t fileOffset, size_t bufferOffset, size_t bytes, std::wstring&) override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(Request{slot, fileOffset, bufferOffset, bytes});
+        }
+        m_requestCv.notify_one();
+        return true;
+    }
+
+    bool Wait(size_t& slot, size_t& bytes, std::wstring& error) override {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_doneCv.wait(lock, [&]() { return !m_done.empty(); });
+        Completion c = m_done.front();
+        m_done.pop_front();
+        slot = c.slot;
+        bytes = c.bytes;
+        if (c.failed) {
+            error = L"Failed to read file";
+            return false;
+        }
+        return true;
+    }
+
+    void CancelAll() override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+    }
+
+protected:
+    bool OpenFile(const std::wstring& path, std::wstring& error) override {
+#if defined(_WIN32)
+        // Overlapped, so that reads on different threads do not serialize on
+        // the file object; each worker waits for its own request.
+        m_file = CreateFileW(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                             nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            error = L"Failed to open file";
+            return false;
+        }
+        LARGE_INTEGER li = {};
+        if (!GetFileSizeEx(m_file, &li)) {
+            error = L"Failed to get file size";
+            return false;
+        }
+        m_fileSize = static_cast<uint64_t>(li.QuadPart);
+        return true;
+#else
+        return OpenPosix(path, m_fd, m_fileSize, error);
+#endif
+    }
+
+    bool RegisterSlots(std::wstring&) override {
+        m_threads.reserve(m_slotCount);
+        for (size_t i = 0; i < m_slotCount; ++i) {
+            m_threads.emplace_back([this]() { Worker(); });
+        }
+        return true;
+    }
+
+private:
+    struct Request {
+        size_t slot;
+        uint64_t fileOffset;
+        size_t bufferOffset;
+        size_t bytes;
+    };
+
+    struct Completion {
+        size_t slot;
+        size_t bytes;
+        bool failed;
+    };
+
+    // Reads until the request is full or the file ends.
+    bool ReadAt(uint8_t* dst, uint64_t offset, size_t bytes, size_t& got) {
+        got = 0;
+#if defined(_WIN32)
+        OVERLAPPED ov = {};
+        ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (ov.hEvent == nullptr) {
+            return false;
+        }
+        bool ok = true;
+        while (got < bytes) {
+            uint64_t at = offset + got;
+            ov.Offset = static_cast<DWORD>(at & 0xFFFFFFFF);
+            ov.OffsetHigh = static_cast<DWORD>(at >> 32);
+            ResetEvent(ov.hEvent);
+            DWORD n = 0;
+            if (!ReadFile(m_file, dst + got, static_cast<DWORD>(bytes - got), nullptr, &ov) && GetLastError() != ERROR_IO_PENDING) {
+                ok = GetLastError() == ERROR_HANDLE_EOF;
+                break;
+            }
+            if (!GetOverlappedResult(m_file, &ov, &n, TRUE)) {
+                ok = GetLastError() == ERROR_HANDLE_EOF;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            got += n;
+        }
+        CloseHandle(ov.hEvent);
+        return ok;
+#else
+        while (got < bytes) {
+            ssize_t n = pread(m_fd, dst + got, bytes - got, static_cast<off_t>(offset + got));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            got += static_cast<size_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    void Worker() {
+        for (;;) {
+            Request r;
+            bool skip = false;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_requestCv.wait(lock, [&]() { return m_stop || !m_requests.empty(); });
+                if (m_requests.empty()) {
+                    return;
+                }
+                r = m_requests.front();
+                m_requests.pop_front();
+                skip = m_cancelled;
+            }
+            size_t got = 0;
+            bool ok = skip || ReadAt(GetSlotData(r.slot) + r.bufferOffset, r.fileOffset, r.bytes, got);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done.push_back(Completion{r.slot, got, !ok});
+            }
+            m_doneCv.notify_one();
+        }
+    }
+
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_fd = -1;
+#endif
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_requestCv;
+    std::condition_variable m_doneCv;
+    std::deque<Request> m_requests;
+    std::deque<Completion> m_done;
+    bool m_stop = false;
+    bool m_cancelled = false;
+};
+
+// Hill climbing on the measured end-to-end rate (reads and the consumer
+// together): keep doubling the queue depth while each step is at least 5%
+// faster than the best so far, then do the same for the chunk size, then hold.
+// The rate includes the consumer, so a CPU-bound hash stops the growth early
+// instead of queueing memory it cannot use.
+class ReadTuner {
+public:
+    ReadTuner(size_t depth, size_t chunk, bool tuneDepth, bool tuneChunk, size_t maxDepth, size_t maxChunk)
+        : m_depth(depth), m_chunk(chunk), m_maxDepth(maxDepth), m_maxChunk(maxChunk),
+          m_phase(tuneDepth ? Phase::Depth : (tuneChunk ? Phase::Chunk : Phase::Done)), m_tuneChunk(tuneChunk) {
+        m_bestDepth = m_depth;
+        m_bestChunk = m_chunk;
+        if (m_phase != Phase::Done && !Step()) {
+            NextPhase();
+        }
+        m_windowStart = std::chrono::steady_clock::now();
+    }
+
+    size_t Depth() const { return m_depth; }
+    size_t Chunk() const { return m_chunk; }
+
+    void OnDelivered(size_t bytes) {
+        if (m_phase == Phase::Done) {
+            return;
+        }
+        m_windowBytes += bytes;
+        // Long enough to average out device and scheduler noise.
+        const uint64_t window = std::max<uint64_t>(32ull << 20, 8ull * m_depth * m_chunk);
+        if (m_windowBytes < window) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - m_windowStart).count();
+        double rate = seconds > 0.0 ? static_cast<double>(m_windowBytes) / seconds : 0.0;
+        m_windowBytes = 0;
+        m_windowStart = now;
+
+        if (m_bestRate == 0.0) {
+            // First window measures the starting point, before any step.
+            m_bestRate = rate;
+            m_depth = m_bestDepth;
+            m_chunk = m_bestChunk;
+            if (!Step()) {
+                NextPhase();
+            }
+            return;
+        }
+        if (rate > m_bestRate * 1.05) {
+            m_bestRate = rate;
+            m_bestDepth = m_depth;
+            m_bestChunk = m_chunk;
+            if (!Step()) {
+                NextPhase();
+            }
+        } else {
+            m_depth = m_bestDepth;
+            m_chunk = m_bestChunk;
+            NextPhase();
+        }
+    }
+
+private:
+    enum class Phase { Depth, Chunk, Done };
+
+    // Moves one step up in the current dimension; false when at the limit.
+    bool Step() {
+        if (m_bestRate == 0.0) {
+            return true;
+        }
+        if (m_phase == Phase::Depth && m_bestDepth * 2 <= m_maxDepth) {
+            m_depth = m_bestDepth * 2;
+            return true;
+        }
+        if (m_phase == Phase::Chunk && m_bestChunk * 2 <= m_maxChunk) {
+            m_chunk = m_bestChunk * 2;
+            return true;
+        }
+        return false;
+    }
+
+    void NextPhase() {
+        m_phase = (m_phase == Phase::Depth && m_tuneChunk) ? Phase::Chunk : Phase::Done;
+        if (m_phase != Phase::Done && !Step()) {
+            m_phase = Phase::Done;
+        }
+    }
+
+    size_t m_depth;
+    size_t m_chunk;
+    size_t m_maxDepth;
+    size_t m_maxChunk;
+    Phase m_phase;
+    bool m_tuneChunk;
+    size_t m_bestDepth = 0;
+    size_t m_bestChunk = 0;
+    double m_bestRate = 0.0;
+    uint64_t m_windowBytes = 0;
+    std::chrono::steady_clock::time_point m_windowStart;
+};
+
+} // namespace
+
+const char* GetAsyncIoBackendName(AsyncIoBackend backend) {
+    switch (backend) {
+        case AsyncIoBackend::Auto: return "auto";
+        case AsyncIoBackend::Iocp: return "iocp";
+        case AsyncIoBackend::IoUring: return "io_uring";
+        case AsyncIoBackend::ThreadPool: return "threadpool";
+        default: return "unknown";
+    }
+}
+
+bool ParseAsyncIoBackendName(const std::string& name, AsyncIoBackend& out) {
+    const AsyncIoBackend all[] = {AsyncIoBackend::Auto, AsyncIoBackend::Iocp, AsyncIoBackend::IoUring, AsyncIoBackend::ThreadPool};
+    for (AsyncIoBackend backend : all) {
+        if (name == GetAsyncIoBackendName(backend)) {
+            out = backend;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<AsyncIoBackend> GetAsyncIoBackends() {
+    std::vector<AsyncIoBackend> backends;
+#if defined(_WIN32)
+    backends.push_back(AsyncIoBackend::Iocp);
+#elif defined(PEINFO_HAVE_IO_URING)
+    if (IsIoUringUsable()) {
+        backends.push_back(AsyncIoBackend::IoUring);
+    }
+#endif
+    backends.push_back(AsyncIoBackend::ThreadPool);
+    return backends;
+}
+
+std::unique_ptr<AsyncFileReader> AsyncFileReader::Create(AsyncIoBackend backend) {
+    if (backend == AsyncIoBackend::Auto) {
+        backend = GetAsyncIoBackends().front();
+    }
+    switch (backend) {
+#if defined(_WIN32)
+        case AsyncIoBackend::Iocp: return std::unique_ptr<AsyncFileReader>(new IocpReader());
+#endif
+#if defined(PEINFO_HAVE_IO_URING)
+        case AsyncIoBackend::IoUring:
+            if (IsIoUringUsable()) {
+                return std::unique_ptr<AsyncFileReader>(new IoUringReader());
+            }
+            return nullptr;
+#endif
+        case AsyncIoBackend::ThreadPool: return std::unique_ptr<AsyncFileReader>(new ThreadPoolReader());
+        default: return nullptr;
+    }
+}
+
+AsyncFileReader::AsyncFileReader(AsyncIoBackend backend) : m_backend(backend) {
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    // Derived destructors have drained every outstanding read by now.
+    if (m_arena != nullptr) {
+        AlignedFree(m_arena);
+    }
+}
+
+bool AsyncFileReader::Open(const std::wstring& path, std::wstring& error) {
+    return OpenFile(path, error);
+}
+
+bool AsyncFileReader::SetupSlots(size_t slotCount, size_t slotBytes, std::wstring& error) {
+    m_slotCount = std::max<size_t>(1, slotCount);
+    m_slotBytes = AlignUp(std::max<size_t>(1, slotBytes), kAlignment);
+    m_arena = AlignedAlloc(m_slotCount * m_slotBytes);
+    if (m_arena == nullptr) {
+        error = L"Out of memory";
+        return false;
+    }
+    return RegisterSlots(error);
+}
+
+bool AsyncFileReader::RegisterSlots(std::wstring&) {
+    return true;
+}
+
+bool ReadFileAsync(const std::wstring& path,
+                   const AsyncReadOptions& options,
+                   const std::function<void(const uint8_t*, size_t)>& consume,
+                   AsyncReadStats& stats,
+                   std::wstring& error) {
+    auto start = std::chrono::steady_clock::now();
+    stats = AsyncReadStats();
+
+    // Declared first so that it closes last, and the purge that closing it
+    // does on Windows comes after the reader's reads.
+    PageCacheFile dropper;
+    if (options.cachePolicy != PageCachePolicy::Cached) {
+        std::wstring ignored;
+        dropper.Open(path, PageCachePolicy::DropBehind, ignored);
+    }
+
+    std::unique_ptr<AsyncFileReader> reader = AsyncFileReader::Create(options.backend);
+    if (!reader) {
+        error = L"I/O backend not available";
+        return false;
+    }
+    stats.backend = reader->GetBackend();
+    if (!reader->Open(path, error)) {
+        return false;
+    }
+    const uint64_t total = reader->GetFileSize();
+
+    const size_t maxChunk = options.chunkSize != 0 ? options.chunkSize : kMaxChunk;
+    const size_t maxDepth = options.queueDepth != 0 ? options.queueDepth : kMaxDepth;
+    ReadTuner tuner(options.queueDepth != 0 ? options.queueDepth : kStartDepth,
+                    options.chunkSize != 0 ? options.chunkSize : kStartChunk,
+                    options.queueDepth == 0,
+                    options.chunkSize == 0,
+                    maxDepth,
+                    maxChunk);
+
+    // Small files need neither the full arena nor every slot.
+    size_t slotBytes = std::min<size_t>(maxChunk, AlignUp(std::max<uint64_t>(total, 1), kAlignment));
+    size_t firstChunk = std::max<size_t>(kMinChunk, std::min<size_t>(tuner.Chunk(), slotBytes));
+    uint64_t chunksInFile = (total + firstChunk - 1) / firstChunk;
+    size_t slotCount = static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(maxDepth, chunksInFile)));
+    if (!reader->SetupSlots(slotCount, slotBytes, error)) {
+        return false;
+    }
+
+    struct SlotState {
+        uint64_t offset = 0;
+        size_t requested = 0;
+        size_t got = 0;
+        bool done = false;
+    };
+    std::vector<SlotState> slots(slotCount);
+    std::vector<size_t> freeSlots;
+    for (size_t i = slotCount; i > 0; --i) {
+        freeSlots.push_back(i - 1);
+    }
+    // Slots in file order; the front one is the next to hand to the consumer.
+    std::deque<size_t> order;
+
+    uint64_t nextOffset = 0;
+    uint64_t processed = 0;
+    size_t inFlight = 0;
+    bool stopped = false;
+    bool failed = false;
+    bool cancelled = false;
+    bool truncated = false;
+
+    auto stop = [&]() {
+        if (!stopped) {
+            stopped = true;
+            reader->CancelAll();
+        }
+    };
+    auto fail = [&](const std::wstring& message) {
+        if (!failed) {
+            failed = true;
+            error = message;
+        }
+        stop();
+    };
+
+    for (;;) {
+        while (!stopped && inFlight < tuner.Depth() && !freeSlots.empty() && nextOffset < total) {
+            size_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            size_t bytes = static_cast<size_t>(std::min<uint64_t>(std::min<size_t>(tuner.Chunk(), slotBytes), total - nextOffset));
+            slots[slot] = SlotState();
+            slots[slot].offset = nextOffset;
+            slots[slot].requested = bytes;
+            std::wstring submitError;
+            if (!reader->Submit(slot, nextOffset, 0, bytes, submitError)) {
+                freeSlots.push_back(slot);
+                fail(submitError);
+                break;
+            }
+            order.push_back(slot);
+            nextOffset += bytes;
+            ++inFlight;
+            ++stats.reads;
+        }
+        if (inFlight == 0) {
+            break;
+        }
+
+        size_t slot = SIZE_MAX;
+        size_t bytes = 0;
+        std::wstring waitError;
+        if (!reader->Wait(slot, bytes, waitError)) {
+            if (slot >= slotCount) {
+                // No completion to account for; nothing more will arrive.
+                error = waitError;
+                return false;
+            }
+            --inFlight;
+            slots[slot].done = true;
+            fail(waitError);
+            continue;
+        }
+        --inFlight;
+        SlotState& st = slots[slot];
+        st.got += bytes;
+        if (st.got < st.requested && bytes != 0 && !stopped) {
+            // Short read before the end: ask for the rest into the same slot.
+            std::wstring submitError;
+            if (reader->Submit(slot, st.offset + st.got, st.got, st.requested - st.got, submitError)) {
+                ++inFlight;
+                ++stats.reads;
+                continue;
+            }
+            fail(submitError);
+        }
+        if (st.got < st.requested && !stopped) {
+            truncated = true;
+            stop();
+        }
+        st.done = true;
+
+        while (!order.empty() && slots[order.front()].done) {
+            size_t s = order.front();
+            order.pop_front();
+            if (!failed && !cancelled && slots[s].got != 0) {
+                consume(reader->GetSlotData(s), slots[s].got);
+                if (dropper.IsOpen()) {
+                    dropper.Release(slots[s].offset, slots[s].got);
+                }
+                processed += slots[s].got;
+                tuner.OnDelivered(slots[s].got);
+                if (options.progress) {
+                    options.progress(processed, total);
+                }
+            }
+            freeSlots.push_back(s);
+        }
+        if (!stopped && options.cancel && options.cancel->load()) {
+            cancelled = true;
+            stop();
+        }
+    }
+
+    stats.bytes = processed;
+    stats.chunkSize = std::min<size_t>(tuner.Chunk(), slotBytes);
+    stats.queueDepth = std::min<size_t>(tuner.Depth(), slotCount);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (failed) {
+        return false;
+    }
+    if (cancelled) {
+        error = L"Cancelled";
+        return false;
+    }
+    if (truncated || processed != total) {
+        error = L"File changed while reading";
+        return false;
+    }
+    return true;
+}
+
+std::vector<AsyncReadBenchmarkResult> RunAsyncReadBenchmark(const std::wstring& path,
+                                                            HashAlgorithm algorithm,
+                                                            const std::vector<std::pair<size_t, size_t>>& fixedSettings) {
+    std::vector<std::pair<size_t, size_t>> settings;
+    settings.push_back(std::make_pair(size_t(0), size_t(0)));
+    settings.insert(settings.end(), fixedSettings.begin(), fixedSettings.end());
+
+    std::vector<AsyncReadBenchmarkResult> results;
+    for (AsyncIoBackend backend : GetAsyncIoBackends()) {
+        for (const auto& setting : settings) {
+            AsyncReadBenchmarkResult res;
+            res.backend = GetAsyncIoBackendName(backend);
+            res.chunkSize = setting.first;
+            res.queueDepth = setting.second;
+
+            AsyncReadOptions options;
+            options.backend = backend;
+            options.chunkSize = setting.first;
+            options.queueDepth = setting.second;
+            Digest digest(algorithm);
+            std::wstring error;
+            bool ok = ReadFileAsync(path, options, [&](const uint8_t* data, size_t size) { digest.Update(data, size); }, res.stats, error);
+            std::wstring text = digest.FinalText();
+            res.algorithm = GetDigestAlgorithmName(algorithm);
+            res.digest.assign(text.begin(), text.end());
+            if (!ok) {
+                res.error.assign(error.begin(), error.end());
+            } else if (res.stats.seconds > 0.0) {
+                res.megabytesPerSecond = (static_cast<double>(res.stats.bytes) / 1e6) / res.stats.seconds;
+            }
+            results.push_back(res);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+#include "PageCacheIo.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Overlapped file reading with interchangeable backends: IOCP on Windows,
+// io_uring on Linux, and positioned reads on a small thread pool everywhere.
+// Builds without Windows headers on other platforms.
+
+enum class AsyncIoBackend {
+    Auto,
+    Iocp,
+    IoUring,
+    ThreadPool
+};
+
+const char* GetAsyncIoBackendName(AsyncIoBackend backend);
+bool ParseAsyncIoBackendName(const std::string& name, AsyncIoBackend& out);
+// Backends compiled into this binary, Auto excluded.
+std::vector<AsyncIoBackend> GetAsyncIoBackends();
+
+#if !defined(_WIN32)
+// UTF-8 file name for the POSIX calls.
+std::string ToNativePath(const std::wstring& path);
+#endif
+
+// One open file plus a fixed set of equally sized, page-aligned read slots.
+// The slots are allocated once and, where the kernel supports it, registered
+// with it up front. Every request carries its slot index, so a completion
+// maps back to its buffer without a search.
+class AsyncFileReader {
+public:
+    // Auto picks the native backend and falls back to the thread pool when it
+    // cannot be set up (for example io_uring disabled by the kernel).
+    static std::unique_ptr<AsyncFileReader> Create(AsyncIoBackend backend);
+
+    virtual ~AsyncFileReader();
+
+    AsyncIoBackend GetBackend() const { return m_backend; }
+
+    bool Open(const std::wstring& path, std::wstring& error);
+    uint64_t GetFileSize() const { return m_fileSize; }
+    // Allocates the slots; call once, after Open.
+    bool SetupSlots(size_t slotCount, size_t slotBytes, std::wstring& error);
+    size_t GetSlotCount() const { return m_slotCount; }
+    size_t GetSlotBytes() const { return m_slotBytes; }
+    uint8_t* GetSlotData(size_t slot) { return m_arena + slot * m_slotBytes; }
+
+    // Reads bytes at fileOffset into the slot, starting bufferOffset bytes in.
+    virtual bool Submit(size_t slot, uint64_t fileOffset, size_t bufferOffset, size_t bytes, std::wstring& error) = 0;
+    // Blocks until some submitted read finishes. A read that stops short of
+    // the requested size is not an error; the caller decides whether it hit
+    // the end of the file.
+    virtual bool Wait(size_t& slot, size_t& bytes, std::wstring& error) = 0;
+    // Asks outstanding reads to stop early; they still complete through Wait.
+    virtual void CancelAll() = 0;
+
+protected:
+    explicit AsyncFileReader(AsyncIoBackend backend);
+
+    virtual bool OpenFile(const std::wstring& path, std::wstring& error) = 0;
+    virtual bool RegisterSlots(std::wstring& error);
+
+    AsyncIoBackend m_backend;
+    uint64_t m_fileSize = 0;
+    size_t m_slotCount = 0;
+    size_t m_slotBytes = 0;
+    uint8_t* m_arena = nullptr;
+};
+
+struct AsyncReadOptions {
+    AsyncIoBackend backend = AsyncIoBackend::Auto;
+    // 0 = tuned while reading; a fixed value turns tuning off for that knob.
+    size_t chunkSize = 0;
+    size_t queueDepth = 0;
+    // Reads are cached; under DropBehind and Direct each range is dropped
+    // from the cache once it has been handed to the consumer.
+    PageCachePolicy cachePolicy = PageCachePolicy::Cached;
+    std::atomic<bool>* cancel = nullptr;
+    // (processed, total), after every chunk handed to the consumer.
+    std::function<void(uint64_t, uint64_t)> progress;
+};
+
+struct AsyncReadStats {
+    AsyncIoBackend backend = AsyncIoBackend::Auto;
+    uint64_t bytes = 0;
+    uint64_t reads = 0;
+    double seconds = 0.0;
+    // Settings the tuner ended up with.
+    size_t chunkSize = 0;
+    size_t queueDepth = 0;
+};
+
+// Reads the whole file with several requests in flight and hands the data to
+// consume strictly in file order, whatever order the reads complete in.
+// Returns false with error set on failure or cancellation ("Cancelled").
+bool ReadFileAsync(const std::wstring& path,
+                   const AsyncReadOptions& options,
+                   const std::function<void(const uint8_t*, size_t)>& consume,
+                   AsyncReadStats& stats,
+                   std::wstring& error);
+
+struct AsyncReadBenchmarkResult {
+    std::string backend;
+    std::string algorithm;
+    // Every run must produce the same digest.
+    std::string digest;
+    size_t chunkSize = 0;  // 0 = tuned
+    size_t queueDepth = 0; // 0 = tuned
+    AsyncReadStats stats;
+    double megabytesPerSecond = 0.0;
+    std::string error;
+};
+
+// Hashes the file with every backend, once tuned and once per fixed
+// (chunk size, queue depth) pair given. Use a file larger than RAM, or drop
+// the page cache first, to measure the storage rather than the cache.
+std::vector<AsyncReadBenchmarkResult> RunAsyncReadBenchmark(const std::wstring& path,
+                                                            HashAlgorithm algorithm,
+                                                            const std::vector<std::pair<size_t, size_t>>& fixedSettings);
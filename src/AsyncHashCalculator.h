@@ -1,34 +1,41 @@
 #pragma once
 
 #include <windows.h>
-#include <wincrypt.h>
 #include <string>
 #include <vector>
 #include <functional>
 #include <atomic>
 #include <chrono>
 
-#pragma comment(lib, "advapi32.lib")
-
-enum class HashAlgorithm;
-struct HashResult;
+#include "AsyncFileReader.h"
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
 
+// Hashes one file with several reads in flight: HashEngine with the Async
+// policy. Chunk size and queue depth are tuned from the measured throughput
+// unless set.
 class AsyncHashCalculator {
 public:
     AsyncHashCalculator();
     ~AsyncHashCalculator();
 
+    // 0 = tuned (the default).
     void SetChunkSize(size_t bytes);
+    void SetQueueDepth(size_t depth);
+    void SetBackend(AsyncIoBackend backend);
+    // Called with (processed, total), like the other progress callbacks.
     void SetProgressCallback(std::function<void(uint64_t, uint64_t)> cb);
     void SetCancelFlag(std::atomic<bool>* flag);
     HashResult CalculateFileHash(const std::wstring& filePath, HashAlgorithm algorithm);
 
-private:
-    ALG_ID GetCryptoAPIAlgId(HashAlgorithm algorithm);
-    std::wstring BytesToHexString(const std::vector<BYTE>& bytes);
+    // Backend and settings of the last CalculateFileHash call.
+    const AsyncReadStats& GetLastStats() const { return m_lastStats; }
 
 private:
-    size_t m_chunkSize = (1u << 20);
+    size_t m_chunkSize = 0;
+    size_t m_queueDepth = 0;
+    AsyncIoBackend m_backend = AsyncIoBackend::Auto;
     std::function<void(uint64_t, uint64_t)> m_progress;
     std::atomic<bool>* m_cancel = nullptr;
+    AsyncReadStats m_lastStats;
 };
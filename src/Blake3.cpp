@@ -0,0 +1,929 @@
+#include "Blake3.h"
+
+#include "CpuFeatures.h"
+#include "HashState.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_BLAKE3_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#define PEINFO_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#define PEINFO_TARGET_AVX512
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_BLAKE3_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const size_t kChunkLen = 1024;
+const size_t kBlockLen = 64;
+const size_t kBatchBytes = 16u << 20;
+// Smallest piece of a subtree worth handing to another thread.
+const size_t kMinPartChunks = 256;
+
+const uint32_t kChunkStart = 1;
+const uint32_t kChunkEnd = 2;
+const uint32_t kParent = 4;
+const uint32_t kRoot = 8;
+
+const uint32_t kIv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+const uint8_t kMsgSchedule[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+inline uint32_t Rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t LoadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline void G(uint32_t* v, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+    v[a] = v[a] + v[b] + x;
+    v[d] = Rotr(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = Rotr(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + y;
+    v[d] = Rotr(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = Rotr(v[b] ^ v[c], 7);
+}
+
+inline void Round(uint32_t* v, const uint32_t* m, const uint8_t* s) {
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+// Compression function; writes the 8-word chaining value (the first half of
+// the output, which is all the hash mode needs).
+void Compress(const uint32_t* cv, const uint8_t* block, uint32_t blockLen, uint64_t counter, uint32_t flags, uint32_t* out) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i) {
+        m[i] = LoadLe32(block + 4 * i);
+    }
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        kIv[0], kIv[1], kIv[2], kIv[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), blockLen, flags,
+    };
+    // Unrolled so the schedule indices fold into constants.
+    Round(v, m, kMsgSchedule[0]);
+    Round(v, m, kMsgSchedule[1]);
+    Round(v, m, kMsgSchedule[2]);
+    Round(v, m, kMsgSchedule[3]);
+    Round(v, m, kMsgSchedule[4]);
+    Round(v, m, kMsgSchedule[5]);
+    Round(v, m, kMsgSchedule[6]);
+    for (int i = 0; i < 8; ++i) {
+        out[i] = v[i] ^ v[i + 8];
+    }
+}
+
+void StoreCv(uint8_t* out, const uint32_t* cv) {
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(cv[i]);
+        out[4 * i + 1] = static_cast<uint8_t>(cv[i] >> 8);
+        out[4 * i + 2] = static_cast<uint8_t>(cv[i] >> 16);
+        out[4 * i + 3] = static_cast<uint8_t>(cv[i] >> 24);
+    }
+}
+
+// Inputs to the last compression of a node, kept back until we know whether
+// the node is the root.
+struct Output {
+    uint32_t cv[8];
+    uint8_t block[64];
+    uint32_t blockLen;
+    uint64_t counter;
+    uint32_t flags;
+
+    void ChainingValue(uint32_t* out) const {
+        Compress(cv, block, blockLen, counter, flags, out);
+    }
+    void RootBytes(uint8_t* out) const {
+        uint32_t words[8];
+        Compress(cv, block, blockLen, 0, flags | kRoot, words);
+        StoreCv(out, words);
+    }
+};
+
+Output ParentOutput(const uint32_t* left, const uint32_t* right) {
+    Output o;
+    std::memcpy(o.cv, kIv, sizeof(kIv));
+    StoreCv(o.block, left);
+    StoreCv(o.block + 32, right);
+    o.blockLen = static_cast<uint32_t>(kBlockLen);
+    o.counter = 0;
+    o.flags = kParent;
+    return o;
+}
+
+void ParentCv(const uint32_t* left, const uint32_t* right, uint32_t* out) {
+    ParentOutput(left, right).ChainingValue(out);
+}
+
+// Chaining value of one complete, non-root chunk.
+void ChunkCv(const uint8_t* input, uint64_t counter, uint32_t* out) {
+    uint32_t cv[8];
+    std::memcpy(cv, kIv, sizeof(kIv));
+    for (size_t b = 0; b < kChunkLen / kBlockLen; ++b) {
+        uint32_t flags = 0;
+        if (b == 0) {
+            flags |= kChunkStart;
+        }
+        if (b + 1 == kChunkLen / kBlockLen) {
+            flags |= kChunkEnd;
+        }
+        Compress(cv, input + b * kBlockLen, static_cast<uint32_t>(kBlockLen), counter, flags, cv);
+    }
+    std::memcpy(out, cv, sizeof(cv));
+}
+
+// The lane functions hash `lanes` consecutive whole chunks side by side and
+// write their chaining values to cvs[lane * 8 + word].
+typedef void (*ChunkLanesFn)(const uint8_t* input, uint64_t counter, uint32_t* cvs);
+
+#if defined(PEINFO_BLAKE3_X86)
+namespace sse2 {
+
+PEINFO_TARGET_SSE2
+inline __m128i Add(__m128i x, __m128i y) {
+    return _mm_add_epi32(x, y);
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i Xor(__m128i x, __m128i y) {
+    return _mm_xor_si128(x, y);
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i Load(const uint32_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+PEINFO_TARGET_SSE2
+inline void Store(uint32_t* p, __m128i x) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+}
+
+template <int n>
+PEINFO_TARGET_SSE2
+inline __m128i Rotr(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n));
+}
+
+PEINFO_TARGET_SSE2
+inline void G(__m128i* v, int a, int b, int c, int d, __m128i x, __m128i y) {
+    v[a] = Add(Add(v[a], v[b]), x);
+    v[d] = Rotr<16>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<12>(Xor(v[b], v[c]));
+    v[a] = Add(Add(v[a], v[b]), y);
+    v[d] = Rotr<8>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<7>(Xor(v[b], v[c]));
+}
+
+PEINFO_TARGET_SSE2
+inline void Round(__m128i* v, const __m128i* m, const uint8_t* s) {
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+PEINFO_TARGET_SSE2
+void HashChunks(const uint8_t* input, uint64_t counter, uint32_t* cvs) {
+    const size_t lanes = 4;
+    uint32_t lane[lanes];
+    __m128i cv[8];
+    for (int i = 0; i < 8; ++i) {
+        cv[i] = _mm_set1_epi32(kIv[i]);
+    }
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>(counter + l);
+    }
+    const __m128i counterLo = Load(lane);
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>((counter + l) >> 32);
+    }
+    const __m128i counterHi = Load(lane);
+
+    for (size_t b = 0; b < kChunkLen / kBlockLen; ++b) {
+        __m128i m[16];
+        for (int i = 0; i < 16; ++i) {
+            for (size_t l = 0; l < lanes; ++l) {
+                lane[l] = LoadLe32(input + l * kChunkLen + b * kBlockLen + 4 * i);
+            }
+            m[i] = Load(lane);
+        }
+        uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == kChunkLen / kBlockLen ? kChunkEnd : 0);
+        __m128i v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            _mm_set1_epi32(kIv[0]), _mm_set1_epi32(kIv[1]), _mm_set1_epi32(kIv[2]), _mm_set1_epi32(kIv[3]),
+            counterLo, counterHi, _mm_set1_epi32(static_cast<uint32_t>(kBlockLen)), _mm_set1_epi32(flags),
+        };
+        Round(v, m, kMsgSchedule[0]);
+        Round(v, m, kMsgSchedule[1]);
+        Round(v, m, kMsgSchedule[2]);
+        Round(v, m, kMsgSchedule[3]);
+        Round(v, m, kMsgSchedule[4]);
+        Round(v, m, kMsgSchedule[5]);
+        Round(v, m, kMsgSchedule[6]);
+        for (int i = 0; i < 8; ++i) {
+            cv[i] = Xor(v[i], v[i + 8]);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Store(lane, cv[i]);
+        for (size_t l = 0; l < lanes; ++l) {
+            cvs[l * 8 + i] = lane[l];
+        }
+    }
+}
+
+} // namespace sse2
+
+namespace avx2 {
+
+PEINFO_TARGET_AVX2
+inline __m256i Add(__m256i x, __m256i y) {
+    return _mm256_add_epi32(x, y);
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i Xor(__m256i x, __m256i y) {
+    return _mm256_xor_si256(x, y);
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i Load(const uint32_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+PEINFO_TARGET_AVX2
+inline void Store(uint32_t* p, __m256i x) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+}
+
+template <int n>
+PEINFO_TARGET_AVX2
+inline __m256i Rotr(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+PEINFO_TARGET_AVX2
+inline void G(__m256i* v, int a, int b, int c, int d, __m256i x, __m256i y) {
+    v[a] = Add(Add(v[a], v[b]), x);
+    v[d] = Rotr<16>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<12>(Xor(v[b], v[c]));
+    v[a] = Add(Add(v[a], v[b]), y);
+    v[d] = Rotr<8>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<7>(Xor(v[b], v[c]));
+}
+
+PEINFO_TARGET_AVX2
+inline void Round(__m256i* v, const __m256i* m, const uint8_t* s) {
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+PEINFO_TARGET_AVX2
+void HashChunks(const uint8_t* input, uint64_t counter, uint32_t* cvs) {
+    const size_t lanes = 8;
+    uint32_t lane[lanes];
+    __m256i cv[8];
+    for (int i = 0; i < 8; ++i) {
+        cv[i] = _mm256_set1_epi32(kIv[i]);
+    }
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>(counter + l);
+    }
+    const __m256i counterLo = Load(lane);
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>((counter + l) >> 32);
+    }
+    const __m256i counterHi = Load(lane);
+
+    for (size_t b = 0; b < kChunkLen / kBlockLen; ++b) {
+        __m256i m[16];
+        for (int i = 0; i < 16; ++i) {
+            for (size_t l = 0; l < lanes; ++l) {
+                lane[l] = LoadLe32(input + l * kChunkLen + b * kBlockLen + 4 * i);
+            }
+            m[i] = Load(lane);
+        }
+        uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == kChunkLen / kBlockLen ? kChunkEnd : 0);
+        __m256i v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            _mm256_set1_epi32(kIv[0]), _mm256_set1_epi32(kIv[1]), _mm256_set1_epi32(kIv[2]), _mm256_set1_epi32(kIv[3]),
+            counterLo, counterHi, _mm256_set1_epi32(static_cast<uint32_t>(kBlockLen)), _mm256_set1_epi32(flags),
+        };
+        Round(v, m, kMsgSchedule[0]);
+        Round(v, m, kMsgSchedule[1]);
+        Round(v, m, kMsgSchedule[2]);
+        Round(v, m, kMsgSchedule[3]);
+        Round(v, m, kMsgSchedule[4]);
+        Round(v, m, kMsgSchedule[5]);
+        Round(v, m, kMsgSchedule[6]);
+        for (int i = 0; i < 8; ++i) {
+            cv[i] = Xor(v[i], v[i + 8]);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Store(lane, cv[i]);
+        for (size_t l = 0; l < lanes; ++l) {
+            cvs[l * 8 + i] = lane[l];
+        }
+    }
+}
+
+} // namespace avx2
+
+namespace avx512 {
+
+PEINFO_TARGET_AVX512
+inline __m512i Add(__m512i x, __m512i y) {
+    return _mm512_add_epi32(x, y);
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i Xor(__m512i x, __m512i y) {
+    return _mm512_xor_si512(x, y);
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i Load(const uint32_t* p) {
+    return _mm512_loadu_si512(p);
+}
+
+PEINFO_TARGET_AVX512
+inline void Store(uint32_t* p, __m512i x) {
+    _mm512_storeu_si512(p, x);
+}
+
+template <int n>
+PEINFO_TARGET_AVX512
+inline __m512i Rotr(__m512i x) {
+    return _mm512_ror_epi32(x, n);
+}
+
+PEINFO_TARGET_AVX512
+inline void G(__m512i* v, int a, int b, int c, int d, __m512i x, __m512i y) {
+    v[a] = Add(Add(v[a], v[b]), x);
+    v[d] = Rotr<16>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<12>(Xor(v[b], v[c]));
+    v[a] = Add(Add(v[a], v[b]), y);
+    v[d] = Rotr<8>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<7>(Xor(v[b], v[c]));
+}
+
+PEINFO_TARGET_AVX512
+inline void Round(__m512i* v, const __m512i* m, const uint8_t* s) {
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+PEINFO_TARGET_AVX512
+void HashChunks(const uint8_t* input, uint64_t counter, uint32_t* cvs) {
+    const size_t lanes = 16;
+    uint32_t lane[lanes];
+    __m512i cv[8];
+    for (int i = 0; i < 8; ++i) {
+        cv[i] = _mm512_set1_epi32(kIv[i]);
+    }
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>(counter + l);
+    }
+    const __m512i counterLo = Load(lane);
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>((counter + l) >> 32);
+    }
+    const __m512i counterHi = Load(lane);
+
+    for (size_t b = 0; b < kChunkLen / kBlockLen; ++b) {
+        __m512i m[16];
+        for (int i = 0; i < 16; ++i) {
+            for (size_t l = 0; l < lanes; ++l) {
+                lane[l] = LoadLe32(input + l * kChunkLen + b * kBlockLen + 4 * i);
+            }
+            m[i] = Load(lane);
+        }
+        uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == kChunkLen / kBlockLen ? kChunkEnd : 0);
+        __m512i v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            _mm512_set1_epi32(kIv[0]), _mm512_set1_epi32(kIv[1]), _mm512_set1_epi32(kIv[2]), _mm512_set1_epi32(kIv[3]),
+            counterLo, counterHi, _mm512_set1_epi32(static_cast<uint32_t>(kBlockLen)), _mm512_set1_epi32(flags),
+        };
+        Round(v, m, kMsgSchedule[0]);
+        Round(v, m, kMsgSchedule[1]);
+        Round(v, m, kMsgSchedule[2]);
+        Round(v, m, kMsgSchedule[3]);
+        Round(v, m, kMsgSchedule[4]);
+        Round(v, m, kMsgSchedule[5]);
+        Round(v, m, kMsgSchedule[6]);
+        for (int i = 0; i < 8; ++i) {
+            cv[i] = Xor(v[i], v[i + 8]);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Store(lane, cv[i]);
+        for (size_t l = 0; l < lanes; ++l) {
+            cvs[l * 8 + i] = lane[l];
+        }
+    }
+}
+
+} // namespace avx512
+#elif defined(PEINFO_BLAKE3_NEON)
+namespace neon {
+
+inline uint32x4_t Add(uint32x4_t x, uint32x4_t y) {
+    return vaddq_u32(x, y);
+}
+
+inline uint32x4_t Xor(uint32x4_t x, uint32x4_t y) {
+    return veorq_u32(x, y);
+}
+
+inline uint32x4_t Load(const uint32_t* p) {
+    return vld1q_u32(p);
+}
+
+inline void Store(uint32_t* p, uint32x4_t x) {
+    vst1q_u32(p, x);
+}
+
+template <int n>
+inline uint32x4_t Rotr(uint32x4_t x) {
+    return vorrq_u32(vshrq_n_u32(x, n), vshlq_n_u32(x, 32 - n));
+}
+
+inline void G(uint32x4_t* v, int a, int b, int c, int d, uint32x4_t x, uint32x4_t y) {
+    v[a] = Add(Add(v[a], v[b]), x);
+    v[d] = Rotr<16>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<12>(Xor(v[b], v[c]));
+    v[a] = Add(Add(v[a], v[b]), y);
+    v[d] = Rotr<8>(Xor(v[d], v[a]));
+    v[c] = Add(v[c], v[d]);
+    v[b] = Rotr<7>(Xor(v[b], v[c]));
+}
+
+inline void Round(uint32x4_t* v, const uint32x4_t* m, const uint8_t* s) {
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+void HashChunks(const uint8_t* input, uint64_t counter, uint32_t* cvs) {
+    const size_t lanes = 4;
+    uint32_t lane[lanes];
+    uint32x4_t cv[8];
+    for (int i = 0; i < 8; ++i) {
+        cv[i] = vdupq_n_u32(kIv[i]);
+    }
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>(counter + l);
+    }
+    const uint32x4_t counterLo = Load(lane);
+    for (size_t l = 0; l < lanes; ++l) {
+        lane[l] = static_cast<uint32_t>((counter + l) >> 32);
+    }
+    const uint32x4_t counterHi = Load(lane);
+
+    for (size_t b = 0; b < kChunkLen / kBlockLen; ++b) {
+        uint32x4_t m[16];
+        for (int i = 0; i < 16; ++i) {
+            for (size_t l = 0; l < lanes; ++l) {
+                lane[l] = LoadLe32(input + l * kChunkLen + b * kBlockLen + 4 * i);
+            }
+            m[i] = Load(lane);
+        }
+        uint32_t flags = (b == 0 ? kChunkStart : 0) | (b + 1 == kChunkLen / kBlockLen ? kChunkEnd : 0);
+        uint32x4_t v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            vdupq_n_u32(kIv[0]), vdupq_n_u32(kIv[1]), vdupq_n_u32(kIv[2]), vdupq_n_u32(kIv[3]),
+            counterLo, counterHi, vdupq_n_u32(static_cast<uint32_t>(kBlockLen)), vdupq_n_u32(flags),
+        };
+        Round(v, m, kMsgSchedule[0]);
+        Round(v, m, kMsgSchedule[1]);
+        Round(v, m, kMsgSchedule[2]);
+        Round(v, m, kMsgSchedule[3]);
+        Round(v, m, kMsgSchedule[4]);
+        Round(v, m, kMsgSchedule[5]);
+        Round(v, m, kMsgSchedule[6]);
+        for (int i = 0; i < 8; ++i) {
+            cv[i] = Xor(v[i], v[i + 8]);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Store(lane, cv[i]);
+        for (size_t l = 0; l < lanes; ++l) {
+            cvs[l * 8 + i] = lane[l];
+        }
+    }
+}
+
+} // namespace neon
+#endif
+
+struct ChunkLanes {
+    const char* name;
+    size_t lanes;
+    ChunkLanesFn hash;
+};
+
+const ChunkLanes& GetChunkLanes() {
+    static const ChunkLanes active = []() {
+        ChunkLanes best = {"portable", 1, nullptr};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_BLAKE3_X86)
+        if (cpu.avx512f) {
+            best = {"avx512", 16, avx512::HashChunks};
+        } else if (cpu.avx2) {
+            best = {"avx2", 8, avx2::HashChunks};
+        } else if (cpu.sse2) {
+            best = {"sse2", 4, sse2::HashChunks};
+        }
+#elif defined(PEINFO_BLAKE3_NEON)
+        (void)cpu;
+        best = {"neon", 4, neon::HashChunks};
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+// Subtrees up to this many chunks are hashed as one lane batch.
+const size_t kLeafChunks = 16;
+
+// Chaining value of a complete, non-root subtree of chunks (a power of two).
+void SubtreeCv(const uint8_t* input, size_t chunks, uint64_t counter, uint32_t* out) {
+    if (chunks <= kLeafChunks) {
+        const ChunkLanes& lanes = GetChunkLanes();
+        uint32_t cvs[kLeafChunks * 8];
+        size_t i = 0;
+        if (lanes.hash) {
+            for (; i + lanes.lanes <= chunks; i += lanes.lanes) {
+                lanes.hash(input + i * kChunkLen, counter + i, cvs + i * 8);
+            }
+        }
+        for (; i < chunks; ++i) {
+            ChunkCv(input + i * kChunkLen, counter + i, cvs + i * 8);
+        }
+        for (size_t n = chunks; n > 1; n /= 2) {
+            for (size_t j = 0; j < n / 2; ++j) {
+                ParentCv(cvs + 2 * j * 8, cvs + (2 * j + 1) * 8, cvs + j * 8);
+            }
+        }
+        std::memcpy(out, cvs, 8 * sizeof(uint32_t));
+        return;
+    }
+    size_t half = chunks / 2;
+    uint32_t left[8];
+    uint32_t right[8];
+    SubtreeCv(input, half, counter, left);
+    SubtreeCv(input + half * kChunkLen, half, counter + half, right);
+    ParentCv(left, right, out);
+}
+
+size_t RoundDownToPowerOf2(size_t x) {
+    size_t p = 1;
+    while (p <= x / 2) {
+        p *= 2;
+    }
+    return p;
+}
+
+int PopCount(uint64_t x) {
+    int n = 0;
+    for (; x != 0; x &= x - 1) {
+        ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+const char* GetBlake3ImplName() {
+    return GetChunkLanes().name;
+}
+
+Blake3Hasher::Blake3Hasher() : m_threads(0) {
+    Reset();
+}
+
+void Blake3Hasher::Reset() {
+    std::memcpy(m_chunk.cv, kIv, sizeof(kIv));
+    m_chunk.counter = 0;
+    m_chunk.blockLen = 0;
+    m_chunk.blocksCompressed = 0;
+    m_cvStackLen = 0;
+    m_pending.clear();
+}
+
+void Blake3Hasher::Update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    // Everything reaches UpdateCore in whole batches until Final, so subtrees
+    // stay aligned to the batch size and can be split across threads.
+    if (!m_pending.empty()) {
+        size_t take = std::min(size, kBatchBytes - m_pending.size());
+        m_pending.insert(m_pending.end(), p, p + take);
+        p += take;
+        size -= take;
+        if (m_pending.size() < kBatchBytes) {
+            return;
+        }
+        UpdateCore(m_pending.data(), m_pending.size());
+        m_pending.clear();
+    }
+    size_t direct = size - size % kBatchBytes;
+    if (direct != 0) {
+        UpdateCore(p, direct);
+        p += direct;
+        size -= direct;
+    }
+    if (size != 0) {
+        m_pending.reserve(kBatchBytes);
+        m_pending.assign(p, p + size);
+    }
+}
+
+void Blake3Hasher::Final(uint8_t* out) {
+    if (!m_pending.empty()) {
+        UpdateCore(m_pending.data(), m_pending.size());
+        m_pending.clear();
+    }
+
+    size_t chunkLen = m_chunk.blocksCompressed * kBlockLen + m_chunk.blockLen;
+    auto chunkOutput = [&]() {
+        Output o;
+        std::memcpy(o.cv, m_chunk.cv, sizeof(o.cv));
+        std::memset(o.block, 0, sizeof(o.block));
+        std::memcpy(o.block, m_chunk.block, m_chunk.blockLen);
+        o.blockLen = static_cast<uint32_t>(m_chunk.blockLen);
+        o.counter = m_chunk.counter;
+        o.flags = kChunkEnd | (m_chunk.blocksCompressed == 0 ? kChunkStart : 0);
+        return o;
+    };
+
+    if (m_cvStackLen == 0) {
+        chunkOutput().RootBytes(out);
+        return;
+    }
+    Output output;
+    size_t remaining = 0;
+    if (chunkLen > 0) {
+        remaining = m_cvStackLen;
+        output = chunkOutput();
+    } else {
+        remaining = m_cvStackLen - 2;
+        output = ParentOutput(m_cvStack[remaining], m_cvStack[remaining + 1]);
+    }
+    while (remaining > 0) {
+        --remaining;
+        uint32_t cv[8];
+        output.ChainingValue(cv);
+        output = ParentOutput(m_cvStack[remaining], cv);
+    }
+    output.RootBytes(out);
+}
+
+void Blake3Hasher::SaveState(HashStateWriter& out) {
+    // Hashing the batch now only changes how later input is split across
+    // threads, not the result.
+    if (!m_pending.empty()) {
+        UpdateCore(m_pending.data(), m_pending.size());
+        m_pending.clear();
+    }
+    for (uint32_t word : m_chunk.cv) {
+        out.U32(word);
+    }
+    out.U64(m_chunk.counter);
+    out.Bytes(m_chunk.block, sizeof(m_chunk.block));
+    out.U32(static_cast<uint32_t>(m_chunk.blockLen));
+    out.U32(static_cast<uint32_t>(m_chunk.blocksCompressed));
+    out.U32(static_cast<uint32_t>(m_cvStackLen));
+    for (size_t i = 0; i < m_cvStackLen; ++i) {
+        for (uint32_t word : m_cvStack[i]) {
+            out.U32(word);
+        }
+    }
+}
+
+bool Blake3Hasher::LoadState(HashStateReader& in) {
+    Reset();
+    for (uint32_t& word : m_chunk.cv) {
+        word = in.U32();
+    }
+    m_chunk.counter = in.U64();
+    in.Bytes(m_chunk.block, sizeof(m_chunk.block));
+    m_chunk.blockLen = in.U32();
+    m_chunk.blocksCompressed = in.U32();
+    m_cvStackLen = in.U32();
+    if (m_chunk.blockLen > kBlockLen || m_chunk.blocksCompressed >= kChunkLen / kBlockLen || m_cvStackLen > 54) {
+        in.Fail();
+        m_cvStackLen = 0;
+    }
+    for (size_t i = 0; i < m_cvStackLen; ++i) {
+        for (uint32_t& word : m_cvStack[i]) {
+            word = in.U32();
+        }
+    }
+    if (!in.Ok()) {
+        Reset();
+        return false;
+    }
+    return true;
+}
+
+void Blake3Hasher::MergeCvStack(uint64_t totalChunks) {
+    size_t target = static_cast<size_t>(PopCount(totalChunks));
+    while (m_cvStackLen > target) {
+        uint32_t* left = m_cvStack[m_cvStackLen - 2];
+        ParentCv(left, m_cvStack[m_cvStackLen - 1], left);
+        --m_cvStackLen;
+    }
+}
+
+// Merging is lazy: the newest entry is only folded in once more input shows
+// it cannot be the root.
+void Blake3Hasher::PushCv(const uint32_t* cv, uint64_t chunkCounter) {
+    MergeCvStack(chunkCounter);
+    std::memcpy(m_cvStack[m_cvStackLen], cv, 8 * sizeof(uint32_t));
+    ++m_cvStackLen;
+}
+
+void Blake3Hasher::CompressSubtreeToParentNode(const uint8_t* input, size_t chunks, uint64_t counter, uint32_t* left, uint32_t* right) {
+    size_t threads = m_threads;
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    size_t parts = 2;
+    while (parts < threads && chunks / (parts * 2) >= kMinPartChunks) {
+        parts *= 2;
+    }
+    if (parts > chunks) {
+        parts = chunks;
+    }
+
+    size_t partChunks = chunks / parts;
+    std::vector<uint32_t> cvs(parts * 8);
+    auto hashPart = [&](size_t i) {
+        SubtreeCv(input + i * partChunks * kChunkLen, partChunks, counter + i * partChunks, &cvs[i * 8]);
+    };
+    if (threads > 1 && chunks >= 2 * kMinPartChunks) {
+        RunParallel(parts, threads, hashPart);
+    } else {
+        for (size_t i = 0; i < parts; ++i) {
+            hashPart(i);
+        }
+    }
+    for (size_t n = parts; n > 2; n /= 2) {
+        for (size_t i = 0; i < n / 2; ++i) {
+            ParentCv(&cvs[2 * i * 8], &cvs[(2 * i + 1) * 8], &cvs[i * 8]);
+        }
+    }
+    std::memcpy(left, &cvs[0], 8 * sizeof(uint32_t));
+    std::memcpy(right, &cvs[8], 8 * sizeof(uint32_t));
+}
+
+void Blake3Hasher::UpdateCore(const uint8_t* input, size_t size) {
+    // Top up a partially filled chunk first. A full chunk is only finalized
+    // once more input arrives, because until then it might be the root.
+    size_t chunkLen = m_chunk.blocksCompressed * kBlockLen + m_chunk.blockLen;
+    if (chunkLen > 0) {
+        size_t take = std::min(kChunkLen - chunkLen, size);
+        while (take > 0) {
+            if (m_chunk.blockLen == kBlockLen) {
+                uint32_t flags = m_chunk.blocksCompressed == 0 ? kChunkStart : 0;
+                Compress(m_chunk.cv, m_chunk.block, static_cast<uint32_t>(kBlockLen), m_chunk.counter, flags, m_chunk.cv);
+                ++m_chunk.blocksCompressed;
+                m_chunk.blockLen = 0;
+            }
+            size_t n = std::min(kBlockLen - m_chunk.blockLen, take);
+            std::memcpy(m_chunk.block + m_chunk.blockLen, input, n);
+            m_chunk.blockLen += n;
+            input += n;
+            size -= n;
+            take -= n;
+        }
+        if (size == 0) {
+            return;
+        }
+        uint32_t flags = kChunkEnd | (m_chunk.blocksCompressed == 0 ? kChunkStart : 0);
+        uint8_t block[64] = {};
+        std::memcpy(block, m_chunk.block, m_chunk.blockLen);
+        uint32_t cv[8];
+        Compress(m_chunk.cv, block, static_cast<uint32_t>(m_chunk.blockLen), m_chunk.counter, flags, cv);
+        PushCv(cv, m_chunk.counter);
+        uint64_t next = m_chunk.counter + 1;
+        std::memcpy(m_chunk.cv, kIv, sizeof(kIv));
+        m_chunk.counter = next;
+        m_chunk.blockLen = 0;
+        m_chunk.blocksCompressed = 0;
+    }
+
+    while (size > kChunkLen) {
+        size_t subtreeLen = RoundDownToPowerOf2(size);
+        uint64_t countSoFar = m_chunk.counter * kChunkLen;
+        while (((static_cast<uint64_t>(subtreeLen) - 1) & countSoFar) != 0) {
+            subtreeLen /= 2;
+        }
+        size_t subtreeChunks = subtreeLen / kChunkLen;
+        if (subtreeLen <= kChunkLen) {
+            uint32_t cv[8];
+            ChunkCv(input, m_chunk.counter, cv);
+            PushCv(cv, m_chunk.counter);
+        } else {
+            uint32_t left[8];
+            uint32_t right[8];
+            CompressSubtreeToParentNode(input, subtreeChunks, m_chunk.counter, left, right);
+            PushCv(left, m_chunk.counter);
+            PushCv(right, m_chunk.counter + subtreeChunks / 2);
+        }
+        m_chunk.counter += subtreeChunks;
+        input += subtreeLen;
+        size -= subtreeLen;
+    }
+
+    // The tail (at most one chunk) stays in the chunk state. When a subtree
+    // consumed everything, its two halves stay unmerged on the stack so that
+    // Final can still flag their parent as the root.
+    if (size == 0) {
+        return;
+    }
+    while (size > 0) {
+        if (m_chunk.blockLen == kBlockLen) {
+            uint32_t flags = m_chunk.blocksCompressed == 0 ? kChunkStart : 0;
+            Compress(m_chunk.cv, m_chunk.block, static_cast<uint32_t>(kBlockLen), m_chunk.counter, flags, m_chunk.cv);
+            ++m_chunk.blocksCompressed;
+            m_chunk.blockLen = 0;
+        }
+        size_t n = std::min(kBlockLen - m_chunk.blockLen, size);
+        std::memcpy(m_chunk.block + m_chunk.blockLen, input, n);
+        m_chunk.blockLen += n;
+        input += n;
+        size -= n;
+    }
+    MergeCvStack(m_chunk.counter);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class HashStateReader;
+class HashStateWriter;
+
+// BLAKE3 in its default hash mode with a 32-byte output. Large inputs are
+// collected into 16 MiB batches whose chunk subtrees are hashed on several
+// threads; the result is the same as the reference implementation's.
+class Blake3Hasher {
+public:
+    static const size_t kOutLen = 32;
+
+    Blake3Hasher();
+
+    // 0 = hardware concurrency, 1 = hash on the calling thread only.
+    void SetThreadCount(size_t threads) { m_threads = threads; }
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    void Final(uint8_t* out);
+
+    // Checkpoint state; saving hashes the pending batch first.
+    void SaveState(HashStateWriter& out);
+    bool LoadState(HashStateReader& in);
+
+private:
+    struct ChunkState {
+        uint32_t cv[8];
+        uint64_t counter;
+        uint8_t block[64];
+        size_t blockLen;
+        size_t blocksCompressed;
+    };
+
+    void UpdateCore(const uint8_t* input, size_t size);
+    void PushCv(const uint32_t* cv, uint64_t chunkCounter);
+    void MergeCvStack(uint64_t totalChunks);
+    void CompressSubtreeToParentNode(const uint8_t* input, size_t chunks, uint64_t counter, uint32_t* left, uint32_t* right);
+
+    ChunkState m_chunk;
+    uint32_t m_cvStack[54][8];
+    size_t m_cvStackLen;
+    std::vector<uint8_t> m_pending;
+    size_t m_threads;
+};
+
+// Chunk code in use: "portable", "sse2", "avx2", "avx512" or "neon".
+const char* GetBlake3ImplName();
@@ -0,0 +1,253 @@
+#include "ChunkHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// FastCDC sizes: nothing is cut before kMinChunk, a stricter mask applies up
+// to kNormalChunk and a looser one after it, which keeps most chunks near the
+// normal size; kMaxChunk is a forced cut.
+const uint32_t kMinChunk = 1024;
+const uint32_t kNormalChunk = 4096;
+const uint32_t kMaxChunk = 32768;
+// The Gear hash shifts left, so its top bits cover the most bytes (the last
+// 64). log2(kNormalChunk) = 12 bits, plus and minus 2.
+const uint64_t kMaskSmall = ~0ull << (64 - 14);
+const uint64_t kMaskLarge = ~0ull << (64 - 10);
+
+// Random per-byte values, generated from a fixed seed so that chunk
+// boundaries are the same in every build.
+const uint64_t* GetGearTable() {
+    static const struct Table {
+        uint64_t values[256];
+        Table() {
+            uint64_t x = 0x5045496E666F4344ull;
+            for (uint64_t& v : values) {
+                // splitmix64
+                x += 0x9E3779B97F4A7C15ull;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                v = z ^ (z >> 31);
+            }
+        }
+    } table;
+    return table.values;
+}
+
+struct DigestKey {
+    uint8_t bytes[kChunkDigestSize];
+
+    bool operator==(const DigestKey& other) const { return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+};
+
+struct DigestKeyHash {
+    size_t operator()(const DigestKey& key) const {
+        // The digest is already uniform.
+        uint64_t h;
+        std::memcpy(&h, key.bytes, sizeof(h));
+        return static_cast<size_t>(h);
+    }
+};
+
+DigestKey KeyOf(const ContentChunk& chunk) {
+    DigestKey key;
+    std::memcpy(key.bytes, chunk.digest, sizeof(key.bytes));
+    return key;
+}
+
+} // namespace
+
+ContentChunkSink::ContentChunkSink(const std::vector<HashRegion>& regions) : m_regions(regions) {
+    for (size_t r = 0; r < m_regions.size(); ++r) {
+        m_order.push_back(r);
+        m_states.push_back(State());
+        m_states.back().chunkOffset = m_regions[r].offset;
+        m_digests.emplace_back(HashAlgorithm::SHA256);
+        RegionChunks result;
+        result.name = m_regions[r].name;
+        result.offset = m_regions[r].offset;
+        result.size = m_regions[r].size;
+        m_results.push_back(result);
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [this](size_t a, size_t b) { return m_regions[a].offset < m_regions[b].offset; });
+}
+
+void ContentChunkSink::Update(uint64_t offset, const uint8_t* data, size_t size) {
+    const uint64_t end = offset + size;
+    while (m_next < m_order.size() && m_regions[m_order[m_next]].offset + m_regions[m_order[m_next]].size <= offset) {
+        ++m_next;
+    }
+    // Overlapping regions can leave finished ones past m_next; they are
+    // passed over below.
+    for (size_t i = m_next; i < m_order.size() && m_regions[m_order[i]].offset < end; ++i) {
+        const HashRegion& region = m_regions[m_order[i]];
+        uint64_t from = std::max<uint64_t>(region.offset, offset);
+        uint64_t to = std::min<uint64_t>(region.offset + region.size, end);
+        if (from < to) {
+            Feed(m_order[i], data + (from - offset), static_cast<size_t>(to - from));
+        }
+    }
+}
+
+void ContentChunkSink::Feed(size_t region, const uint8_t* data, size_t size) {
+    const uint64_t* gear = GetGearTable();
+    State& state = m_states[region];
+    Digest& digest = m_digests[region];
+    while (size > 0) {
+        uint64_t fp = state.fingerprint;
+        const uint32_t start = state.length;
+        size_t i = 0;
+        bool cut = false;
+        // Bytes before the minimum size cannot end a chunk; they are not
+        // rolled into the fingerprint either.
+        if (start < kMinChunk) {
+            i = std::min<size_t>(size, kMinChunk - start);
+        }
+        size_t limit = std::max<size_t>(i, std::min<size_t>(size, start < kNormalChunk ? kNormalChunk - start : 0));
+        for (; i < limit; ++i) {
+            fp = (fp << 1) + gear[data[i]];
+            if ((fp & kMaskSmall) == 0) {
+                cut = true;
+                ++i;
+                break;
+            }
+        }
+        if (!cut) {
+            limit = std::min<size_t>(size, kMaxChunk - start);
+            for (; i < limit; ++i) {
+                fp = (fp << 1) + gear[data[i]];
+                if ((fp & kMaskLarge) == 0) {
+                    cut = true;
+                    ++i;
+                    break;
+                }
+            }
+        }
+        const uint32_t length = start + static_cast<uint32_t>(i);
+        cut = cut || length == kMaxChunk;
+        digest.Update(data, i);
+        state.fingerprint = fp;
+        state.length = length;
+        if (cut) {
+            CloseChunk(region);
+        }
+        data += i;
+        size -= i;
+    }
+}
+
+void ContentChunkSink::CloseChunk(size_t region) {
+    State& state = m_states[region];
+    uint8_t full[32];
+    m_digests[region].Final(full);
+    m_digests[region].Reset();
+    ContentChunk chunk;
+    chunk.offset = state.chunkOffset;
+    chunk.size = state.length;
+    std::memcpy(chunk.digest, full, kChunkDigestSize);
+    m_results[region].chunks.push_back(chunk);
+    state.chunkOffset += state.length;
+    state.fingerprint = 0;
+    state.length = 0;
+}
+
+std::vector<RegionChunks> ContentChunkSink::Final() {
+    for (size_t r = 0; r < m_regions.size(); ++r) {
+        if (m_states[r].length != 0) {
+            CloseChunk(r);
+        }
+    }
+    return m_results;
+}
+
+std::vector<ContentChunk> ChunkBuffer(const uint8_t* data, size_t size, uint64_t base) {
+    HashRegion region;
+    region.offset = base;
+    region.size = size;
+    ContentChunkSink sink({region});
+    sink.Update(base, data, size);
+    return sink.Final().front().chunks;
+}
+
+ChunkCompareResult CompareChunkLists(const std::vector<ContentChunk>& oldChunks, const std::vector<ContentChunk>& newChunks) {
+    ChunkCompareResult result;
+    // Digest -> old chunks not yet matched.
+    std::unordered_map<DigestKey, uint32_t, DigestKeyHash> unmatched;
+    unmatched.reserve(oldChunks.size());
+    for (const auto& c : oldChunks) {
+        ++unmatched[KeyOf(c)];
+        ++result.oldOnlyChunks;
+        result.oldOnlyBytes += c.size;
+    }
+    for (const auto& c : newChunks) {
+        auto it = unmatched.find(KeyOf(c));
+        if (it != unmatched.end() && it->second != 0) {
+            --it->second;
+            ++result.sharedChunks;
+            result.sharedBytes += c.size;
+            // Same digest, so the same size on both sides.
+            --result.oldOnlyChunks;
+            result.oldOnlyBytes -= c.size;
+        } else {
+            ++result.newOnlyChunks;
+            result.newOnlyBytes += c.size;
+        }
+    }
+    return result;
+}
+
+bool RunChunkHashSelfTest(std::wstring& error) {
+    std::vector<uint8_t> data(300000);
+    uint32_t x = 0x2545F491;
+    for (auto& b : data) {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    std::vector<ContentChunk> whole = ChunkBuffer(data.data(), data.size());
+    uint64_t pos = 0;
+    for (size_t i = 0; i < whole.size(); ++i) {
+        const ContentChunk& c = whole[i];
+        bool last = i + 1 == whole.size();
+        if (c.offset != pos || c.size > kMaxChunk || (!last && c.size < kMinChunk)) {
+            error = L"Content chunks are out of order or outside the size limits";
+            return false;
+        }
+        pos += c.size;
+    }
+    if (pos != data.size()) {
+        error = L"Content chunks do not cover the input";
+        return false;
+    }
+
+    // Split updates, and a second region over the same bytes.
+    const size_t splits[] = {1, 1023, 1024, 4097, 32768, 100001};
+    for (size_t split : splits) {
+        HashRegion a;
+        a.size = data.size();
+        HashRegion b = a;
+        ContentChunkSink sink({a, b});
+        sink.Update(0, data.data(), split);
+        sink.Update(split, data.data() + split, data.size() - split);
+        std::vector<RegionChunks> results = sink.Final();
+        for (const auto& r : results) {
+            ChunkCompareResult cmp = CompareChunkLists(whole, r.chunks);
+            if (r.chunks.size() != whole.size() || cmp.sharedChunks != whole.size()) {
+                error = L"Content chunks change with the update split";
+                return false;
+            }
+        }
+    }
+
+    // A one-byte edit changes at most the chunks around it.
+    std::vector<uint8_t> edited = data;
+    edited[150000] ^= 0xFF;
+    ChunkCompareResult cmp = CompareChunkLists(whole, ChunkBuffer(edited.data(), edited.size()));
+    if (cmp.oldOnlyChunks == 0 || cmp.oldOnlyChunks > 2 || cmp.newOnlyChunks > 2 || cmp.sharedChunks + 2 < whole.size()) {
+        error = L"A one-byte edit changed chunks away from the edit";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Digest.h"
+#include "HashEngine.h"
+#include "RegionHash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Content-defined chunking (FastCDC: a Gear rolling hash with normalized
+// chunk sizes) of file regions, fed from the whole-file HashEngine pass.
+// Boundaries depend only on nearby content, so an insertion or a patch moves
+// or changes the chunks around it and leaves the rest of a section's chunk
+// list intact. Builds without Windows headers.
+
+const size_t kChunkDigestSize = 16;
+
+struct ContentChunk {
+    // File offset; chunks of a region are contiguous and in order.
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    // SHA-256 of the chunk, truncated.
+    uint8_t digest[kChunkDigestSize] = {};
+};
+
+struct RegionChunks {
+    std::wstring name;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    std::vector<ContentChunk> chunks;
+};
+
+// Regions may overlap and need not be sorted; their skip ranges are ignored.
+// The chunks must arrive in file order.
+class ContentChunkSink : public HashSink {
+public:
+    explicit ContentChunkSink(const std::vector<HashRegion>& regions);
+
+    void Update(uint64_t offset, const uint8_t* data, size_t size) override;
+    // One list per region, in the order given. Call once, after the pass.
+    std::vector<RegionChunks> Final();
+
+private:
+    struct State {
+        uint64_t fingerprint = 0;
+        // Bytes in the open chunk.
+        uint32_t length = 0;
+        uint64_t chunkOffset = 0;
+    };
+
+    void Feed(size_t region, const uint8_t* data, size_t size);
+    void CloseChunk(size_t region);
+
+    std::vector<HashRegion> m_regions;
+    // Sorted by offset; m_next is the first region the stream has not passed.
+    std::vector<size_t> m_order;
+    size_t m_next = 0;
+    std::vector<State> m_states;
+    std::vector<Digest> m_digests;
+    std::vector<RegionChunks> m_results;
+};
+
+// Chunks of one buffer, as ContentChunkSink cuts a region of the same bytes
+// (offsets start at base).
+std::vector<ContentChunk> ChunkBuffer(const uint8_t* data, size_t size, uint64_t base = 0);
+
+struct ChunkCompareResult {
+    // Chunks of each side with a match on the other; a digest repeated n
+    // times on one side matches at most n times on the other.
+    uint64_t sharedChunks = 0;
+    uint64_t sharedBytes = 0;
+    uint64_t oldOnlyChunks = 0;
+    uint64_t oldOnlyBytes = 0;
+    uint64_t newOnlyChunks = 0;
+    uint64_t newOnlyBytes = 0;
+};
+
+// Matches by digest regardless of position, in time linear in the number of
+// chunks (a hash table over the old list).
+ChunkCompareResult CompareChunkLists(const std::vector<ContentChunk>& oldChunks, const std::vector<ContentChunk>& newChunks);
+
+// Split updates against one-shot chunking, the size limits, and locality of a
+// one-byte edit; error describes the first failure.
+bool RunChunkHashSelfTest(std::wstring& error);
@@ -0,0 +1,97 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_CPU_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_CPU_ARM64 1
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace {
+
+#if defined(PEINFO_CPU_X86)
+void CpuId(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4] = {};
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<unsigned>(r[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long ReadXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo = 0;
+    unsigned hi = 0;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+CpuFeatures Detect() {
+    CpuFeatures f;
+#if defined(PEINFO_CPU_X86)
+    unsigned regs[4] = {};
+    CpuId(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+    if (maxLeaf < 1) {
+        return f;
+    }
+    CpuId(1, 0, regs);
+    f.sse2 = (regs[3] & (1u << 26)) != 0;
+    f.ssse3 = (regs[2] & (1u << 9)) != 0;
+    f.sse41 = (regs[2] & (1u << 19)) != 0;
+    f.sse42 = (regs[2] & (1u << 20)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    unsigned long long xcr0 = osxsave ? ReadXcr0() : 0;
+    bool ymmSaved = (xcr0 & 0x6) == 0x6;
+    bool zmmSaved = (xcr0 & 0xE6) == 0xE6;
+    if (maxLeaf >= 7) {
+        CpuId(7, 0, regs);
+        f.avx2 = avx && ymmSaved && (regs[1] & (1u << 5)) != 0;
+        f.avx512f = avx && zmmSaved && (regs[1] & (1u << 16)) != 0;
+        f.shaNi = f.ssse3 && f.sse41 && (regs[1] & (1u << 29)) != 0;
+    }
+#elif defined(PEINFO_CPU_ARM64)
+#if defined(_WIN32)
+    bool crypto = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != FALSE;
+    f.armSha1 = crypto;
+    f.armSha2 = crypto;
+    f.armCrc32 = IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != FALSE;
+#elif defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    f.armSha1 = (hwcap & HWCAP_SHA1) != 0;
+    f.armSha2 = (hwcap & HWCAP_SHA2) != 0;
+    f.armCrc32 = (hwcap & HWCAP_CRC32) != 0;
+#elif defined(__APPLE__)
+    f.armSha1 = true;
+    f.armSha2 = true;
+    f.armCrc32 = true;
+#endif
+#endif
+    return f;
+}
+
+} // namespace
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = Detect();
+    return features;
+}
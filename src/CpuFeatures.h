@@ -0,0 +1,18 @@
+#pragma once
+
+// Instruction set extensions usable by the current process. Detected once on
+// first use; x86 AVX state is only reported when the OS saves it (XGETBV).
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool sse42 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+    bool shaNi = false;
+    bool armSha1 = false;
+    bool armSha2 = false;
+    bool armCrc32 = false;
+};
+
+const CpuFeatures& GetCpuFeatures();
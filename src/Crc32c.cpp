@@ -0,0 +1,243 @@
+#include "Crc32c.h"
+
+#include "CpuFeatures.h"
+#include "HashState.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PEINFO_CRC32C_X64 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define PEINFO_TARGET_SSE42
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_CRC32C_ARM64 1
+#if defined(_MSC_VER)
+#include <arm64intr.h>
+#define PEINFO_TARGET_ARMCRC
+#else
+#include <arm_acle.h>
+#if defined(__clang__)
+#define PEINFO_TARGET_ARMCRC __attribute__((target("crc")))
+#else
+#define PEINFO_TARGET_ARMCRC __attribute__((target("+crc")))
+#endif
+#endif
+#endif
+
+namespace {
+
+// Reflected Castagnoli polynomial.
+const uint32_t kPolynomial = 0x82F63B78u;
+
+typedef uint32_t (*Crc32cFn)(uint32_t crc, const uint8_t* data, size_t size);
+
+struct SliceTables {
+    uint32_t t[8][256];
+};
+
+const SliceTables& GetSliceTables() {
+    static const SliceTables tables = []() {
+        SliceTables s;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+            }
+            s.t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                s.t[k][i] = (s.t[k - 1][i] >> 8) ^ s.t[0][s.t[k - 1][i] & 0xFF];
+            }
+        }
+        return s;
+    }();
+    return tables;
+}
+
+uint32_t Crc32cPortable(uint32_t crc, const uint8_t* data, size_t size) {
+    const SliceTables& s = GetSliceTables();
+    while (size >= 8) {
+        const uint32_t lo = crc ^ (static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                                   (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24));
+        crc = s.t[7][lo & 0xFF] ^ s.t[6][(lo >> 8) & 0xFF] ^ s.t[5][(lo >> 16) & 0xFF] ^ s.t[4][lo >> 24] ^ s.t[3][data[4]] ^
+              s.t[2][data[5]] ^ s.t[1][data[6]] ^ s.t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- != 0) {
+        crc = (crc >> 8) ^ s.t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(PEINFO_CRC32C_X64) || defined(PEINFO_CRC32C_ARM64)
+// The CRC instructions have a latency of three cycles and a throughput of
+// one, so the hardware paths run three lanes of kLaneBytes each and fold
+// the first two into the third: the CRC of A || B is the CRC of A advanced
+// over |B| zero bytes, xor the CRC of B from zero.
+const size_t kLaneBytes = 4096;
+
+struct ShiftTables {
+    uint32_t t[4][256];
+};
+
+// Advances a CRC over kLaneBytes zero bytes, one table per CRC byte.
+const ShiftTables& GetShiftTables() {
+    static const ShiftTables tables = []() {
+        const SliceTables& s = GetSliceTables();
+        uint32_t basis[32];
+        for (int bit = 0; bit < 32; ++bit) {
+            uint32_t crc = 1u << bit;
+            for (size_t i = 0; i < kLaneBytes; ++i) {
+                crc = (crc >> 8) ^ s.t[0][crc & 0xFF];
+            }
+            basis[bit] = crc;
+        }
+        ShiftTables shift;
+        for (int byte = 0; byte < 4; ++byte) {
+            for (uint32_t v = 0; v < 256; ++v) {
+                uint32_t crc = 0;
+                for (int bit = 0; bit < 8; ++bit) {
+                    if ((v >> bit) & 1) {
+                        crc ^= basis[8 * byte + bit];
+                    }
+                }
+                shift.t[byte][v] = crc;
+            }
+        }
+        return shift;
+    }();
+    return tables;
+}
+
+inline uint32_t ShiftLane(const ShiftTables& s, uint32_t crc) {
+    return s.t[0][crc & 0xFF] ^ s.t[1][(crc >> 8) & 0xFF] ^ s.t[2][(crc >> 16) & 0xFF] ^ s.t[3][crc >> 24];
+}
+
+inline uint64_t LoadWord(const uint8_t* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+#endif
+
+#if defined(PEINFO_CRC32C_X64)
+PEINFO_TARGET_SSE42
+uint32_t Crc32cSse42(uint32_t crc, const uint8_t* data, size_t size) {
+    uint64_t c = crc;
+    if (size >= 3 * kLaneBytes) {
+        const ShiftTables& shift = GetShiftTables();
+        do {
+            uint64_t c1 = 0;
+            uint64_t c2 = 0;
+            for (size_t i = 0; i < kLaneBytes; i += 8) {
+                c = _mm_crc32_u64(c, LoadWord(data + i));
+                c1 = _mm_crc32_u64(c1, LoadWord(data + kLaneBytes + i));
+                c2 = _mm_crc32_u64(c2, LoadWord(data + 2 * kLaneBytes + i));
+            }
+            c = ShiftLane(shift, ShiftLane(shift, static_cast<uint32_t>(c)) ^ static_cast<uint32_t>(c1)) ^ static_cast<uint32_t>(c2);
+            data += 3 * kLaneBytes;
+            size -= 3 * kLaneBytes;
+        } while (size >= 3 * kLaneBytes);
+    }
+    while (size >= 8) {
+        c = _mm_crc32_u64(c, LoadWord(data));
+        data += 8;
+        size -= 8;
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (size-- != 0) {
+        c32 = _mm_crc32_u8(c32, *data++);
+    }
+    return c32;
+}
+#elif defined(PEINFO_CRC32C_ARM64)
+PEINFO_TARGET_ARMCRC
+uint32_t Crc32cArm(uint32_t crc, const uint8_t* data, size_t size) {
+    if (size >= 3 * kLaneBytes) {
+        const ShiftTables& shift = GetShiftTables();
+        do {
+            uint32_t c1 = 0;
+            uint32_t c2 = 0;
+            for (size_t i = 0; i < kLaneBytes; i += 8) {
+                crc = __crc32cd(crc, LoadWord(data + i));
+                c1 = __crc32cd(c1, LoadWord(data + kLaneBytes + i));
+                c2 = __crc32cd(c2, LoadWord(data + 2 * kLaneBytes + i));
+            }
+            crc = ShiftLane(shift, ShiftLane(shift, crc) ^ c1) ^ c2;
+            data += 3 * kLaneBytes;
+            size -= 3 * kLaneBytes;
+        } while (size >= 3 * kLaneBytes);
+    }
+    while (size >= 8) {
+        crc = __crc32cd(crc, LoadWord(data));
+        data += 8;
+        size -= 8;
+    }
+    while (size-- != 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+struct Crc32cImpl {
+    const char* name;
+    Crc32cFn update;
+};
+
+const Crc32cImpl& GetCrc32cImpl() {
+    static const Crc32cImpl active = []() {
+        Crc32cImpl best = {"portable", Crc32cPortable};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_CRC32C_X64)
+        if (cpu.sse42) {
+            best = {"sse4.2", Crc32cSse42};
+        }
+#elif defined(PEINFO_CRC32C_ARM64)
+        if (cpu.armCrc32) {
+            best = {"armv8-crc", Crc32cArm};
+        }
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+} // namespace
+
+const char* GetCrc32cImplName() {
+    return GetCrc32cImpl().name;
+}
+
+void Crc32cHasher::Update(const void* data, size_t size) {
+    m_crc = GetCrc32cImpl().update(m_crc, static_cast<const uint8_t*>(data), size);
+}
+
+void Crc32cHasher::Final(uint8_t* out) const {
+    const uint32_t crc = ~m_crc;
+    out[0] = static_cast<uint8_t>(crc >> 24);
+    out[1] = static_cast<uint8_t>(crc >> 16);
+    out[2] = static_cast<uint8_t>(crc >> 8);
+    out[3] = static_cast<uint8_t>(crc);
+}
+
+void Crc32cHasher::SaveState(HashStateWriter& out) const {
+    out.U32(m_crc);
+}
+
+bool Crc32cHasher::LoadState(HashStateReader& in) {
+    m_crc = in.U32();
+    if (!in.Ok()) {
+        Reset();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class HashStateReader;
+class HashStateWriter;
+
+// CRC-32C (Castagnoli, as iSCSI, ext4 and Btrfs use it), for cheap change
+// detection. Runs on the SSE4.2 or ARMv8 CRC32 instructions where the CPU
+// has them, with a slice-by-8 table as the fallback. The result is written
+// big-endian, as the value is usually printed.
+class Crc32cHasher {
+public:
+    static const size_t kOutLen = 4;
+
+    Crc32cHasher() { Reset(); }
+
+    void Reset() { m_crc = 0xFFFFFFFFu; }
+    void Update(const void* data, size_t size);
+    void Final(uint8_t* out) const;
+
+    void SaveState(HashStateWriter& out) const;
+    bool LoadState(HashStateReader& in);
+
+private:
+    uint32_t m_crc;
+};
+
+// "portable", "sse4.2" or "armv8-crc".
+const char* GetCrc32cImplName();
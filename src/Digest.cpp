@@ -0,0 +1,1355 @@
+#include "Digest.h"
+
+#include "Blake3.h"
+#include "CpuFeatures.h"
+#include "Crc32c.h"
+#include "FuzzyHash.h"
+#include "HashState.h"
+#include "Sha256Tree.h"
+#include "Xxh3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_DIGEST_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#define PEINFO_TARGET_SHANI
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_DIGEST_ARM64 1
+#include <arm_neon.h>
+#if defined(__clang__)
+#define PEINFO_TARGET_ARMCRYPTO __attribute__((target("crypto")))
+#elif defined(__GNUC__)
+#define PEINFO_TARGET_ARMCRYPTO __attribute__((target("+crypto")))
+#else
+#define PEINFO_TARGET_ARMCRYPTO
+#endif
+#endif
+
+const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t kSha256Init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+namespace {
+
+const uint32_t kMd5K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+const uint32_t kSha1K[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+
+
+const uint32_t kMd5Init[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+const uint32_t kSha1Init[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+inline uint32_t Rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t Rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t LoadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint32_t LoadBe32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void StoreLe32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+inline void StoreBe32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+// ---- Portable implementations ----
+
+#define MD5_STEP(f, a, b, c, d, x, k, s) \
+    a += f(b, c, d) + (x) + (k);              \
+    a = Rotl(a, s) + b
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+void Md5BlocksScalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t m[16];
+        for (int i = 0; i < 16; ++i) {
+            m[i] = LoadLe32(data + 4 * i);
+        }
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        for (int i = 0; i < 16; i += 4) {
+            MD5_STEP(MD5_F, a, b, c, d, m[i], kMd5K[i], 7);
+            MD5_STEP(MD5_F, d, a, b, c, m[i + 1], kMd5K[i + 1], 12);
+            MD5_STEP(MD5_F, c, d, a, b, m[i + 2], kMd5K[i + 2], 17);
+            MD5_STEP(MD5_F, b, c, d, a, m[i + 3], kMd5K[i + 3], 22);
+        }
+        for (int i = 16; i < 32; i += 4) {
+            MD5_STEP(MD5_G, a, b, c, d, m[(5 * i + 1) & 15], kMd5K[i], 5);
+            MD5_STEP(MD5_G, d, a, b, c, m[(5 * i + 6) & 15], kMd5K[i + 1], 9);
+            MD5_STEP(MD5_G, c, d, a, b, m[(5 * i + 11) & 15], kMd5K[i + 2], 14);
+            MD5_STEP(MD5_G, b, c, d, a, m[(5 * i + 16) & 15], kMd5K[i + 3], 20);
+        }
+        for (int i = 32; i < 48; i += 4) {
+            MD5_STEP(MD5_H, a, b, c, d, m[(3 * i + 5) & 15], kMd5K[i], 4);
+            MD5_STEP(MD5_H, d, a, b, c, m[(3 * i + 8) & 15], kMd5K[i + 1], 11);
+            MD5_STEP(MD5_H, c, d, a, b, m[(3 * i + 11) & 15], kMd5K[i + 2], 16);
+            MD5_STEP(MD5_H, b, c, d, a, m[(3 * i + 14) & 15], kMd5K[i + 3], 23);
+        }
+        for (int i = 48; i < 64; i += 4) {
+            MD5_STEP(MD5_I, a, b, c, d, m[(7 * i) & 15], kMd5K[i], 6);
+            MD5_STEP(MD5_I, d, a, b, c, m[(7 * i + 7) & 15], kMd5K[i + 1], 10);
+            MD5_STEP(MD5_I, c, d, a, b, m[(7 * i + 14) & 15], kMd5K[i + 2], 15);
+            MD5_STEP(MD5_I, b, c, d, a, m[(7 * i + 21) & 15], kMd5K[i + 3], 21);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+}
+
+#undef MD5_STEP
+#undef MD5_F
+#undef MD5_G
+#undef MD5_H
+#undef MD5_I
+
+void Sha1BlocksScalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadBe32(data + 4 * i);
+        }
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        for (int i = 0; i < 80; ++i) {
+            if (i >= 16) {
+                w[i & 15] = Rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+            }
+            uint32_t f;
+            if (i < 20) {
+                f = d ^ (b & (c ^ d));
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+            } else if (i < 60) {
+                f = (b & c) | (d & (b | c));
+            } else {
+                f = b ^ c ^ d;
+            }
+            uint32_t t = Rotl(a, 5) + f + e + kSha1K[i / 20] + w[i & 15];
+            e = d;
+            d = c;
+            c = Rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+void Sha256BlocksScalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadBe32(data + 4 * i);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        uint32_t f = state[5];
+        uint32_t g = state[6];
+        uint32_t h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t s1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+            uint32_t ch = g ^ (e & (f ^ g));
+            uint32_t t1 = h + s1 + ch + kSha256K[i] + w[i];
+            uint32_t s0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+            uint32_t maj = (a & b) | (c & (a | b));
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+// ---- x86 SHA extensions ----
+
+#if defined(PEINFO_DIGEST_X86)
+PEINFO_TARGET_SHANI
+void Sha256BlocksShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i kShuffle = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The rounds instruction wants the state as ABEF / CDGH.
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i msg;
+        __m128i msg0;
+        __m128i msg1;
+        __m128i msg2;
+        __m128i msg3;
+
+        // Rounds 0-3
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0)), kShuffle);
+        msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[0])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        // Rounds 4-7
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), kShuffle);
+        msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[4])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+        // Rounds 8-11
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), kShuffle);
+        msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[8])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+        // Rounds 12-15
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), kShuffle);
+        msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[12])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg3, msg2, 4);
+        msg0 = _mm_add_epi32(msg0, tmp);
+        msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+        // Rounds 16-19
+        msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[16])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg0, msg3, 4);
+        msg1 = _mm_add_epi32(msg1, tmp);
+        msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+        // Rounds 20-23
+        msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[20])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg1, msg0, 4);
+        msg2 = _mm_add_epi32(msg2, tmp);
+        msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+        // Rounds 24-27
+        msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[24])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg2, msg1, 4);
+        msg3 = _mm_add_epi32(msg3, tmp);
+        msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+        // Rounds 28-31
+        msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[28])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg3, msg2, 4);
+        msg0 = _mm_add_epi32(msg0, tmp);
+        msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+        // Rounds 32-35
+        msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[32])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg0, msg3, 4);
+        msg1 = _mm_add_epi32(msg1, tmp);
+        msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+        // Rounds 36-39
+        msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[36])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg1, msg0, 4);
+        msg2 = _mm_add_epi32(msg2, tmp);
+        msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+        // Rounds 40-43
+        msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[40])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg2, msg1, 4);
+        msg3 = _mm_add_epi32(msg3, tmp);
+        msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+        // Rounds 44-47
+        msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[44])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg3, msg2, 4);
+        msg0 = _mm_add_epi32(msg0, tmp);
+        msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+        // Rounds 48-51
+        msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[48])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg0, msg3, 4);
+        msg1 = _mm_add_epi32(msg1, tmp);
+        msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+        // Rounds 52-55
+        msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[52])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg1, msg0, 4);
+        msg2 = _mm_add_epi32(msg2, tmp);
+        msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        // Rounds 56-59
+        msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[56])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        tmp = _mm_alignr_epi8(msg2, msg1, 4);
+        msg3 = _mm_add_epi32(msg3, tmp);
+        msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        // Rounds 60-63
+        msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[60])));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+PEINFO_TARGET_SHANI
+void Sha1BlocksShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i kShuffle = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abcdSave = abcd;
+        __m128i e0Save = e0;
+        __m128i e1;
+        __m128i msg0;
+        __m128i msg1;
+        __m128i msg2;
+        __m128i msg3;
+
+        // Rounds 0-3
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0)), kShuffle);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        // Rounds 4-7
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), kShuffle);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        // Rounds 8-11
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), kShuffle);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+        // Rounds 12-15
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), kShuffle);
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+        // Rounds 16-19
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+        // Rounds 20-23
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+        // Rounds 24-27
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+        // Rounds 28-31
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+        // Rounds 32-35
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+        // Rounds 36-39
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+        // Rounds 40-43
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+        // Rounds 44-47
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+        // Rounds 48-51
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+        // Rounds 52-55
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+        // Rounds 56-59
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+        // Rounds 60-63
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+        // Rounds 64-67
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+        // Rounds 68-71
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg3 = _mm_xor_si128(msg3, msg1);
+        // Rounds 72-75
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        // Rounds 76-79
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0Save);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), abcd);
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+#endif
+
+// ---- ARMv8 cryptography extension ----
+
+#if defined(PEINFO_DIGEST_ARM64)
+PEINFO_TARGET_ARMCRYPTO
+void Sha256BlocksArm(uint32_t* state, const uint8_t* data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32x4_t abefSave = state0;
+        uint32x4_t cdghSave = state1;
+        uint32x4_t msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0)));
+        uint32x4_t msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+        uint32x4_t msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+        uint32x4_t msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+        uint32x4_t tmp0 = vaddq_u32(msg0, vld1q_u32(&kSha256K[0]));
+        uint32x4_t tmp1;
+        uint32x4_t tmp2;
+
+        // Rounds 0-3
+        msg0 = vsha256su0q_u32(msg0, msg1);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg1, vld1q_u32(&kSha256K[4]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+        // Rounds 4-7
+        msg1 = vsha256su0q_u32(msg1, msg2);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg2, vld1q_u32(&kSha256K[8]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+        // Rounds 8-11
+        msg2 = vsha256su0q_u32(msg2, msg3);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg3, vld1q_u32(&kSha256K[12]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+        // Rounds 12-15
+        msg3 = vsha256su0q_u32(msg3, msg0);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg0, vld1q_u32(&kSha256K[16]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+        // Rounds 16-19
+        msg0 = vsha256su0q_u32(msg0, msg1);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg1, vld1q_u32(&kSha256K[20]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+        // Rounds 20-23
+        msg1 = vsha256su0q_u32(msg1, msg2);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg2, vld1q_u32(&kSha256K[24]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+        // Rounds 24-27
+        msg2 = vsha256su0q_u32(msg2, msg3);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg3, vld1q_u32(&kSha256K[28]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+        // Rounds 28-31
+        msg3 = vsha256su0q_u32(msg3, msg0);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg0, vld1q_u32(&kSha256K[32]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+        // Rounds 32-35
+        msg0 = vsha256su0q_u32(msg0, msg1);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg1, vld1q_u32(&kSha256K[36]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg0 = vsha256su1q_u32(msg0, msg2, msg3);
+        // Rounds 36-39
+        msg1 = vsha256su0q_u32(msg1, msg2);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg2, vld1q_u32(&kSha256K[40]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg1 = vsha256su1q_u32(msg1, msg3, msg0);
+        // Rounds 40-43
+        msg2 = vsha256su0q_u32(msg2, msg3);
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg3, vld1q_u32(&kSha256K[44]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        msg2 = vsha256su1q_u32(msg2, msg0, msg1);
+        // Rounds 44-47
+        msg3 = vsha256su0q_u32(msg3, msg0);
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg0, vld1q_u32(&kSha256K[48]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        msg3 = vsha256su1q_u32(msg3, msg1, msg2);
+        // Rounds 48-51
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg1, vld1q_u32(&kSha256K[52]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        // Rounds 52-55
+        tmp2 = state0;
+        tmp0 = vaddq_u32(msg2, vld1q_u32(&kSha256K[56]));
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+        // Rounds 56-59
+        tmp2 = state0;
+        tmp1 = vaddq_u32(msg3, vld1q_u32(&kSha256K[60]));
+        state0 = vsha256hq_u32(state0, state1, tmp0);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp0);
+        // Rounds 60-63
+        tmp2 = state0;
+        state0 = vsha256hq_u32(state0, state1, tmp1);
+        state1 = vsha256h2q_u32(state1, tmp2, tmp1);
+
+        state0 = vaddq_u32(state0, abefSave);
+        state1 = vaddq_u32(state1, cdghSave);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+PEINFO_TARGET_ARMCRYPTO
+void Sha1BlocksArm(uint32_t* state, const uint8_t* data, size_t blocks) {
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t e0 = state[4];
+
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32x4_t abcdSave = abcd;
+        uint32_t e0Save = e0;
+        uint32_t e1;
+        uint32x4_t msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 0)));
+        uint32x4_t msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16)));
+        uint32x4_t msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 32)));
+        uint32x4_t msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 48)));
+        uint32x4_t tmp0 = vaddq_u32(msg0, vdupq_n_u32(kSha1K[0]));
+        uint32x4_t tmp1 = vaddq_u32(msg1, vdupq_n_u32(kSha1K[0]));
+
+        // Rounds 0-3
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg2, vdupq_n_u32(kSha1K[0]));
+        msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+        // Rounds 4-7
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg3, vdupq_n_u32(kSha1K[0]));
+        msg0 = vsha1su1q_u32(msg0, msg3);
+        msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+        // Rounds 8-11
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg0, vdupq_n_u32(kSha1K[0]));
+        msg1 = vsha1su1q_u32(msg1, msg0);
+        msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+        // Rounds 12-15
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg1, vdupq_n_u32(kSha1K[1]));
+        msg2 = vsha1su1q_u32(msg2, msg1);
+        msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+        // Rounds 16-19
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg2, vdupq_n_u32(kSha1K[1]));
+        msg3 = vsha1su1q_u32(msg3, msg2);
+        msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+        // Rounds 20-23
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg3, vdupq_n_u32(kSha1K[1]));
+        msg0 = vsha1su1q_u32(msg0, msg3);
+        msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+        // Rounds 24-27
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg0, vdupq_n_u32(kSha1K[1]));
+        msg1 = vsha1su1q_u32(msg1, msg0);
+        msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+        // Rounds 28-31
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg1, vdupq_n_u32(kSha1K[1]));
+        msg2 = vsha1su1q_u32(msg2, msg1);
+        msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+        // Rounds 32-35
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg2, vdupq_n_u32(kSha1K[2]));
+        msg3 = vsha1su1q_u32(msg3, msg2);
+        msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+        // Rounds 36-39
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg3, vdupq_n_u32(kSha1K[2]));
+        msg0 = vsha1su1q_u32(msg0, msg3);
+        msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+        // Rounds 40-43
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg0, vdupq_n_u32(kSha1K[2]));
+        msg1 = vsha1su1q_u32(msg1, msg0);
+        msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+        // Rounds 44-47
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg1, vdupq_n_u32(kSha1K[2]));
+        msg2 = vsha1su1q_u32(msg2, msg1);
+        msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+        // Rounds 48-51
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg2, vdupq_n_u32(kSha1K[2]));
+        msg3 = vsha1su1q_u32(msg3, msg2);
+        msg0 = vsha1su0q_u32(msg0, msg1, msg2);
+        // Rounds 52-55
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg3, vdupq_n_u32(kSha1K[3]));
+        msg0 = vsha1su1q_u32(msg0, msg3);
+        msg1 = vsha1su0q_u32(msg1, msg2, msg3);
+        // Rounds 56-59
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg0, vdupq_n_u32(kSha1K[3]));
+        msg1 = vsha1su1q_u32(msg1, msg0);
+        msg2 = vsha1su0q_u32(msg2, msg3, msg0);
+        // Rounds 60-63
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg1, vdupq_n_u32(kSha1K[3]));
+        msg2 = vsha1su1q_u32(msg2, msg1);
+        msg3 = vsha1su0q_u32(msg3, msg0, msg1);
+        // Rounds 64-67
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, tmp0);
+        tmp0 = vaddq_u32(msg2, vdupq_n_u32(kSha1K[3]));
+        msg3 = vsha1su1q_u32(msg3, msg2);
+        // Rounds 68-71
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+        tmp1 = vaddq_u32(msg3, vdupq_n_u32(kSha1K[3]));
+        // Rounds 72-75
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, tmp0);
+        // Rounds 76-79
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, tmp1);
+
+        e0 += e0Save;
+        abcd = vaddq_u32(abcdSave, abcd);
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e0;
+}
+#endif
+
+struct ActiveImpls {
+    DigestImplInfo md5;
+    DigestImplInfo sha1;
+    DigestImplInfo sha256;
+    DigestImplInfo blake3;
+    DigestImplInfo sha256Tree;
+    DigestImplInfo xxh3;
+    DigestImplInfo crc32c;
+};
+
+// The last available entry for an algorithm is the preferred one.
+const ActiveImpls& GetActiveImpls() {
+    static const ActiveImpls active = []() {
+        ActiveImpls a = {};
+        for (const auto& impl : GetAvailableDigestImpls()) {
+            switch (impl.algorithm) {
+                case HashAlgorithm::MD5: a.md5 = impl; break;
+                case HashAlgorithm::SHA1: a.sha1 = impl; break;
+                case HashAlgorithm::SHA256: a.sha256 = impl; break;
+                case HashAlgorithm::BLAKE3: a.blake3 = impl; break;
+                case HashAlgorithm::SHA256Tree: a.sha256Tree = impl; break;
+                case HashAlgorithm::XXH3_64: a.xxh3 = impl; break;
+                case HashAlgorithm::CRC32C: a.crc32c = impl; break;
+                default: break;
+            }
+        }
+        return a;
+    }();
+    return active;
+}
+
+const DigestImplInfo& ActiveImpl(HashAlgorithm algorithm) {
+    const ActiveImpls& a = GetActiveImpls();
+    switch (algorithm) {
+        case HashAlgorithm::SHA1: return a.sha1;
+        case HashAlgorithm::SHA256: return a.sha256;
+        case HashAlgorithm::BLAKE3: return a.blake3;
+        case HashAlgorithm::SHA256Tree: return a.sha256Tree;
+        case HashAlgorithm::XXH3_64:
+        case HashAlgorithm::XXH3_128: return a.xxh3;
+        case HashAlgorithm::CRC32C: return a.crc32c;
+        default: return a.md5;
+    }
+}
+
+const char* AlgorithmNameA(HashAlgorithm algorithm) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5: return "MD5";
+        case HashAlgorithm::SHA1: return "SHA1";
+        case HashAlgorithm::SHA256: return "SHA256";
+        case HashAlgorithm::BLAKE3: return "BLAKE3";
+        case HashAlgorithm::SHA256Tree: return "SHA256-TREE";
+        case HashAlgorithm::SSDEEP: return "SSDEEP";
+        case HashAlgorithm::TLSH: return "TLSH";
+        case HashAlgorithm::XXH3_64: return "XXH3-64";
+        case HashAlgorithm::XXH3_128: return "XXH3-128";
+        case HashAlgorithm::CRC32C: return "CRC32C";
+        default: return "Unknown";
+    }
+}
+
+const char kHexDigits[] = "0123456789abcdef";
+
+} // namespace
+
+Digest::Digest(HashAlgorithm algorithm)
+    : Digest(algorithm, ActiveImpl(algorithm).blocks) {
+}
+
+Digest::Digest(HashAlgorithm algorithm, DigestBlockFn blocks)
+    : m_algorithm(algorithm), m_blocks(blocks), m_state(), m_length(0), m_buffer(), m_bufferLen(0) {
+    if (algorithm == HashAlgorithm::BLAKE3) {
+        m_blake3.reset(new Blake3Hasher());
+    } else if (algorithm == HashAlgorithm::SHA256Tree) {
+        m_tree.reset(new Sha256TreeHasher());
+    } else if (algorithm == HashAlgorithm::SSDEEP) {
+        m_ssdeep.reset(new SsdeepHasher());
+    } else if (algorithm == HashAlgorithm::TLSH) {
+        m_tlsh.reset(new TlshHasher());
+    } else if (algorithm == HashAlgorithm::XXH3_64 || algorithm == HashAlgorithm::XXH3_128) {
+        m_xxh3.reset(new Xxh3Hasher(algorithm == HashAlgorithm::XXH3_64 ? 8 : 16));
+    } else if (algorithm == HashAlgorithm::CRC32C) {
+        m_crc32c.reset(new Crc32cHasher());
+    }
+    Reset();
+}
+
+Digest::Digest(Digest&& other) noexcept = default;
+Digest& Digest::operator=(Digest&& other) noexcept = default;
+Digest::~Digest() = default;
+
+void Digest::SetThreadCount(size_t threads) {
+    if (m_blake3) {
+        m_blake3->SetThreadCount(threads);
+    } else if (m_tree) {
+        m_tree->SetThreadCount(threads);
+    }
+}
+
+size_t Digest::GetDigestSize(HashAlgorithm algorithm) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5: return 16;
+        case HashAlgorithm::SHA1: return 20;
+        case HashAlgorithm::SHA256: return 32;
+        case HashAlgorithm::BLAKE3: return Blake3Hasher::kOutLen;
+        case HashAlgorithm::SHA256Tree: return Sha256TreeHasher::kOutLen;
+        case HashAlgorithm::XXH3_64: return 8;
+        case HashAlgorithm::XXH3_128: return 16;
+        case HashAlgorithm::CRC32C: return Crc32cHasher::kOutLen;
+        default: return 0;
+    }
+}
+
+void Digest::Reset() {
+    switch (m_algorithm) {
+        case HashAlgorithm::MD5: std::memcpy(m_state, kMd5Init, sizeof(kMd5Init)); break;
+        case HashAlgorithm::SHA1: std::memcpy(m_state, kSha1Init, sizeof(kSha1Init)); break;
+        case HashAlgorithm::SHA256: std::memcpy(m_state, kSha256Init, sizeof(kSha256Init)); break;
+        case HashAlgorithm::BLAKE3: m_blake3->Reset(); break;
+        case HashAlgorithm::SHA256Tree: m_tree->Reset(); break;
+        case HashAlgorithm::SSDEEP: m_ssdeep->Reset(); break;
+        case HashAlgorithm::TLSH: m_tlsh->Reset(); break;
+        case HashAlgorithm::XXH3_64:
+        case HashAlgorithm::XXH3_128: m_xxh3->Reset(); break;
+        case HashAlgorithm::CRC32C: m_crc32c->Reset(); break;
+    }
+    m_length = 0;
+    m_bufferLen = 0;
+}
+
+void Digest::Update(const void* data, size_t size) {
+    if (m_blake3) {
+        m_blake3->Update(data, size);
+        return;
+    }
+    if (m_tree) {
+        m_tree->Update(data, size);
+        return;
+    }
+    if (m_ssdeep) {
+        m_ssdeep->Update(data, size);
+        return;
+    }
+    if (m_tlsh) {
+        m_tlsh->Update(data, size);
+        return;
+    }
+    if (m_xxh3) {
+        m_xxh3->Update(data, size);
+        return;
+    }
+    if (m_crc32c) {
+        m_crc32c->Update(data, size);
+        return;
+    }
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    m_length += size;
+    if (m_bufferLen != 0) {
+        size_t take = std::min(size, sizeof(m_buffer) - m_bufferLen);
+        std::memcpy(m_buffer + m_bufferLen, p, take);
+        m_bufferLen += take;
+        p += take;
+        size -= take;
+        if (m_bufferLen < sizeof(m_buffer)) {
+            return;
+        }
+        m_blocks(m_state, m_buffer, 1);
+        m_bufferLen = 0;
+    }
+    if (size >= 64) {
+        size_t blocks = size / 64;
+        m_blocks(m_state, p, blocks);
+        p += blocks * 64;
+        size -= blocks * 64;
+    }
+    if (size != 0) {
+        std::memcpy(m_buffer, p, size);
+        m_bufferLen = size;
+    }
+}
+
+void Digest::Final(uint8_t* out) {
+    if (m_blake3) {
+        m_blake3->Final(out);
+        return;
+    }
+    if (m_tree) {
+        m_tree->Final(out);
+        return;
+    }
+    if (m_ssdeep || m_tlsh) {
+        return;
+    }
+    if (m_xxh3) {
+        m_xxh3->Final(out);
+        return;
+    }
+    if (m_crc32c) {
+        m_crc32c->Final(out);
+        return;
+    }
+    const bool littleEndian = m_algorithm == HashAlgorithm::MD5;
+    uint64_t bits = m_length * 8;
+
+    uint8_t pad[128] = {};
+    size_t padLen = (m_bufferLen < 56) ? (56 - m_bufferLen) : (120 - m_bufferLen);
+    pad[0] = 0x80;
+    for (int i = 0; i < 8; ++i) {
+        int shift = littleEndian ? (8 * i) : (56 - 8 * i);
+        pad[padLen + static_cast<size_t>(i)] = static_cast<uint8_t>(bits >> shift);
+    }
+    Update(pad, padLen + 8);
+
+    size_t words = DigestSize() / 4;
+    for (size_t i = 0; i < words; ++i) {
+        if (littleEndian) {
+            StoreLe32(out + 4 * i, m_state[i]);
+        } else {
+            StoreBe32(out + 4 * i, m_state[i]);
+        }
+    }
+}
+
+std::wstring Digest::FinalText() {
+    std::string text;
+    if (m_ssdeep) {
+        text = m_ssdeep->Final();
+    } else if (m_tlsh) {
+        text = m_tlsh->Final();
+    } else {
+        uint8_t out[kMaxDigestSize];
+        Final(out);
+        return DigestToHex(out, DigestSize());
+    }
+    return std::wstring(text.begin(), text.end());
+}
+
+std::vector<uint8_t> Digest::SaveState() {
+    std::vector<uint8_t> state;
+    HashStateWriter out(state);
+    out.U8(static_cast<uint8_t>(m_algorithm));
+    if (m_blake3) {
+        m_blake3->SaveState(out);
+    } else if (m_tree) {
+        m_tree->SaveState(out);
+    } else if (m_ssdeep) {
+        m_ssdeep->SaveState(out);
+    } else if (m_tlsh) {
+        m_tlsh->SaveState(out);
+    } else if (m_xxh3) {
+        m_xxh3->SaveState(out);
+    } else if (m_crc32c) {
+        m_crc32c->SaveState(out);
+    } else {
+        for (uint32_t word : m_state) {
+            out.U32(word);
+        }
+        out.U64(m_length);
+        out.U32(static_cast<uint32_t>(m_bufferLen));
+        out.Bytes(m_buffer, m_bufferLen);
+    }
+    return state;
+}
+
+bool Digest::LoadState(const std::vector<uint8_t>& state) {
+    Reset();
+    HashStateReader in(state.data(), state.size());
+    if (in.U8() != static_cast<uint8_t>(m_algorithm)) {
+        return false;
+    }
+    bool ok = false;
+    if (m_blake3) {
+        ok = m_blake3->LoadState(in);
+    } else if (m_tree) {
+        ok = m_tree->LoadState(in);
+    } else if (m_ssdeep) {
+        ok = m_ssdeep->LoadState(in);
+    } else if (m_tlsh) {
+        ok = m_tlsh->LoadState(in);
+    } else if (m_xxh3) {
+        ok = m_xxh3->LoadState(in);
+    } else if (m_crc32c) {
+        ok = m_crc32c->LoadState(in);
+    } else {
+        for (uint32_t& word : m_state) {
+            word = in.U32();
+        }
+        m_length = in.U64();
+        m_bufferLen = in.U32();
+        if (m_bufferLen >= sizeof(m_buffer) || m_bufferLen != m_length % sizeof(m_buffer)) {
+            in.Fail();
+        } else {
+            in.Bytes(m_buffer, m_bufferLen);
+        }
+        ok = in.Ok();
+    }
+    if (!ok || !in.AtEnd()) {
+        Reset();
+        return false;
+    }
+    return true;
+}
+
+std::vector<DigestImplInfo> GetAvailableDigestImpls() {
+    std::vector<DigestImplInfo> impls = {
+        {HashAlgorithm::MD5, "portable", Md5BlocksScalar},
+        {HashAlgorithm::SHA1, "portable", Sha1BlocksScalar},
+        {HashAlgorithm::SHA256, "portable", Sha256BlocksScalar},
+        // No block function: the tree hashes run their own code on several
+        // threads. BLAKE3, XXH3 and CRC32C are listed under the name of the
+        // code they picked for this CPU.
+        {HashAlgorithm::BLAKE3, GetBlake3ImplName(), nullptr},
+        {HashAlgorithm::SHA256Tree, "parallel", nullptr},
+        {HashAlgorithm::XXH3_64, GetXxh3ImplName(), nullptr},
+        {HashAlgorithm::XXH3_128, GetXxh3ImplName(), nullptr},
+        {HashAlgorithm::CRC32C, GetCrc32cImplName(), nullptr},
+    };
+    const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_DIGEST_X86)
+    if (cpu.shaNi) {
+        impls.push_back({HashAlgorithm::SHA1, "sha-ni", Sha1BlocksShaNi});
+        impls.push_back({HashAlgorithm::SHA256, "sha-ni", Sha256BlocksShaNi});
+    }
+#elif defined(PEINFO_DIGEST_ARM64)
+    if (cpu.armSha1) {
+        impls.push_back({HashAlgorithm::SHA1, "armv8-crypto", Sha1BlocksArm});
+    }
+    if (cpu.armSha2) {
+        impls.push_back({HashAlgorithm::SHA256, "armv8-crypto", Sha256BlocksArm});
+    }
+#else
+    (void)cpu;
+#endif
+    return impls;
+}
+
+const char* GetActiveDigestImplName(HashAlgorithm algorithm) {
+    return ActiveImpl(algorithm).name;
+}
+
+const char* GetDigestAlgorithmName(HashAlgorithm algorithm) {
+    return AlgorithmNameA(algorithm);
+}
+
+DigestBlockFn GetActiveDigestBlocks(HashAlgorithm algorithm) {
+    return ActiveImpl(algorithm).blocks;
+}
+
+std::wstring DigestToHex(const uint8_t* data, size_t size) {
+    std::wstring out(size * 2, L'0');
+    for (size_t i = 0; i < size; ++i) {
+        out[2 * i] = static_cast<wchar_t>(kHexDigits[data[i] >> 4]);
+        out[2 * i + 1] = static_cast<wchar_t>(kHexDigits[data[i] & 0x0F]);
+    }
+    return out;
+}
+
+std::string DigestToHexA(const uint8_t* data, size_t size) {
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        out[2 * i] = kHexDigits[data[i] >> 4];
+        out[2 * i + 1] = kHexDigits[data[i] & 0x0F];
+    }
+    return out;
+}
+
+bool RunDigestSelfTest(std::wstring& error) {
+    struct Vector {
+        HashAlgorithm algorithm;
+        const char* label;
+        std::string input;
+        const char* expected;
+    };
+    const std::string million(1000000, 'a');
+    const std::string msg448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    // The BLAKE3 test-vector input: byte i is i % 251.
+    auto pattern = [](size_t size) {
+        std::string s(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            s[i] = static_cast<char>(i % 251);
+        }
+        return s;
+    };
+    const Vector vectors[] = {
+        {HashAlgorithm::MD5, "empty", "", "d41d8cd98f00b204e9800998ecf8427e"},
+        {HashAlgorithm::MD5, "abc", "abc", "900150983cd24fb0d6963f7d28e17f72"},
+        {HashAlgorithm::MD5, "message digest", "message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+        {HashAlgorithm::MD5, "a x 1000000", million, "7707d6ae4e027c70eea2a935c2296f21"},
+        {HashAlgorithm::SHA1, "empty", "", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+        {HashAlgorithm::SHA1, "abc", "abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+        {HashAlgorithm::SHA1, "448-bit", msg448, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+        {HashAlgorithm::SHA1, "a x 1000000", million, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+        {HashAlgorithm::SHA256, "empty", "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {HashAlgorithm::SHA256, "abc", "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {HashAlgorithm::SHA256, "448-bit", msg448, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {HashAlgorithm::SHA256, "a x 1000000", million, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+        {HashAlgorithm::BLAKE3, "empty", "", "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {HashAlgorithm::BLAKE3, "1 byte", pattern(1), "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+        {HashAlgorithm::BLAKE3, "1024 bytes", pattern(1024), "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+        {HashAlgorithm::BLAKE3, "1025 bytes", pattern(1025), "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+        {HashAlgorithm::BLAKE3, "8193 bytes", pattern(8193), "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+        {HashAlgorithm::BLAKE3, "102400 bytes", pattern(102400), "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+        {HashAlgorithm::BLAKE3, "20000000 bytes", pattern(20000000), "7b64655021b6e77e4ca87cf26aade7feef862c87aa9c0277699fd77977b40dc0"},
+        {HashAlgorithm::SHA256Tree, "empty", "", "a536aa3cede6ea3c1f3e0357c3c60e0f216a8c89b853df13b29daa8f85065dfb"},
+        {HashAlgorithm::SHA256Tree, "3 bytes", pattern(3), "81431495e481b209456a3aa5de24fb649e320a6549d8b3e93576b2be73ae9066"},
+        {HashAlgorithm::SHA256Tree, "1 MiB", pattern(1u << 20), "87deec49446abc8adbb28805d39f35b04a823964b0bd57e5140f71c4bcc9d8f8"},
+        {HashAlgorithm::SHA256Tree, "1 MiB + 1", pattern((1u << 20) + 1), "fac2a8331972d5ce90ea4a3b36104f1be265bc43e9b08c524970e24eb12c3398"},
+        {HashAlgorithm::SHA256Tree, "17 MiB + 3", pattern((17u << 20) + 3), "547d9464cae9478579aafcacd9aa2c655fb0cb0def79c8cb64495121ded2f45e"},
+        // XXH3 covers each length class of the short path and the stripe
+        // loop on either side of a 1 KiB block.
+        {HashAlgorithm::XXH3_64, "empty", "", "2d06800538d394c2"},
+        {HashAlgorithm::XXH3_64, "abc", "abc", "78af5f94892f3950"},
+        {HashAlgorithm::XXH3_64, "6 bytes", pattern(6), "a6584d1d9a6ae704"},
+        {HashAlgorithm::XXH3_64, "16 bytes", pattern(16), "8355e3a6f61770db"},
+        {HashAlgorithm::XXH3_64, "128 bytes", pattern(128), "85c6174c7ff4c46b"},
+        {HashAlgorithm::XXH3_64, "240 bytes", pattern(240), "375a384d957fe865"},
+        {HashAlgorithm::XXH3_64, "1024 bytes", pattern(1024), "e5d78bafa45b2aa5"},
+        {HashAlgorithm::XXH3_64, "1025 bytes", pattern(1025), "e95c42288f28186e"},
+        {HashAlgorithm::XXH3_64, "102400 bytes", pattern(102400), "1428e17f1cac2837"},
+        {HashAlgorithm::XXH3_128, "empty", "", "99aa06d3014798d86001c324468d497f"},
+        {HashAlgorithm::XXH3_128, "6 bytes", pattern(6), "545f093d32b168fea6b52f4dea3896a3"},
+        {HashAlgorithm::XXH3_128, "17 bytes", pattern(17), "685bc458b37d057fc06e233df7729217"},
+        {HashAlgorithm::XXH3_128, "129 bytes", pattern(129), "dd5e74ac6b45f54ebc30b63382b09a3b"},
+        {HashAlgorithm::XXH3_128, "241 bytes", pattern(241), "1da1cb61bcb8a2a102e8cd95421c6d02"},
+        {HashAlgorithm::XXH3_128, "102400 bytes", pattern(102400), "ecd387d36185351b1428e17f1cac2837"},
+        {HashAlgorithm::CRC32C, "empty", "", "00000000"},
+        {HashAlgorithm::CRC32C, "123456789", "123456789", "e3069283"},
+        {HashAlgorithm::CRC32C, "1025 bytes", pattern(1025), "c8d03add"},
+        {HashAlgorithm::CRC32C, "102400 bytes", pattern(102400), "7957da17"},
+    };
+    // Odd split sizes so that the buffered tail, whole-block runs and the
+    // padding boundary all get exercised.
+    const size_t splits[] = {1, 3, 55, 56, 63, 64, 65, 127, 4096 + 7};
+
+    for (const auto& impl : GetAvailableDigestImpls()) {
+        for (const auto& v : vectors) {
+            if (v.algorithm != impl.algorithm) {
+                continue;
+            }
+            Digest d(impl.algorithm, impl.blocks);
+            uint8_t out[kMaxDigestSize];
+            for (size_t pass = 0; pass <= sizeof(splits) / sizeof(splits[0]); ++pass) {
+                d.Reset();
+                if (pass == 0) {
+                    d.Update(v.input.data(), v.input.size());
+                } else {
+                    size_t step = splits[pass - 1];
+                    for (size_t off = 0; off < v.input.size(); off += step) {
+                        d.Update(v.input.data() + off, std::min(step, v.input.size() - off));
+                    }
+                }
+                d.Final(out);
+                if (DigestToHexA(out, d.DigestSize()) != v.expected) {
+                    std::string msg = std::string(AlgorithmNameA(impl.algorithm)) + " (" + impl.name + "): wrong digest for \"" +
+                                      v.label + "\"";
+                    if (pass != 0) {
+                        msg += " in " + std::to_string(splits[pass - 1]) + "-byte updates";
+                    }
+                    error.assign(msg.begin(), msg.end());
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<DigestBenchmarkResult> RunDigestBenchmark(size_t bufferBytes, int rounds) {
+    std::vector<uint8_t> buffer(bufferBytes);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+    }
+    if (rounds < 1) {
+        rounds = 1;
+    }
+
+    std::vector<DigestBenchmarkResult> results;
+    for (const auto& impl : GetAvailableDigestImpls()) {
+        Digest d(impl.algorithm, impl.blocks);
+        uint8_t out[kMaxDigestSize];
+        double best = 0.0;
+        for (int r = 0; r < rounds; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            d.Reset();
+            d.Update(buffer.data(), buffer.size());
+            d.Final(out);
+            std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+            if (r == 0 || diff.count() < best) {
+                best = diff.count();
+            }
+        }
+        DigestBenchmarkResult res;
+        res.algorithm = AlgorithmNameA(impl.algorithm);
+        res.impl = impl.name;
+        res.bytes = bufferBytes;
+        res.seconds = best;
+        res.megabytesPerSecond = best > 0.0 ? (static_cast<double>(bufferBytes) / 1e6) / best : 0.0;
+        results.push_back(res);
+    }
+    return results;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Self-contained MD5 / SHA-1 / SHA-256. Block functions are picked once per
+// process from the CPU features (SHA-NI on x86, the ARMv8 crypto extension on
+// ARM64) with portable C++ as the fallback. BLAKE3 and SHA256-TREE are
+// forwarded to their multi-threaded hashers, SSDEEP and TLSH to FuzzyHash,
+// XXH3 and CRC32C to their own. Builds without Windows headers.
+
+class Blake3Hasher;
+class Crc32cHasher;
+class Sha256TreeHasher;
+class SsdeepHasher;
+class TlshHasher;
+class Xxh3Hasher;
+
+typedef void (*DigestBlockFn)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+const size_t kMaxDigestSize = 32;
+
+// SHA-256 round constants and initial state, shared with the multi-buffer code.
+extern const uint32_t kSha256K[64];
+extern const uint32_t kSha256Init[8];
+
+struct DigestImplInfo {
+    HashAlgorithm algorithm;
+    const char* name;
+    DigestBlockFn blocks;
+};
+
+class Digest {
+public:
+    explicit Digest(HashAlgorithm algorithm);
+    // Uses a specific block implementation; for self-tests and benchmarks.
+    Digest(HashAlgorithm algorithm, DigestBlockFn blocks);
+    Digest(Digest&& other) noexcept;
+    Digest& operator=(Digest&& other) noexcept;
+    ~Digest();
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    // Sets the worker thread count of the tree hashes (0 = hardware
+    // concurrency); ignored by the others.
+    void SetThreadCount(size_t threads);
+    // Writes DigestSize() bytes to out. The context must be Reset() before reuse.
+    // SSDEEP and TLSH have no binary form (DigestSize() is 0); use FinalText.
+    void Final(uint8_t* out);
+    // The result as reports show it: lowercase hex, or the digest text of
+    // SSDEEP and TLSH. Same reuse rule as Final.
+    std::wstring FinalText();
+
+    // The context as hash checkpoints store it (HashCheckpoint.h). The tree
+    // hashes first hash the input they hold back for a parallel batch, which
+    // does not change the result.
+    std::vector<uint8_t> SaveState();
+    // Restores a SaveState result of the same algorithm; false, with the
+    // context Reset, for state of another algorithm or malformed state.
+    bool LoadState(const std::vector<uint8_t>& state);
+
+    HashAlgorithm GetAlgorithm() const { return m_algorithm; }
+    size_t DigestSize() const { return GetDigestSize(m_algorithm); }
+
+    static size_t GetDigestSize(HashAlgorithm algorithm);
+
+private:
+    HashAlgorithm m_algorithm;
+    DigestBlockFn m_blocks;
+    uint32_t m_state[8];
+    uint64_t m_length;
+    uint8_t m_buffer[64];
+    size_t m_bufferLen;
+    std::unique_ptr<Blake3Hasher> m_blake3;
+    std::unique_ptr<Sha256TreeHasher> m_tree;
+    std::unique_ptr<SsdeepHasher> m_ssdeep;
+    std::unique_ptr<TlshHasher> m_tlsh;
+    std::unique_ptr<Xxh3Hasher> m_xxh3;
+    std::unique_ptr<Crc32cHasher> m_crc32c;
+};
+
+// Every implementation compiled into this binary that the CPU can run,
+// portable ones first.
+std::vector<DigestImplInfo> GetAvailableDigestImpls();
+const char* GetActiveDigestImplName(HashAlgorithm algorithm);
+// "MD5", "SHA1", "SHA256", "BLAKE3", "SHA256-TREE", "SSDEEP", "TLSH",
+// "XXH3-64", "XXH3-128" or "CRC32C".
+const char* GetDigestAlgorithmName(HashAlgorithm algorithm);
+DigestBlockFn GetActiveDigestBlocks(HashAlgorithm algorithm);
+
+std::wstring DigestToHex(const uint8_t* data, size_t size);
+std::string DigestToHexA(const uint8_t* data, size_t size);
+
+// Known-answer tests against every available implementation, including inputs
+// split across Update() calls at odd offsets.
+bool RunDigestSelfTest(std::wstring& error);
+
+struct DigestBenchmarkResult {
+    std::string algorithm;
+    std::string impl;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+// Hashes a buffer of the given size with every available implementation,
+// keeping the best of several rounds.
+std::vector<DigestBenchmarkResult> RunDigestBenchmark(size_t bufferBytes, int rounds);
@@ -0,0 +1,1022 @@
+#include "FuzzyHash.h"
+
+#include "CpuFeatures.h"
+#include "HashState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_FUZZY_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_FUZZY_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// ---- ssdeep ----
+
+const uint32_t kRollingWindow = 7;
+const uint64_t kMinBlockSize = 3;
+const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+// The piece hashes are FNV-style, (h * 0x01000193) ^ c starting from
+// 0x28021967, but only their low 6 bits ever reach the digest, so they are
+// kept modulo 64 throughout.
+const uint32_t kHashInit = 0x28021967 & 0x3F;
+
+inline uint32_t SumHash(uint8_t c, uint32_t h) {
+    return ((h * 0x13) ^ c) & 0x3F;
+}
+
+inline uint64_t BlockSize(uint32_t index) {
+    return kMinBlockSize << index;
+}
+
+// h % BlockSize(index) == BlockSize(index) - 1 without a division: h + 1
+// must be a multiple of both 2^index and 3.
+inline bool IsTriggerPoint(uint32_t h, uint32_t index) {
+    const uint32_t low = (uint32_t(1) << index) - 1;
+    return (h & low) == low && (h >> index) % 3 == 2;
+}
+
+// Parts of a parsed digest are at most this long.
+const size_t kSpamSumLength = 64;
+
+// ---- TLSH ----
+
+// Pearson's table, as TLSH uses it.
+const uint8_t kPearson[256] = {
+    1, 87, 49, 12, 176, 178, 102, 166, 121, 193, 6, 84, 249, 230, 44, 163,
+    14, 197, 213, 181, 161, 85, 218, 80, 64, 239, 24, 226, 236, 142, 38, 200,
+    110, 177, 104, 103, 141, 253, 255, 50, 77, 101, 81, 18, 45, 96, 31, 222,
+    25, 107, 190, 70, 86, 237, 240, 34, 72, 242, 20, 214, 244, 227, 149, 235,
+    97, 234, 57, 22, 60, 250, 82, 175, 208, 5, 127, 199, 111, 62, 135, 248,
+    174, 169, 211, 58, 66, 154, 106, 195, 245, 171, 17, 187, 182, 179, 0, 243,
+    132, 56, 148, 75, 128, 133, 158, 100, 130, 126, 91, 13, 153, 246, 216, 219,
+    119, 68, 223, 78, 83, 88, 201, 99, 122, 11, 92, 32, 136, 114, 52, 10,
+    138, 30, 48, 183, 156, 35, 61, 26, 143, 74, 251, 94, 129, 162, 63, 152,
+    170, 7, 115, 167, 241, 206, 3, 150, 55, 59, 151, 220, 90, 53, 23, 131,
+    125, 173, 15, 238, 79, 95, 89, 16, 105, 137, 225, 224, 217, 160, 37, 123,
+    118, 73, 2, 157, 46, 116, 9, 145, 134, 228, 207, 212, 202, 215, 69, 229,
+    27, 188, 67, 124, 168, 252, 42, 4, 29, 108, 21, 247, 19, 205, 39, 203,
+    233, 40, 186, 147, 198, 192, 155, 33, 164, 191, 98, 204, 165, 180, 117, 76,
+    140, 36, 210, 172, 41, 54, 159, 8, 185, 232, 113, 196, 231, 47, 146, 120,
+    51, 65, 28, 144, 254, 221, 93, 189, 194, 139, 112, 43, 71, 109, 184, 209};
+
+const size_t kTlshCodeSize = 32;
+const size_t kTlshBuckets = 128;
+const uint64_t kTlshMinLength = 50;
+
+inline uint8_t PearsonMap(uint8_t salt, uint8_t i, uint8_t j, uint8_t k) {
+    return kPearson[kPearson[kPearson[kPearson[salt] ^ i] ^ j] ^ k];
+}
+
+inline uint8_t SwapNibbles(uint8_t b) {
+    return static_cast<uint8_t>((b >> 4) | (b << 4));
+}
+
+// Log-scale length bucket.
+uint8_t TlshLengthCode(uint32_t length) {
+    int i;
+    if (length <= 656) {
+        i = static_cast<int>(std::floor(std::log(static_cast<float>(length)) / 0.4054651));
+    } else if (length <= 3199) {
+        i = static_cast<int>(std::floor(std::log(static_cast<float>(length)) / 0.26236426 - 8.72777));
+    } else {
+        i = static_cast<int>(std::floor(std::log(static_cast<float>(length)) / 0.095310180 - 62.5472));
+    }
+    return static_cast<uint8_t>(i & 0xFF);
+}
+
+struct TlshDigest {
+    uint8_t checksum;
+    uint8_t lvalue;
+    uint8_t q1ratio;
+    uint8_t q2ratio;
+    // In digest-string order; the distance does not depend on it.
+    uint8_t code[kTlshCodeSize];
+};
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Accepts "T1" + 70 hex digits and the older form without the prefix.
+bool ParseTlsh(const std::string& text, TlshDigest& out) {
+    const size_t kHexLength = 2 * (3 + kTlshCodeSize);
+    size_t start = 0;
+    if (text.size() == kHexLength + 2 && (text[0] == 'T' || text[0] == 't') && text[1] == '1') {
+        start = 2;
+    } else if (text.size() != kHexLength) {
+        return false;
+    }
+    uint8_t bytes[3 + kTlshCodeSize];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        int hi = HexValue(text[start + 2 * i]);
+        int lo = HexValue(text[start + 2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    out.checksum = SwapNibbles(bytes[0]);
+    out.lvalue = SwapNibbles(bytes[1]);
+    uint8_t q = SwapNibbles(bytes[2]);
+    out.q1ratio = q & 0x0F;
+    out.q2ratio = q >> 4;
+    std::memcpy(out.code, bytes + 3, kTlshCodeSize);
+    return true;
+}
+
+int ModDiff(int x, int y, int range) {
+    int dl = x > y ? x - y : y - x;
+    int dr = range - dl;
+    return dl < dr ? dl : dr;
+}
+
+int TlshHeaderDistance(uint8_t checksumA, uint8_t lvalueA, uint8_t q1A, uint8_t q2A,
+                       uint8_t checksumB, uint8_t lvalueB, uint8_t q1B, uint8_t q2B) {
+    int diff = 0;
+    int ldiff = ModDiff(lvalueA, lvalueB, 256);
+    diff += ldiff <= 1 ? ldiff : ldiff * 12;
+    int q1diff = ModDiff(q1A, q1B, 16);
+    diff += q1diff <= 1 ? q1diff : (q1diff - 1) * 12;
+    int q2diff = ModDiff(q2A, q2B, 16);
+    diff += q2diff <= 1 ? q2diff : (q2diff - 1) * 12;
+    if (checksumA != checksumB) {
+        diff += 1;
+    }
+    return diff;
+}
+
+// Sum over the 2-bit bucket codes of |a - b|, with a difference of 3
+// counted as 6.
+typedef void (*TlshCodesFn)(const uint8_t* query, const uint8_t* codes, size_t count, int* out);
+
+int TlshCodeDistance(const uint8_t* a, const uint8_t* b) {
+    int diff = 0;
+    for (size_t i = 0; i < kTlshCodeSize; ++i) {
+        for (int shift = 0; shift < 8; shift += 2) {
+            int d = std::abs(((a[i] >> shift) & 3) - ((b[i] >> shift) & 3));
+            diff += d == 3 ? 6 : d;
+        }
+    }
+    return diff;
+}
+
+void TlshCodesPortable(const uint8_t* query, const uint8_t* codes, size_t count, int* out) {
+    for (size_t e = 0; e < count; ++e) {
+        out[e] = TlshCodeDistance(query, codes + e * kTlshCodeSize);
+    }
+}
+
+// Bit mask of the entries of grams equal to needle; count <= 64.
+typedef uint64_t (*GramMatchFn)(uint32_t needle, const uint32_t* grams, size_t count);
+
+uint64_t GramMatchPortable(uint32_t needle, const uint32_t* grams, size_t count) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (grams[i] == needle) {
+            mask |= uint64_t(1) << i;
+        }
+    }
+    return mask;
+}
+
+#if defined(PEINFO_FUZZY_X86)
+PEINFO_TARGET_SSE2 inline __m128i TlshFieldDiffSse2(__m128i q, __m128i v) {
+    const __m128i three = _mm_set1_epi8(3);
+    __m128i d = _mm_or_si128(_mm_subs_epu8(q, v), _mm_subs_epu8(v, q));
+    return _mm_add_epi8(d, _mm_and_si128(_mm_cmpeq_epi8(d, three), three));
+}
+
+PEINFO_TARGET_SSE2 void TlshCodesSse2(const uint8_t* query, const uint8_t* codes, size_t count, int* out) {
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i q[2][4];
+    for (int h = 0; h < 2; ++h) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(query + 16 * h));
+        q[h][0] = _mm_and_si128(v, three);
+        q[h][1] = _mm_and_si128(_mm_srli_epi16(v, 2), three);
+        q[h][2] = _mm_and_si128(_mm_srli_epi16(v, 4), three);
+        q[h][3] = _mm_and_si128(_mm_srli_epi16(v, 6), three);
+    }
+    for (size_t e = 0; e < count; ++e) {
+        const uint8_t* c = codes + e * kTlshCodeSize;
+        __m128i acc = zero;
+        for (int h = 0; h < 2; ++h) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + 16 * h));
+            acc = _mm_add_epi8(acc, TlshFieldDiffSse2(q[h][0], _mm_and_si128(v, three)));
+            acc = _mm_add_epi8(acc, TlshFieldDiffSse2(q[h][1], _mm_and_si128(_mm_srli_epi16(v, 2), three)));
+            acc = _mm_add_epi8(acc, TlshFieldDiffSse2(q[h][2], _mm_and_si128(_mm_srli_epi16(v, 4), three)));
+            acc = _mm_add_epi8(acc, TlshFieldDiffSse2(q[h][3], _mm_and_si128(_mm_srli_epi16(v, 6), three)));
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        out[e] = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+}
+
+PEINFO_TARGET_AVX2 inline __m256i TlshFieldDiffAvx2(__m256i q, __m256i v) {
+    const __m256i three = _mm256_set1_epi8(3);
+    __m256i d = _mm256_or_si256(_mm256_subs_epu8(q, v), _mm256_subs_epu8(v, q));
+    return _mm256_add_epi8(d, _mm256_and_si256(_mm256_cmpeq_epi8(d, three), three));
+}
+
+PEINFO_TARGET_AVX2 void TlshCodesAvx2(const uint8_t* query, const uint8_t* codes, size_t count, int* out) {
+    const __m256i three = _mm256_set1_epi8(3);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+    const __m256i q0 = _mm256_and_si256(v, three);
+    const __m256i q1 = _mm256_and_si256(_mm256_srli_epi16(v, 2), three);
+    const __m256i q2 = _mm256_and_si256(_mm256_srli_epi16(v, 4), three);
+    const __m256i q3 = _mm256_and_si256(_mm256_srli_epi16(v, 6), three);
+    for (size_t e = 0; e < count; ++e) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + e * kTlshCodeSize));
+        __m256i acc = TlshFieldDiffAvx2(q0, _mm256_and_si256(c, three));
+        acc = _mm256_add_epi8(acc, TlshFieldDiffAvx2(q1, _mm256_and_si256(_mm256_srli_epi16(c, 2), three)));
+        acc = _mm256_add_epi8(acc, TlshFieldDiffAvx2(q2, _mm256_and_si256(_mm256_srli_epi16(c, 4), three)));
+        acc = _mm256_add_epi8(acc, TlshFieldDiffAvx2(q3, _mm256_and_si256(_mm256_srli_epi16(c, 6), three)));
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        out[e] = _mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8));
+    }
+}
+
+PEINFO_TARGET_SSE2 uint64_t GramMatchSse2(uint32_t needle, const uint32_t* grams, size_t count) {
+    const __m128i n = _mm_set1_epi32(static_cast<int>(needle));
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(grams + i)), n);
+        mask |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(eq))) << i;
+    }
+    return mask | (GramMatchPortable(needle, grams + i, count - i) << i);
+}
+
+PEINFO_TARGET_AVX2 uint64_t GramMatchAvx2(uint32_t needle, const uint32_t* grams, size_t count) {
+    const __m256i n = _mm256_set1_epi32(static_cast<int>(needle));
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(grams + i)), n);
+        mask |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(eq))) << i;
+    }
+    return mask | (GramMatchPortable(needle, grams + i, count - i) << i);
+}
+#endif
+
+#if defined(PEINFO_FUZZY_NEON)
+inline uint8x16_t TlshFieldDiffNeon(uint8x16_t q, uint8x16_t v) {
+    const uint8x16_t three = vdupq_n_u8(3);
+    uint8x16_t d = vabdq_u8(q, v);
+    return vaddq_u8(d, vandq_u8(vceqq_u8(d, three), three));
+}
+
+void TlshCodesNeon(const uint8_t* query, const uint8_t* codes, size_t count, int* out) {
+    const uint8x16_t three = vdupq_n_u8(3);
+    uint8x16_t q[2][4];
+    for (int h = 0; h < 2; ++h) {
+        uint8x16_t v = vld1q_u8(query + 16 * h);
+        q[h][0] = vandq_u8(v, three);
+        q[h][1] = vandq_u8(vshrq_n_u8(v, 2), three);
+        q[h][2] = vandq_u8(vshrq_n_u8(v, 4), three);
+        q[h][3] = vshrq_n_u8(v, 6);
+    }
+    for (size_t e = 0; e < count; ++e) {
+        const uint8_t* c = codes + e * kTlshCodeSize;
+        uint8x16_t acc = vdupq_n_u8(0);
+        for (int h = 0; h < 2; ++h) {
+            uint8x16_t v = vld1q_u8(c + 16 * h);
+            acc = vaddq_u8(acc, TlshFieldDiffNeon(q[h][0], vandq_u8(v, three)));
+            acc = vaddq_u8(acc, TlshFieldDiffNeon(q[h][1], vandq_u8(vshrq_n_u8(v, 2), three)));
+            acc = vaddq_u8(acc, TlshFieldDiffNeon(q[h][2], vandq_u8(vshrq_n_u8(v, 4), three)));
+            acc = vaddq_u8(acc, TlshFieldDiffNeon(q[h][3], vshrq_n_u8(v, 6)));
+        }
+        out[e] = static_cast<int>(vaddlvq_u8(acc));
+    }
+}
+
+uint64_t GramMatchNeon(uint32_t needle, const uint32_t* grams, size_t count) {
+    const uint32x4_t n = vdupq_n_u32(needle);
+    const uint32_t bitValues[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(bitValues);
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t eq = vceqq_u32(vld1q_u32(grams + i), n);
+        mask |= static_cast<uint64_t>(vaddvq_u32(vandq_u32(eq, bits))) << i;
+    }
+    return mask | (GramMatchPortable(needle, grams + i, count - i) << i);
+}
+#endif
+
+struct FuzzyKernels {
+    const char* name;
+    TlshCodesFn tlshCodes;
+    GramMatchFn gramMatch;
+};
+
+const FuzzyKernels& GetFuzzyKernels() {
+    static const FuzzyKernels active = []() {
+        FuzzyKernels best = {"portable", TlshCodesPortable, GramMatchPortable};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_FUZZY_X86)
+        if (cpu.avx2) {
+            best = {"avx2", TlshCodesAvx2, GramMatchAvx2};
+        } else if (cpu.sse2) {
+            best = {"sse2", TlshCodesSse2, GramMatchSse2};
+        }
+#elif defined(PEINFO_FUZZY_NEON)
+        (void)cpu;
+        best = {"neon", TlshCodesNeon, GramMatchNeon};
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+// ---- ssdeep comparison ----
+
+struct SsdeepDigest {
+    uint64_t blockSize = 0;
+    // With runs of more than three equal characters cut to three, as
+    // fuzzy_compare does before scoring.
+    std::string part[2];
+};
+
+std::string EliminateSequences(const char* text, size_t size) {
+    std::string out;
+    out.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        if (i >= 3 && text[i] == text[i - 1] && text[i] == text[i - 2] && text[i] == text[i - 3]) {
+            continue;
+        }
+        out.push_back(text[i]);
+    }
+    return out;
+}
+
+// "blocksize:part:part", optionally followed by ",filename" as the ssdeep
+// tool prints it.
+bool ParseSsdeep(const std::string& text, SsdeepDigest& out) {
+    size_t pos = 0;
+    uint64_t blockSize = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        blockSize = blockSize * 10 + static_cast<uint64_t>(text[pos] - '0');
+        if (blockSize > (uint64_t(1) << 40)) {
+            return false;
+        }
+        ++pos;
+    }
+    if (pos == 0 || blockSize == 0 || pos >= text.size() || text[pos] != ':') {
+        return false;
+    }
+    size_t first = pos + 1;
+    size_t colon = text.find(':', first);
+    if (colon == std::string::npos) {
+        return false;
+    }
+    size_t second = colon + 1;
+    size_t end = text.find(',', second);
+    if (end == std::string::npos) {
+        end = text.size();
+    }
+    if (colon - first > kSpamSumLength || end - second > kSpamSumLength) {
+        return false;
+    }
+    out.blockSize = blockSize;
+    out.part[0] = EliminateSequences(text.data() + first, colon - first);
+    out.part[1] = EliminateSequences(text.data() + second, end - second);
+    return true;
+}
+
+// Stands in for ssdeep's rolling hash of every 7-character window; only
+// equal windows matter, and candidates are confirmed with memcmp.
+inline uint32_t GramHash(const char* p) {
+    uint64_t v = 0;
+    std::memcpy(&v, p, kRollingWindow);
+    return static_cast<uint32_t>((v * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+void AppendGrams(const std::string& part, std::vector<uint32_t>& grams) {
+    for (size_t i = 0; i + kRollingWindow <= part.size(); ++i) {
+        grams.push_back(GramHash(part.data() + i));
+    }
+}
+
+size_t GramCount(size_t length) {
+    return length >= kRollingWindow ? length - kRollingWindow + 1 : 0;
+}
+
+struct PartView {
+    const char* text;
+    size_t length;
+    const uint32_t* grams;
+};
+
+bool HaveCommonGram(const PartView& a, const PartView& b, GramMatchFn match) {
+    const size_t aCount = GramCount(a.length);
+    const size_t bCount = GramCount(b.length);
+    for (size_t i = 0; i < aCount; ++i) {
+        uint64_t mask = match(a.grams[i], b.grams, bCount);
+        for (size_t j = 0; mask != 0; ++j, mask >>= 1) {
+            if ((mask & 1) && std::memcmp(a.text + i, b.text + j, kRollingWindow) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Levenshtein distance with insertions and deletions costing 1 and
+// substitutions 2.
+uint32_t EditDistance(const char* a, size_t aLength, const char* b, size_t bLength) {
+    uint32_t rows[2][kSpamSumLength + 1];
+    uint32_t* prev = rows[0];
+    uint32_t* cur = rows[1];
+    for (size_t j = 0; j <= bLength; ++j) {
+        prev[j] = static_cast<uint32_t>(j);
+    }
+    for (size_t i = 0; i < aLength; ++i) {
+        cur[0] = static_cast<uint32_t>(i + 1);
+        for (size_t j = 0; j < bLength; ++j) {
+            uint32_t insert = prev[j + 1] + 1;
+            uint32_t remove = cur[j] + 1;
+            uint32_t replace = prev[j] + (a[i] == b[j] ? 0 : 2);
+            cur[j + 1] = std::min<uint32_t>(std::min<uint32_t>(insert, remove), replace);
+        }
+        std::swap(prev, cur);
+    }
+    return prev[bLength];
+}
+
+uint32_t ScoreParts(const PartView& a, const PartView& b, uint64_t blockSize, GramMatchFn match) {
+    if (!HaveCommonGram(a, b, match)) {
+        return 0;
+    }
+    uint32_t score = EditDistance(a.text, a.length, b.text, b.length);
+    score = static_cast<uint32_t>((score * kSpamSumLength) / (a.length + b.length));
+    score = (100 * score) / static_cast<uint32_t>(kSpamSumLength);
+    if (score >= 100) {
+        return 0;
+    }
+    score = 100 - score;
+    // Short digests of small block sizes match too easily; cap their score.
+    const uint64_t kUncappedBlockSize = (99 + kRollingWindow) / kRollingWindow * kMinBlockSize;
+    if (blockSize >= kUncappedBlockSize) {
+        return score;
+    }
+    uint64_t cap = blockSize / kMinBlockSize * std::min<size_t>(a.length, b.length);
+    return static_cast<uint32_t>(std::min<uint64_t>(score, cap));
+}
+
+// parts[0] and parts[1] of each side are at block sizes bs and 2 * bs.
+int ScoreDigests(uint64_t blockSizeA, const PartView* a, uint64_t blockSizeB, const PartView* b, GramMatchFn match) {
+    if (blockSizeA == blockSizeB) {
+        if (a[0].length == b[0].length && a[1].length == b[1].length &&
+            std::memcmp(a[0].text, b[0].text, a[0].length) == 0 && std::memcmp(a[1].text, b[1].text, a[1].length) == 0) {
+            return 100;
+        }
+        uint32_t s0 = ScoreParts(a[0], b[0], blockSizeA, match);
+        uint32_t s1 = ScoreParts(a[1], b[1], blockSizeA * 2, match);
+        return static_cast<int>(std::max<uint32_t>(s0, s1));
+    }
+    if (blockSizeA * 2 == blockSizeB) {
+        return static_cast<int>(ScoreParts(a[1], b[0], blockSizeB, match));
+    }
+    if (blockSizeB * 2 == blockSizeA) {
+        return static_cast<int>(ScoreParts(a[0], b[1], blockSizeA, match));
+    }
+    return 0;
+}
+
+// Views of a parsed digest; grams holds the 7-character windows of both
+// parts, the first part's first.
+void ViewDigest(const SsdeepDigest& d, std::vector<uint32_t>& grams, PartView* views) {
+    grams.clear();
+    AppendGrams(d.part[0], grams);
+    AppendGrams(d.part[1], grams);
+    const size_t firstCount = GramCount(d.part[0].size());
+    views[0] = {d.part[0].data(), d.part[0].size(), grams.data()};
+    views[1] = {d.part[1].data(), d.part[1].size(), grams.data() + firstCount};
+}
+
+} // namespace
+
+SsdeepHasher::SsdeepHasher() {
+    Reset();
+}
+
+void SsdeepHasher::Reset() {
+    m_bhStart = 0;
+    m_bhEnd = 1;
+    m_bh[0].h = kHashInit;
+    m_bh[0].halfh = kHashInit;
+    m_bh[0].digest[0] = '\0';
+    m_bh[0].halfdigest = '\0';
+    m_bh[0].dlen = 0;
+    m_totalSize = 0;
+    m_lastH = 0;
+    m_needLastH = false;
+    std::memset(m_window, 0, sizeof(m_window));
+    m_h1 = 0;
+    m_h2 = 0;
+    m_h3 = 0;
+    m_n = 0;
+}
+
+void SsdeepHasher::Update(const void* data, size_t size) {
+    const uint64_t kMaxTotalSize = BlockSize(kNumBlockHashes - 1) * kSpamSumLength;
+    m_totalSize = std::min<uint64_t>(m_totalSize + size, kMaxTotalSize + 1);
+    // The rolling hash runs in locals: byte stores into the member window
+    // would make the compiler reload every other member after each one.
+    uint8_t window[kRollingWindow];
+    std::memcpy(window, m_window, sizeof(window));
+    uint32_t h1 = m_h1;
+    uint32_t h2 = m_h2;
+    uint32_t h3 = m_h3;
+    uint32_t n = m_n;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t k = 0; k < size; ++k) {
+        const uint8_t c = p[k];
+        h2 -= h1;
+        h2 += kRollingWindow * static_cast<uint32_t>(c);
+        h1 += c;
+        h1 -= window[n];
+        window[n] = c;
+        if (++n == kRollingWindow) {
+            n = 0;
+        }
+        h3 = (h3 << 5) ^ c;
+
+        for (uint32_t i = m_bhStart; i < m_bhEnd; ++i) {
+            m_bh[i].h = SumHash(c, m_bh[i].h);
+            m_bh[i].halfh = SumHash(c, m_bh[i].halfh);
+        }
+        if (m_needLastH) {
+            m_lastH = SumHash(c, m_lastH);
+        }
+        const uint32_t h = h1 + h2 + h3;
+        if (IsTriggerPoint(h, m_bhStart)) {
+            AddTriggerPoint(h);
+        }
+    }
+    std::memcpy(m_window, window, sizeof(window));
+    m_h1 = h1;
+    m_h2 = h2;
+    m_h3 = h3;
+    m_n = n;
+}
+
+void SsdeepHasher::AddTriggerPoint(uint32_t h) {
+    // Block sizes double, so a trigger point of one is a trigger point of
+    // every smaller one.
+    for (uint32_t i = m_bhStart; i < m_bhEnd; ++i) {
+        if (!IsTriggerPoint(h, i)) {
+            break;
+        }
+        if (m_bh[i].dlen == 0) {
+            TryForkBlockHash();
+        }
+        BlockHash& bh = m_bh[i];
+        bh.digest[bh.dlen] = kBase64[bh.h];
+        bh.halfdigest = kBase64[bh.halfh];
+        if (bh.dlen < kSpamSumLength - 1) {
+            bh.digest[++bh.dlen] = '\0';
+            bh.h = kHashInit;
+            if (bh.dlen < kSpamSumLength / 2) {
+                bh.halfh = kHashInit;
+                bh.halfdigest = '\0';
+            }
+        } else {
+            TryReduceBlockHash();
+        }
+    }
+}
+
+void SsdeepHasher::TryForkBlockHash() {
+    const BlockHash& last = m_bh[m_bhEnd - 1];
+    if (m_bhEnd < kNumBlockHashes) {
+        BlockHash& next = m_bh[m_bhEnd];
+        next.h = last.h;
+        next.halfh = last.halfh;
+        next.digest[0] = '\0';
+        next.halfdigest = '\0';
+        next.dlen = 0;
+        ++m_bhEnd;
+    } else if (!m_needLastH) {
+        m_needLastH = true;
+        m_lastH = last.h;
+    }
+}
+
+void SsdeepHasher::TryReduceBlockHash() {
+    // Drops the smallest block size once it can no longer be the one
+    // reported; only saves work.
+    if (m_bhEnd - m_bhStart < 2) {
+        return;
+    }
+    if (BlockSize(m_bhStart) * kSpamSumLength >= m_totalSize) {
+        return;
+    }
+    if (m_bh[m_bhStart + 1].dlen < kSpamSumLength / 2) {
+        return;
+    }
+    ++m_bhStart;
+}
+
+std::string SsdeepHasher::Final() const {
+    if (m_totalSize > BlockSize(kNumBlockHashes - 1) * kSpamSumLength) {
+        return std::string();
+    }
+    const uint32_t h = m_h1 + m_h2 + m_h3;
+    uint32_t bi = m_bhStart;
+    while (BlockSize(bi) * kSpamSumLength < m_totalSize) {
+        ++bi;
+    }
+    while (bi >= m_bhEnd) {
+        --bi;
+    }
+    while (bi > m_bhStart && m_bh[bi].dlen < kSpamSumLength / 2) {
+        --bi;
+    }
+
+    std::string out = std::to_string(BlockSize(bi));
+    out.push_back(':');
+    const BlockHash& first = m_bh[bi];
+    out.append(first.digest, first.dlen);
+    // A non-zero rolling hash means input after the last trigger point.
+    if (h != 0) {
+        out.push_back(kBase64[first.h]);
+    } else if (first.digest[first.dlen] != '\0') {
+        out.push_back(first.digest[first.dlen]);
+    }
+    out.push_back(':');
+    if (bi < m_bhEnd - 1) {
+        const BlockHash& second = m_bh[bi + 1];
+        out.append(second.digest, std::min<size_t>(second.dlen, kSpamSumLength / 2 - 1));
+        if (h != 0) {
+            out.push_back(kBase64[second.halfh]);
+        } else if (second.halfdigest != '\0') {
+            out.push_back(second.halfdigest);
+        }
+    } else if (h != 0) {
+        out.push_back(kBase64[bi == 0 ? first.h : m_lastH]);
+    }
+    return out;
+}
+
+void SsdeepHasher::SaveState(HashStateWriter& out) const {
+    out.U32(m_bhStart);
+    out.U32(m_bhEnd);
+    for (uint32_t i = m_bhStart; i < m_bhEnd; ++i) {
+        const BlockHash& bh = m_bh[i];
+        out.U32(bh.h);
+        out.U32(bh.halfh);
+        out.U32(bh.dlen);
+        out.Bytes(bh.digest, sizeof(bh.digest));
+        out.U8(static_cast<uint8_t>(bh.halfdigest));
+    }
+    out.U64(m_totalSize);
+    out.U32(m_lastH);
+    out.U8(m_needLastH ? 1 : 0);
+    out.Bytes(m_window, sizeof(m_window));
+    out.U32(m_h1);
+    out.U32(m_h2);
+    out.U32(m_h3);
+    out.U32(m_n);
+}
+
+bool SsdeepHasher::LoadState(HashStateReader& in) {
+    Reset();
+    uint32_t start = in.U32();
+    uint32_t end = in.U32();
+    if (start >= end || end > kNumBlockHashes) {
+        in.Fail();
+        return false;
+    }
+    m_bhStart = start;
+    m_bhEnd = end;
+    for (uint32_t i = start; i < end; ++i) {
+        BlockHash& bh = m_bh[i];
+        bh.h = in.U32();
+        bh.halfh = in.U32();
+        bh.dlen = in.U32();
+        in.Bytes(bh.digest, sizeof(bh.digest));
+        bh.halfdigest = static_cast<char>(in.U8());
+        // Indexes into the base64 alphabet and the digest buffer.
+        if (bh.h >= 64 || bh.halfh >= 64 || bh.dlen >= kSpamSumLength) {
+            in.Fail();
+        }
+    }
+    m_totalSize = in.U64();
+    m_lastH = in.U32();
+    m_needLastH = in.U8() != 0;
+    in.Bytes(m_window, sizeof(m_window));
+    m_h1 = in.U32();
+    m_h2 = in.U32();
+    m_h3 = in.U32();
+    m_n = in.U32();
+    if (!in.Ok() || m_lastH >= 64 || m_n >= kRollingWindow) {
+        Reset();
+        return false;
+    }
+    return true;
+}
+
+TlshHasher::TlshHasher() {
+    Reset();
+}
+
+void TlshHasher::Reset() {
+    std::memset(m_buckets, 0, sizeof(m_buckets));
+    std::memset(m_window, 0, sizeof(m_window));
+    m_checksum = 0;
+    m_length = 0;
+}
+
+void TlshHasher::Update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t j = static_cast<size_t>(m_length % 5);
+    for (size_t i = 0; i < size; ++i, ++m_length, j = (j + 1) % 5) {
+        m_window[j] = p[i];
+        if (m_length < 4) {
+            continue;
+        }
+        // w0 is the newest byte of the 5-byte window, w4 the oldest.
+        const uint8_t w0 = m_window[j];
+        const uint8_t w1 = m_window[(j + 4) % 5];
+        const uint8_t w2 = m_window[(j + 3) % 5];
+        const uint8_t w3 = m_window[(j + 2) % 5];
+        const uint8_t w4 = m_window[(j + 1) % 5];
+        m_checksum = PearsonMap(0, w0, w1, m_checksum);
+        ++m_buckets[PearsonMap(2, w0, w1, w2)];
+        ++m_buckets[PearsonMap(3, w0, w1, w3)];
+        ++m_buckets[PearsonMap(5, w0, w2, w3)];
+        ++m_buckets[PearsonMap(7, w0, w2, w4)];
+        ++m_buckets[PearsonMap(11, w0, w1, w4)];
+        ++m_buckets[PearsonMap(13, w0, w3, w4)];
+    }
+}
+
+std::string TlshHasher::Final() const {
+    const std::string kNull = "TNULL";
+    if (m_length < kTlshMinLength || m_length > 0xFFFFFFFFull) {
+        return kNull;
+    }
+    uint32_t sorted[kTlshBuckets];
+    std::memcpy(sorted, m_buckets, sizeof(sorted));
+    std::sort(sorted, sorted + kTlshBuckets);
+    const uint32_t q1 = sorted[kTlshBuckets / 4 - 1];
+    const uint32_t q2 = sorted[kTlshBuckets / 2 - 1];
+    const uint32_t q3 = sorted[kTlshBuckets - kTlshBuckets / 4 - 1];
+    if (q3 == 0) {
+        return kNull;
+    }
+    size_t nonZero = 0;
+    for (size_t i = 0; i < kTlshBuckets; ++i) {
+        if (m_buckets[i] != 0) {
+            ++nonZero;
+        }
+    }
+    if (nonZero <= kTlshBuckets / 2) {
+        return kNull;
+    }
+
+    uint8_t bytes[3 + kTlshCodeSize];
+    const uint32_t q1ratio = static_cast<uint32_t>(static_cast<float>(q1 * 100) / static_cast<float>(q3)) % 16;
+    const uint32_t q2ratio = static_cast<uint32_t>(static_cast<float>(q2 * 100) / static_cast<float>(q3)) % 16;
+    bytes[0] = SwapNibbles(m_checksum);
+    bytes[1] = SwapNibbles(TlshLengthCode(static_cast<uint32_t>(m_length)));
+    bytes[2] = static_cast<uint8_t>((q1ratio << 4) | q2ratio);
+    // Bucket codes, highest buckets first.
+    for (size_t i = 0; i < kTlshCodeSize; ++i) {
+        uint8_t code = 0;
+        for (size_t k = 0; k < 4; ++k) {
+            uint32_t count = m_buckets[4 * i + k];
+            uint8_t level = count > q3 ? 3 : (count > q2 ? 2 : (count > q1 ? 1 : 0));
+            code |= static_cast<uint8_t>(level << (2 * k));
+        }
+        bytes[3 + kTlshCodeSize - 1 - i] = code;
+    }
+
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string out = "T1";
+    for (uint8_t b : bytes) {
+        out.push_back(kHex[b >> 4]);
+        out.push_back(kHex[b & 0x0F]);
+    }
+    return out;
+}
+
+void TlshHasher::SaveState(HashStateWriter& out) const {
+    for (uint32_t count : m_buckets) {
+        out.U32(count);
+    }
+    out.Bytes(m_window, sizeof(m_window));
+    out.U8(m_checksum);
+    out.U64(m_length);
+}
+
+bool TlshHasher::LoadState(HashStateReader& in) {
+    for (uint32_t& count : m_buckets) {
+        count = in.U32();
+    }
+    in.Bytes(m_window, sizeof(m_window));
+    m_checksum = in.U8();
+    m_length = in.U64();
+    if (!in.Ok()) {
+        Reset();
+        return false;
+    }
+    return true;
+}
+
+int CompareSsdeep(const std::string& a, const std::string& b) {
+    SsdeepDigest da;
+    SsdeepDigest db;
+    if (!ParseSsdeep(a, da) || !ParseSsdeep(b, db)) {
+        return -1;
+    }
+    std::vector<uint32_t> gramsA;
+    std::vector<uint32_t> gramsB;
+    PartView va[2];
+    PartView vb[2];
+    ViewDigest(da, gramsA, va);
+    ViewDigest(db, gramsB, vb);
+    return ScoreDigests(da.blockSize, va, db.blockSize, vb, GramMatchPortable);
+}
+
+int CompareTlsh(const std::string& a, const std::string& b) {
+    TlshDigest da;
+    TlshDigest db;
+    if (!ParseTlsh(a, da) || !ParseTlsh(b, db)) {
+        return -1;
+    }
+    return TlshHeaderDistance(da.checksum, da.lvalue, da.q1ratio, da.q2ratio, db.checksum, db.lvalue, db.q1ratio, db.q2ratio) +
+           TlshCodeDistance(da.code, db.code);
+}
+
+bool SsdeepSet::Add(const std::string& digest) {
+    SsdeepDigest d;
+    if (!ParseSsdeep(digest, d)) {
+        return false;
+    }
+    Entry e;
+    e.blockSize = d.blockSize;
+    for (int p = 0; p < 2; ++p) {
+        e.text[p] = m_text.size();
+        e.textLen[p] = d.part[p].size();
+        e.grams[p] = m_grams.size();
+        m_text += d.part[p];
+        AppendGrams(d.part[p], m_grams);
+    }
+    m_entries.push_back(e);
+    return true;
+}
+
+bool SsdeepSet::Compare(const std::string& query, std::vector<int>& scores) const {
+    SsdeepDigest q;
+    if (!ParseSsdeep(query, q)) {
+        return false;
+    }
+    std::vector<uint32_t> queryGrams;
+    PartView qv[2];
+    ViewDigest(q, queryGrams, qv);
+    const GramMatchFn match = GetFuzzyKernels().gramMatch;
+    scores.assign(m_entries.size(), 0);
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        const Entry& e = m_entries[i];
+        // Most of a large set fails the block size test; skip those before
+        // building views.
+        if (e.blockSize != q.blockSize && e.blockSize != q.blockSize * 2 && e.blockSize * 2 != q.blockSize) {
+            continue;
+        }
+        PartView ev[2];
+        for (int p = 0; p < 2; ++p) {
+            ev[p] = {m_text.data() + e.text[p], e.textLen[p], m_grams.data() + e.grams[p]};
+        }
+        scores[i] = ScoreDigests(q.blockSize, qv, e.blockSize, ev, match);
+    }
+    return true;
+}
+
+bool TlshSet::Add(const std::string& digest) {
+    TlshDigest d;
+    if (!ParseTlsh(digest, d)) {
+        return false;
+    }
+    m_headers.push_back({d.checksum, d.lvalue, d.q1ratio, d.q2ratio});
+    m_codes.insert(m_codes.end(), d.code, d.code + kTlshCodeSize);
+    return true;
+}
+
+bool TlshSet::Compare(const std::string& query, std::vector<int>& distances) const {
+    TlshDigest q;
+    if (!ParseTlsh(query, q)) {
+        return false;
+    }
+    distances.assign(m_headers.size(), 0);
+    if (m_headers.empty()) {
+        return true;
+    }
+    GetFuzzyKernels().tlshCodes(q.code, m_codes.data(), m_headers.size(), distances.data());
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+        const Header& h = m_headers[i];
+        distances[i] += TlshHeaderDistance(q.checksum, q.lvalue, q.q1ratio, q.q2ratio, h.checksum, h.lvalue, h.q1ratio, h.q2ratio);
+    }
+    return true;
+}
+
+const char* GetFuzzyCompareImplName() {
+    return GetFuzzyKernels().name;
+}
+
+bool RunFuzzyHashSelfTest(std::wstring& error) {
+    SsdeepHasher empty;
+    if (empty.Final() != "3::") {
+        error = L"ssdeep of empty input is not 3::";
+        return false;
+    }
+
+    // A base buffer and variants with a few bytes changed, hashed whole and
+    // in odd-sized pieces.
+    std::vector<uint8_t> data(200000);
+    uint32_t x = 0x2545F491;
+    for (auto& b : data) {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    std::vector<std::string> ssdeeps;
+    std::vector<std::string> tlshes;
+    for (size_t variant = 0; variant < 24; ++variant) {
+        std::vector<uint8_t> v(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(data.size() - variant * 997));
+        for (size_t k = 0; k < variant * 3; ++k) {
+            v[(k * 7919 + variant * 104729) % v.size()] ^= 0x5A;
+        }
+        SsdeepHasher ssdeep;
+        TlshHasher tlsh;
+        ssdeep.Update(v.data(), v.size());
+        tlsh.Update(v.data(), v.size());
+        SsdeepHasher ssdeepSplit;
+        TlshHasher tlshSplit;
+        for (size_t pos = 0; pos < v.size();) {
+            size_t n = std::min<size_t>(v.size() - pos, 1 + (pos * 31) % 4099);
+            ssdeepSplit.Update(v.data() + pos, n);
+            tlshSplit.Update(v.data() + pos, n);
+            pos += n;
+        }
+        if (ssdeep.Final() != ssdeepSplit.Final() || tlsh.Final() != tlshSplit.Final()) {
+            error = L"Fuzzy hash changes with the update split";
+            return false;
+        }
+        ssdeeps.push_back(ssdeep.Final());
+        tlshes.push_back(tlsh.Final());
+    }
+    if (CompareSsdeep(ssdeeps[0], ssdeeps[0]) != 100 || CompareTlsh(tlshes[0], tlshes[0]) != 0) {
+        error = L"Fuzzy hash does not match itself";
+        return false;
+    }
+    if (CompareSsdeep(ssdeeps[0], ssdeeps[1]) <= 0 || CompareTlsh(tlshes[0], tlshes[1]) <= 0) {
+        error = L"Fuzzy hash does not rate a small change as similar but different";
+        return false;
+    }
+
+    SsdeepSet ssdeepSet;
+    TlshSet tlshSet;
+    for (size_t i = 0; i < ssdeeps.size(); ++i) {
+        if (!ssdeepSet.Add(ssdeeps[i]) || !tlshSet.Add(tlshes[i])) {
+            error = L"Fuzzy hash set rejects a digest";
+            return false;
+        }
+    }
+    std::vector<int> scores;
+    std::vector<int> distances;
+    for (size_t q = 0; q < ssdeeps.size(); q += 5) {
+        ssdeepSet.Compare(ssdeeps[q], scores);
+        tlshSet.Compare(tlshes[q], distances);
+        for (size_t i = 0; i < ssdeeps.size(); ++i) {
+            if (scores[i] != CompareSsdeep(ssdeeps[q], ssdeeps[i]) || distances[i] != CompareTlsh(tlshes[q], tlshes[i])) {
+                error = L"Fuzzy hash set compare differs from the single compare";
+                return false;
+            }
+        }
+    }
+    return true;
+}
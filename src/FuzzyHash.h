@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class HashStateReader;
+class HashStateWriter;
+
+// Similarity digests for clustering near-identical files. Both stream, so
+// Digest (and through it HashEngine) runs them next to the other algorithms.
+// Builds without Windows headers.
+
+// ssdeep context-triggered piecewise hash, "blocksize:hash:hash" as
+// fuzzy_hash_buf prints it.
+class SsdeepHasher {
+public:
+    SsdeepHasher();
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    // Empty for inputs beyond ssdeep's limit (about 192 GiB).
+    std::string Final() const;
+
+    // Checkpoint state.
+    void SaveState(HashStateWriter& out) const;
+    bool LoadState(HashStateReader& in);
+
+private:
+    static const size_t kSpamSumLength = 64;
+    static const size_t kNumBlockHashes = 31;
+
+    struct BlockHash {
+        uint32_t h;
+        uint32_t halfh;
+        char digest[kSpamSumLength];
+        char halfdigest;
+        uint32_t dlen;
+    };
+
+    // h is a trigger point of the smallest block size in use.
+    void AddTriggerPoint(uint32_t h);
+    void TryForkBlockHash();
+    void TryReduceBlockHash();
+
+    BlockHash m_bh[kNumBlockHashes];
+    uint32_t m_bhStart;
+    uint32_t m_bhEnd;
+    uint64_t m_totalSize;
+    uint32_t m_lastH;
+    bool m_needLastH;
+    uint8_t m_window[7];
+    uint32_t m_h1;
+    uint32_t m_h2;
+    uint32_t m_h3;
+    uint32_t m_n;
+};
+
+// TLSH with 128 buckets and a 1-byte checksum, "T1" and 70 hex digits as the
+// tlsh tool prints it; "TNULL" when the input is shorter than 50 bytes or has
+// too little variety.
+class TlshHasher {
+public:
+    TlshHasher();
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    std::string Final() const;
+
+    void SaveState(HashStateWriter& out) const;
+    bool LoadState(HashStateReader& in);
+
+private:
+    uint32_t m_buckets[256];
+    uint8_t m_window[5];
+    uint8_t m_checksum;
+    uint64_t m_length;
+};
+
+// Similarity score 0..100 (100 = identical); -1 when either digest is
+// malformed.
+int CompareSsdeep(const std::string& a, const std::string& b);
+// Distance 0 (identical) and up, length difference included; -1 when either
+// digest is malformed or TNULL.
+int CompareTlsh(const std::string& a, const std::string& b);
+
+// Many digests kept in the layout the compare kernels (SSE2, AVX2 or NEON,
+// picked at runtime) stream through, for matching one digest against a large
+// set. Results are the same as CompareSsdeep / CompareTlsh.
+class SsdeepSet {
+public:
+    // False, and nothing is added, for a malformed digest.
+    bool Add(const std::string& digest);
+    size_t Size() const { return m_entries.size(); }
+    // scores[i] is the score against the i-th digest added; false when the
+    // query is malformed.
+    bool Compare(const std::string& query, std::vector<int>& scores) const;
+
+private:
+    struct Entry {
+        uint64_t blockSize;
+        // Into m_text and m_grams, for the two parts.
+        size_t text[2];
+        size_t textLen[2];
+        size_t grams[2];
+    };
+
+    std::vector<Entry> m_entries;
+    std::string m_text;
+    std::vector<uint32_t> m_grams;
+};
+
+class TlshSet {
+public:
+    bool Add(const std::string& digest);
+    size_t Size() const { return m_headers.size(); }
+    // distances[i] is the distance to the i-th digest added; false when the
+    // query is malformed or TNULL.
+    bool Compare(const std::string& query, std::vector<int>& distances) const;
+
+private:
+    struct Header {
+        uint8_t checksum;
+        uint8_t lvalue;
+        uint8_t q1ratio;
+        uint8_t q2ratio;
+    };
+
+    std::vector<Header> m_headers;
+    // 32 code bytes per digest.
+    std::vector<uint8_t> m_codes;
+};
+
+// "portable", "sse2", "avx2" or "neon".
+const char* GetFuzzyCompareImplName();
+// Known answers, split updates, and the set kernels against the single
+// compares; error describes the first failure.
+bool RunFuzzyHashSelfTest(std::wstring& error);
@@ -1,5 +1,12 @@
 #include "stdafx.h"
 
+#include "ApiHashDb.h"
+#include "AsyncHashCalculator.h"
+#include "HashBenchmark.h"
+#include "HashCalculator.h"
+#include "HashCheckpoint.h"
+#include "HashManifest.h"
+#include "OrdinalNames.h"
 #include "PECore.h"
 #include "PEResource.h"
 #include "ReportJsonWriter.h"
@@ -386,6 +393,66 @@ static bool TryReadIniInt(const std::wstring& ini, const wchar_t* section, const
     return true;
 }
 
+// Opens each set of a ';'-separated list; sets that fail to open are skipped.
+static void OpenKnownHashSets(const std::wstring& paths, std::vector<std::unique_ptr<KnownHashSet>>& out) {
+    size_t start = 0;
+    while (start <= paths.size()) {
+        size_t end = paths.find(L';', start);
+        if (end == std::wstring::npos) {
+            end = paths.size();
+        }
+        std::wstring path = paths.substr(start, end - start);
+        start = end + 1;
+        if (path.empty()) {
+            continue;
+        }
+        std::unique_ptr<KnownHashSet> set(new KnownHashSet());
+        std::wstring err;
+        if (set->Open(path, err)) {
+            out.push_back(std::move(set));
+        }
+    }
+}
+
+// The sets listed under [KnownHashes] Sets= in settings.ini, opened on first
+// use and kept for the life of the process.
+static const std::vector<const KnownHashSet*>& GetSettingsKnownHashSets() {
+    struct Loaded {
+        std::vector<std::unique_ptr<KnownHashSet>> owned;
+        std::vector<const KnownHashSet*> sets;
+    };
+    static const Loaded loaded = [] {
+        Loaded l;
+        std::wstring ini = GetPeInfoSettingsIniPath();
+        if (!ini.empty()) {
+            std::vector<wchar_t> buf(32768);
+            DWORD n = GetPrivateProfileStringW(L"KnownHashes", L"Sets", L"", buf.data(), static_cast<DWORD>(buf.size()), ini.c_str());
+            OpenKnownHashSets(std::wstring(buf.data(), n), l.owned);
+        }
+        for (const auto& set : l.owned) {
+            l.sets.push_back(set.get());
+        }
+        return l;
+    }();
+    return loaded.sets;
+}
+
+// [Io] CachePolicy= in settings.ini ("cached", "dropbehind" or "direct"):
+// what analysing, hashing and scanning files leaves in the page cache.
+static PageCachePolicy GetSettingsPageCachePolicy() {
+    static const PageCachePolicy policy = [] {
+        PageCachePolicy p = PageCachePolicy::Cached;
+        std::wstring ini = GetPeInfoSettingsIniPath();
+        if (!ini.empty()) {
+            wchar_t buf[64] = {};
+            DWORD n = GetPrivateProfileStringW(L"Io", L"CachePolicy", L"", buf, static_cast<DWORD>(sizeof(buf) / sizeof(buf[0])), ini.c_str());
+            ParsePageCachePolicyName(WStringToUtf8(std::wstring(buf, n)), p);
+        }
+        return p;
+    }();
+    return policy;
+}
+
 static bool LoadWindowPlacementFromIni(int& x, int& y, int& w, int& h, bool& maximized) {
     std::wstring ini = GetPeInfoSettingsIniPath();
     if (ini.empty()) {
@@ -807,7 +874,7 @@ static void BuildImportRowsFromParser(std::vector<GuiState::ImportRow>& out, con
                 GuiState::ImportRow r;
                 r.type = type;
                 r.dll = dllName;
-                r.function = ToWStringUtf8BestEffort(fn.name);
+                r.function = ToWStringUtf8BestEffort(ImportFunctionDisplayName(d.dllName, fn));
                 r.haystackLower = ToLowerString(r.type + L" " + r.dll + L" " + r.function);
                 out.push_back(std::move(r));
             }
@@ -1686,7 +1753,8 @@ static bool IsVerifyInFlightForCurrent(const GuiState* s) {
     return s->verifyInFlight && !s->verifyInFlightFile.empty() && s->verifyInFlightFile == s->currentFile;
 }
 
-static void PopulateHash(HWND edit, const std::vector<HashResult>& hashes) {
+static void PopulateHash(HWND edit, const std::vector<HashResult>& hashes, const std::vector<HashResult>& authentihashes,
+                         const std::vector<HashResult>& fuzzyHashes) {
     std::wostringstream out;
     if (hashes.empty()) {
         out << L"(none)\r\n";
@@ -1698,7 +1766,24 @@ static void PopulateHash(HWND edit, const std::vector<HashResult>& hashes) {
             out << h.algorithm << L": (error) " << h.errorMessage << L"\r\n";
             continue;
         }
-        out << h.algorithm << L": " << h.result << L"\r\n";
+        out << h.algorithm << L": " << h.result;
+        if (!h.standard) {
+            out << L" (non-standard)";
+        }
+        if (h.known != HashKnownState::Unchecked) {
+            out << (h.known == HashKnownState::Known ? L" (known)" : L" (unknown)");
+        }
+        out << L"\r\n";
+    }
+    for (const auto& h : authentihashes) {
+        if (h.success) {
+            out << L"Authentihash " << h.algorithm << L": " << h.result << L"\r\n";
+        }
+    }
+    for (const auto& h : fuzzyHashes) {
+        if (h.success) {
+            out << h.algorithm << L": " << h.result << L"\r\n";
+        }
     }
     SetWindowTextWString(edit, out.str());
 }
@@ -2114,7 +2199,7 @@ static void RefreshAllViews(GuiState* s) {
     PopulateResources(s->pageResources, s->analysis->parser);
     PopulatePdb(s->pagePdb, s);
     PopulateSignature(s->pageSignature, *s->analysis, IsVerifyInFlightForCurrent(s));
-    PopulateHash(s->pageHash, s->analysis->hashes);
+    PopulateHash(s->pageHash, s->analysis->hashes, s->analysis->authentihashes, s->analysis->fuzzyHashes);
     UpdateFileInfo(s);
 }
 
@@ -2132,10 +2217,13 @@ static unsigned __stdcall AnalysisThreadProc(void* param) {
     opt.computeSignaturePresence = true;
     opt.verifySignature = false;
     opt.computeHashes = true;
-    opt.hashAlgorithms = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256};
+    opt.hashAlgorithms = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256, HashAlgorithm::BLAKE3, HashAlgorithm::XXH3_128};
+    opt.computeFuzzyHashes = true;
     opt.timeFormat = ReportTimeFormat::Local;
+    opt.knownHashSets = GetSettingsKnownHashSets();
+    opt.cachePolicy = GetSettingsPageCachePolicy();
     opt.hashCancel = pl->cancel;
-    opt.hashProgress = [hwnd](uint64_t total, uint64_t processed) {
+    opt.hashProgress = [hwnd](uint64_t processed, uint64_t total) {
         int pct = 0;
         if (total > 0) {
             pct = static_cast<int>((processed * 100) / total);
@@ -2374,6 +2462,7 @@ static void StartStringsScan(GuiState* s) {
     opt.scanAscii = (typeIdx != 2);
     opt.scanUtf16Le = (typeIdx != 1);
     opt.maxHits = 3000000;
+    opt.cachePolicy = GetSettingsPageCachePolicy();
 
     auto* cancel = new std::atomic<bool>(false);
     s->stringsCancel = cancel;
@@ -4172,16 +4261,352 @@ static void EnableBestDpiAwareness() {
     SetProcessDPIAware();
 }
 
+// Directories expand to the regular files directly inside them.
+static void AppendInputFiles(const std::wstring& arg, std::vector<std::wstring>& out) {
+    DWORD attr = GetFileAttributesW(arg.c_str());
+    if (attr == INVALID_FILE_ATTRIBUTES || (attr & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        out.push_back(arg);
+        return;
+    }
+    std::wstring dir = arg;
+    if (!dir.empty() && dir.back() != L'\\' && dir.back() != L'/') {
+        dir.push_back(L'\\');
+    }
+    WIN32_FIND_DATAW fd = {};
+    HANDLE h = FindFirstFileW((dir + L"*").c_str(), &fd);
+    if (h == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            out.push_back(dir + fd.cFileName);
+        }
+    } while (FindNextFileW(h, &fd));
+    FindClose(h);
+}
+
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
     EnableBestDpiAwareness();
     {
         int argc = 0;
         LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        if (argv != nullptr && argc >= 5) {
+            std::wstring mode = argv[1];
+            if (mode == L"--diff-json" || mode == L"--diff-text") {
+                std::wstring oldPath = argv[2];
+                std::wstring newPath = argv[3];
+                std::wstring outPath = argv[4];
+
+                PEParser oldImage;
+                PEParser newImage;
+                PEDiffResult diff;
+                std::wstring err;
+                if (!oldImage.LoadFile(oldPath) || !newImage.LoadFile(newPath) || !DiffPeImages(oldImage, newImage, diff, err)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+
+                bool ok = false;
+                if (mode == L"--diff-json") {
+                    std::string json = BuildJsonDiffReport(oldPath, newPath, diff);
+                    json.push_back('\n');
+                    ok = WriteAllBytes(outPath, json);
+                } else {
+                    ok = WriteAllBytes(outPath, WStringToUtf8(BuildTextDiffReport(oldPath, newPath, diff)));
+                }
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return diff.IsIdentical() ? 0 : 1;
+            }
+            if (mode == L"--resolve-forwarders") {
+                PEExportCache cache(argv[2]);
+                std::wstring outPath = argv[3];
+                std::vector<std::wstring> files;
+                for (int i = 4; i < argc; ++i) {
+                    files.push_back(argv[i]);
+                }
+
+                std::vector<PEForwarderImageResult> images;
+                ResolveForwardersForFiles(cache, files, images);
+                std::string json = BuildJsonForwarderReport(cache, images);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                return ok ? 0 : 3;
+            }
+            if (mode == L"--apihash-build") {
+                std::wstring outPath = argv[2];
+                ApiHashBuildOptions opt;
+                for (int i = 4; i < argc; ++i) {
+                    if (std::wstring(argv[i]) == L"--with-module") {
+                        opt.withModule = true;
+                    }
+                }
+                size_t records = 0;
+                std::wstring err;
+                bool ok = BuildApiHashDb(ListDllFiles(argv[3]), opt, outPath, records, err);
+                LocalFree(argv);
+                return ok ? 0 : 2;
+            }
+            if (mode == L"--knownhash-build") {
+                // --knownhash-build <out> <algorithm> <list>...
+                std::wstring outPath = argv[2];
+                KnownHashBuildOptions opt;
+                if (!ParseHashAlgorithmName(argv[3], opt.algorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::vector<std::wstring> lists;
+                for (int i = 4; i < argc; ++i) {
+                    AppendInputFiles(argv[i], lists);
+                }
+                uint64_t count = 0;
+                std::wstring err;
+                bool ok = BuildKnownHashSet(lists, opt, outPath, count, err);
+                LocalFree(argv);
+                return ok ? 0 : 2;
+            }
+            if (mode == L"--apihash-lookup") {
+                ApiHashDb db;
+                std::wstring err;
+                if (!db.Open(argv[2], err)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::wstring outPath = argv[3];
+                std::string text;
+                size_t matches = 0;
+                for (int i = 4; i < argc; ++i) {
+                    std::wstring arg = argv[i];
+                    uint32_t value = 0;
+                    if (ParseApiHashConstant(arg, value)) {
+                        matches += AppendApiHashMatches(db, WStringToUtf8(arg), value, text);
+                        continue;
+                    }
+                    // Anything else is treated as a file: every byte offset is
+                    // tried as a little-endian 32-bit constant.
+                    PEParser raw;
+                    raw.LoadFile(arg);
+                    const BYTE* data = raw.GetFileData();
+                    size_t size = raw.GetFileSize();
+                    std::string label = WStringToUtf8(arg);
+                    for (size_t off = 0; off + 4 <= size; ++off) {
+                        uint32_t v = static_cast<uint32_t>(data[off]) | (static_cast<uint32_t>(data[off + 1]) << 8) |
+                                     (static_cast<uint32_t>(data[off + 2]) << 16) | (static_cast<uint32_t>(data[off + 3]) << 24);
+                        if (db.Lookup(v, nullptr) != 0) {
+                            matches += AppendApiHashMatches(db, label + "+" + WStringToUtf8(HexU64(off, 8)), v, text);
+                        }
+                    }
+                }
+                bool ok = WriteAllBytes(outPath, text);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return matches != 0 ? 0 : 1;
+            }
+            if (mode == L"--hash-batch") {
+                HashAlgorithm algorithm = HashAlgorithm::SHA256;
+                if (!ParseHashAlgorithmName(argv[2], algorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::wstring outPath = argv[3];
+                std::vector<std::wstring> files;
+                for (int i = 4; i < argc; ++i) {
+                    AppendInputFiles(argv[i], files);
+                }
+
+                HashCalculator calc;
+                // A cancelled or killed run over large images picks up where
+                // it stopped.
+                calc.SetResumable(true);
+                calc.SetCachePolicy(GetSettingsPageCachePolicy());
+                // Unchanged files hashed by an earlier run are not read again.
+                HashCache cache;
+                std::wstring cacheError;
+                std::wstring cachePath = GetPeInfoHashCachePath();
+                if (!cachePath.empty() && cache.Open(cachePath, 0, cacheError)) {
+                    calc.SetCache(&cache);
+                }
+                std::vector<HashResult> results = calc.CalculateFileHashBatch(files, algorithm);
+                std::string text;
+                size_t failed = 0;
+                for (size_t i = 0; i < results.size(); ++i) {
+                    if (!results[i].success) {
+                        ++failed;
+                        continue;
+                    }
+                    text += WStringToUtf8(results[i].result) + "  " + WStringToUtf8(files[i]) + "\n";
+                }
+                bool ok = WriteAllBytes(outPath, text);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return failed == 0 ? 0 : 1;
+            }
+            if (mode == L"--verify-manifest") {
+                // --verify-manifest <algorithm|auto> <out> <manifest>
+                HashAlgorithm algorithm = HashAlgorithm::SHA256;
+                bool inferAlgorithm = _wcsicmp(argv[2], L"auto") == 0;
+                if (!inferAlgorithm && !ParseHashAlgorithmName(argv[2], algorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::wstring outPath = argv[3];
+                std::vector<ManifestEntry> entries;
+                std::wstring error;
+                if (!LoadHashManifest(argv[4], inferAlgorithm ? nullptr : &algorithm, entries, error)) {
+                    WriteAllBytes(outPath, WStringToUtf8(error) + "\n");
+                    LocalFree(argv);
+                    return 2;
+                }
+
+                // Lines in sha256sum -c style, written as soon as each entry
+                // and all before it are done.
+                std::ofstream out(outPath.c_str(), std::ios::binary);
+                size_t failed = 0;
+                ManifestVerifyOptions options;
+                options.engine.cachePolicy = GetSettingsPageCachePolicy();
+                options.onResult = [&](size_t index, const ManifestResult& result) {
+                    if (result.status != ManifestStatus::Ok) {
+                        ++failed;
+                    }
+                    out << WStringToUtf8(entries[index].path) << ": " << GetManifestStatusName(result.status) << "\n";
+                    out.flush();
+                };
+                VerifyHashManifest(entries, options);
+                bool ok = static_cast<bool>(out);
+                out.close();
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return failed == 0 ? 0 : 1;
+            }
+            if (mode == L"--deps-json") {
+                // --deps-json <out> <dir;dir...> [--previous <graph.json>] <root>...
+                std::wstring outPath = argv[2];
+                PEDependencyOptions opt;
+                std::wstring dirs = argv[3];
+                size_t start = 0;
+                while (start <= dirs.size()) {
+                    size_t end = dirs.find(L';', start);
+                    if (end == std::wstring::npos) {
+                        end = dirs.size();
+                    }
+                    if (end > start) {
+                        opt.searchDirectories.push_back(dirs.substr(start, end - start));
+                    }
+                    start = end + 1;
+                }
+                int firstRoot = 4;
+                PEDependencyGraph previous;
+                if (argc >= 7 && _wcsicmp(argv[4], L"--previous") == 0) {
+                    // A missing or unreadable graph just means a full run.
+                    std::wstring loadError;
+                    if (LoadDependencyGraph(argv[5], previous, loadError)) {
+                        opt.previous = &previous;
+                    }
+                    firstRoot = 6;
+                }
+                std::vector<std::wstring> roots;
+                for (int i = firstRoot; i < argc; ++i) {
+                    roots.push_back(argv[i]);
+                }
+
+                PEDependencyGraph graph;
+                std::wstring err;
+                if (!BuildDependencyGraph(roots, opt, graph, err)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::string json = BuildJsonDependencyReport(graph);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return (graph.missingDlls.empty() && graph.unresolvedImportCount == 0) ? 0 : 1;
+            }
+        }
         if (argv != nullptr && argc >= 4) {
             std::wstring mode = argv[1];
+            if (mode == L"--bench-async") {
+                // --bench-async <file> <out.json> [algorithm]: every I/O backend,
+                // tuned and at fixed (chunk size, queue depth) settings.
+                std::wstring inPath = argv[2];
+                std::wstring outPath = argv[3];
+                HashAlgorithm algorithm = HashAlgorithm::SHA256;
+                if (argc >= 5 && !ParseHashAlgorithmName(argv[4], algorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                const std::vector<std::pair<size_t, size_t>> fixed = {
+                    {64u << 10, 1}, {256u << 10, 4}, {1u << 20, 4}, {1u << 20, 16}, {2u << 20, 8},
+                };
+                std::vector<AsyncReadBenchmarkResult> results = RunAsyncReadBenchmark(inPath, algorithm, fixed);
+                bool allOk = !results.empty();
+                for (const auto& r : results) {
+                    if (!r.error.empty() || r.digest != results.front().digest) {
+                        allOk = false;
+                    }
+                }
+                std::string json = BuildJsonAsyncReadBenchmark(inPath, results);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return allOk ? 0 : 2;
+            }
+            if (mode == L"--bench-pagecache") {
+                // --bench-pagecache <file> <out.json> [algorithm]: throughput
+                // and page-cache footprint of every cache and I/O policy,
+                // each from an evicted file.
+                std::wstring inPath = argv[2];
+                std::wstring outPath = argv[3];
+                HashAlgorithm algorithm = HashAlgorithm::SHA256;
+                if (argc >= 5 && !ParseHashAlgorithmName(argv[4], algorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                std::vector<PageCacheBenchmarkResult> results = RunPageCacheBenchmark(inPath, algorithm);
+                bool allOk = !results.empty();
+                for (const auto& r : results) {
+                    if (!r.error.empty() || r.digest != results.front().digest) {
+                        allOk = false;
+                    }
+                }
+                std::string json = BuildJsonPageCacheBenchmark(inPath, results);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return allOk ? 0 : 2;
+            }
             if (mode == L"--export-json" || mode == L"--export-text") {
                 std::wstring inPath = argv[2];
                 std::wstring outPath = argv[3];
+                // Optional report digest, e.g. BLAKE3 for very large images.
+                HashAlgorithm reportAlgorithm = HashAlgorithm::SHA256;
+                if (argc >= 5 && !ParseHashAlgorithmName(argv[4], reportAlgorithm)) {
+                    LocalFree(argv);
+                    return 2;
+                }
+                // Known-file sets to mark the report digest with, besides
+                // those in settings.ini.
+                std::vector<std::unique_ptr<KnownHashSet>> knownSets;
+                for (int i = 5; i < argc; ++i) {
+                    OpenKnownHashSets(argv[i], knownSets);
+                }
 
                 PEAnalysisResult ar;
                 PEAnalysisOptions opt;
@@ -4189,8 +4614,16 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
                 opt.computeSignaturePresence = true;
                 opt.verifySignature = false;
                 opt.computeHashes = true;
-                opt.hashAlgorithms = {HashAlgorithm::SHA256};
+                opt.hashAlgorithms = {reportAlgorithm};
+                opt.computeFuzzyHashes = true;
+                // Chunk lists only go to the JSON export.
+                opt.computeSectionChunks = (mode == L"--export-json");
                 opt.timeFormat = ReportTimeFormat::Local;
+                opt.knownHashSets = GetSettingsKnownHashSets();
+                opt.cachePolicy = GetSettingsPageCachePolicy();
+                for (const auto& set : knownSets) {
+                    opt.knownHashSets.push_back(set.get());
+                }
 
                 std::wstring err;
                 if (!AnalyzePeFile(inPath, opt, ar, err)) {
@@ -4219,7 +4652,12 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
                                                        ar.signaturePresenceReady ? &ar.signaturePresence : nullptr,
                                                        &ar.embeddedVerify,
                                                        &ar.catalogVerify,
-                                                       ar.reportHash.has_value() ? &ar.reportHash : nullptr);
+                                                       ar.reportHash.has_value() ? &ar.reportHash : nullptr,
+                                                       &ar.authentihashes,
+                                                       &ar.checksum,
+                                                       &ar.regionHashes,
+                                                       &ar.fuzzyHashes,
+                                                       &ar.sectionChunks);
                     json.push_back('\n');
                     bool ok = WriteAllBytes(outPath, json);
                     LocalFree(argv);
@@ -4234,6 +4672,10 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
                                                     ar.embeddedVerify,
                                                     ar.catalogVerify,
                                                     ar.reportHash,
+                                                    ar.authentihashes,
+                                                    ar.checksum,
+                                                    ar.regionHashes,
+                                                    ar.fuzzyHashes,
                                                     0,
                                                     500);
                 std::string utf8 = WStringToUtf8(text);
@@ -4242,6 +4684,72 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow) {
                 return ok ? 0 : 3;
             }
         }
+        if (argv != nullptr && argc >= 3) {
+            std::wstring mode = argv[1];
+            if (mode == L"--bench-digest") {
+                std::wstring outPath = argv[2];
+                std::wstring selfTestError;
+                bool passed = RunDigestSelfTest(selfTestError) && RunSha256MultiBufferSelfTest(selfTestError) &&
+                              RunPEChecksumSelfTest(selfTestError) && RunFuzzyHashSelfTest(selfTestError) &&
+                              RunChunkHashSelfTest(selfTestError) && RunHashCheckpointSelfTest(selfTestError) &&
+                              RunHashCacheSelfTest(selfTestError) && RunHashManifestSelfTest(selfTestError) &&
+                              RunKnownHashSetSelfTest(selfTestError);
+                std::vector<DigestBenchmarkResult> results;
+                std::vector<Sha256MultiBufferBenchmark> multiBuffer;
+                const size_t kMessageSize = 16u << 10;
+                if (passed) {
+                    results = RunDigestBenchmark(256u << 20, 5);
+                    multiBuffer = RunSha256MultiBufferBenchmark(kMessageSize, (256u << 20) / kMessageSize);
+                }
+                std::string json = BuildJsonDigestBenchmark(selfTestError, results, kMessageSize, multiBuffer);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return passed ? 0 : 2;
+            }
+            if (mode == L"--bench-hash") {
+                // --bench-hash <out.json> [directory...]: HashCalculator and
+                // AsyncHashCalculator over generated inputs, swept across
+                // algorithms, chunk sizes, I/O policies and backends, and file
+                // sizes.
+                std::wstring outPath = argv[2];
+                HashSweepOptions options;
+                for (int i = 3; i < argc; ++i) {
+                    options.directories.push_back(argv[i]);
+                }
+                options.hash = [](const HashSweepCase& c, const std::wstring& path) {
+                    if (c.policy == HashIoPolicy::Async) {
+                        AsyncHashCalculator calculator;
+                        calculator.SetChunkSize(c.chunkSize);
+                        calculator.SetBackend(c.backend);
+                        return calculator.CalculateFileHash(path, c.algorithm);
+                    }
+                    HashCalculator calculator;
+                    calculator.SetIoPolicy(c.policy);
+                    calculator.SetChunkSize(c.chunkSize);
+                    return calculator.CalculateFileHash(path, c.algorithm);
+                };
+                std::vector<HashSweepResult> results;
+                std::wstring err;
+                bool passed = RunHashSweep(options, nullptr, results, err);
+                for (const auto& r : results) {
+                    if (!r.error.empty()) {
+                        passed = false;
+                    }
+                }
+                std::string json = BuildJsonHashSweep(options, results);
+                json.push_back('\n');
+                bool ok = WriteAllBytes(outPath, json);
+                LocalFree(argv);
+                if (!ok) {
+                    return 3;
+                }
+                return passed ? 0 : 2;
+            }
+        }
         if (argv != nullptr) {
             LocalFree(argv);
         }
@@ -0,0 +1,26 @@
+#pragma once
+
+enum class HashAlgorithm {
+    MD5,
+    SHA1,
+    SHA256,
+    // Tree hashes for very large files; both use several threads per file.
+    BLAKE3,
+    // PEInfo-specific, not interchangeable with SHA256 (see Sha256Tree.h).
+    SHA256Tree,
+    // Similarity digests; text rather than hex, compared by score or
+    // distance (see FuzzyHash.h).
+    SSDEEP,
+    TLSH,
+    // Non-cryptographic, for dedup and change detection: several times the
+    // speed of SHA256, but trivial to collide on purpose (see Xxh3.h,
+    // Crc32c.h).
+    XXH3_64,
+    XXH3_128,
+    CRC32C
+};
+
+// False for digests that other tools will not reproduce; reports label them.
+inline bool IsStandardHashAlgorithm(HashAlgorithm algorithm) {
+    return algorithm != HashAlgorithm::SHA256Tree;
+}
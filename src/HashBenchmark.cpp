@@ -0,0 +1,366 @@
+#include "HashBenchmark.h"
+
+#include "Digest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/vfs.h>
+#endif
+#endif
+
+namespace {
+
+const size_t kGenerateBlock = 1u << 20;
+
+struct ProcessCounters {
+    double cpuSeconds = 0.0;
+    int64_t readCalls = -1;
+    int64_t contextSwitches = -1;
+};
+
+ProcessCounters ReadProcessCounters() {
+    ProcessCounters counters;
+#if defined(_WIN32)
+    FILETIME created = {};
+    FILETIME exited = {};
+    FILETIME kernel = {};
+    FILETIME user = {};
+    if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        auto ticks = [](const FILETIME& ft) { return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+        counters.cpuSeconds = static_cast<double>(ticks(kernel) + ticks(user)) / 1e7;
+    }
+    IO_COUNTERS io = {};
+    if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+        counters.readCalls = static_cast<int64_t>(io.ReadOperationCount);
+    }
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        counters.cpuSeconds = static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+                              static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+        counters.contextSwitches = static_cast<int64_t>(ru.ru_nvcsw + ru.ru_nivcsw);
+    }
+#if defined(__linux__)
+    // Summed over all threads of the process, exited ones included.
+    if (FILE* io = std::fopen("/proc/self/io", "r")) {
+        char line[128];
+        while (std::fgets(line, sizeof(line), io) != nullptr) {
+            long long value = 0;
+            if (std::sscanf(line, "syscr: %lld", &value) == 1) {
+                counters.readCalls = value;
+                break;
+            }
+        }
+        std::fclose(io);
+    }
+#endif
+#endif
+    return counters;
+}
+
+std::string WideToUtf8(const std::wstring& text) {
+#if defined(_WIN32)
+    int len = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+    std::string out(len > 0 ? static_cast<size_t>(len) : 0, '\0');
+    if (len > 0) {
+        WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &out[0], len, nullptr, nullptr);
+    }
+    return out;
+#else
+    return ToNativePath(text);
+#endif
+}
+
+std::string JsonQuote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (u < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", u);
+            out += buf;
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+std::wstring GetTempDirectory() {
+#if defined(_WIN32)
+    wchar_t dir[MAX_PATH + 1] = {};
+    DWORD len = GetTempPathW(MAX_PATH + 1, dir);
+    std::wstring path = (len != 0 && len <= MAX_PATH) ? std::wstring(dir, len) : std::wstring(L".");
+#else
+    const char* dir = std::getenv("TMPDIR");
+    std::string base = (dir != nullptr && *dir != '\0') ? dir : "/tmp";
+    std::wstring path(base.begin(), base.end());
+#endif
+    while (path.size() > 1 && (path.back() == L'/' || path.back() == L'\\')) {
+        path.pop_back();
+    }
+    return path;
+}
+
+std::string GetMedium(const std::wstring& directory) {
+#if defined(__linux__)
+    const long kTmpfsMagic = 0x01021994;
+    const long kRamfsMagic = static_cast<long>(0x858458f6);
+    struct statfs st;
+    if (statfs(ToNativePath(directory).c_str(), &st) == 0 &&
+        (static_cast<long>(st.f_type) == kTmpfsMagic || static_cast<long>(st.f_type) == kRamfsMagic)) {
+        return "tmpfs";
+    }
+#else
+    (void)directory;
+#endif
+    return "disk";
+}
+
+std::wstring GetInputPath(const std::wstring& directory, uint64_t size) {
+#if defined(_WIN32)
+    const wchar_t separator = L'\\';
+    const std::wstring pid = std::to_wstring(GetCurrentProcessId());
+#else
+    const wchar_t separator = L'/';
+    const std::wstring pid = std::to_wstring(getpid());
+#endif
+    std::wstring path = directory;
+    if (!path.empty() && path.back() != L'/' && path.back() != L'\\') {
+        path.push_back(separator);
+    }
+    return path + L"peinfo-bench-" + pid + L"-" + std::to_wstring(size) + L".bin";
+}
+
+void RemoveFile(const std::wstring& path) {
+#if defined(_WIN32)
+    DeleteFileW(path.c_str());
+#else
+    unlink(ToNativePath(path).c_str());
+#endif
+}
+
+// Pseudo-random bytes, so that no layer below can compress or deduplicate
+// them.
+bool GenerateInput(const std::wstring& path, uint64_t size, std::wstring& error) {
+#if defined(_WIN32)
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+#else
+    std::ofstream out(ToNativePath(path).c_str(), std::ios::binary | std::ios::trunc);
+#endif
+    std::vector<uint64_t> block(kGenerateBlock / sizeof(uint64_t));
+    uint64_t state = size;
+    for (uint64_t written = 0; out && written < size;) {
+        for (auto& word : block) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+        size_t bytes = static_cast<size_t>(std::min<uint64_t>(kGenerateBlock, size - written));
+        out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(bytes));
+        written += bytes;
+    }
+    out.close();
+    if (!out) {
+        error = L"Cannot write the benchmark input " + path;
+        return false;
+    }
+    return true;
+}
+
+HashResult HashWithEngine(const HashSweepCase& sweepCase, const std::wstring& path) {
+    HashEngineOptions options;
+    options.policy = sweepCase.policy;
+    options.backend = sweepCase.backend;
+    options.chunkSize = sweepCase.chunkSize;
+    return HashEngine(options).Hash(HashSource::FromPath(path), sweepCase.algorithm);
+}
+
+HashSweepResult MeasureCase(const HashSweepOptions& options, const HashSweepCase& sweepCase, const std::wstring& path) {
+    HashSweepResult best;
+    best.sweepCase = sweepCase;
+    const int rounds = std::max<int>(1, options.rounds);
+    for (int round = 0; round < rounds; ++round) {
+        if (sweepCase.cold) {
+            EvictFromPageCache(path);
+        }
+        ProcessCounters before = ReadProcessCounters();
+        auto start = std::chrono::steady_clock::now();
+        HashResult hash = options.hash ? options.hash(sweepCase, path) : HashWithEngine(sweepCase, path);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ProcessCounters after = ReadProcessCounters();
+        if (!hash.success) {
+            best.error = WideToUtf8(hash.errorMessage.empty() ? std::wstring(L"Hash calculation failed") : hash.errorMessage);
+            return best;
+        }
+        if (round != 0 && seconds >= best.seconds) {
+            continue;
+        }
+        best.bytes = sweepCase.fileSize;
+        best.seconds = seconds;
+        best.cpuSeconds = after.cpuSeconds - before.cpuSeconds;
+        best.readCalls = before.readCalls >= 0 && after.readCalls >= 0 ? after.readCalls - before.readCalls : -1;
+        best.contextSwitches =
+            before.contextSwitches >= 0 && after.contextSwitches >= 0 ? after.contextSwitches - before.contextSwitches : -1;
+        best.gigabytesPerSecond = seconds > 0.0 ? static_cast<double>(best.bytes) / 1e9 / seconds : 0.0;
+        best.digest = WideToUtf8(hash.result);
+    }
+    return best;
+}
+
+} // namespace
+
+std::vector<std::wstring> GetDefaultSweepDirectories() {
+    std::vector<std::wstring> directories;
+#if defined(__linux__)
+    if (GetMedium(L"/dev/shm") == "tmpfs") {
+        directories.push_back(L"/dev/shm");
+    }
+#endif
+    std::wstring temp = GetTempDirectory();
+    if (std::find(directories.begin(), directories.end(), temp) == directories.end()) {
+        directories.push_back(temp);
+    }
+    return directories;
+}
+
+bool RunHashSweep(const HashSweepOptions& options,
+                  const std::function<void(const HashSweepResult&)>& onResult,
+                  std::vector<HashSweepResult>& results,
+                  std::wstring& error) {
+    std::vector<HashAlgorithm> algorithms = options.algorithms;
+    if (algorithms.empty()) {
+        algorithms = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256, HashAlgorithm::BLAKE3, HashAlgorithm::XXH3_64};
+    }
+    std::vector<size_t> chunkSizes = options.chunkSizes;
+    if (chunkSizes.empty()) {
+        chunkSizes = {0, 64u << 10, 1u << 20};
+    }
+    std::vector<HashIoPolicy> policies = options.policies;
+    if (policies.empty()) {
+        policies = {HashIoPolicy::Sync, HashIoPolicy::Mapped, HashIoPolicy::Async};
+    }
+    std::vector<AsyncIoBackend> backends = options.backends;
+    if (backends.empty()) {
+        backends = GetAsyncIoBackends();
+    }
+    std::vector<uint64_t> fileSizes = options.fileSizes;
+    if (fileSizes.empty()) {
+        fileSizes = {1ull << 20, 64ull << 20};
+    }
+    std::vector<std::wstring> directories = options.directories;
+    if (directories.empty()) {
+        directories = GetDefaultSweepDirectories();
+    }
+
+    results.clear();
+    for (const std::wstring& directory : directories) {
+        const std::string medium = GetMedium(directory);
+        for (uint64_t fileSize : fileSizes) {
+            // One input at a time, so the sweep needs no more room than its
+            // largest file.
+            const std::wstring path = GetInputPath(directory, fileSize);
+            if (!GenerateInput(path, fileSize, error)) {
+                RemoveFile(path);
+                return false;
+            }
+            for (HashAlgorithm algorithm : algorithms) {
+                std::string expected;
+                for (HashIoPolicy policy : policies) {
+                    const std::vector<AsyncIoBackend> caseBackends =
+                        policy == HashIoPolicy::Async ? backends : std::vector<AsyncIoBackend>{AsyncIoBackend::Auto};
+                    for (AsyncIoBackend backend : caseBackends) {
+                        for (size_t chunkSize : chunkSizes) {
+                            HashSweepCase sweepCase;
+                            sweepCase.policy = policy;
+                            sweepCase.backend = backend;
+                            sweepCase.algorithm = algorithm;
+                            sweepCase.chunkSize = chunkSize;
+                            sweepCase.fileSize = fileSize;
+                            sweepCase.directory = directory;
+                            sweepCase.medium = medium;
+                            sweepCase.cold = options.coldCache && medium == "disk";
+                            HashSweepResult result = MeasureCase(options, sweepCase, path);
+                            if (result.error.empty() && expected.empty()) {
+                                expected = result.digest;
+                            } else if (result.error.empty() && result.digest != expected) {
+                                result.error = "Digest differs from the first case of this input";
+                            }
+                            if (onResult) {
+                                onResult(result);
+                            }
+                            results.push_back(result);
+                        }
+                    }
+                }
+            }
+            RemoveFile(path);
+        }
+    }
+    return true;
+}
+
+std::string BuildJsonHashSweep(const HashSweepOptions& options, const std::vector<HashSweepResult>& results) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"formatVersion\":1";
+    oss << ",\"hardwareThreads\":" << std::thread::hardware_concurrency();
+    oss << ",\"rounds\":" << std::max<int>(1, options.rounds);
+    oss << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const HashSweepResult& r = results[i];
+        const HashSweepCase& c = r.sweepCase;
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"frontEnd\":" << JsonQuote(c.policy == HashIoPolicy::Async ? "AsyncHashCalculator" : "HashCalculator");
+        oss << ",\"policy\":" << JsonQuote(GetHashIoPolicyName(c.policy));
+        if (c.policy == HashIoPolicy::Async) {
+            oss << ",\"backend\":" << JsonQuote(GetAsyncIoBackendName(c.backend));
+        }
+        oss << ",\"algorithm\":" << JsonQuote(GetDigestAlgorithmName(c.algorithm));
+        oss << ",\"chunkSize\":" << c.chunkSize;
+        oss << ",\"fileSize\":" << c.fileSize;
+        oss << ",\"medium\":" << JsonQuote(c.medium);
+        oss << ",\"directory\":" << JsonQuote(WideToUtf8(c.directory));
+        oss << ",\"cold\":" << (c.cold ? "true" : "false");
+        if (r.error.empty()) {
+            oss << ",\"bytes\":" << r.bytes;
+            oss << std::fixed << std::setprecision(6);
+            oss << ",\"seconds\":" << r.seconds;
+            oss << ",\"cpuSeconds\":" << r.cpuSeconds;
+            oss << std::setprecision(3);
+            oss << ",\"gigabytesPerSecond\":" << r.gigabytesPerSecond;
+            if (r.readCalls >= 0) {
+                oss << ",\"readCalls\":" << r.readCalls;
+            }
+            if (r.contextSwitches >= 0) {
+                oss << ",\"contextSwitches\":" << r.contextSwitches;
+            }
+            oss << ",\"digest\":" << JsonQuote(r.digest);
+        } else {
+            oss << ",\"error\":" << JsonQuote(r.error);
+        }
+        oss << "}";
+    }
+    oss << "]";
+    oss << "}";
+    return oss.str();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "AsyncFileReader.h"
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Throughput sweep of file hashing over generated inputs: every combination
+// of algorithm, chunk size, I/O policy (and async backend), file size and
+// directory, so that changes to the engine can be compared run to run from
+// the JSON it writes. Sync and Mapped cases are what HashCalculator does,
+// Async cases what AsyncHashCalculator does. Builds without Windows headers.
+
+struct HashSweepCase {
+    HashIoPolicy policy = HashIoPolicy::Sync;
+    // Async cases only.
+    AsyncIoBackend backend = AsyncIoBackend::Auto;
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    // 0 = the front end's default (tuned for Async).
+    size_t chunkSize = 0;
+    uint64_t fileSize = 0;
+    std::wstring directory;
+    // "tmpfs" for memory-backed file systems, "disk" otherwise.
+    std::string medium;
+    // Evicted from the page cache before every round.
+    bool cold = false;
+};
+
+struct HashSweepOptions {
+    // Empty lists take the defaults: MD5, SHA1, SHA256, BLAKE3 and XXH3-64;
+    // chunk sizes 0, 64 KiB and 1 MiB; Sync, Mapped and Async; every
+    // compiled-in backend; 1 MiB and 64 MiB; GetDefaultSweepDirectories().
+    std::vector<HashAlgorithm> algorithms;
+    std::vector<size_t> chunkSizes;
+    std::vector<HashIoPolicy> policies;
+    std::vector<AsyncIoBackend> backends;
+    std::vector<uint64_t> fileSizes;
+    std::vector<std::wstring> directories;
+    // Each case is timed this often; the fastest round is reported.
+    int rounds = 3;
+    // Inputs on disk are evicted from the page cache before every round, so
+    // that the storage is measured; tmpfs inputs always stay in memory.
+    bool coldCache = true;
+    // Hashes one case. Unset, HashEngine runs with the options the front end
+    // would set; the Windows build passes HashCalculator and
+    // AsyncHashCalculator themselves.
+    std::function<HashResult(const HashSweepCase& sweepCase, const std::wstring& path)> hash;
+};
+
+struct HashSweepResult {
+    HashSweepCase sweepCase;
+    uint64_t bytes = 0;
+    // Wall time, and user plus kernel time of the whole process (reader and
+    // digest threads included).
+    double seconds = 0.0;
+    double cpuSeconds = 0.0;
+    double gigabytesPerSecond = 0.0;
+    // Read system calls (/proc/self/io syscr; I/O read operations on
+    // Windows) and context switches; -1 where the OS does not tell.
+    int64_t readCalls = -1;
+    int64_t contextSwitches = -1;
+    // Cases hashing the same input must agree.
+    std::string digest;
+    std::string error;
+};
+
+// A tmpfs directory where there is one (/dev/shm), and the temp directory.
+std::vector<std::wstring> GetDefaultSweepDirectories();
+
+// Runs every case; onResult sees each result as it is measured. Fails only
+// when an input cannot be generated.
+bool RunHashSweep(const HashSweepOptions& options,
+                  const std::function<void(const HashSweepResult&)>& onResult,
+                  std::vector<HashSweepResult>& results,
+                  std::wstring& error);
+
+std::string BuildJsonHashSweep(const HashSweepOptions& options, const std::vector<HashSweepResult>& results);
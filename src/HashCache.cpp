@@ -0,0 +1,362 @@
+#include "HashCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'P', 'E', 'I', 'H', 'C', 'A', 'C', 'H'};
+const uint32_t kVersion = 1;
+const size_t kHeaderSize = 4096;
+const size_t kSlotsPerBucket = 8;
+const size_t kTextSize = 200;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the cache file is shared through lock-free atomics");
+
+uint64_t Mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+void MakeKey(const HashFileIdentity& identity, uint64_t* key) {
+    key[0] = identity.device;
+    key[1] = identity.fileId;
+    key[2] = identity.size;
+    key[3] = identity.modifiedTime;
+    key[4] = identity.changeTime;
+}
+
+} // namespace
+
+// The first page of the file. Every process that finds it zeroed writes the
+// same values, magic last.
+struct HashCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t bucketCount;
+    // Recency clock for eviction.
+    std::atomic<uint64_t> tick;
+};
+
+// seq is 0 for an empty slot, odd while a writer owns it, and even otherwise.
+struct HashCache::Slot {
+    std::atomic<uint32_t> seq;
+    uint8_t algorithm;
+    uint8_t textLength;
+    uint16_t reserved;
+    std::atomic<uint64_t> lastUsed;
+    uint64_t key[5];
+    char text[kTextSize];
+};
+
+HashCache::HashCache() : m_hits(0), m_misses(0), m_stores(0), m_evictions(0) {
+}
+
+HashCache::~HashCache() {
+    Close();
+}
+
+bool HashCache::Open(const std::wstring& path, uint64_t maxBytes, std::wstring& error) {
+    static_assert(sizeof(Header) <= kHeaderSize, "cache header outgrew its page");
+    static_assert(sizeof(Slot) == 256, "cache slot layout changed");
+    Close();
+    if (maxBytes == 0) {
+        maxBytes = kDefaultMaxBytes;
+    }
+    const uint64_t bucketBytes = kSlotsPerBucket * sizeof(Slot);
+    const uint64_t newSize = kHeaderSize + std::max<uint64_t>(1, (maxBytes - std::min<uint64_t>(maxBytes, kHeaderSize)) / bucketBytes) * bucketBytes;
+
+    uint64_t size = 0;
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = L"Failed to open hash cache";
+        return false;
+    }
+    LARGE_INTEGER li = {};
+    if (!GetFileSizeEx(file, &li)) {
+        CloseHandle(file);
+        error = L"Failed to open hash cache";
+        return false;
+    }
+    size = static_cast<uint64_t>(li.QuadPart);
+    // The mapping grows an empty file to its size.
+    const uint64_t mapSize = size == 0 ? newSize : size;
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(mapSize >> 32), static_cast<DWORD>(mapSize), nullptr);
+    CloseHandle(file);
+    void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+    }
+    if (view == nullptr) {
+        error = L"Failed to map hash cache";
+        return false;
+    }
+    size = mapSize;
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = L"Failed to open hash cache";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size == 0 && ftruncate(fd, static_cast<off_t>(newSize)) != 0)) {
+        close(fd);
+        error = L"Failed to open hash cache";
+        return false;
+    }
+    size = st.st_size == 0 ? newSize : static_cast<uint64_t>(st.st_size);
+    void* view = size <= SIZE_MAX ? mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (view == MAP_FAILED) {
+        error = L"Failed to map hash cache";
+        return false;
+    }
+#endif
+    m_view = static_cast<uint8_t*>(view);
+    m_viewSize = size;
+
+    Header* header = reinterpret_cast<Header*>(m_view);
+    const uint64_t bucketCount = size >= kHeaderSize ? (size - kHeaderSize) / bucketBytes : 0;
+    static const char kZero[sizeof(kMagic)] = {};
+    if (bucketCount != 0 && std::memcmp(header->magic, kZero, sizeof(kZero)) == 0) {
+        header->version = kVersion;
+        header->slotSize = static_cast<uint32_t>(sizeof(Slot));
+        header->bucketCount = bucketCount;
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (bucketCount == 0 || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion ||
+        header->slotSize != sizeof(Slot) || header->bucketCount != bucketCount) {
+        Close();
+        error = L"Not a hash cache";
+        return false;
+    }
+    m_bucketCount = bucketCount;
+    m_hits = 0;
+    m_misses = 0;
+    m_stores = 0;
+    m_evictions = 0;
+    return true;
+}
+
+void HashCache::Close() {
+    if (m_view == nullptr) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, static_cast<size_t>(m_viewSize));
+#endif
+    m_view = nullptr;
+    m_viewSize = 0;
+    m_bucketCount = 0;
+}
+
+HashCache::Slot* HashCache::Bucket(const HashFileIdentity& identity, HashAlgorithm algorithm) const {
+    uint64_t key[5];
+    MakeKey(identity, key);
+    uint64_t h = static_cast<uint64_t>(algorithm);
+    for (uint64_t k : key) {
+        h = Mix(h, k);
+    }
+    return reinterpret_cast<Slot*>(m_view + kHeaderSize) + (h % m_bucketCount) * kSlotsPerBucket;
+}
+
+bool HashCache::Lookup(const HashFileIdentity& identity, HashAlgorithm algorithm, std::wstring& result) {
+    if (m_view == nullptr) {
+        return false;
+    }
+    uint64_t key[5];
+    MakeKey(identity, key);
+    Slot* bucket = Bucket(identity, algorithm);
+    for (size_t i = 0; i < kSlotsPerBucket; ++i) {
+        Slot& slot = bucket[i];
+        const uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before == 0 || (before & 1) != 0) {
+            continue;
+        }
+        const uint8_t slotAlgorithm = slot.algorithm;
+        const uint8_t length = slot.textLength;
+        uint64_t slotKey[5];
+        char text[kTextSize];
+        std::memcpy(slotKey, slot.key, sizeof(slotKey));
+        std::memcpy(text, slot.text, sizeof(text));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (slotAlgorithm != static_cast<uint8_t>(algorithm) || std::memcmp(slotKey, key, sizeof(key)) != 0 || length > kTextSize) {
+            continue;
+        }
+        Header* header = reinterpret_cast<Header*>(m_view);
+        slot.lastUsed.store(header->tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        result.assign(text, text + length);
+        ++m_hits;
+        return true;
+    }
+    ++m_misses;
+    return false;
+}
+
+void HashCache::Store(const HashFileIdentity& identity, HashAlgorithm algorithm, const std::wstring& result) {
+    if (m_view == nullptr || result.size() > kTextSize) {
+        return;
+    }
+    char text[kTextSize] = {};
+    for (size_t i = 0; i < result.size(); ++i) {
+        if (result[i] >= 0x80) {
+            return;
+        }
+        text[i] = static_cast<char>(result[i]);
+    }
+    uint64_t key[5];
+    MakeKey(identity, key);
+
+    // The slot already holding this key, else an empty one, else the least
+    // recently used.
+    Slot* bucket = Bucket(identity, algorithm);
+    Slot* target = nullptr;
+    Slot* empty = nullptr;
+    Slot* oldest = nullptr;
+    for (size_t i = 0; i < kSlotsPerBucket && target == nullptr; ++i) {
+        Slot& slot = bucket[i];
+        const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            if (empty == nullptr) {
+                empty = &slot;
+            }
+            continue;
+        }
+        if ((seq & 1) != 0) {
+            continue;
+        }
+        if (slot.algorithm == static_cast<uint8_t>(algorithm) && std::memcmp(slot.key, key, sizeof(key)) == 0) {
+            target = &slot;
+        } else if (oldest == nullptr || slot.lastUsed.load(std::memory_order_relaxed) < oldest->lastUsed.load(std::memory_order_relaxed)) {
+            oldest = &slot;
+        }
+    }
+    const bool evicting = target == nullptr && empty == nullptr;
+    if (target == nullptr) {
+        target = empty != nullptr ? empty : oldest;
+    }
+    if (target == nullptr) {
+        return;
+    }
+
+    // Another writer holding or taking the slot wins; this result is simply
+    // not cached.
+    uint32_t before = target->seq.load(std::memory_order_relaxed);
+    if ((before & 1) != 0 || !target->seq.compare_exchange_strong(before, before + 1, std::memory_order_acq_rel)) {
+        return;
+    }
+    target->algorithm = static_cast<uint8_t>(algorithm);
+    target->textLength = static_cast<uint8_t>(result.size());
+    std::memcpy(target->key, key, sizeof(key));
+    std::memcpy(target->text, text, sizeof(text));
+    Header* header = reinterpret_cast<Header*>(m_view);
+    target->lastUsed.store(header->tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    uint32_t after = before + 2;
+    target->seq.store(after == 0 ? 2 : after, std::memory_order_release);
+    ++m_stores;
+    if (evicting) {
+        ++m_evictions;
+    }
+}
+
+HashCacheStats HashCache::GetStats() const {
+    HashCacheStats stats;
+    stats.hits = m_hits.load();
+    stats.misses = m_misses.load();
+    stats.stores = m_stores.load();
+    stats.evictions = m_evictions.load();
+    return stats;
+}
+
+bool RunHashCacheSelfTest(std::wstring& error) {
+    const std::wstring path = GetSelfTestTempPath(L"peinfo-hashcache-");
+    auto removeFile = [&]() {
+#if defined(_WIN32)
+        DeleteFileW(path.c_str());
+#else
+        unlink(ToNativePath(path).c_str());
+#endif
+    };
+    removeFile();
+
+    bool ok = false;
+    {
+        HashCache cache;
+        // One bucket, so the ninth file evicts.
+        if (!cache.Open(path, kHeaderSize + kSlotsPerBucket * 256, error)) {
+            removeFile();
+            return false;
+        }
+        HashFileIdentity id;
+        id.size = 1234;
+        id.modifiedTime = 5678;
+        id.changeTime = 5679;
+        id.device = 1;
+        id.fileId = 42;
+        std::wstring result;
+        cache.Store(id, HashAlgorithm::SHA256, L"aa");
+        cache.Store(id, HashAlgorithm::MD5, L"bb");
+        cache.Store(id, HashAlgorithm::SHA256, L"cc");
+        HashFileIdentity touched = id;
+        ++touched.changeTime;
+        if (!cache.Lookup(id, HashAlgorithm::SHA256, result) || result != L"cc" || !cache.Lookup(id, HashAlgorithm::MD5, result) ||
+            result != L"bb" || cache.Lookup(touched, HashAlgorithm::SHA256, result) || cache.Lookup(id, HashAlgorithm::SHA1, result)) {
+            error = L"Hash cache lookups are wrong";
+        } else {
+            // Seven more files fill the bucket and then evict the least
+            // recently used entry, MD5.
+            cache.Lookup(id, HashAlgorithm::SHA256, result);
+            for (uint64_t i = 0; i < 7; ++i) {
+                HashFileIdentity other = id;
+                other.fileId = 100 + i;
+                cache.Store(other, HashAlgorithm::SHA256, L"dd");
+            }
+            if (cache.GetStats().evictions != 1 || cache.Lookup(id, HashAlgorithm::MD5, result) || !cache.Lookup(id, HashAlgorithm::SHA256, result)) {
+                error = L"Hash cache did not evict the least recently used entry";
+            } else {
+                ok = true;
+            }
+        }
+    }
+    if (ok) {
+        HashCache reopened;
+        HashFileIdentity id;
+        id.size = 1234;
+        id.modifiedTime = 5678;
+        id.changeTime = 5679;
+        id.device = 1;
+        id.fileId = 42;
+        std::wstring result;
+        // The size cap only applies to a new file.
+        if (!reopened.Open(path, 1ull << 30, error) || !reopened.Lookup(id, HashAlgorithm::SHA256, result) || result != L"cc") {
+            error = L"Hash cache entries did not survive reopening";
+            ok = false;
+        }
+    }
+    removeFile();
+    return ok;
+}
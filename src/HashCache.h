@@ -0,0 +1,70 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Digests of files already hashed, kept across runs in a memory-mapped file
+// and keyed on the file's identity (device, file ID, size, modification and
+// change times), so an unchanged file is not read again. The table has a
+// fixed number of slots, set when the file is created from the size cap, in
+// buckets of eight; a full bucket evicts its least recently used entry.
+// Several threads and processes may use one cache file at once: every slot
+// carries a sequence number that writers bump around their update and
+// readers check around their copy, so a reader never sees a half-written
+// entry, and a writer that loses the race for a slot skips its store. Builds
+// without Windows headers.
+
+struct HashCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0;
+};
+
+class HashCache {
+public:
+    static const uint64_t kDefaultMaxBytes = 64ull << 20;
+
+    HashCache();
+    ~HashCache();
+    HashCache(const HashCache&) = delete;
+    HashCache& operator=(const HashCache&) = delete;
+
+    // Opens the cache file, creating it when it does not exist yet. maxBytes
+    // (0 = kDefaultMaxBytes) only sizes a new file; an existing one keeps its
+    // size. Fails for a file that is not a hash cache.
+    bool Open(const std::wstring& path, uint64_t maxBytes, std::wstring& error);
+    void Close();
+    bool IsOpen() const { return m_view != nullptr; }
+
+    // Lookup and Store may be called from several threads at once.
+    bool Lookup(const HashFileIdentity& identity, HashAlgorithm algorithm, std::wstring& result);
+    // Results longer than a slot holds are not stored.
+    void Store(const HashFileIdentity& identity, HashAlgorithm algorithm, const std::wstring& result);
+
+    // Counts of this object since Open.
+    HashCacheStats GetStats() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    Slot* Bucket(const HashFileIdentity& identity, HashAlgorithm algorithm) const;
+
+    uint8_t* m_view = nullptr;
+    uint64_t m_viewSize = 0;
+    uint64_t m_bucketCount = 0;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_stores;
+    std::atomic<uint64_t> m_evictions;
+};
+
+// Hits and misses, updates, eviction from a full bucket, and a cache file
+// reopened; error describes the first failure.
+bool RunHashCacheSelfTest(std::wstring& error);
@@ -1,6 +1,10 @@
 #include "stdafx.h"
 #include "HashCalculator.h"
-#include <fstream>
+#include "Digest.h"
+#include "HashCheckpoint.h"
+#include "ReportUtil.h"
+#include "Sha256MultiBuffer.h"
+#include "WorkerPool.h"
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
@@ -13,305 +17,230 @@ HashCalculator::~HashCalculator() {
 }
 
 void HashCalculator::SetChunkSize(size_t bytes) {
-    m_chunkSize = bytes == 0 ? (1u << 20) : bytes;
+    m_options.chunkSize = bytes;
 }
 
 void HashCalculator::SetProgressCallback(std::function<void(uint64_t, uint64_t)> cb) {
-    m_progress = std::move(cb);
+    m_options.progress = std::move(cb);
 }
 
 void HashCalculator::SetCancelFlag(std::atomic<bool>* flag) {
-    m_cancel = flag;
+    m_options.cancel = flag;
 }
 
-HashResult HashCalculator::CalculateFileHash(const std::wstring& filePath, HashAlgorithm algorithm) {
-    return HashFileStream(filePath, algorithm);
+void HashCalculator::SetParallelDigests(bool enabled) {
+    m_options.parallelDigests = enabled;
 }
 
-std::vector<HashResult> HashCalculator::CalculateFileHashes(const std::wstring& filePath, const std::vector<HashAlgorithm>& algorithms) {
-    std::vector<HashResult> results;
-    results.reserve(algorithms.size());
-    for (const auto& alg : algorithms) {
-        results.push_back(HashFileStream(filePath, alg));
-    }
-    return results;
+void HashCalculator::SetIoPolicy(HashIoPolicy policy) {
+    m_options.policy = policy;
 }
 
-HashResult HashCalculator::CalculateTextHash(const std::wstring& text, HashAlgorithm algorithm) {
-    std::vector<BYTE> textData = StringToBytes(text);
-    return PerformHash(textData, algorithm);
+void HashCalculator::SetCachePolicy(PageCachePolicy policy) {
+    m_options.cachePolicy = policy;
 }
 
-std::vector<HashResult> HashCalculator::CalculateTextHashes(const std::wstring& text, const std::vector<HashAlgorithm>& algorithms) {
-    std::vector<BYTE> textData = StringToBytes(text);
-    std::vector<HashResult> results;
+void HashCalculator::SetResumable(bool enabled, uint64_t intervalBytes) {
+    m_resumable = enabled;
+    m_checkpointInterval = intervalBytes;
+}
 
-    for (const auto& alg : algorithms) {
-        results.push_back(PerformHash(textData, alg));
+HashEngineOptions HashCalculator::GetFileOptions(const HashEngineOptions& base, const std::wstring& filePath) const {
+    HashEngineOptions options = base;
+    if (m_resumable) {
+        options.checkpointPath = GetHashCheckpointPath(filePath);
+        options.checkpointInterval = m_checkpointInterval;
     }
-
-    return results;
+    return options;
 }
 
-bool HashCalculator::IsHashAlgorithmSupported(HashAlgorithm algorithm) {
-    switch (algorithm) {
-        case HashAlgorithm::MD5:
-        case HashAlgorithm::SHA1:
-        case HashAlgorithm::SHA256:
-            return true;
-        default:
-            return false;
-    }
+void HashCalculator::SetCache(HashCache* cache) {
+    m_cache = cache;
 }
 
-std::wstring HashCalculator::GetAlgorithmName(HashAlgorithm algorithm) {
-    switch (algorithm) {
-        case HashAlgorithm::MD5: return L"MD5";
-        case HashAlgorithm::SHA1: return L"SHA1";
-        case HashAlgorithm::SHA256: return L"SHA256";
-        default: return L"Unknown";
+void HashCalculator::StoreInCache(const std::wstring& filePath, const HashFileIdentity& before, HashAlgorithm algorithm, const HashResult& result) {
+    // A file written while it was hashed may not match its new identity.
+    HashFileIdentity after;
+    if (result.success && GetHashFileIdentity(filePath, after) && after == before) {
+        m_cache->Store(before, algorithm, result.result);
     }
 }
 
-void HashCalculator::ClearResults() {
-    m_lastResults.clear();
+HashResult HashCalculator::CalculateFileHash(const std::wstring& filePath, HashAlgorithm algorithm) {
+    return CalculateFileHashes(filePath, {algorithm}).front();
 }
 
-HashResult HashCalculator::PerformHash(const std::vector<BYTE>& data, HashAlgorithm algorithm) {
-    HashResult result;
-    result.algorithm = GetAlgorithmName(algorithm);
-    
-    auto start = std::chrono::high_resolution_clock::now();
-
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-
-    // Acquire cryptographic provider
-    if (!CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
-        result.success = false;
-        result.errorMessage = L"Failed to acquire cryptographic context";
-        return result;
+std::vector<HashResult> HashCalculator::CalculateFileHashes(const std::wstring& filePath, const std::vector<HashAlgorithm>& algorithms) {
+    HashFileIdentity identity;
+    const bool cached = m_cache != nullptr && m_cache->IsOpen() && GetHashFileIdentity(filePath, identity);
+    if (!cached) {
+        return HashEngine(GetFileOptions(m_options, filePath)).Hash(HashSource::FromPath(filePath), algorithms);
     }
 
-    // Create hash object
-    ALG_ID algId = GetCryptoAPIAlgId(algorithm);
-    if (!CryptCreateHash(hProv, algId, 0, 0, &hHash)) {
-        CryptReleaseContext(hProv, 0);
-        result.success = false;
-        result.errorMessage = L"Failed to create hash object";
-        return result;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<HashResult> results(algorithms.size());
+    std::vector<HashAlgorithm> missing;
+    std::vector<size_t> missingIndex;
+    for (size_t i = 0; i < algorithms.size(); ++i) {
+        HashResult& r = results[i];
+        r.algorithm = GetAlgorithmName(algorithms[i]);
+        r.standard = IsStandardHashAlgorithm(algorithms[i]);
+        r.success = m_cache->Lookup(identity, algorithms[i], r.result);
+        if (!r.success) {
+            missing.push_back(algorithms[i]);
+            missingIndex.push_back(i);
+        }
     }
-
-    // Hash the data
-    if (!CryptHashData(hHash, data.data(), static_cast<DWORD>(data.size()), 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        result.success = false;
-        result.errorMessage = L"Failed to hash data";
-        return result;
+    std::chrono::duration<double> lookupTime = std::chrono::high_resolution_clock::now() - start;
+    for (auto& r : results) {
+        r.calculationTime = lookupTime.count();
     }
-
-    // Get hash size
-    DWORD hashLen = 0;
-    DWORD dataLen = sizeof(DWORD);
-    if (!CryptGetHashParam(hHash, HP_HASHSIZE, reinterpret_cast<BYTE*>(&hashLen), &dataLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        result.success = false;
-        result.errorMessage = L"Failed to get hash size";
-        return result;
+    if (missing.empty()) {
+        return results;
     }
-
-    // Get hash value
-    std::vector<BYTE> hashData(hashLen);
-    if (!CryptGetHashParam(hHash, HP_HASHVAL, hashData.data(), &hashLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        result.success = false;
-        result.errorMessage = L"Failed to get hash value";
-        return result;
+    std::vector<HashResult> hashed = HashEngine(GetFileOptions(m_options, filePath)).Hash(HashSource::FromPath(filePath), missing);
+    for (size_t k = 0; k < missing.size(); ++k) {
+        StoreInCache(filePath, identity, missing[k], hashed[k]);
+        results[missingIndex[k]] = hashed[k];
     }
+    return results;
+}
 
-    // Clean up
-    CryptDestroyHash(hHash);
-    CryptReleaseContext(hProv, 0);
+void HashCalculator::SetBatchOptions(size_t maxSmallFileSize, size_t threadCount) {
+    m_batchMaxFileSize = maxSmallFileSize;
+    m_batchThreads = threadCount;
+}
 
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = end - start;
-    result.calculationTime = diff.count();
+std::vector<HashResult> HashCalculator::CalculateFileHashBatch(const std::vector<std::wstring>& filePaths, HashAlgorithm algorithm) {
+    const size_t kGroupSize = 64;
+    std::vector<HashResult> results(filePaths.size());
+    const std::wstring algorithmName = GetAlgorithmName(algorithm);
+    const bool multiBuffer = algorithm == HashAlgorithm::SHA256 && IsSha256MultiBufferPreferred();
+    size_t groups = (filePaths.size() + kGroupSize - 1) / kGroupSize;
+
+    // Large files stream with the usual settings. Groups already run in
+    // parallel, so small files keep tree hashes on their group's thread.
+    HashEngineOptions streamOptions = m_options;
+    streamOptions.progress = nullptr;
+    HashEngineOptions smallOptions;
+    smallOptions.digestThreads = 1;
+    smallOptions.parallelDigests = false;
+
+    RunParallel(groups, m_batchThreads, [&](size_t g) {
+        size_t first = g * kGroupSize;
+        size_t last = std::min<size_t>(filePaths.size(), first + kGroupSize);
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<std::vector<BYTE>> contents(last - first);
+        std::vector<HashFileIdentity> identities(last - first);
+        std::vector<size_t> small;
+        const bool cached = m_cache != nullptr && m_cache->IsOpen();
+        for (size_t i = first; i < last; ++i) {
+            HashResult& r = results[i];
+            r.success = false;
+            r.algorithm = algorithmName;
+            r.standard = IsStandardHashAlgorithm(algorithm);
+            r.calculationTime = 0.0;
+            if (m_options.cancel && m_options.cancel->load()) {
+                r.errorMessage = L"Cancelled";
+                continue;
+            }
+            HashFileIdentity& identity = identities[i - first];
+            const bool known = cached && GetHashFileIdentity(filePaths[i], identity);
+            if (known && m_cache->Lookup(identity, algorithm, r.result)) {
+                r.success = true;
+                continue;
+            }
+            std::wstring error;
+            bool tooLarge = false;
+            if (!ReadWholeFile(filePaths[i], m_options.cachePolicy, m_batchMaxFileSize, contents[i - first], tooLarge, error)) {
+                if (!tooLarge) {
+                    r.errorMessage = error;
+                    continue;
+                }
+                r = HashEngine(GetFileOptions(streamOptions, filePaths[i])).Hash(HashSource::FromPath(filePaths[i]), algorithm);
+                if (known) {
+                    StoreInCache(filePaths[i], identity, algorithm, r);
+                }
+                continue;
+            }
+            if (!known) {
+                identity = HashFileIdentity();
+            }
+            small.push_back(i);
+        }
 
-    result.success = true;
-    result.result = BytesToHexString(hashData);
+        if (multiBuffer) {
+            std::vector<Sha256Job> jobs(small.size());
+            for (size_t k = 0; k < small.size(); ++k) {
+                const auto& data = contents[small[k] - first];
+                jobs[k].data = data.data();
+                jobs[k].size = data.size();
+            }
+            Sha256MultiBuffer(jobs.data(), jobs.size());
+            for (size_t k = 0; k < small.size(); ++k) {
+                results[small[k]].result = DigestToHex(jobs[k].digest, sizeof(jobs[k].digest));
+            }
+        } else {
+            HashEngine engine(smallOptions);
+            for (size_t i : small) {
+                const auto& data = contents[i - first];
+                results[i].result = engine.Hash(HashSource::FromMemory(data.data(), data.size()), algorithm).result;
+            }
+        }
 
-    return result;
+        std::chrono::duration<double> diff = std::chrono::high_resolution_clock::now() - start;
+        for (size_t i : small) {
+            results[i].success = true;
+            results[i].calculationTime = diff.count() / static_cast<double>(small.size());
+            if (cached && identities[i - first] != HashFileIdentity()) {
+                StoreInCache(filePaths[i], identities[i - first], algorithm, results[i]);
+            }
+        }
+    });
+    return results;
 }
 
-ALG_ID HashCalculator::GetCryptoAPIAlgId(HashAlgorithm algorithm) {
-    switch (algorithm) {
-        case HashAlgorithm::MD5: return CALG_MD5;
-        case HashAlgorithm::SHA1: return CALG_SHA1;
-        case HashAlgorithm::SHA256: return CALG_SHA_256;
-        default: return CALG_MD5;
-    }
+HashResult HashCalculator::CalculateTextHash(const std::wstring& text, HashAlgorithm algorithm) {
+    return CalculateTextHashes(text, {algorithm}).front();
 }
 
-std::wstring HashCalculator::BytesToHexString(const std::vector<BYTE>& bytes) {
-    std::wstringstream ss;
-    ss << std::hex << std::setfill(L'0');
-    
-    for (BYTE b : bytes) {
-        ss << std::setw(2) << static_cast<unsigned int>(b);
-    }
-    
-    return ss.str();
+std::vector<HashResult> HashCalculator::CalculateTextHashes(const std::wstring& text, const std::vector<HashAlgorithm>& algorithms) {
+    // Hashes the UTF-8 form, converted once straight into its final buffer.
+    std::string utf8 = WStringToUtf8(text);
+    return HashEngine(m_options).Hash(HashSource::FromMemory(utf8.data(), utf8.size()), algorithms);
 }
 
-std::vector<BYTE> HashCalculator::StringToBytes(const std::wstring& str) {
-    std::vector<BYTE> result;
-    
-    // Convert wide string to multi-byte string
-    int size = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    if (size > 0) {
-        std::vector<char> buffer(size);
-        WideCharToMultiByte(CP_UTF8, 0, str.c_str(), -1, buffer.data(), size, nullptr, nullptr);
-        result.assign(buffer.begin(), buffer.end() - 1); // Exclude null terminator
-    }
-    
-    return result;
+HashResult HashCalculator::CalculateBufferHash(const void* data, size_t size, HashAlgorithm algorithm) {
+    return HashEngine(m_options).Hash(HashSource::FromMemory(data, size), algorithm);
 }
 
-std::vector<BYTE> HashCalculator::ReadFileData(const std::wstring& filePath) {
-    std::vector<BYTE> data;
-    
-    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        return data;
-    }
-
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    data.resize(static_cast<size_t>(size));
-    if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
-        data.clear();
+bool HashCalculator::IsHashAlgorithmSupported(HashAlgorithm algorithm) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5:
+        case HashAlgorithm::SHA1:
+        case HashAlgorithm::SHA256:
+        case HashAlgorithm::BLAKE3:
+        case HashAlgorithm::SHA256Tree:
+        case HashAlgorithm::SSDEEP:
+        case HashAlgorithm::TLSH:
+        case HashAlgorithm::XXH3_64:
+        case HashAlgorithm::XXH3_128:
+        case HashAlgorithm::CRC32C:
+            return true;
+        default:
+            return false;
     }
-
-    return data;
 }
 
-HashResult HashCalculator::HashFileStream(const std::wstring& filePath, HashAlgorithm algorithm) {
-    HashResult result;
-    result.algorithm = GetAlgorithmName(algorithm);
-    auto start = std::chrono::high_resolution_clock::now();
-
-    HANDLE hFile = CreateFileW(filePath.c_str(),
-                               GENERIC_READ,
-                               FILE_SHARE_READ | FILE_SHARE_DELETE,
-                               nullptr,
-                               OPEN_EXISTING,
-                               FILE_FLAG_SEQUENTIAL_SCAN,
-                               nullptr);
-    if (hFile == INVALID_HANDLE_VALUE) {
-        result.success = false;
-        result.errorMessage = L"Failed to open file";
-        return result;
-    }
-
-    LARGE_INTEGER li = {};
-    uint64_t totalBytes = 0;
-    if (GetFileSizeEx(hFile, &li)) {
-        totalBytes = static_cast<uint64_t>(li.QuadPart);
-    }
-
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-    if (!CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)) {
-        CloseHandle(hFile);
-        result.success = false;
-        result.errorMessage = L"Failed to acquire cryptographic context";
-        return result;
-    }
-
-    ALG_ID algId = GetCryptoAPIAlgId(algorithm);
-    if (!CryptCreateHash(hProv, algId, 0, 0, &hHash)) {
-        CryptReleaseContext(hProv, 0);
-        CloseHandle(hFile);
-        result.success = false;
-        result.errorMessage = L"Failed to create hash object";
-        return result;
-    }
-
-    const DWORD kBufSize = static_cast<DWORD>(m_chunkSize);
-    std::vector<BYTE> buffer(kBufSize);
-    DWORD bytesRead = 0;
-    BOOL ok = TRUE;
-    uint64_t processed = 0;
-    for (;;) {
-        ok = ReadFile(hFile, buffer.data(), kBufSize, &bytesRead, nullptr);
-        if (!ok) {
-            CryptDestroyHash(hHash);
-            CryptReleaseContext(hProv, 0);
-            CloseHandle(hFile);
-            result.success = false;
-            result.errorMessage = L"Failed to read file";
-            return result;
-        }
-        if (bytesRead == 0) {
-            break;
-        }
-        processed += bytesRead;
-        if (m_cancel && m_cancel->load()) {
-            CryptDestroyHash(hHash);
-            CryptReleaseContext(hProv, 0);
-            CloseHandle(hFile);
-            result.success = false;
-            result.errorMessage = L"Cancelled";
-            return result;
-        }
-        if (!CryptHashData(hHash, buffer.data(), bytesRead, 0)) {
-            CryptDestroyHash(hHash);
-            CryptReleaseContext(hProv, 0);
-            CloseHandle(hFile);
-            result.success = false;
-            result.errorMessage = L"Failed to hash data";
-            return result;
-        }
-        if (m_progress) {
-            m_progress(totalBytes, processed);
-        }
-    }
-
-    DWORD hashLen = 0;
-    DWORD dataLen = sizeof(DWORD);
-    if (!CryptGetHashParam(hHash, HP_HASHSIZE, reinterpret_cast<BYTE*>(&hashLen), &dataLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        CloseHandle(hFile);
-        result.success = false;
-        result.errorMessage = L"Failed to get hash size";
-        return result;
-    }
-    std::vector<BYTE> hashData(hashLen);
-    if (!CryptGetHashParam(hHash, HP_HASHVAL, hashData.data(), &hashLen, 0)) {
-        CryptDestroyHash(hHash);
-        CryptReleaseContext(hProv, 0);
-        CloseHandle(hFile);
-        result.success = false;
-        result.errorMessage = L"Failed to get hash value";
-        return result;
-    }
-
-    CryptDestroyHash(hHash);
-    CryptReleaseContext(hProv, 0);
-    CloseHandle(hFile);
+std::wstring HashCalculator::GetAlgorithmName(HashAlgorithm algorithm) {
+    return GetHashAlgorithmName(algorithm);
+}
 
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = end - start;
-    result.calculationTime = diff.count();
-    result.success = true;
-    result.result = BytesToHexString(hashData);
-    return result;
+void HashCalculator::ClearResults() {
+    m_lastResults.clear();
 }
+
 // Test function
 void TestHashCalculation() {
     std::wcout << L"=== Hash Calculation Test ===" << std::endl;
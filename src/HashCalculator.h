@@ -1,63 +1,78 @@
 #pragma once
 
 #include <windows.h>
-#include <wincrypt.h>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <functional>
 #include <atomic>
 
-#pragma comment(lib, "advapi32.lib")
-
-enum class HashAlgorithm {
-    MD5,
-    SHA1,
-    SHA256
-};
-
-struct HashResult {
-    bool success;
-    std::wstring result;
-    std::wstring algorithm;
-    double calculationTime;
-    std::wstring errorMessage;
-};
+#include "HashAlgorithm.h"
+#include "HashCache.h"
+#include "HashEngine.h"
 
+// Front end of HashEngine with the settings most callers need; every method
+// hashes through the engine.
 class HashCalculator {
 public:
     HashCalculator();
     ~HashCalculator();
 
     void SetChunkSize(size_t bytes);
+    // Called with (processed, total) after every chunk.
     void SetProgressCallback(std::function<void(uint64_t, uint64_t)> cb);
     void SetCancelFlag(std::atomic<bool>* flag);
+    // When several digests are requested, update them on separate threads
+    // while the next chunk is being read. The file is read once either way.
+    void SetParallelDigests(bool enabled);
+    // How files are read (sync by default); see HashIoPolicy.
+    void SetIoPolicy(HashIoPolicy policy);
+    // What reading files leaves in the page cache (cached by default); see
+    // PageCachePolicy.
+    void SetCachePolicy(PageCachePolicy policy);
+    // Streamed files keep a checkpoint next to them ("<file>.peinfo-hashstate",
+    // every intervalBytes, 0 = 256 MiB) and resume from it after a cancel or
+    // a crash; see HashCheckpoint.h. Off by default.
+    void SetResumable(bool enabled, uint64_t intervalBytes = 0);
+    // File digests are looked up here before the file is read, and stored
+    // once computed if the file did not change meanwhile. Not owned; nullptr
+    // (the default) turns the cache off.
+    void SetCache(HashCache* cache);
 
     // File hashing
     HashResult CalculateFileHash(const std::wstring& filePath, HashAlgorithm algorithm);
     std::vector<HashResult> CalculateFileHashes(const std::wstring& filePath, const std::vector<HashAlgorithm>& algorithms);
+
+    // Many-file hashing. Files up to maxSmallFileSize are read whole, in groups,
+    // on threadCount threads (0 = hardware concurrency); SHA256 groups use the
+    // multi-buffer code where it beats the single-stream one. Larger files go
+    // through the streaming path. Results are in input order; each small-file
+    // calculationTime is its share of the group time. No progress callbacks.
+    void SetBatchOptions(size_t maxSmallFileSize, size_t threadCount);
+    std::vector<HashResult> CalculateFileHashBatch(const std::vector<std::wstring>& filePaths, HashAlgorithm algorithm);
     
     // Text hashing
     HashResult CalculateTextHash(const std::wstring& text, HashAlgorithm algorithm);
     std::vector<HashResult> CalculateTextHashes(const std::wstring& text, const std::vector<HashAlgorithm>& algorithms);
 
+    // In-memory hashing
+    HashResult CalculateBufferHash(const void* data, size_t size, HashAlgorithm algorithm);
+
     // Utility functions
     bool IsHashAlgorithmSupported(HashAlgorithm algorithm);
     std::wstring GetAlgorithmName(HashAlgorithm algorithm);
     void ClearResults();
 
 private:
-    // Core hashing function
-    HashResult PerformHash(const std::vector<BYTE>& data, HashAlgorithm algorithm);
-    ALG_ID GetCryptoAPIAlgId(HashAlgorithm algorithm);
-    std::wstring BytesToHexString(const std::vector<BYTE>& bytes);
-    std::vector<BYTE> StringToBytes(const std::wstring& str);
-    std::vector<BYTE> ReadFileData(const std::wstring& filePath);
-    HashResult HashFileStream(const std::wstring& filePath, HashAlgorithm algorithm);
+    HashEngineOptions GetFileOptions(const HashEngineOptions& base, const std::wstring& filePath) const;
+    void StoreInCache(const std::wstring& filePath, const HashFileIdentity& before, HashAlgorithm algorithm, const HashResult& result);
 
 private:
     std::vector<HashResult> m_lastResults;
-    size_t m_chunkSize = (1u << 20);
-    std::function<void(uint64_t, uint64_t)> m_progress;
-    std::atomic<bool>* m_cancel = nullptr;
+    HashEngineOptions m_options;
+    size_t m_batchMaxFileSize = (1u << 20);
+    size_t m_batchThreads = 0;
+    bool m_resumable = false;
+    uint64_t m_checkpointInterval = 0;
+    HashCache* m_cache = nullptr;
 };
@@ -0,0 +1,314 @@
+#include "HashCheckpoint.h"
+
+#include "Digest.h"
+#include "HashState.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'P', 'E', 'I', 'H', 'C', 'K', 'P', 'T'};
+const uint32_t kVersion = 2;
+// Far above any real checkpoint (the SHA256-TREE leaf list of a 1 TiB file is
+// 32 MiB); guards the allocation against a damaged size field.
+const uint64_t kMaxFileSize = 256ull << 20;
+
+std::vector<uint8_t> Sha256Of(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> out(32);
+    Digest digest(HashAlgorithm::SHA256);
+    digest.Update(data, size);
+    digest.Final(out.data());
+    return out;
+}
+
+bool WriteWholeFile(const std::wstring& path, const std::vector<uint8_t>& data) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) && written == data.size() &&
+              FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = open(ToNativePath(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    bool ok = done == data.size() && fsync(fd) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+bool ReplaceWithFile(const std::wstring& from, const std::wstring& to) {
+#if defined(_WIN32)
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(ToNativePath(from).c_str(), ToNativePath(to).c_str()) == 0;
+#endif
+}
+
+void RemoveFile(const std::wstring& path) {
+#if defined(_WIN32)
+    DeleteFileW(path.c_str());
+#else
+    unlink(ToNativePath(path).c_str());
+#endif
+}
+
+bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>& out) {
+    out.clear();
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    bool ok = GetFileSizeEx(file, &size) && static_cast<uint64_t>(size.QuadPart) <= kMaxFileSize;
+    if (ok) {
+        out.resize(static_cast<size_t>(size.QuadPart));
+        DWORD got = 0;
+        ok = out.empty() || (ReadFile(file, out.data(), static_cast<DWORD>(out.size()), &got, nullptr) && got == out.size());
+    }
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) <= kMaxFileSize;
+    if (ok) {
+        out.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < out.size()) {
+            ssize_t n = read(fd, out.data() + done, out.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        ok = done == out.size();
+    }
+    close(fd);
+    return ok;
+#endif
+}
+
+} // namespace
+
+std::wstring GetHashCheckpointPath(const std::wstring& filePath) {
+    return filePath + L".peinfo-hashstate";
+}
+
+bool WriteHashCheckpoint(const std::wstring& path, const HashCheckpoint& checkpoint, std::wstring& error) {
+    if (checkpoint.algorithms.size() != checkpoint.states.size()) {
+        error = L"Checkpoint has a state count different from its algorithm count";
+        return false;
+    }
+    std::vector<uint8_t> data;
+    HashStateWriter out(data);
+    out.Bytes(kMagic, sizeof(kMagic));
+    out.U32(kVersion);
+    out.U64(checkpoint.identity.size);
+    out.U64(checkpoint.identity.modifiedTime);
+    out.U64(checkpoint.identity.changeTime);
+    out.U64(checkpoint.identity.device);
+    out.U64(checkpoint.identity.fileId);
+    out.U64(checkpoint.offset);
+    out.U32(static_cast<uint32_t>(checkpoint.algorithms.size()));
+    for (size_t i = 0; i < checkpoint.algorithms.size(); ++i) {
+        out.U8(static_cast<uint8_t>(checkpoint.algorithms[i]));
+        out.Blob(checkpoint.states[i]);
+    }
+    std::vector<uint8_t> trailer = Sha256Of(data.data(), data.size());
+    out.Bytes(trailer.data(), trailer.size());
+
+    const std::wstring temp = path + L".tmp";
+    if (!WriteWholeFile(temp, data)) {
+        RemoveFile(temp);
+        error = L"Failed to write checkpoint";
+        return false;
+    }
+    if (!ReplaceWithFile(temp, path)) {
+        RemoveFile(temp);
+        error = L"Failed to replace checkpoint";
+        return false;
+    }
+    return true;
+}
+
+bool ReadHashCheckpoint(const std::wstring& path, HashCheckpoint& checkpoint, std::wstring& error) {
+    checkpoint = HashCheckpoint();
+    std::vector<uint8_t> data;
+    if (!ReadWholeFile(path, data)) {
+        error = L"Failed to read checkpoint";
+        return false;
+    }
+    if (data.size() < sizeof(kMagic) + 32 || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        error = L"Not a hash checkpoint";
+        return false;
+    }
+    const size_t body = data.size() - 32;
+    if (Sha256Of(data.data(), body) != std::vector<uint8_t>(data.begin() + body, data.end())) {
+        error = L"Checkpoint is damaged";
+        return false;
+    }
+    HashStateReader in(data.data() + sizeof(kMagic), body - sizeof(kMagic));
+    if (in.U32() != kVersion) {
+        error = L"Checkpoint is from another version";
+        return false;
+    }
+    checkpoint.identity.size = in.U64();
+    checkpoint.identity.modifiedTime = in.U64();
+    checkpoint.identity.changeTime = in.U64();
+    checkpoint.identity.device = in.U64();
+    checkpoint.identity.fileId = in.U64();
+    checkpoint.offset = in.U64();
+    uint32_t count = in.U32();
+    for (uint32_t i = 0; i < count && in.Ok(); ++i) {
+        checkpoint.algorithms.push_back(static_cast<HashAlgorithm>(in.U8()));
+        checkpoint.states.emplace_back();
+        in.Blob(checkpoint.states.back(), static_cast<size_t>(kMaxFileSize));
+    }
+    if (!in.Ok() || !in.AtEnd() || checkpoint.offset > checkpoint.identity.size) {
+        checkpoint = HashCheckpoint();
+        error = L"Checkpoint is malformed";
+        return false;
+    }
+    return true;
+}
+
+void DeleteHashCheckpoint(const std::wstring& path) {
+    RemoveFile(path);
+}
+
+bool RunHashCheckpointSelfTest(std::wstring& error) {
+    std::vector<uint8_t> data((3u << 20) + 12345);
+    uint32_t x = 0x7F4A7C15;
+    for (auto& b : data) {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    const HashAlgorithm all[] = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256, HashAlgorithm::BLAKE3,
+                                 HashAlgorithm::SHA256Tree, HashAlgorithm::SSDEEP, HashAlgorithm::TLSH,
+                                 HashAlgorithm::XXH3_64, HashAlgorithm::XXH3_128, HashAlgorithm::CRC32C};
+    // Split points inside a block, a BLAKE3 chunk and a tree leaf, and past
+    // one tree leaf.
+    const size_t splits[] = {0, 1, 63, 1025, (1u << 20), (1u << 20) + 77, (2u << 20) + 4096};
+    std::vector<HashAlgorithm> algorithms(std::begin(all), std::end(all));
+    for (HashAlgorithm algorithm : all) {
+        Digest whole(algorithm);
+        whole.Update(data.data(), data.size());
+        const std::wstring expected = whole.FinalText();
+        for (size_t split : splits) {
+            Digest first(algorithm);
+            first.Update(data.data(), split);
+            std::vector<uint8_t> state = first.SaveState();
+            // Saving must leave the context usable.
+            first.Update(data.data() + split, data.size() - split);
+            Digest second(algorithm);
+            if (!second.LoadState(state)) {
+                error = L"Digest state does not load: " + GetHashAlgorithmName(algorithm);
+                return false;
+            }
+            second.Update(data.data() + split, data.size() - split);
+            if (second.FinalText() != expected || first.FinalText() != expected) {
+                error = L"Resumed digest differs from the one-pass digest: " + GetHashAlgorithmName(algorithm);
+                return false;
+            }
+        }
+        Digest other(algorithm == HashAlgorithm::MD5 ? HashAlgorithm::SHA1 : HashAlgorithm::MD5);
+        if (other.LoadState(Digest(algorithm).SaveState())) {
+            error = L"Digest state loads into another algorithm";
+            return false;
+        }
+    }
+
+    // A hash cancelled part way leaves a checkpoint, and the next run resumes
+    // from it.
+    const std::wstring path = GetSelfTestTempPath(L"peinfo-hashcheckpoint-");
+    const std::wstring sidecar = GetHashCheckpointPath(path);
+    if (!WriteWholeFile(path, data)) {
+        error = L"Cannot write the checkpoint test file";
+        return false;
+    }
+    std::vector<HashResult> expected = HashEngine().Hash(HashSource::FromMemory(data.data(), data.size()), algorithms);
+    std::atomic<bool> cancel(false);
+    HashEngineOptions options;
+    options.chunkSize = 256u << 10;
+    options.checkpointPath = sidecar;
+    options.checkpointInterval = 1u << 20;
+    options.cancel = &cancel;
+    options.progress = [&](uint64_t processed, uint64_t) {
+        if (processed >= (2u << 20) + (512u << 10)) {
+            cancel = true;
+        }
+    };
+    bool ok = true;
+    std::vector<HashResult> cancelled = HashEngine(options).Hash(HashSource::FromPath(path), algorithms);
+    HashCheckpoint checkpoint;
+    std::wstring readError;
+    if (cancelled.front().success || !ReadHashCheckpoint(sidecar, checkpoint, readError) || checkpoint.offset == 0) {
+        error = L"Cancelled hash left no checkpoint";
+        ok = false;
+    }
+    if (ok) {
+        cancel = false;
+        uint64_t firstOffset = 0;
+        options.progress = [&](uint64_t processed, uint64_t) {
+            if (firstOffset == 0) {
+                firstOffset = processed;
+            }
+        };
+        std::vector<HashResult> resumed = HashEngine(options).Hash(HashSource::FromPath(path), algorithms);
+        for (size_t i = 0; i < resumed.size() && ok; ++i) {
+            if (!resumed[i].success || resumed[i].result != expected[i].result) {
+                error = L"Resumed file hash differs: " + resumed[i].algorithm;
+                ok = false;
+            }
+        }
+        if (ok && firstOffset <= checkpoint.offset) {
+            error = L"File hash did not resume from the checkpoint";
+            ok = false;
+        }
+        HashCheckpoint left;
+        if (ok && ReadHashCheckpoint(sidecar, left, readError)) {
+            error = L"Checkpoint left behind after the hash completed";
+            ok = false;
+        }
+    }
+    RemoveFile(sidecar);
+    RemoveFile(path);
+    return ok;
+}
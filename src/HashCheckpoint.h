@@ -0,0 +1,40 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Checkpoints of a file hash in progress, so that hashing a very large file
+// can resume after a cancel or a crash instead of starting over. HashEngine
+// writes them (see HashEngineOptions::checkpointPath) to a small sidecar file:
+// the offset reached, each digest's serialized context (Digest::SaveState),
+// and the identity of the file, which must still match for the checkpoint to
+// be used. Builds without Windows headers.
+
+struct HashCheckpoint {
+    HashFileIdentity identity;
+    // Bytes of the file already fed to the digests.
+    uint64_t offset = 0;
+    std::vector<HashAlgorithm> algorithms;
+    // Digest::SaveState of each algorithm, in the same order.
+    std::vector<std::vector<uint8_t>> states;
+};
+
+// The sidecar next to the file: "<file>.peinfo-hashstate".
+std::wstring GetHashCheckpointPath(const std::wstring& filePath);
+
+// Replaces the file atomically (a temporary file renamed over it), so a crash
+// while writing leaves the previous checkpoint.
+bool WriteHashCheckpoint(const std::wstring& path, const HashCheckpoint& checkpoint, std::wstring& error);
+// Fails for a missing file and for one that is truncated, corrupted (its
+// SHA-256 trailer does not match) or from another format version.
+bool ReadHashCheckpoint(const std::wstring& path, HashCheckpoint& checkpoint, std::wstring& error);
+void DeleteHashCheckpoint(const std::wstring& path);
+
+// Every algorithm saved part way, restored, and finished against the one-pass
+// digest; then a file hash cancelled and resumed through the engine; error
+// describes the first failure.
+bool RunHashCheckpointSelfTest(std::wstring& error);
@@ -0,0 +1,862 @@
+#include "HashEngine.h"
+
+#include "Digest.h"
+#include "HashCheckpoint.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kDefaultChunk = 1u << 20;
+const size_t kPageSize = 4096;
+const size_t kSlots = 3;
+
+#if defined(_WIN32)
+const NativeFileHandle kNoFile = INVALID_HANDLE_VALUE;
+#else
+const NativeFileHandle kNoFile = -1;
+#endif
+
+// Reads one byte per page so that the faults of a mapped view happen here,
+// where an I/O error can be caught, rather than inside a digest. No objects
+// with destructors in this frame: __try does not allow unwinding.
+#if defined(_WIN32)
+bool TouchPages(const uint8_t* data, size_t size) {
+    __try {
+        volatile uint8_t sink = 0;
+        for (size_t offset = 0; offset < size; offset += kPageSize) {
+            sink ^= data[offset];
+        }
+        if (size != 0) {
+            sink ^= data[size - 1];
+        }
+        return true;
+    } __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return false;
+    }
+}
+#else
+bool TouchPages(const uint8_t*, size_t) {
+    return true;
+}
+#endif
+
+// Sorts and merges skip ranges so that UpdateSkipping can walk them once.
+std::vector<HashSkipRange> NormalizeSkipRanges(std::vector<HashSkipRange> skip) {
+    std::sort(skip.begin(), skip.end(), [](const HashSkipRange& a, const HashSkipRange& b) { return a.offset < b.offset; });
+    std::vector<HashSkipRange> merged;
+    for (const auto& r : skip) {
+        if (r.size == 0) {
+            continue;
+        }
+        if (!merged.empty() && r.offset <= merged.back().offset + merged.back().size) {
+            uint64_t end = std::max<uint64_t>(merged.back().offset + merged.back().size, r.offset + r.size);
+            merged.back().size = end - merged.back().offset;
+        } else {
+            merged.push_back(r);
+        }
+    }
+    return merged;
+}
+
+// Updates the digest with the parts of [offset, offset + size) outside the
+// (normalized) skip ranges.
+void UpdateSkipping(Digest& digest, const std::vector<HashSkipRange>& skip, uint64_t offset, const uint8_t* data, size_t size) {
+    const uint64_t end = offset + size;
+    uint64_t pos = offset;
+    for (const auto& r : skip) {
+        if (r.offset >= end) {
+            break;
+        }
+        if (r.offset + r.size <= pos) {
+            continue;
+        }
+        if (r.offset > pos) {
+            digest.Update(data + (pos - offset), static_cast<size_t>(r.offset - pos));
+        }
+        pos = std::min<uint64_t>(r.offset + r.size, end);
+    }
+    if (pos < end) {
+        digest.Update(data + (pos - offset), static_cast<size_t>(end - pos));
+    }
+}
+
+// Feeds every requested digest and sink. With more than one of them and
+// threading on, each gets a worker thread and chunks are handed over through a ring
+// of slots, so the digests run concurrently with each other and with the next
+// read. A zero-sized slot is the end-of-stream marker for the workers.
+class DigestFan {
+public:
+    DigestFan(const std::vector<HashRequest>& requests, const std::vector<HashSink*>& sinks, size_t digestThreads, bool threaded)
+        : m_sinks(sinks), m_threaded(threaded && requests.size() + sinks.size() > 1), m_slots(kSlots) {
+        m_digests.reserve(requests.size());
+        for (const auto& request : requests) {
+            m_digests.emplace_back(request.algorithm);
+            m_digests.back().SetThreadCount(digestThreads);
+            m_skip.push_back(NormalizeSkipRanges(request.skip));
+        }
+        if (m_threaded) {
+            m_threads.reserve(Lanes());
+            for (size_t d = 0; d < Lanes(); ++d) {
+                m_threads.emplace_back(&DigestFan::Worker, this, d);
+            }
+        }
+    }
+
+    ~DigestFan() {
+        Drain();
+    }
+
+    // Buffer of at least minBytes for the next chunk; Commit hands it over.
+    uint8_t* Buffer(size_t minBytes) {
+        Slot& slot = m_threaded ? WaitFreeSlot() : m_slots[0];
+        if (!slot.storage.Resize(minBytes)) {
+            throw std::bad_alloc();
+        }
+        return slot.storage.Data();
+    }
+
+    void Commit(size_t size) {
+        Slot& slot = m_slots[m_threaded ? m_seq % kSlots : 0];
+        Feed(slot, slot.storage.Data(), size);
+    }
+
+    // For data that stays valid until Drain or Finish; never copied.
+    void FeedStable(const uint8_t* data, size_t size) {
+        Feed(m_threaded ? WaitFreeSlot() : m_slots[0], data, size);
+    }
+
+    // For data that is only valid during the call; copied into a slot first
+    // when the digests run on their own threads.
+    void FeedTransient(const uint8_t* data, size_t size) {
+        if (!m_threaded) {
+            Feed(m_slots[0], data, size);
+            return;
+        }
+        std::memcpy(Buffer(size), data, size);
+        Commit(size);
+    }
+
+    // Waits for the workers to consume everything fed so far and ends them;
+    // later chunks are hashed on the calling thread.
+    void Drain() {
+        if (m_threads.empty()) {
+            return;
+        }
+        Publish(WaitFreeSlot(), nullptr, 0);
+        for (auto& th : m_threads) {
+            th.join();
+        }
+        m_threads.clear();
+        m_threaded = false;
+    }
+
+    // Contexts of the digests after everything fed so far, for a checkpoint.
+    std::vector<std::vector<uint8_t>> SaveStates() {
+        WaitIdle();
+        std::vector<std::vector<uint8_t>> states;
+        states.reserve(m_digests.size());
+        for (auto& digest : m_digests) {
+            states.push_back(digest.SaveState());
+        }
+        return states;
+    }
+
+    // Before anything is fed: continues from a checkpoint at offset.
+    bool LoadStates(const std::vector<std::vector<uint8_t>>& states, uint64_t offset) {
+        if (states.size() != m_digests.size()) {
+            return false;
+        }
+        for (size_t d = 0; d < m_digests.size(); ++d) {
+            if (!m_digests[d].LoadState(states[d])) {
+                for (auto& digest : m_digests) {
+                    digest.Reset();
+                }
+                return false;
+            }
+        }
+        m_offset = offset;
+        return true;
+    }
+
+    uint64_t Offset() const {
+        return m_offset;
+    }
+
+    std::vector<std::wstring> Finish() {
+        Drain();
+        std::vector<std::wstring> hex;
+        hex.reserve(m_digests.size());
+        for (auto& digest : m_digests) {
+            hex.push_back(digest.FinalText());
+        }
+        return hex;
+    }
+
+private:
+    struct Slot {
+        // Page-aligned for unbuffered reads.
+        AlignedBuffer storage;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint64_t offset = 0;
+        uint64_t seq = UINT64_MAX;
+        size_t pending = 0;
+    };
+
+    // Until the workers have consumed every slot; they then wait for the next
+    // one without touching the digests.
+    void WaitIdle() {
+        if (!m_threaded) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            for (const auto& slot : m_slots) {
+                if (slot.pending != 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    Slot& WaitFreeSlot() {
+        Slot& slot = m_slots[m_seq % kSlots];
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return slot.pending == 0; });
+        return slot;
+    }
+
+    void Feed(Slot& slot, const uint8_t* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (!m_threaded) {
+            for (size_t d = 0; d < Lanes(); ++d) {
+                UpdateLane(d, m_offset, data, size);
+            }
+        } else {
+            Publish(slot, data, size);
+        }
+        m_offset += size;
+    }
+
+    // Digests first, then sinks.
+    size_t Lanes() const {
+        return m_digests.size() + m_sinks.size();
+    }
+
+    void UpdateLane(size_t d, uint64_t offset, const uint8_t* data, size_t size) {
+        if (d >= m_digests.size()) {
+            m_sinks[d - m_digests.size()]->Update(offset, data, size);
+        } else if (m_skip[d].empty()) {
+            m_digests[d].Update(data, size);
+        } else {
+            UpdateSkipping(m_digests[d], m_skip[d], offset, data, size);
+        }
+    }
+
+    void Publish(Slot& slot, const uint8_t* data, size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.data = data;
+            slot.size = size;
+            slot.offset = m_offset;
+            slot.pending = Lanes();
+            slot.seq = m_seq++;
+        }
+        m_cv.notify_all();
+    }
+
+    void Worker(size_t d) {
+        for (uint64_t seq = 0;; ++seq) {
+            Slot& slot = m_slots[seq % kSlots];
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            uint64_t offset = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]() { return slot.seq == seq; });
+                data = slot.data;
+                size = slot.size;
+                offset = slot.offset;
+            }
+            if (size != 0) {
+                UpdateLane(d, offset, data, size);
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --slot.pending;
+            }
+            m_cv.notify_all();
+            if (size == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<Digest> m_digests;
+    std::vector<std::vector<HashSkipRange>> m_skip;
+    std::vector<HashSink*> m_sinks;
+    bool m_threaded;
+    // Source offset of the next byte fed.
+    uint64_t m_offset = 0;
+    std::vector<Slot> m_slots;
+    uint64_t m_seq = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_threads;
+};
+
+// State of one Hash call.
+struct HashRun {
+    HashRun(const HashEngineOptions& opts, const std::vector<HashRequest>& reqs, const std::vector<HashSink*>& sinkList, size_t chunk)
+        : options(opts), requests(reqs), sinks(sinkList), chunkSize(chunk) {}
+
+    const HashEngineOptions& options;
+    const std::vector<HashRequest>& requests;
+    const std::vector<HashSink*>& sinks;
+    size_t chunkSize;
+    uint64_t total = 0;
+    uint64_t processed = 0;
+    std::unique_ptr<DigestFan> fan;
+    std::wstring error;
+    // Set by StartCheckpointing; checkpoint holds this run's file identity
+    // and algorithms.
+    bool checkpointing = false;
+    HashCheckpoint checkpoint;
+    uint64_t nextCheckpoint = 0;
+
+    // Worker threads only pay off when there is more than a couple of chunks
+    // to overlap; total == 0 means the size is not known up front.
+    void Start(uint64_t totalBytes) {
+        total = totalBytes;
+        bool threaded = options.parallelDigests && (total == 0 || total > 2ull * chunkSize);
+        fan.reset(new DigestFan(requests, sinks, options.digestThreads, threaded));
+    }
+
+    bool Cancelled() {
+        if (options.cancel && options.cancel->load()) {
+            error = L"Cancelled";
+            return true;
+        }
+        return false;
+    }
+
+    void Advance(size_t bytes) {
+        processed += bytes;
+        if (options.progress) {
+            options.progress(processed, total);
+        }
+        if (checkpointing && fan->Offset() >= nextCheckpoint) {
+            SaveCheckpoint();
+        }
+    }
+
+    uint64_t CheckpointInterval() const {
+        return options.checkpointInterval != 0 ? options.checkpointInterval : (256ull << 20);
+    }
+
+    // After Start: resumes from the checkpoint of this file and these
+    // algorithms if there is one, and returns the offset to read from.
+    uint64_t StartCheckpointing(NativeFileHandle file) {
+        if (options.checkpointPath.empty() || requests.empty() || !sinks.empty()) {
+            return 0;
+        }
+        for (const auto& request : requests) {
+            if (!request.skip.empty()) {
+                return 0;
+            }
+            checkpoint.algorithms.push_back(request.algorithm);
+        }
+        if (!GetHashFileIdentity(file, checkpoint.identity)) {
+            return 0;
+        }
+        checkpointing = true;
+        uint64_t offset = 0;
+        HashCheckpoint saved;
+        std::wstring ignored;
+        if (ReadHashCheckpoint(options.checkpointPath, saved, ignored) && saved.identity == checkpoint.identity &&
+            saved.algorithms == checkpoint.algorithms && fan->LoadStates(saved.states, saved.offset)) {
+            offset = saved.offset;
+            processed = offset;
+        }
+        nextCheckpoint = offset + CheckpointInterval();
+        return offset;
+    }
+
+    void SaveCheckpoint() {
+        checkpoint.offset = fan->Offset();
+        checkpoint.states = fan->SaveStates();
+        // Failing to write only costs the resume.
+        std::wstring ignored;
+        WriteHashCheckpoint(options.checkpointPath, checkpoint, ignored);
+        nextCheckpoint = checkpoint.offset + CheckpointInterval();
+    }
+
+    // A completed hash has no use for its checkpoint; an interrupted one
+    // saves where it got to.
+    void FinishCheckpointing(bool completed) {
+        if (!checkpointing) {
+            return;
+        }
+        if (completed) {
+            DeleteHashCheckpoint(options.checkpointPath);
+        } else if (fan->Offset() != 0) {
+            SaveCheckpoint();
+        }
+    }
+};
+
+// consumed, when given, is told how much of data the digests are done with.
+bool HashSpan(HashRun& run, const uint8_t* data, size_t size, bool mapped, const std::function<void(size_t)>& consumed = nullptr) {
+    // A slot is only reused once every digest is done with it, so a chunk fed
+    // kSlots chunks ago is no longer read.
+    const size_t lag = kSlots * run.chunkSize;
+    for (size_t offset = 0; offset < size;) {
+        size_t bytes = std::min<size_t>(run.chunkSize, size - offset);
+        if (run.Cancelled()) {
+            return false;
+        }
+        if (mapped && !TouchPages(data + offset, bytes)) {
+            run.error = L"Failed to read file";
+            return false;
+        }
+        run.fan->FeedStable(data + offset, bytes);
+        offset += bytes;
+        if (consumed && offset > lag) {
+            consumed(offset - lag);
+        }
+        run.Advance(bytes);
+    }
+    return true;
+}
+
+bool HashStream(HashRun& run, const HashSource::ReadFn& read) {
+    for (;;) {
+        uint8_t* buffer = run.fan->Buffer(run.chunkSize);
+        size_t bytesRead = 0;
+        if (!read(buffer, run.chunkSize, bytesRead)) {
+            run.error = L"Failed to read file";
+            return false;
+        }
+        if (bytesRead == 0) {
+            return true;
+        }
+        if (run.Cancelled()) {
+            return false;
+        }
+        run.fan->Commit(bytesRead);
+        run.Advance(bytesRead);
+    }
+}
+
+NativeFileHandle OpenForHash(const std::wstring& path) {
+#if defined(_WIN32)
+    return CreateFileW(path.c_str(),
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       nullptr,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return fd;
+#endif
+}
+
+void CloseForHash(NativeFileHandle file) {
+#if defined(_WIN32)
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+// Maps the whole file read-only. Fails for empty files and files larger than
+// the address space, which the caller then reads instead.
+const uint8_t* MapForHash(NativeFileHandle file, uint64_t size) {
+    if (size == 0 || size > SIZE_MAX) {
+        return nullptr;
+    }
+#if defined(_WIN32)
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    // The view keeps the mapping object alive.
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return static_cast<const uint8_t*>(view);
+#else
+    void* view = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(view);
+#endif
+}
+
+void UnmapForHash(const uint8_t* view, uint64_t size) {
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap(const_cast<uint8_t*>(view), static_cast<size_t>(size));
+#endif
+}
+
+bool HashFile(HashRun& run, PageCacheFile& file, HashIoPolicy policy) {
+    uint64_t size = 0;
+    bool sizeKnown = file.GetSize(size);
+    run.Start(size);
+    uint64_t offset = run.StartCheckpointing(file.GetHandle());
+    bool ok = false;
+    const uint8_t* view = nullptr;
+    if (policy == HashIoPolicy::Mapped && sizeKnown) {
+        view = MapForHash(file.GetHandle(), size);
+    }
+    if (view != nullptr) {
+        offset = std::min<uint64_t>(offset, size);
+        file.AdviseMapped(view, size);
+        uint64_t released = offset;
+        auto release = [&](uint64_t to) {
+            if (to > released) {
+                file.ReleaseMapped(view, released, to - released);
+                released = to;
+            }
+        };
+        ok = HashSpan(run, view + offset, static_cast<size_t>(size - offset), true, [&](size_t done) { release(offset + done); });
+        run.fan->Drain();
+        release(size);
+        UnmapForHash(view, size);
+    } else {
+        ok = HashStream(run, [&](uint8_t* buffer, size_t capacity, size_t& bytesRead) {
+            if (!file.ReadAt(offset, buffer, capacity, bytesRead)) {
+                return false;
+            }
+            offset += bytesRead;
+            return true;
+        });
+    }
+    run.FinishCheckpointing(ok);
+    return ok;
+}
+
+} // namespace
+
+bool GetHashFileIdentity(NativeFileHandle file, HashFileIdentity& out) {
+    out = HashFileIdentity();
+#if defined(_WIN32)
+    BY_HANDLE_FILE_INFORMATION info = {};
+    FILE_BASIC_INFO basic = {};
+    if (!GetFileInformationByHandle(file, &info) || !GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof(basic))) {
+        return false;
+    }
+    out.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    out.modifiedTime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+    out.changeTime = static_cast<uint64_t>(basic.ChangeTime.QuadPart);
+    out.device = info.dwVolumeSerialNumber;
+    out.fileId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+#else
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        return false;
+    }
+    out.size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+    out.modifiedTime = static_cast<uint64_t>(st.st_mtimespec.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+    out.changeTime = static_cast<uint64_t>(st.st_ctimespec.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_ctimespec.tv_nsec);
+#else
+    out.modifiedTime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    out.changeTime = static_cast<uint64_t>(st.st_ctim.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_ctim.tv_nsec);
+#endif
+    out.device = static_cast<uint64_t>(st.st_dev);
+    out.fileId = static_cast<uint64_t>(st.st_ino);
+#endif
+    return true;
+}
+
+std::wstring GetSelfTestTempPath(const wchar_t* prefix) {
+#if defined(_WIN32)
+    wchar_t dir[MAX_PATH + 1] = {};
+    DWORD len = GetTempPathW(MAX_PATH + 1, dir);
+    std::wstring path = (len != 0 && len <= MAX_PATH) ? std::wstring(dir, len) : std::wstring(L".\\");
+    return path + prefix + std::to_wstring(GetCurrentProcessId());
+#else
+    const char* dir = std::getenv("TMPDIR");
+    std::string base = (dir != nullptr && *dir != '\0') ? dir : "/tmp";
+    std::wstring path(base.begin(), base.end());
+    return path + L"/" + prefix + std::to_wstring(getpid());
+#endif
+}
+
+bool GetHashFileIdentity(const std::wstring& path, HashFileIdentity& out) {
+    NativeFileHandle file = OpenForHash(path);
+    if (file == kNoFile) {
+        return false;
+    }
+    bool ok = GetHashFileIdentity(file, out);
+    CloseForHash(file);
+    return ok;
+}
+
+std::wstring GetHashAlgorithmName(HashAlgorithm algorithm) {
+    std::string name = GetDigestAlgorithmName(algorithm);
+    return std::wstring(name.begin(), name.end());
+}
+
+bool ParseHashAlgorithmName(const std::wstring& name, HashAlgorithm& out) {
+    auto normalize = [](const std::wstring& s) {
+        std::wstring key;
+        for (wchar_t ch : s) {
+            if (ch != L'-' && ch != L'_') {
+                key.push_back(static_cast<wchar_t>(towupper(ch)));
+            }
+        }
+        return key;
+    };
+    const std::wstring key = normalize(name);
+    const HashAlgorithm all[] = {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256,
+                                 HashAlgorithm::BLAKE3, HashAlgorithm::SHA256Tree,
+                                 HashAlgorithm::SSDEEP, HashAlgorithm::TLSH,
+                                 HashAlgorithm::XXH3_64, HashAlgorithm::XXH3_128, HashAlgorithm::CRC32C};
+    for (HashAlgorithm algorithm : all) {
+        if (normalize(GetHashAlgorithmName(algorithm)) == key) {
+            out = algorithm;
+            return true;
+        }
+    }
+    // The tags xxhsum writes.
+    if (key == L"XXH3") {
+        out = HashAlgorithm::XXH3_64;
+        return true;
+    }
+    if (key == L"XXH128") {
+        out = HashAlgorithm::XXH3_128;
+        return true;
+    }
+    return false;
+}
+
+HashSource HashSource::FromPath(const std::wstring& path) {
+    HashSource source;
+    source.kind = Kind::Path;
+    source.path = path;
+    return source;
+}
+
+HashSource HashSource::FromHandle(NativeFileHandle file) {
+    HashSource source;
+    source.kind = Kind::Handle;
+    source.handle = file;
+    return source;
+}
+
+HashSource HashSource::FromMemory(const void* data, size_t size) {
+    HashSource source;
+    source.kind = Kind::Memory;
+    source.data = static_cast<const uint8_t*>(data);
+    source.size = size;
+    return source;
+}
+
+HashSource HashSource::FromMapped(const void* view, size_t size) {
+    HashSource source = FromMemory(view, size);
+    source.kind = Kind::Mapped;
+    return source;
+}
+
+HashSource HashSource::FromStream(ReadFn read, uint64_t totalBytes) {
+    HashSource source;
+    source.kind = Kind::Stream;
+    source.read = std::move(read);
+    source.totalBytes = totalBytes;
+    return source;
+}
+
+const char* GetHashIoPolicyName(HashIoPolicy policy) {
+    switch (policy) {
+        case HashIoPolicy::Sync: return "sync";
+        case HashIoPolicy::Async: return "async";
+        case HashIoPolicy::Mapped: return "mapped";
+        default: return "unknown";
+    }
+}
+
+bool ParseHashIoPolicyName(const std::string& name, HashIoPolicy& out) {
+    const HashIoPolicy all[] = {HashIoPolicy::Sync, HashIoPolicy::Async, HashIoPolicy::Mapped};
+    for (HashIoPolicy policy : all) {
+        if (name == GetHashIoPolicyName(policy)) {
+            out = policy;
+            return true;
+        }
+    }
+    return false;
+}
+
+HashEngine::HashEngine() {
+}
+
+HashEngine::HashEngine(const HashEngineOptions& options) : m_options(options) {
+}
+
+HashResult HashEngine::Hash(const HashSource& source, HashAlgorithm algorithm) {
+    return Hash(source, std::vector<HashAlgorithm>{algorithm}).front();
+}
+
+std::vector<HashResult> HashEngine::Hash(const HashSource& source, const std::vector<HashAlgorithm>& algorithms) {
+    std::vector<HashRequest> requests(algorithms.size());
+    for (size_t i = 0; i < algorithms.size(); ++i) {
+        requests[i].algorithm = algorithms[i];
+    }
+    return Hash(source, requests);
+}
+
+std::vector<HashResult> HashEngine::Hash(const HashSource& source, const std::vector<HashRequest>& requests) {
+    return Hash(source, requests, std::vector<HashSink*>());
+}
+
+std::vector<HashResult> HashEngine::Hash(const HashSource& source, const std::vector<HashRequest>& requests, const std::vector<HashSink*>& sinks) {
+    std::vector<HashResult> results(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        results[i].success = false;
+        results[i].algorithm = GetHashAlgorithmName(requests[i].algorithm);
+        results[i].standard = IsStandardHashAlgorithm(requests[i].algorithm);
+        results[i].calculationTime = 0.0;
+    }
+    if (requests.empty() && sinks.empty()) {
+        return results;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    HashRun run(m_options, requests, sinks, m_options.chunkSize != 0 ? m_options.chunkSize : kDefaultChunk);
+    bool ok = false;
+    switch (source.kind) {
+        case HashSource::Kind::Memory:
+        case HashSource::Kind::Mapped:
+            run.Start(source.size);
+            ok = HashSpan(run, source.data, source.size, source.kind == HashSource::Kind::Mapped);
+            break;
+        case HashSource::Kind::Stream:
+            run.Start(source.totalBytes);
+            ok = HashStream(run, source.read);
+            break;
+        case HashSource::Kind::Handle: {
+            PageCacheFile file;
+            file.Attach(source.handle, m_options.cachePolicy);
+            ok = HashFile(run, file, m_options.policy == HashIoPolicy::Async ? HashIoPolicy::Sync : m_options.policy);
+            break;
+        }
+        case HashSource::Kind::Path:
+            if (m_options.policy == HashIoPolicy::Async && m_options.checkpointPath.empty()) {
+                // The reader opens the file itself, with the flags its
+                // backend needs. Its chunks are only valid during the call.
+                AsyncReadOptions options;
+                options.backend = m_options.backend;
+                options.chunkSize = m_options.chunkSize;
+                options.queueDepth = m_options.queueDepth;
+                options.cachePolicy = m_options.cachePolicy;
+                options.cancel = m_options.cancel;
+                options.progress = m_options.progress;
+                run.Start(0);
+                ok = ReadFileAsync(source.path, options,
+                                   [&](const uint8_t* data, size_t size) { run.fan->FeedTransient(data, size); },
+                                   m_asyncStats, run.error);
+            } else {
+                PageCacheFile file;
+                if (!file.Open(source.path, m_options.cachePolicy, run.error)) {
+                    break;
+                }
+                ok = HashFile(run, file, m_options.policy == HashIoPolicy::Async ? HashIoPolicy::Sync : m_options.policy);
+            }
+            break;
+    }
+
+    if (!ok) {
+        for (auto& r : results) {
+            r.errorMessage = run.error.empty() ? L"Hash calculation failed" : run.error;
+        }
+        return results;
+    }
+    std::vector<std::wstring> hex = run.fan->Finish();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = end - start;
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i].success = true;
+        results[i].result = hex[i];
+        results[i].calculationTime = diff.count();
+    }
+    return results;
+}
+
+std::vector<PageCacheBenchmarkResult> RunPageCacheBenchmark(const std::wstring& path, HashAlgorithm algorithm) {
+    const PageCachePolicy cachePolicies[] = {PageCachePolicy::Cached, PageCachePolicy::DropBehind, PageCachePolicy::Direct};
+    const HashIoPolicy ioPolicies[] = {HashIoPolicy::Sync, HashIoPolicy::Mapped, HashIoPolicy::Async};
+    std::vector<PageCacheBenchmarkResult> results;
+    for (PageCachePolicy cachePolicy : cachePolicies) {
+        for (HashIoPolicy ioPolicy : ioPolicies) {
+            PageCacheBenchmarkResult res;
+            res.cachePolicy = GetPageCachePolicyName(cachePolicy);
+            res.ioPolicy = GetHashIoPolicyName(ioPolicy);
+            std::wstring name = GetHashAlgorithmName(algorithm);
+            res.algorithm.assign(name.begin(), name.end());
+
+            EvictFromPageCache(path);
+            uint64_t before = 0;
+            uint64_t after = 0;
+            GetCachedBytes(path, before);
+
+            HashEngineOptions options;
+            options.policy = ioPolicy;
+            options.cachePolicy = cachePolicy;
+            uint64_t bytes = 0;
+            options.progress = [&](uint64_t processed, uint64_t) { bytes = processed; };
+            auto start = std::chrono::steady_clock::now();
+            HashResult hash = HashEngine(options).Hash(HashSource::FromPath(path), algorithm);
+            res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            GetCachedBytes(path, after);
+
+            res.bytes = bytes;
+            res.cacheGrowthBytes = static_cast<int64_t>(after) - static_cast<int64_t>(before);
+            if (!hash.success) {
+                res.error.assign(hash.errorMessage.begin(), hash.errorMessage.end());
+            } else {
+                res.digest.assign(hash.result.begin(), hash.result.end());
+                if (res.seconds > 0.0) {
+                    res.megabytesPerSecond = (static_cast<double>(res.bytes) / 1e6) / res.seconds;
+                }
+            }
+            results.push_back(res);
+        }
+    }
+    EvictFromPageCache(path);
+    return results;
+}
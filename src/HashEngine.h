@@ -0,0 +1,224 @@
+#pragma once
+
+#include "AsyncFileReader.h"
+#include "HashAlgorithm.h"
+#include "PageCacheIo.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The one place digests are fed. Every hashing path (files, text, buffers,
+// batches, async reads) goes through HashEngine::Hash, which reads the source
+// once and updates all requested digests from the same buffers. Builds
+// without Windows headers on other platforms.
+
+// Whether a known-file hash set (KnownHashSet.h) lists the digest.
+enum class HashKnownState {
+    Unchecked,
+    Known,
+    Unknown
+};
+
+struct HashResult {
+    bool success;
+    std::wstring result;
+    std::wstring algorithm;
+    double calculationTime;
+    std::wstring errorMessage;
+    // False for PEInfo-specific digests (SHA256-TREE) that other tools do not
+    // produce; reports label those results.
+    bool standard = true;
+    // Set by TagKnownHashes.
+    HashKnownState known = HashKnownState::Unchecked;
+};
+
+// "MD5", "SHA1", "SHA256", "BLAKE3", "SHA256-TREE", "SSDEEP", "TLSH", "XXH3-64",
+// "XXH3-128" or "CRC32C".
+std::wstring GetHashAlgorithmName(HashAlgorithm algorithm);
+// Accepts the names GetHashAlgorithmName returns, case-insensitively, with or
+// without dashes and underscores ("sha-256", "sha256tree", "xxh3_64"), and
+// xxhsum's "XXH3" and "XXH128".
+bool ParseHashAlgorithmName(const std::wstring& name, HashAlgorithm& out);
+
+// What identifies one version of a file without reading it: if none of these
+// changed, neither did the content (for checkpoints and the hash cache).
+struct HashFileIdentity {
+    uint64_t size = 0;
+    // Last write and last change (metadata included) times: FILETIME on
+    // Windows, nanoseconds since the epoch elsewhere. A restored mtime still
+    // moves the change time.
+    uint64_t modifiedTime = 0;
+    uint64_t changeTime = 0;
+    // Volume serial number and file index on Windows, st_dev and st_ino
+    // elsewhere.
+    uint64_t device = 0;
+    uint64_t fileId = 0;
+
+    bool operator==(const HashFileIdentity& other) const {
+        return size == other.size && modifiedTime == other.modifiedTime && changeTime == other.changeTime && device == other.device &&
+               fileId == other.fileId;
+    }
+    bool operator!=(const HashFileIdentity& other) const { return !(*this == other); }
+};
+
+bool GetHashFileIdentity(NativeFileHandle file, HashFileIdentity& out);
+bool GetHashFileIdentity(const std::wstring& path, HashFileIdentity& out);
+
+// prefix followed by the process ID, in the temp directory; for self-tests
+// that need a file.
+std::wstring GetSelfTestTempPath(const wchar_t* prefix);
+
+// Where the bytes come from. Sources only describe the input; they own
+// nothing, so the data, handle or callback must outlive the Hash call.
+struct HashSource {
+    enum class Kind {
+        Path,
+        Handle,
+        Memory,
+        Mapped,
+        Stream
+    };
+
+    // Reads up to capacity bytes; bytesRead == 0 ends the stream. Return
+    // false on failure.
+    typedef std::function<bool(uint8_t* buffer, size_t capacity, size_t& bytesRead)> ReadFn;
+
+    static HashSource FromPath(const std::wstring& path);
+    // An open file; hashed from offset 0 with positioned reads, so the file
+    // pointer is left alone.
+    static HashSource FromHandle(NativeFileHandle file);
+    static HashSource FromMemory(const void* data, size_t size);
+    // A view of a mapped file. Pages are touched before they are hashed so
+    // that an I/O error behind the view fails the hash instead of the process
+    // (Windows only; elsewhere the signal is not caught).
+    static HashSource FromMapped(const void* view, size_t size);
+    // Output of another stage; totalBytes (0 = unknown) is only used for
+    // progress.
+    static HashSource FromStream(ReadFn read, uint64_t totalBytes = 0);
+
+    Kind kind = Kind::Memory;
+    std::wstring path;
+    NativeFileHandle handle = NativeFileHandle();
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    ReadFn read;
+    uint64_t totalBytes = 0;
+};
+
+// How Path and Handle sources are read. The other sources ignore it.
+enum class HashIoPolicy {
+    // Sequential reads into the engine's buffers.
+    Sync,
+    // Several reads in flight through AsyncFileReader; Path sources only,
+    // Handle sources fall back to Sync.
+    Async,
+    // Hash straight from a read-only mapping of the file; falls back to Sync
+    // where the file cannot be mapped (empty, or too large for the address
+    // space).
+    Mapped
+};
+
+// Bytes of the source left out of a digest.
+struct HashSkipRange {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+// One digest of a Hash call. With skip ranges the digest sees the source with
+// those bytes cut out (the Authenticode image hash, for example); the ranges
+// may be unsorted or overlap.
+struct HashRequest {
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    std::vector<HashSkipRange> skip;
+};
+
+// A consumer of a Hash call that is not a digest (the PE checksum, for
+// example). Sees every chunk in source order with its offset; runs on a
+// worker thread of its own when the digests do.
+class HashSink {
+public:
+    virtual ~HashSink() {}
+    virtual void Update(uint64_t offset, const uint8_t* data, size_t size) = 0;
+};
+
+const char* GetHashIoPolicyName(HashIoPolicy policy);
+bool ParseHashIoPolicyName(const std::string& name, HashIoPolicy& out);
+
+struct HashEngineOptions {
+    HashIoPolicy policy = HashIoPolicy::Sync;
+    // Bytes per read or per hashed piece of a span. 0 = 1 MiB, or tuned for
+    // the Async policy.
+    size_t chunkSize = 0;
+    // Async policy only; 0 = tuned.
+    size_t queueDepth = 0;
+    AsyncIoBackend backend = AsyncIoBackend::Auto;
+    // What Path and Handle sources leave in the page cache. The Async policy
+    // reads cached and drops behind for both DropBehind and Direct.
+    PageCachePolicy cachePolicy = PageCachePolicy::Cached;
+    // When several digests are requested, update them on separate threads
+    // while the next chunk is being read.
+    bool parallelDigests = true;
+    // Worker threads of the tree hashes (0 = hardware concurrency).
+    size_t digestThreads = 0;
+    // (processed, total), after every chunk.
+    std::function<void(uint64_t, uint64_t)> progress;
+    std::atomic<bool>* cancel = nullptr;
+    // Resumable hashing of Path and Handle sources (see HashCheckpoint.h).
+    // When set, the digest contexts are saved to this file every
+    // checkpointInterval bytes and when the hash is cancelled or a read
+    // fails; a later call resumes from a checkpoint of the same file and
+    // algorithms, and a completed hash deletes it. The Async policy reads
+    // synchronously then. Ignored with skip ranges or sinks.
+    std::wstring checkpointPath;
+    // 0 = 256 MiB.
+    uint64_t checkpointInterval = 0;
+};
+
+class HashEngine {
+public:
+    HashEngine();
+    explicit HashEngine(const HashEngineOptions& options);
+
+    HashEngineOptions& Options() { return m_options; }
+    const HashEngineOptions& Options() const { return m_options; }
+
+    // One result per request, in the order given. On failure every result
+    // carries the error ("Failed to open file", "Failed to read file",
+    // "Cancelled", ...) and no digest.
+    std::vector<HashResult> Hash(const HashSource& source, const std::vector<HashRequest>& requests);
+    // Also feeds the sinks from the same pass. They have no result of their
+    // own; on failure their state is incomplete.
+    std::vector<HashResult> Hash(const HashSource& source, const std::vector<HashRequest>& requests, const std::vector<HashSink*>& sinks);
+    std::vector<HashResult> Hash(const HashSource& source, const std::vector<HashAlgorithm>& algorithms);
+    HashResult Hash(const HashSource& source, HashAlgorithm algorithm);
+
+    // Backend and settings of the last Hash call that used the Async policy.
+    const AsyncReadStats& GetLastAsyncStats() const { return m_asyncStats; }
+
+private:
+    HashEngineOptions m_options;
+    AsyncReadStats m_asyncStats;
+};
+
+struct PageCacheBenchmarkResult {
+    std::string cachePolicy;
+    std::string ioPolicy;
+    std::string algorithm;
+    // Every run must produce the same digest.
+    std::string digest;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    double megabytesPerSecond = 0.0;
+    // Growth of GetCachedBytes over the run, which starts from an evicted
+    // file: the run's page-cache footprint.
+    int64_t cacheGrowthBytes = 0;
+    std::string error;
+};
+
+// Hashes the file once per cache policy with each of the Sync, Mapped and
+// Async I/O policies, evicting it from the cache before every run.
+std::vector<PageCacheBenchmarkResult> RunPageCacheBenchmark(const std::wstring& path, HashAlgorithm algorithm);
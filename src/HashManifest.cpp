@@ -0,0 +1,600 @@
+#include "HashManifest.h"
+
+#include "JsonReader.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Invalid sequences become U+FFFD. Code points above U+FFFF are split into
+// surrogate pairs where wchar_t is 16 bits.
+std::wstring Utf8ToWide(const std::string& s) {
+    std::wstring out;
+    out.reserve(s.size());
+    size_t i = 0;
+    while (i < s.size()) {
+        uint8_t c = static_cast<uint8_t>(s[i]);
+        uint32_t cp = 0xFFFD;
+        size_t extra = 0;
+        uint32_t min = 0;
+        if (c < 0x80) {
+            cp = c;
+        } else if ((c & 0xE0) == 0xC0) {
+            cp = c & 0x1F;
+            extra = 1;
+            min = 0x80;
+        } else if ((c & 0xF0) == 0xE0) {
+            cp = c & 0x0F;
+            extra = 2;
+            min = 0x800;
+        } else if ((c & 0xF8) == 0xF0) {
+            cp = c & 0x07;
+            extra = 3;
+            min = 0x10000;
+        }
+        ++i;
+        bool valid = c < 0x80 || extra != 0;
+        for (size_t k = 0; k < extra && valid; ++k) {
+            if (i >= s.size() || (static_cast<uint8_t>(s[i]) & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (static_cast<uint8_t>(s[i]) & 0x3F);
+            ++i;
+        }
+        if (!valid || (extra != 0 && cp < min) || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            cp = 0xFFFD;
+        }
+        if (sizeof(wchar_t) == 2 && cp > 0xFFFF) {
+            cp -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+            out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+        } else {
+            out.push_back(static_cast<wchar_t>(cp));
+        }
+    }
+    return out;
+}
+
+bool IsHexText(const std::string& s) {
+    if (s.empty()) {
+        return false;
+    }
+    for (char ch : s) {
+        if (!((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool InferAlgorithm(const std::string& digest, HashAlgorithm& out) {
+    if (!IsHexText(digest)) {
+        return false;
+    }
+    switch (digest.size()) {
+    case 32:
+        out = HashAlgorithm::MD5;
+        return true;
+    case 40:
+        out = HashAlgorithm::SHA1;
+        return true;
+    case 64:
+        out = HashAlgorithm::SHA256;
+        return true;
+    case 16:
+        out = HashAlgorithm::XXH3_64;
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::wstring LineError(size_t line, const wchar_t* what) {
+    return L"Manifest line " + std::to_wstring(line) + L": " + what;
+}
+
+// Fills algorithm and expected; named is the algorithm the manifest gives
+// for the entry, if any.
+bool SetDigest(ManifestEntry& entry,
+               const std::string& digest,
+               const HashAlgorithm* named,
+               const HashAlgorithm* defaultAlgorithm,
+               std::wstring& error) {
+    if (digest.empty()) {
+        error = LineError(entry.line, L"missing digest");
+        return false;
+    }
+    // xxhsum prefixes XXH3-64 digests with "XXH3_" outside --tag output.
+    const HashAlgorithm xxh3 = HashAlgorithm::XXH3_64;
+    std::string value = digest;
+    if (value.size() > 5 && value.compare(0, 5, "XXH3_") == 0) {
+        value.erase(0, 5);
+        if (named == nullptr) {
+            named = &xxh3;
+        }
+    }
+    if (named != nullptr) {
+        entry.algorithm = *named;
+    } else if (defaultAlgorithm != nullptr) {
+        entry.algorithm = *defaultAlgorithm;
+    } else if (!InferAlgorithm(value, entry.algorithm)) {
+        error = LineError(entry.line, L"cannot tell the algorithm from the digest");
+        return false;
+    }
+    entry.expected = Utf8ToWide(value);
+    return true;
+}
+
+// GNU coreutils escapes names holding a backslash or newline and marks the
+// line with a leading backslash.
+std::string UnescapeName(const std::string& name) {
+    std::string out;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == '\\' && i + 1 < name.size()) {
+            char next = name[++i];
+            out.push_back(next == 'n' ? '\n' : next == 'r' ? '\r' : next);
+        } else {
+            out.push_back(name[i]);
+        }
+    }
+    return out;
+}
+
+bool ParseTextLine(const std::string& line, size_t lineNumber, const HashAlgorithm* defaultAlgorithm, std::vector<ManifestEntry>& entries, std::wstring& error) {
+    ManifestEntry entry;
+    entry.line = lineNumber;
+
+    // Tagged: "SHA256 (name) = digest".
+    size_t open = line.find(" (");
+    size_t close = line.rfind(") = ");
+    if (open != std::string::npos && close != std::string::npos && close > open && line.find(' ') == open) {
+        std::string tag = line.substr(0, open);
+        bool escaped = !tag.empty() && tag[0] == '\\';
+        if (escaped) {
+            tag.erase(0, 1);
+        }
+        HashAlgorithm named;
+        if (!ParseHashAlgorithmName(Utf8ToWide(tag), named)) {
+            error = LineError(lineNumber, L"unknown algorithm");
+            return false;
+        }
+        std::string name = line.substr(open + 2, close - open - 2);
+        entry.path = Utf8ToWide(escaped ? UnescapeName(name) : name);
+        if (!SetDigest(entry, line.substr(close + 4), &named, defaultAlgorithm, error)) {
+            return false;
+        }
+    } else {
+        // "digest  name" or "digest *name".
+        bool escaped = line[0] == '\\';
+        size_t start = escaped ? 1 : 0;
+        size_t space = line.find(' ', start);
+        if (space == std::string::npos || space + 1 >= line.size() || (line[space + 1] != ' ' && line[space + 1] != '*') ||
+            space + 2 >= line.size()) {
+            error = LineError(lineNumber, L"expected \"<digest>  <file>\"");
+            return false;
+        }
+        std::string name = line.substr(space + 2);
+        entry.path = Utf8ToWide(escaped ? UnescapeName(name) : name);
+        if (!SetDigest(entry, line.substr(start, space - start), nullptr, defaultAlgorithm, error)) {
+            return false;
+        }
+    }
+    entry.file = entry.path;
+    entries.push_back(entry);
+    return true;
+}
+
+bool ReadNamedAlgorithm(const JsonValue& object, bool& present, HashAlgorithm& out, std::wstring& error) {
+    present = false;
+    const JsonValue* name = object.Find("algorithm");
+    if (name == nullptr || name->type == JsonValue::Type::Null) {
+        return true;
+    }
+    if (name->type != JsonValue::Type::String || !ParseHashAlgorithmName(Utf8ToWide(name->text), out)) {
+        error = LineError(name->line, L"unknown algorithm");
+        return false;
+    }
+    present = true;
+    return true;
+}
+
+bool ParseJsonManifest(const std::string& text, const HashAlgorithm* defaultAlgorithm, std::vector<ManifestEntry>& entries, std::wstring& error) {
+    JsonValue root;
+    size_t errorLine = 0;
+    std::wstring what;
+    if (!ParseJson(text, root, errorLine, what)) {
+        error = LineError(errorLine, what.c_str());
+        return false;
+    }
+    const JsonValue* files = &root;
+    bool rootNamed = false;
+    HashAlgorithm rootAlgorithm = HashAlgorithm::SHA256;
+    if (root.type == JsonValue::Type::Object) {
+        if (!ReadNamedAlgorithm(root, rootNamed, rootAlgorithm, error)) {
+            return false;
+        }
+        files = root.Find("files");
+    }
+    if (files == nullptr || files->type != JsonValue::Type::Array) {
+        error = LineError(root.line, L"expected a \"files\" array");
+        return false;
+    }
+    for (const JsonValue& item : files->items) {
+        ManifestEntry entry;
+        entry.line = item.line;
+        const JsonValue* path = item.type == JsonValue::Type::Object ? item.Find("path") : nullptr;
+        const JsonValue* hash = item.type == JsonValue::Type::Object ? item.Find("hash") : nullptr;
+        if (path == nullptr || path->type != JsonValue::Type::String || path->text.empty() || hash == nullptr ||
+            hash->type != JsonValue::Type::String) {
+            error = LineError(item.line, L"expected an object with \"path\" and \"hash\"");
+            return false;
+        }
+        bool named = false;
+        HashAlgorithm algorithm = HashAlgorithm::SHA256;
+        if (!ReadNamedAlgorithm(item, named, algorithm, error)) {
+            return false;
+        }
+        const HashAlgorithm* entryAlgorithm = named ? &algorithm : rootNamed ? &rootAlgorithm : nullptr;
+        if (!SetDigest(entry, hash->text, entryAlgorithm, defaultAlgorithm, error)) {
+            return false;
+        }
+        entry.path = Utf8ToWide(path->text);
+        entry.file = entry.path;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool IsAbsolutePath(const std::wstring& path) {
+    if (!path.empty() && (path[0] == L'/' || path[0] == L'\\')) {
+        return true;
+    }
+#if defined(_WIN32)
+    return path.size() >= 2 && path[1] == L':';
+#else
+    return false;
+#endif
+}
+
+bool IsMissingFile(const std::wstring& path) {
+#if defined(_WIN32)
+    if (GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        return false;
+    }
+    DWORD code = GetLastError();
+    return code == ERROR_FILE_NOT_FOUND || code == ERROR_PATH_NOT_FOUND;
+#else
+    struct stat st;
+    return stat(ToNativePath(path).c_str(), &st) != 0 && (errno == ENOENT || errno == ENOTDIR);
+#endif
+}
+
+bool DigestsMatch(HashAlgorithm algorithm, const std::wstring& expected, const std::wstring& actual) {
+    if (expected.size() != actual.size()) {
+        return false;
+    }
+    // ssdeep text is base64 and case-sensitive; everything else is hex.
+    if (algorithm == HashAlgorithm::SSDEEP) {
+        return expected == actual;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        wchar_t a = expected[i];
+        wchar_t b = actual[i];
+        if (a >= L'A' && a <= L'Z') {
+            a = static_cast<wchar_t>(a - L'A' + L'a');
+        }
+        if (b >= L'A' && b <= L'Z') {
+            b = static_cast<wchar_t>(b - L'A' + L'a');
+        }
+        if (a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool ParseHashManifest(const std::string& text,
+                       const HashAlgorithm* defaultAlgorithm,
+                       std::vector<ManifestEntry>& entries,
+                       std::wstring& error) {
+    entries.clear();
+    size_t start = 0;
+    // A UTF-8 byte order mark, as some editors write.
+    if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        start = 3;
+    }
+    size_t first = text.find_first_not_of(" \t\r\n", start);
+    if (first != std::string::npos && (text[first] == '{' || text[first] == '[')) {
+        bool ok = ParseJsonManifest(text.substr(start), defaultAlgorithm, entries, error);
+        if (!ok) {
+            entries.clear();
+        }
+        return ok;
+    }
+
+    size_t lineNumber = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") == std::string::npos || line[0] == '#') {
+            continue;
+        }
+        if (!ParseTextLine(line, lineNumber, defaultAlgorithm, entries, error)) {
+            entries.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoadHashManifest(const std::wstring& path,
+                      const HashAlgorithm* defaultAlgorithm,
+                      std::vector<ManifestEntry>& entries,
+                      std::wstring& error) {
+    entries.clear();
+#if defined(_WIN32)
+    std::ifstream in(path.c_str(), std::ios::binary);
+#else
+    std::ifstream in(ToNativePath(path).c_str(), std::ios::binary);
+#endif
+    if (!in) {
+        error = L"Failed to open manifest";
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        error = L"Failed to read manifest";
+        return false;
+    }
+    if (!ParseHashManifest(text, defaultAlgorithm, entries, error)) {
+        return false;
+    }
+
+    size_t slash = path.find_last_of(L"/\\");
+    std::wstring directory = slash == std::wstring::npos ? std::wstring() : path.substr(0, slash + 1);
+    for (ManifestEntry& entry : entries) {
+        if (!directory.empty() && !IsAbsolutePath(entry.path)) {
+            entry.file = directory + entry.path;
+        }
+    }
+    return true;
+}
+
+const char* GetManifestStatusName(ManifestStatus status) {
+    switch (status) {
+    case ManifestStatus::Ok:
+        return "OK";
+    case ManifestStatus::Missing:
+        return "MISSING";
+    case ManifestStatus::Failed:
+    default:
+        return "FAILED";
+    }
+}
+
+std::vector<ManifestResult> VerifyHashManifest(const std::vector<ManifestEntry>& entries, const ManifestVerifyOptions& options) {
+    const size_t count = entries.size();
+    std::vector<ManifestResult> results(count);
+    std::vector<uint64_t> sizes(count, 0);
+    std::vector<char> done(count, 0);
+    std::mutex reportLock;
+    size_t nextReport = 0;
+
+    // Results are published in manifest order: each finished entry releases
+    // the run of finished entries that starts at the first unreported one.
+    auto finish = [&](size_t i) {
+        std::lock_guard<std::mutex> guard(reportLock);
+        done[i] = 1;
+        while (nextReport < count && done[nextReport]) {
+            if (options.onResult) {
+                options.onResult(nextReport, results[nextReport]);
+            }
+            ++nextReport;
+        }
+    };
+    auto setOutcome = [&](size_t i, ManifestStatus status, const std::wstring& message) {
+        HashResult& hash = results[i].hash;
+        hash.success = false;
+        hash.algorithm = GetHashAlgorithmName(entries[i].algorithm);
+        hash.standard = IsStandardHashAlgorithm(entries[i].algorithm);
+        hash.calculationTime = 0.0;
+        hash.errorMessage = message;
+        results[i].status = status;
+    };
+
+    // Sizes first (metadata only, so this pass is short), to hand out the
+    // largest files first. Missing files are settled here.
+    RunParallel(count, options.threadCount, [&](size_t i) {
+        HashFileIdentity identity;
+        if (GetHashFileIdentity(entries[i].file, identity)) {
+            sizes[i] = identity.size;
+        } else if (IsMissingFile(entries[i].file)) {
+            setOutcome(i, ManifestStatus::Missing, L"File not found");
+            finish(i);
+        }
+    });
+
+    std::vector<size_t> order;
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i].status != ManifestStatus::Missing) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    HashEngineOptions engineOptions = options.engine;
+    engineOptions.progress = nullptr;
+    RunParallel(order.size(), options.threadCount, [&](size_t k) {
+        const size_t i = order[k];
+        const ManifestEntry& entry = entries[i];
+        if (options.engine.cancel != nullptr && options.engine.cancel->load()) {
+            setOutcome(i, ManifestStatus::Failed, L"Cancelled");
+            finish(i);
+            return;
+        }
+        results[i].hash = HashEngine(engineOptions).Hash(HashSource::FromPath(entry.file), entry.algorithm);
+        if (!results[i].hash.success) {
+            // Deleted between the size pass and the hash.
+            results[i].status = IsMissingFile(entry.file) ? ManifestStatus::Missing : ManifestStatus::Failed;
+        } else {
+            results[i].status = DigestsMatch(entry.algorithm, entry.expected, results[i].hash.result) ? ManifestStatus::Ok : ManifestStatus::Failed;
+        }
+        finish(i);
+    });
+    return results;
+}
+
+bool RunHashManifestSelfTest(std::wstring& error) {
+    const std::string text =
+        "# build drop\r\n"
+        "d41d8cd98f00b204e9800998ecf8427e  empty.txt\r\n"
+        "\r\n"
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855 *bin/a b.dll\n"
+        "\\da39a3ee5e6b4b0d3255bfef95601890afd80709  dir\\\\x\\nname\n"
+        "BLAKE3 (lib/c.so) = af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262\n";
+    std::vector<ManifestEntry> entries;
+    if (!ParseHashManifest(text, nullptr, entries, error)) {
+        return false;
+    }
+    if (entries.size() != 4 || entries[0].algorithm != HashAlgorithm::MD5 || entries[0].path != L"empty.txt" || entries[0].line != 2 ||
+        entries[1].algorithm != HashAlgorithm::SHA256 || entries[1].path != L"bin/a b.dll" || entries[2].algorithm != HashAlgorithm::SHA1 ||
+        entries[2].path != L"dir\\x\nname" || entries[3].algorithm != HashAlgorithm::BLAKE3 || entries[3].path != L"lib/c.so") {
+        error = L"Text manifest parsed wrongly";
+        return false;
+    }
+    const HashAlgorithm blake3 = HashAlgorithm::BLAKE3;
+    if (!ParseHashManifest("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef  x\n", &blake3, entries, error) ||
+        entries.size() != 1 || entries[0].algorithm != HashAlgorithm::BLAKE3) {
+        error = L"Default algorithm not applied";
+        return false;
+    }
+    if (!ParseHashManifest("XXH3_2d06800538d394c2  a\nXXH128 (b) = 99aa06d3014798d86001c324468d497f\n", nullptr, entries, error) ||
+        entries.size() != 2 || entries[0].algorithm != HashAlgorithm::XXH3_64 || entries[0].expected != L"2d06800538d394c2" ||
+        entries[1].algorithm != HashAlgorithm::XXH3_128) {
+        error = L"xxhsum manifest parsed wrongly";
+        return false;
+    }
+    std::wstring parseError;
+    if (ParseHashManifest("abc  x\n", nullptr, entries, parseError) || ParseHashManifest("d41d8cd98f00b204e9800998ecf8427e x\n", nullptr, entries, parseError) ||
+        ParseHashManifest("{\"files\": [{\"path\": \"x\"}]}", nullptr, entries, parseError)) {
+        error = L"Malformed manifest accepted";
+        return false;
+    }
+
+    const std::string json =
+        "{\n"
+        "  \"algorithm\": \"sha-1\",\n"
+        "  \"files\": [\n"
+        "    {\"path\": \"a\\u00e9\\ud83d\\ude00.bin\", \"hash\": \"DA39A3EE5E6B4B0D3255BFEF95601890AFD80709\", \"size\": 0},\n"
+        "    {\"path\": \"b.bin\", \"algorithm\": \"md5\", \"hash\": \"d41d8cd98f00b204e9800998ecf8427e\"}\n"
+        "  ]\n"
+        "}\n";
+    if (!ParseHashManifest(json, nullptr, entries, error)) {
+        return false;
+    }
+    std::wstring firstName = L"a\u00e9";
+    if (sizeof(wchar_t) == 2) {
+        firstName += L"\xD83D\xDE00";
+    } else {
+        firstName += static_cast<wchar_t>(0x1F600);
+    }
+    firstName += L".bin";
+    if (entries.size() != 2 || entries[0].path != firstName || entries[0].algorithm != HashAlgorithm::SHA1 || entries[0].line != 4 ||
+        entries[1].algorithm != HashAlgorithm::MD5) {
+        error = L"JSON manifest parsed wrongly";
+        return false;
+    }
+
+    // Verification: a match, a mismatch, a missing file and a larger match,
+    // reported in manifest order whatever order they finish in.
+    const std::wstring base = GetSelfTestTempPath(L"peinfo-manifest-");
+    std::vector<uint8_t> small(1000, 0x61);
+    std::vector<uint8_t> large(3u << 20);
+    uint32_t x = 0x2545F491;
+    for (auto& b : large) {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    struct TestFile {
+        std::wstring path;
+        const std::vector<uint8_t>* data;
+    };
+    const TestFile files[] = {{base + L"-small", &small}, {base + L"-large", &large}};
+    for (const TestFile& file : files) {
+#if defined(_WIN32)
+        std::ofstream out(file.path.c_str(), std::ios::binary);
+#else
+        std::ofstream out(ToNativePath(file.path).c_str(), std::ios::binary);
+#endif
+        out.write(reinterpret_cast<const char*>(file.data->data()), static_cast<std::streamsize>(file.data->size()));
+        if (!out) {
+            error = L"Cannot write the manifest test files";
+            return false;
+        }
+    }
+    HashEngine engine;
+    std::wstring smallSha = engine.Hash(HashSource::FromMemory(small.data(), small.size()), HashAlgorithm::SHA256).result;
+    std::wstring largeMd5 = engine.Hash(HashSource::FromMemory(large.data(), large.size()), HashAlgorithm::MD5).result;
+    for (auto& ch : largeMd5) {
+        if (ch >= L'a' && ch <= L'f') {
+            ch = static_cast<wchar_t>(ch - L'a' + L'A');
+        }
+    }
+    std::vector<ManifestEntry> verify(4);
+    verify[0].file = files[0].path;
+    verify[0].expected = smallSha;
+    verify[1].file = files[0].path;
+    verify[1].expected = std::wstring(64, L'0');
+    verify[2].file = base + L"-absent";
+    verify[3].file = files[1].path;
+    verify[3].algorithm = HashAlgorithm::MD5;
+    verify[3].expected = largeMd5;
+
+    std::vector<size_t> reported;
+    ManifestVerifyOptions options;
+    options.threadCount = 3;
+    options.onResult = [&](size_t index, const ManifestResult&) { reported.push_back(index); };
+    std::vector<ManifestResult> results = VerifyHashManifest(verify, options);
+    const ManifestStatus expected[] = {ManifestStatus::Ok, ManifestStatus::Failed, ManifestStatus::Missing, ManifestStatus::Ok};
+    bool ok = results.size() == 4 && reported == std::vector<size_t>{0, 1, 2, 3};
+    for (size_t i = 0; i < results.size() && ok; ++i) {
+        ok = results[i].status == expected[i];
+    }
+    if (!ok) {
+        error = L"Manifest verification gave wrong results";
+    }
+    for (const TestFile& file : files) {
+#if defined(_WIN32)
+        DeleteFileW(file.path.c_str());
+#else
+        std::remove(ToNativePath(file.path).c_str());
+#endif
+    }
+    return ok;
+}
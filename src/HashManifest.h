@@ -0,0 +1,76 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Verification of hash manifests: the lists sha256sum, md5sum, b3sum and
+// xxhsum write ("<digest>  <path>", binary "<digest> *<path>", and the --tag
+// form "SHA256 (<path>) = <digest>"), and a JSON variant
+//   {"algorithm": "SHA256", "files": [{"path": "bin/a.dll", "hash": "..."}]}
+// in which a file may name its own "algorithm" and a bare array of files is
+// accepted too. Listed files are hashed concurrently through HashEngine,
+// largest first, so that one huge file starts early instead of running alone
+// at the end. Builds without Windows headers.
+
+struct ManifestEntry {
+    // As written in the manifest (UTF-8 decoded).
+    std::wstring path;
+    // The file to hash: path resolved against the manifest's directory by
+    // LoadHashManifest; ParseHashManifest leaves it equal to path.
+    std::wstring file;
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    std::wstring expected;
+    // 1-based line of the manifest the entry starts on.
+    size_t line = 0;
+};
+
+// defaultAlgorithm applies to entries whose manifest names no algorithm;
+// nullptr infers it from the digest (16 hex digits XXH3-64, 32 MD5, 40 SHA1,
+// 64 SHA256).
+// Fails on the first malformed line or entry.
+bool ParseHashManifest(const std::string& text,
+                       const HashAlgorithm* defaultAlgorithm,
+                       std::vector<ManifestEntry>& entries,
+                       std::wstring& error);
+bool LoadHashManifest(const std::wstring& path,
+                      const HashAlgorithm* defaultAlgorithm,
+                      std::vector<ManifestEntry>& entries,
+                      std::wstring& error);
+
+enum class ManifestStatus {
+    Ok,
+    // Digest mismatch, or a file that exists but could not be read.
+    Failed,
+    Missing
+};
+
+// "OK", "FAILED" or "MISSING".
+const char* GetManifestStatusName(ManifestStatus status);
+
+struct ManifestResult {
+    ManifestStatus status = ManifestStatus::Failed;
+    // The computed digest; errorMessage says why a file could not be hashed.
+    HashResult hash;
+};
+
+struct ManifestVerifyOptions {
+    // Used for every file; progress is not reported per file.
+    HashEngineOptions engine;
+    // Files hashed at once (0 = hardware concurrency).
+    size_t threadCount = 0;
+    // Called once per entry, in manifest order, as soon as that entry and all
+    // before it are done. Calls come from worker threads, one at a time.
+    std::function<void(size_t index, const ManifestResult& result)> onResult;
+};
+
+// One result per entry, in manifest order.
+std::vector<ManifestResult> VerifyHashManifest(const std::vector<ManifestEntry>& entries, const ManifestVerifyOptions& options);
+
+// Text and JSON manifests parsed, then files that match, differ and are
+// missing verified in order; error describes the first failure.
+bool RunHashManifestSelfTest(std::wstring& error);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Little-endian encoding of digest contexts for hash checkpoints
+// (HashCheckpoint.h). Each hasher writes its fields in a fixed order and reads
+// them back the same way; nothing here is meant to be stable across PEInfo
+// versions. Builds without Windows headers.
+
+class HashStateWriter {
+public:
+    explicit HashStateWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void U8(uint8_t v) { m_out.push_back(v); }
+
+    void U32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            m_out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    }
+
+    void U64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            m_out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    }
+
+    void Bytes(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        m_out.insert(m_out.end(), p, p + size);
+    }
+
+    // Length-prefixed.
+    void Blob(const std::vector<uint8_t>& data) {
+        U64(data.size());
+        Bytes(data.data(), data.size());
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+};
+
+// Reads fail (and keep failing) past the end of the data; check Ok() once
+// everything has been read.
+class HashStateReader {
+public:
+    HashStateReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    uint8_t U8() {
+        uint8_t v = 0;
+        Bytes(&v, 1);
+        return v;
+    }
+
+    uint32_t U32() {
+        uint8_t b[4] = {};
+        Bytes(b, sizeof(b));
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= static_cast<uint32_t>(b[i]) << (8 * i);
+        }
+        return v;
+    }
+
+    uint64_t U64() {
+        uint8_t b[8] = {};
+        Bytes(b, sizeof(b));
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= static_cast<uint64_t>(b[i]) << (8 * i);
+        }
+        return v;
+    }
+
+    void Bytes(void* out, size_t size) {
+        if (!m_ok || size > m_size - m_pos) {
+            m_ok = false;
+            std::memset(out, 0, size);
+            return;
+        }
+        std::memcpy(out, m_data + m_pos, size);
+        m_pos += size;
+    }
+
+    // At most maxSize bytes; longer blobs fail the read.
+    void Blob(std::vector<uint8_t>& out, size_t maxSize) {
+        uint64_t size = U64();
+        if (!m_ok || size > maxSize || size > m_size - m_pos) {
+            m_ok = false;
+            out.clear();
+            return;
+        }
+        out.assign(m_data + m_pos, m_data + m_pos + size);
+        m_pos += static_cast<size_t>(size);
+    }
+
+    void Fail() { m_ok = false; }
+    bool Ok() const { return m_ok; }
+    bool AtEnd() const { return m_pos == m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
@@ -0,0 +1,280 @@
+#include "JsonReader.h"
+
+namespace {
+
+const size_t kMaxJsonDepth = 64;
+
+void AppendUtf8(uint32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : m_text(text) {}
+
+    bool Parse(JsonValue& out, size_t& errorLine, std::wstring& what) {
+        bool ok = Value(out, 0);
+        if (ok) {
+            SkipSpace();
+            ok = m_pos == m_text.size();
+            if (!ok) {
+                m_what = L"unexpected text after the value";
+            }
+        }
+        if (!ok) {
+            errorLine = m_line;
+            what = m_what;
+        }
+        return ok;
+    }
+
+private:
+    void SkipSpace() {
+        while (m_pos < m_text.size()) {
+            char ch = m_text[m_pos];
+            if (ch == '\n') {
+                ++m_line;
+            } else if (ch != ' ' && ch != '\t' && ch != '\r') {
+                return;
+            }
+            ++m_pos;
+        }
+    }
+
+    bool Fail(const wchar_t* what) {
+        m_what = what;
+        return false;
+    }
+
+    bool Literal(const char* word) {
+        size_t len = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, len, word) != 0) {
+            return Fail(L"invalid value");
+        }
+        m_pos += len;
+        return true;
+    }
+
+    bool Hex4(uint32_t& out) {
+        if (m_text.size() - m_pos < 4) {
+            return Fail(L"truncated escape");
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            char ch = m_text[m_pos++];
+            int digit = (ch >= '0' && ch <= '9') ? ch - '0' : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 : (ch >= 'A' && ch <= 'F') ? ch - 'A' + 10 : -1;
+            if (digit < 0) {
+                return Fail(L"invalid escape");
+            }
+            out = (out << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    bool String(std::string& out) {
+        ++m_pos;
+        for (;;) {
+            if (m_pos >= m_text.size()) {
+                return Fail(L"unterminated string");
+            }
+            char ch = m_text[m_pos++];
+            if (ch == '"') {
+                return true;
+            }
+            if (ch == '\n' || static_cast<uint8_t>(ch) < 0x20) {
+                return Fail(L"control character in string");
+            }
+            if (ch != '\\') {
+                out.push_back(ch);
+                continue;
+            }
+            if (m_pos >= m_text.size()) {
+                return Fail(L"unterminated string");
+            }
+            char esc = m_text[m_pos++];
+            switch (esc) {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(esc);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (!Hex4(cp)) {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp <= 0xDBFF && m_text.compare(m_pos, 2, "\\u") == 0) {
+                    m_pos += 2;
+                    uint32_t low = 0;
+                    if (!Hex4(low)) {
+                        return false;
+                    }
+                    cp = (low >= 0xDC00 && low <= 0xDFFF) ? 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00) : 0xFFFD;
+                } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                AppendUtf8(cp, out);
+                break;
+            }
+            default:
+                return Fail(L"invalid escape");
+            }
+        }
+    }
+
+    bool Value(JsonValue& out, size_t depth) {
+        if (depth > kMaxJsonDepth) {
+            return Fail(L"nested too deeply");
+        }
+        SkipSpace();
+        out.line = m_line;
+        if (m_pos >= m_text.size()) {
+            return Fail(L"unexpected end of input");
+        }
+        char ch = m_text[m_pos];
+        if (ch == '"') {
+            out.type = JsonValue::Type::String;
+            return String(out.text);
+        }
+        if (ch == '{') {
+            out.type = JsonValue::Type::Object;
+            ++m_pos;
+            SkipSpace();
+            if (m_pos < m_text.size() && m_text[m_pos] == '}') {
+                ++m_pos;
+                return true;
+            }
+            for (;;) {
+                SkipSpace();
+                if (m_pos >= m_text.size() || m_text[m_pos] != '"') {
+                    return Fail(L"expected a member name");
+                }
+                std::pair<std::string, JsonValue> member;
+                if (!String(member.first)) {
+                    return false;
+                }
+                SkipSpace();
+                if (m_pos >= m_text.size() || m_text[m_pos] != ':') {
+                    return Fail(L"expected ':'");
+                }
+                ++m_pos;
+                if (!Value(member.second, depth + 1)) {
+                    return false;
+                }
+                out.members.push_back(std::move(member));
+                SkipSpace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',') {
+                    ++m_pos;
+                    continue;
+                }
+                if (m_pos < m_text.size() && m_text[m_pos] == '}') {
+                    ++m_pos;
+                    return true;
+                }
+                return Fail(L"expected ',' or '}'");
+            }
+        }
+        if (ch == '[') {
+            out.type = JsonValue::Type::Array;
+            ++m_pos;
+            SkipSpace();
+            if (m_pos < m_text.size() && m_text[m_pos] == ']') {
+                ++m_pos;
+                return true;
+            }
+            for (;;) {
+                out.items.emplace_back();
+                if (!Value(out.items.back(), depth + 1)) {
+                    return false;
+                }
+                SkipSpace();
+                if (m_pos < m_text.size() && m_text[m_pos] == ',') {
+                    ++m_pos;
+                    continue;
+                }
+                if (m_pos < m_text.size() && m_text[m_pos] == ']') {
+                    ++m_pos;
+                    return true;
+                }
+                return Fail(L"expected ',' or ']'");
+            }
+        }
+        if (ch == 't' || ch == 'f') {
+            out.type = JsonValue::Type::Bool;
+            out.text = ch == 't' ? "true" : "false";
+            return Literal(out.text.c_str());
+        }
+        if (ch == 'n') {
+            return Literal("null");
+        }
+        if (ch == '-' || (ch >= '0' && ch <= '9')) {
+            out.type = JsonValue::Type::Number;
+            size_t start = m_pos;
+            while (m_pos < m_text.size() && std::string("+-.eE0123456789").find(m_text[m_pos]) != std::string::npos) {
+                ++m_pos;
+            }
+            out.text = m_text.substr(start, m_pos - start);
+            return true;
+        }
+        return Fail(L"invalid value");
+    }
+
+    const std::string& m_text;
+    size_t m_pos = 0;
+    size_t m_line = 1;
+    const wchar_t* m_what = L"";
+};
+
+} // namespace
+
+bool JsonValue::ToUint64(uint64_t& out) const {
+    if (type != Type::Number || text.empty()) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (char ch : text) {
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+        uint64_t digit = static_cast<uint64_t>(ch - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    out = value;
+    return true;
+}
+
+bool ParseJson(const std::string& text, JsonValue& out, size_t& errorLine, std::wstring& what) {
+    return JsonReader(text).Parse(out, errorLine, what);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A small JSON reader for the files PEInfo reads back (hash manifests, prior
+// dependency graphs). Values are kept as a tree; strings are UTF-8 and
+// numbers keep their text. Builds without Windows headers.
+
+struct JsonValue {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+    // Strings (UTF-8), numbers and booleans, as written.
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+    // 1-based line the value starts on.
+    size_t line = 0;
+
+    const JsonValue* Find(const char* key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    bool IsTrue() const { return type == Type::Bool && text == "true"; }
+
+    // Unsigned integers only; false for anything with a sign, fraction,
+    // exponent or more than 64 bits.
+    bool ToUint64(uint64_t& out) const;
+};
+
+// On failure errorLine is the line the problem was found on and what
+// describes it ("unterminated string", ...).
+bool ParseJson(const std::string& text, JsonValue& out, size_t& errorLine, std::wstring& what);
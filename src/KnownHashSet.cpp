@@ -0,0 +1,795 @@
+#include "KnownHashSet.h"
+
+#include "Digest.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'P', 'E', 'I', 'K', 'N', 'O', 'W', 'N'};
+const uint32_t kVersion = 1;
+// Digests start on the second page.
+const uint64_t kHeaderSize = 4096;
+const size_t kFanoutEntries = 65536;
+// One cache line per filter block; a digest sets and tests bits in one block.
+const size_t kBloomBlockSize = 64;
+const uint32_t kMaxBloomHashes = 7;
+const uint64_t kDefaultMemoryBytes = 256ull << 20;
+const size_t kReadBlockSize = 16u << 20;
+const size_t kMergeBufferSize = 1u << 20;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint8_t algorithm;
+    uint8_t digestSize;
+    uint16_t reserved;
+    uint64_t count;
+    uint64_t digestOffset;
+    // kFanoutEntries cumulative counts: fanout[p] is the number of digests
+    // whose first two bytes, big-endian, are at most p.
+    uint64_t fanoutOffset;
+    uint64_t bloomOffset;
+    uint64_t bloomBlocks;
+    uint32_t bloomHashes;
+    uint32_t reserved2;
+};
+
+template <typename Stream>
+void OpenStream(Stream& stream, const std::wstring& path, std::ios::openmode mode) {
+#if defined(_WIN32)
+    stream.open(path.c_str(), mode);
+#else
+    stream.open(ToNativePath(path).c_str(), mode);
+#endif
+}
+
+void RemoveFile(const std::wstring& path) {
+#if defined(_WIN32)
+    DeleteFileW(path.c_str());
+#else
+    unlink(ToNativePath(path).c_str());
+#endif
+}
+
+uint64_t Load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t SplitMix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Digests are close to uniform already; mixing both ends keeps a skewed list
+// (many digests sharing a prefix) from crowding a few blocks.
+uint64_t BloomHash(const uint8_t* digest, size_t size) {
+    return SplitMix(Load64(digest) ^ (Load64(digest + size - 8) * 0x9E3779B97F4A7C15ull));
+}
+
+// k 9-bit positions within the block's 512 bits.
+uint8_t* BloomBlock(uint8_t* bloom, uint64_t blocks, uint64_t hash) {
+    return bloom + (hash % blocks) * kBloomBlockSize;
+}
+
+void BloomAdd(uint8_t* bloom, uint64_t blocks, uint32_t hashes, const uint8_t* digest, size_t size) {
+    const uint64_t hash = BloomHash(digest, size);
+    uint8_t* block = BloomBlock(bloom, blocks, hash);
+    const uint64_t bits = SplitMix(hash);
+    for (uint32_t i = 0; i < hashes; ++i) {
+        const uint32_t bit = static_cast<uint32_t>(bits >> (9 * i)) & 511;
+        block[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+    }
+}
+
+size_t Prefix(const uint8_t* digest) {
+    return (static_cast<size_t>(digest[0]) << 8) | digest[1];
+}
+
+int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+// Appends to out the first run of exactly 2 * digestSize hex digits of each
+// line of text.
+void ParseLines(const char* text, size_t size, size_t digestSize, std::vector<uint8_t>& out) {
+    const size_t want = digestSize * 2;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* newline = static_cast<const char*>(std::memchr(text + pos, '\n', size - pos));
+        const size_t lineEnd = newline != nullptr ? static_cast<size_t>(newline - text) : size;
+        size_t run = 0;
+        for (size_t i = pos; i <= lineEnd; ++i) {
+            if (i < lineEnd && HexValue(text[i]) >= 0) {
+                ++run;
+                continue;
+            }
+            if (run == want) {
+                const char* hex = text + i - want;
+                const size_t at = out.size();
+                out.resize(at + digestSize);
+                for (size_t b = 0; b < digestSize; ++b) {
+                    out[at + b] = static_cast<uint8_t>((HexValue(hex[2 * b]) << 4) | HexValue(hex[2 * b + 1]));
+                }
+                break;
+            }
+            run = 0;
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+template <size_t N>
+struct Record {
+    uint8_t bytes[N];
+};
+
+template <size_t N>
+bool RecordLess(const Record<N>& a, const Record<N>& b) {
+    return std::memcmp(a.bytes, b.bytes, N) < 0;
+}
+
+template <size_t N>
+bool RecordEqual(const Record<N>& a, const Record<N>& b) {
+    return std::memcmp(a.bytes, b.bytes, N) == 0;
+}
+
+// Sorts slices of the run on separate threads, merges neighbouring slices in
+// parallel rounds, and drops duplicates. Returns the records left.
+template <size_t N>
+size_t SortRecords(uint8_t* data, size_t count, size_t threadCount) {
+    static_assert(sizeof(Record<N>) == N, "digest records must be packed");
+    Record<N>* records = reinterpret_cast<Record<N>*>(data);
+    const size_t slices = std::max<size_t>(1, std::min<size_t>(threadCount, count / 65536));
+    std::vector<size_t> bounds(slices + 1);
+    for (size_t i = 0; i <= slices; ++i) {
+        bounds[i] = count * i / slices;
+    }
+    RunParallel(slices, threadCount, [&](size_t i) { std::sort(records + bounds[i], records + bounds[i + 1], RecordLess<N>); });
+    for (size_t width = 1; width < slices; width *= 2) {
+        const size_t pairs = (slices + 2 * width - 1) / (2 * width);
+        RunParallel(pairs, threadCount, [&](size_t p) {
+            const size_t lo = p * 2 * width;
+            const size_t mid = std::min<size_t>(lo + width, slices);
+            const size_t hi = std::min<size_t>(lo + 2 * width, slices);
+            if (mid < hi) {
+                std::inplace_merge(records + bounds[lo], records + bounds[mid], records + bounds[hi], RecordLess<N>);
+            }
+        });
+    }
+    return static_cast<size_t>(std::unique(records, records + count, RecordEqual<N>) - records);
+}
+
+size_t SortDigests(uint8_t* data, size_t count, size_t digestSize, size_t threadCount) {
+    switch (digestSize) {
+    case 8:
+        return SortRecords<8>(data, count, threadCount);
+    case 16:
+        return SortRecords<16>(data, count, threadCount);
+    case 20:
+        return SortRecords<20>(data, count, threadCount);
+    case 32:
+        return SortRecords<32>(data, count, threadCount);
+    default:
+        return 0;
+    }
+}
+
+// A sorted run: a temporary file, or the last run still in memory.
+struct RunReader {
+    std::ifstream file;
+    std::vector<uint8_t> buffer;
+    size_t pos = 0;
+    size_t have = 0;
+    uint64_t left = 0;
+    size_t digestSize = 0;
+    bool failed = false;
+
+    const uint8_t* Current() const { return buffer.data() + pos; }
+
+    // Moves to the next digest; false at the end of the run.
+    bool Advance() {
+        pos += digestSize;
+        if (pos < have) {
+            return true;
+        }
+        return Refill();
+    }
+
+    bool Refill() {
+        pos = 0;
+        have = 0;
+        if (!file.is_open() || left == 0) {
+            return false;
+        }
+        const uint64_t records = std::min<uint64_t>(left, kMergeBufferSize / digestSize);
+        buffer.resize(static_cast<size_t>(records) * digestSize);
+        file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        if (!file) {
+            failed = true;
+            return false;
+        }
+        left -= records;
+        have = buffer.size();
+        return true;
+    }
+};
+
+struct RunOrder {
+    const std::vector<std::unique_ptr<RunReader>>* runs;
+    size_t digestSize;
+
+    // Greater-than, for a min-heap.
+    bool operator()(size_t a, size_t b) const {
+        return std::memcmp((*runs)[a]->Current(), (*runs)[b]->Current(), digestSize) > 0;
+    }
+};
+
+class RunBuilder {
+public:
+    RunBuilder(const KnownHashBuildOptions& opt, size_t digestSize, const std::wstring& runPrefix)
+        : m_digestSize(digestSize), m_runPrefix(runPrefix) {
+        const uint64_t memory = opt.memoryBytes != 0 ? opt.memoryBytes : kDefaultMemoryBytes;
+        m_runLimit = std::max<size_t>(digestSize, static_cast<size_t>(std::min<uint64_t>(memory, SIZE_MAX / 2)) / digestSize * digestSize);
+        m_threads = opt.threadCount != 0 ? opt.threadCount : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    ~RunBuilder() {
+        for (const std::wstring& path : m_runPaths) {
+            RemoveFile(path);
+        }
+    }
+
+    // Parses a block of whole lines on the worker threads.
+    bool AddText(const char* text, size_t size, std::wstring& error) {
+        const size_t slices = std::max<size_t>(1, std::min<size_t>(m_threads, size / (256u << 10)));
+        std::vector<size_t> bounds(slices + 1, size);
+        bounds[0] = 0;
+        for (size_t i = 1; i < slices; ++i) {
+            size_t at = std::max<size_t>(bounds[i - 1], size * i / slices);
+            const char* newline = at < size ? static_cast<const char*>(std::memchr(text + at, '\n', size - at)) : nullptr;
+            bounds[i] = newline != nullptr ? static_cast<size_t>(newline - text) + 1 : size;
+        }
+        std::vector<std::vector<uint8_t>> parsed(slices);
+        RunParallel(slices, m_threads, [&](size_t i) { ParseLines(text + bounds[i], bounds[i + 1] - bounds[i], m_digestSize, parsed[i]); });
+        for (const auto& digests : parsed) {
+            size_t pos = 0;
+            while (pos < digests.size()) {
+                const size_t take = std::min<size_t>(digests.size() - pos, m_runLimit - m_current.size());
+                m_current.insert(m_current.end(), digests.begin() + pos, digests.begin() + pos + take);
+                pos += take;
+                if (m_current.size() == m_runLimit && !FlushRun(error)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool FlushRun(std::wstring& error) {
+        const size_t count = SortDigests(m_current.data(), m_current.size() / m_digestSize, m_digestSize, m_threads);
+        const std::wstring path = m_runPrefix + std::to_wstring(m_runPaths.size());
+        m_runPaths.push_back(path);
+        std::ofstream out;
+        OpenStream(out, path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(m_current.data()), static_cast<std::streamsize>(count * m_digestSize));
+        if (!out) {
+            error = L"Failed to write a sorted run";
+            return false;
+        }
+        m_runCounts.push_back(count);
+        m_current.clear();
+        return true;
+    }
+
+    // Readers over every run, positioned on their first digest. The digests
+    // not yet flushed become the last run, sorted in memory.
+    bool OpenRuns(std::vector<std::unique_ptr<RunReader>>& runs, uint64_t& upperCount, std::wstring& error) {
+        runs.clear();
+        upperCount = 0;
+        for (size_t i = 0; i < m_runPaths.size(); ++i) {
+            std::unique_ptr<RunReader> run(new RunReader());
+            run->digestSize = m_digestSize;
+            run->left = m_runCounts[i];
+            OpenStream(run->file, m_runPaths[i], std::ios::binary);
+            if (!run->file.is_open()) {
+                error = L"Failed to read a sorted run";
+                return false;
+            }
+            upperCount += m_runCounts[i];
+            if (run->Refill()) {
+                runs.push_back(std::move(run));
+            }
+        }
+        if (!m_current.empty()) {
+            std::unique_ptr<RunReader> run(new RunReader());
+            run->digestSize = m_digestSize;
+            const size_t count = SortDigests(m_current.data(), m_current.size() / m_digestSize, m_digestSize, m_threads);
+            m_current.resize(count * m_digestSize);
+            run->buffer.swap(m_current);
+            run->have = run->buffer.size();
+            upperCount += count;
+            runs.push_back(std::move(run));
+        }
+        return true;
+    }
+
+private:
+    size_t m_digestSize;
+    std::wstring m_runPrefix;
+    size_t m_runLimit = 0;
+    size_t m_threads = 1;
+    std::vector<uint8_t> m_current;
+    std::vector<std::wstring> m_runPaths;
+    std::vector<uint64_t> m_runCounts;
+};
+
+bool WriteAll(std::ofstream& out, const void* data, uint64_t size) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    return static_cast<bool>(out);
+}
+
+bool WritePadding(std::ofstream& out, uint64_t& offset, uint64_t alignment) {
+    static const char kZero[kBloomBlockSize] = {};
+    const uint64_t pad = (alignment - offset % alignment) % alignment;
+    offset += pad;
+    return WriteAll(out, kZero, pad);
+}
+
+} // namespace
+
+bool BuildKnownHashSet(const std::vector<std::wstring>& listFiles,
+                       const KnownHashBuildOptions& opt,
+                       const std::wstring& outPath,
+                       uint64_t& count,
+                       std::wstring& error) {
+    count = 0;
+    const size_t digestSize = Digest::GetDigestSize(opt.algorithm);
+    if (digestSize != 8 && digestSize != 16 && digestSize != 20 && digestSize != 32) {
+        error = L"Algorithm has no fixed-width digest";
+        return false;
+    }
+
+    std::wstring runPrefix = opt.tempDirectory;
+    if (runPrefix.empty()) {
+        runPrefix = outPath;
+    } else {
+        size_t slash = outPath.find_last_of(L"/\\");
+        if (runPrefix.back() != L'/' && runPrefix.back() != L'\\') {
+            runPrefix.push_back(L'/');
+        }
+        runPrefix += slash == std::wstring::npos ? outPath : outPath.substr(slash + 1);
+    }
+    runPrefix += L".run";
+    RunBuilder builder(opt, digestSize, runPrefix);
+
+    // Whole lines go to the parser; a partial last line waits for the next
+    // block.
+    std::vector<char> block;
+    for (const std::wstring& listFile : listFiles) {
+        std::ifstream in;
+        OpenStream(in, listFile, std::ios::binary);
+        if (!in.is_open()) {
+            error = L"Failed to open list: " + listFile;
+            return false;
+        }
+        size_t carry = 0;
+        for (;;) {
+            block.resize(carry + kReadBlockSize);
+            in.read(block.data() + carry, static_cast<std::streamsize>(kReadBlockSize));
+            const size_t got = static_cast<size_t>(in.gcount());
+            const size_t size = carry + got;
+            const bool atEnd = got < kReadBlockSize;
+            if (atEnd && in.bad()) {
+                error = L"Failed to read list: " + listFile;
+                return false;
+            }
+            size_t whole = size;
+            if (!atEnd) {
+                while (whole > 0 && block[whole - 1] != '\n') {
+                    --whole;
+                }
+                // A line longer than a block: parse what there is.
+                if (whole == 0) {
+                    whole = size;
+                }
+            }
+            if (!builder.AddText(block.data(), whole, error)) {
+                return false;
+            }
+            carry = size - whole;
+            std::memmove(block.data(), block.data() + whole, carry);
+            if (atEnd) {
+                break;
+            }
+        }
+    }
+
+    uint64_t upperCount = 0;
+    std::vector<std::unique_ptr<RunReader>> runs;
+    if (!builder.OpenRuns(runs, upperCount, error)) {
+        return false;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.algorithm = static_cast<uint8_t>(opt.algorithm);
+    header.digestSize = static_cast<uint8_t>(digestSize);
+    if (opt.bloomBitsPerEntry != 0 && upperCount != 0) {
+        header.bloomBlocks = std::max<uint64_t>(1, (upperCount * opt.bloomBitsPerEntry + kBloomBlockSize * 8 - 1) / (kBloomBlockSize * 8));
+        header.bloomHashes = std::min<uint32_t>(kMaxBloomHashes, std::max<uint32_t>(1, (opt.bloomBitsPerEntry * 693 + 500) / 1000));
+    }
+    std::vector<uint8_t> bloom(static_cast<size_t>(header.bloomBlocks * kBloomBlockSize));
+    std::vector<uint64_t> fanout(kFanoutEntries, 0);
+
+    std::ofstream out;
+    OpenStream(out, outPath, std::ios::binary | std::ios::trunc);
+    std::vector<uint8_t> placeholder(static_cast<size_t>(kHeaderSize));
+    bool ok = out.is_open() && WriteAll(out, placeholder.data(), placeholder.size());
+
+    // k-way merge of the runs into the digest section, dropping duplicates
+    // across runs.
+    RunOrder order = {&runs, digestSize};
+    std::priority_queue<size_t, std::vector<size_t>, RunOrder> heap(order);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        heap.push(i);
+    }
+    std::vector<uint8_t> pending;
+    pending.reserve(kMergeBufferSize);
+    uint8_t last[kMaxDigestSize] = {};
+    while (ok && !heap.empty()) {
+        const size_t top = heap.top();
+        heap.pop();
+        const uint8_t* digest = runs[top]->Current();
+        if (count == 0 || std::memcmp(digest, last, digestSize) != 0) {
+            std::memcpy(last, digest, digestSize);
+            pending.insert(pending.end(), digest, digest + digestSize);
+            ++fanout[Prefix(digest)];
+            if (!bloom.empty()) {
+                BloomAdd(bloom.data(), header.bloomBlocks, header.bloomHashes, digest, digestSize);
+            }
+            ++count;
+            if (pending.size() + digestSize > kMergeBufferSize) {
+                ok = WriteAll(out, pending.data(), pending.size());
+                pending.clear();
+            }
+        }
+        if (runs[top]->Advance()) {
+            heap.push(top);
+        }
+    }
+    for (const auto& run : runs) {
+        if (run->failed || run->left != 0) {
+            ok = false;
+        }
+    }
+    ok = ok && WriteAll(out, pending.data(), pending.size());
+
+    for (size_t p = 1; p < kFanoutEntries; ++p) {
+        fanout[p] += fanout[p - 1];
+    }
+    uint64_t offset = kHeaderSize + count * digestSize;
+    header.count = count;
+    header.digestOffset = kHeaderSize;
+    ok = ok && WritePadding(out, offset, 8);
+    header.fanoutOffset = offset;
+    ok = ok && WriteAll(out, fanout.data(), fanout.size() * sizeof(uint64_t));
+    offset += fanout.size() * sizeof(uint64_t);
+    ok = ok && WritePadding(out, offset, kBloomBlockSize);
+    header.bloomOffset = offset;
+    ok = ok && WriteAll(out, bloom.data(), bloom.size());
+    // The header goes in last, so an interrupted build leaves no valid set.
+    if (ok) {
+        out.seekp(0);
+        ok = WriteAll(out, &header, sizeof(header));
+    }
+    out.close();
+    if (!ok || out.fail()) {
+        RemoveFile(outPath);
+        count = 0;
+        error = L"Failed to write known hash set";
+        return false;
+    }
+    return true;
+}
+
+KnownHashSet::KnownHashSet() {
+}
+
+KnownHashSet::~KnownHashSet() {
+    Close();
+}
+
+bool KnownHashSet::Open(const std::wstring& path, std::wstring& error) {
+    Close();
+    uint64_t size = 0;
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = L"Failed to open known hash set";
+        return false;
+    }
+    LARGE_INTEGER li = {};
+    if (!GetFileSizeEx(file, &li) || li.QuadPart < static_cast<LONGLONG>(kHeaderSize)) {
+        CloseHandle(file);
+        error = L"Not a known hash set";
+        return false;
+    }
+    size = static_cast<uint64_t>(li.QuadPart);
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+    }
+    if (view == nullptr) {
+        error = L"Failed to map known hash set";
+        return false;
+    }
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = L"Failed to open known hash set";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < kHeaderSize || static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        close(fd);
+        error = L"Not a known hash set";
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    void* view = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        error = L"Failed to map known hash set";
+        return false;
+    }
+    // Lookups land anywhere in the file; readahead would only waste I/O.
+    madvise(view, static_cast<size_t>(size), MADV_RANDOM);
+#endif
+    m_view = static_cast<const uint8_t*>(view);
+    m_viewSize = size;
+
+    FileHeader header;
+    std::memcpy(&header, m_view, sizeof(header));
+    const size_t digestSize =
+        header.algorithm <= static_cast<uint8_t>(HashAlgorithm::CRC32C) ? Digest::GetDigestSize(static_cast<HashAlgorithm>(header.algorithm)) : 0;
+    const bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.version == kVersion && digestSize != 0 &&
+                       header.digestSize == digestSize && header.digestOffset <= size &&
+                       header.count <= (size - header.digestOffset) / digestSize && header.fanoutOffset % 8 == 0 &&
+                       header.fanoutOffset <= size && (size - header.fanoutOffset) / sizeof(uint64_t) >= kFanoutEntries &&
+                       header.bloomOffset <= size && header.bloomBlocks <= (size - header.bloomOffset) / kBloomBlockSize &&
+                       header.bloomHashes <= kMaxBloomHashes;
+    const uint64_t* fanout = valid ? reinterpret_cast<const uint64_t*>(m_view + header.fanoutOffset) : nullptr;
+    if (!valid || fanout[kFanoutEntries - 1] != header.count) {
+        Close();
+        error = L"Not a known hash set";
+        return false;
+    }
+    m_algorithm = static_cast<HashAlgorithm>(header.algorithm);
+    m_digestSize = digestSize;
+    m_count = header.count;
+    m_fanout = fanout;
+    m_digests = m_view + header.digestOffset;
+    m_bloomBlocks = header.bloomBlocks;
+    m_bloomHashes = header.bloomHashes;
+    m_bloom = m_bloomBlocks != 0 ? m_view + header.bloomOffset : nullptr;
+    return true;
+}
+
+void KnownHashSet::Close() {
+    if (m_view != nullptr) {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_view);
+#else
+        munmap(const_cast<uint8_t*>(m_view), static_cast<size_t>(m_viewSize));
+#endif
+    }
+    m_view = nullptr;
+    m_viewSize = 0;
+    m_digestSize = 0;
+    m_count = 0;
+    m_fanout = nullptr;
+    m_bloom = nullptr;
+    m_bloomBlocks = 0;
+    m_bloomHashes = 0;
+    m_digests = nullptr;
+}
+
+bool KnownHashSet::MayContain(const uint8_t* digest) const {
+    if (m_bloom == nullptr) {
+        return true;
+    }
+    const uint64_t hash = BloomHash(digest, m_digestSize);
+    const uint8_t* block = m_bloom + (hash % m_bloomBlocks) * kBloomBlockSize;
+    const uint64_t bits = SplitMix(hash);
+    for (uint32_t i = 0; i < m_bloomHashes; ++i) {
+        const uint32_t bit = static_cast<uint32_t>(bits >> (9 * i)) & 511;
+        if ((block[bit >> 3] & (1u << (bit & 7))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KnownHashSet::Contains(const uint8_t* digest) const {
+    if (m_view == nullptr || m_count == 0 || !MayContain(digest)) {
+        return false;
+    }
+    const size_t prefix = Prefix(digest);
+    // Clamped, so a damaged table cannot send the search out of the file.
+    uint64_t hi = std::min<uint64_t>(m_fanout[prefix], m_count);
+    uint64_t lo = std::min<uint64_t>(prefix == 0 ? 0 : m_fanout[prefix - 1], hi);
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        const int cmp = std::memcmp(m_digests + mid * m_digestSize, digest, m_digestSize);
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+bool KnownHashSet::Contains(const std::wstring& hex) const {
+    if (hex.size() != m_digestSize * 2) {
+        return false;
+    }
+    uint8_t digest[kMaxDigestSize];
+    for (size_t i = 0; i < m_digestSize; ++i) {
+        const wchar_t hi = hex[2 * i];
+        const wchar_t lo = hex[2 * i + 1];
+        const int h = hi < 0x80 ? HexValue(static_cast<char>(hi)) : -1;
+        const int l = lo < 0x80 ? HexValue(static_cast<char>(lo)) : -1;
+        if (h < 0 || l < 0) {
+            return false;
+        }
+        digest[i] = static_cast<uint8_t>((h << 4) | l);
+    }
+    return Contains(digest);
+}
+
+void TagKnownHashes(const std::vector<const KnownHashSet*>& sets, std::vector<HashResult>& results) {
+    for (HashResult& result : results) {
+        HashAlgorithm algorithm;
+        if (!result.success || !ParseHashAlgorithmName(result.algorithm, algorithm)) {
+            continue;
+        }
+        for (const KnownHashSet* set : sets) {
+            if (set != nullptr && set->IsOpen() && set->GetAlgorithm() == algorithm) {
+                result.known = set->Contains(result.result) ? HashKnownState::Known : HashKnownState::Unknown;
+                break;
+            }
+        }
+    }
+}
+
+bool RunKnownHashSetSelfTest(std::wstring& error) {
+    auto sha1Text = [](uint32_t i) {
+        Digest digest(HashAlgorithm::SHA1);
+        digest.Update(&i, sizeof(i));
+        return digest.FinalText();
+    };
+    auto narrow = [](const std::wstring& s) { return std::string(s.begin(), s.end()); };
+    auto upper = [](std::string s) {
+        for (char& ch : s) {
+            if (ch >= 'a' && ch <= 'f') {
+                ch = static_cast<char>(ch - 'a' + 'A');
+            }
+        }
+        return s;
+    };
+
+    // Plain, sha1sum and NSRL CSV lines, upper and lower case, every digest
+    // listed twice, and lines without a digest of the right width.
+    const uint32_t listed = 5000;
+    std::string list = "\"SHA-1\",\"MD5\",\"CRC32\",\"FileName\"\r\n";
+    for (uint32_t i = 0; i < listed; ++i) {
+        const std::string hex = narrow(sha1Text(i));
+        switch (i % 3) {
+        case 0:
+            list += hex + "\n";
+            break;
+        case 1:
+            list += hex + "  file" + std::to_string(i) + ".dll\n";
+            break;
+        default:
+            list += "\"" + upper(hex) + "\",\"d41d8cd98f00b204e9800998ecf8427e\",\"00000000\",\"x.exe\"\r\n";
+            break;
+        }
+    }
+    for (uint32_t i = listed; i-- > 0;) {
+        list += upper(narrow(sha1Text(i))) + "\n";
+    }
+    list += "d41d8cd98f00b204e9800998ecf8427e  md5.txt\n0123456789abcdef0123456789abcdef0123456789abcdef  too-long\n";
+
+    const std::wstring base = GetSelfTestTempPath(L"peinfo-knownhash-");
+    const std::wstring listPath = base + L".txt";
+    const std::wstring setPath = base + L".set";
+    {
+        std::ofstream out;
+        OpenStream(out, listPath, std::ios::binary | std::ios::trunc);
+        out.write(list.data(), static_cast<std::streamsize>(list.size()));
+        if (!out) {
+            error = L"Cannot write the known hash test list";
+            return false;
+        }
+    }
+    KnownHashBuildOptions opt;
+    opt.algorithm = HashAlgorithm::SHA1;
+    // Several runs to merge.
+    opt.memoryBytes = 20 * 1500;
+    opt.threadCount = 4;
+    uint64_t count = 0;
+    bool ok = BuildKnownHashSet({listPath}, opt, setPath, count, error);
+    if (ok && count != listed) {
+        error = L"Known hash set has the wrong number of digests";
+        ok = false;
+    }
+    KnownHashSet set;
+    if (ok && !set.Open(setPath, error)) {
+        ok = false;
+    }
+    for (uint32_t i = 0; ok && i < listed * 2; ++i) {
+        if (set.Contains(sha1Text(i)) != (i < listed)) {
+            error = L"Known hash set lookup is wrong";
+            ok = false;
+        }
+    }
+    if (ok) {
+        std::vector<HashResult> results(3);
+        results[0].success = true;
+        results[0].algorithm = L"SHA1";
+        results[0].result = sha1Text(7);
+        results[1] = results[0];
+        results[1].result = sha1Text(listed + 7);
+        results[2].success = true;
+        results[2].algorithm = L"MD5";
+        results[2].result = L"d41d8cd98f00b204e9800998ecf8427e";
+        TagKnownHashes({&set}, results);
+        if (results[0].known != HashKnownState::Known || results[1].known != HashKnownState::Unknown ||
+            results[2].known != HashKnownState::Unchecked) {
+            error = L"Known hash tagging is wrong";
+            ok = false;
+        }
+    }
+    set.Close();
+    RemoveFile(listPath);
+    RemoveFile(setPath);
+    return ok;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "HashAlgorithm.h"
+#include "HashEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sets of known file digests (NSRL-style reference lists of hundreds of
+// millions of entries) for telling known files from unknown ones. The set is
+// a file of sorted fixed-width digests of one algorithm, behind a 64K-entry
+// fanout table on the first two digest bytes and a blocked Bloom filter. It
+// is mapped, not read, so opening costs nothing however large it is; a lookup
+// probes one cache line of the filter and, when that passes, binary-searches
+// one fanout bucket. Builds without Windows headers.
+
+struct KnownHashBuildOptions {
+    // Any algorithm with a binary digest of at least 8 bytes (not SSDEEP,
+    // TLSH or CRC32C).
+    HashAlgorithm algorithm = HashAlgorithm::SHA1;
+    // Digest bytes sorted in memory per run of the external sort
+    // (0 = 256 MiB).
+    uint64_t memoryBytes = 0;
+    // Threads that parse and sort (0 = hardware concurrency).
+    size_t threadCount = 0;
+    // Bloom filter size; about 1% false positives at 10, 0 leaves the filter
+    // out. The filter is built in memory.
+    uint32_t bloomBitsPerEntry = 10;
+    // Where sorted runs are kept while building; empty puts them next to the
+    // output file.
+    std::wstring tempDirectory;
+};
+
+// Builds a set from text lists. From each line the first run of hex digits
+// exactly as long as the algorithm's digest is taken, so plain lists,
+// sha1sum/sha256sum output and NSRL RDS CSV ("SHA-1","MD5",...) all work;
+// other lines are skipped. Lines are parsed and runs sorted on threadCount
+// threads; the runs are then merged, dropping duplicates. count receives the
+// number of distinct digests.
+bool BuildKnownHashSet(const std::vector<std::wstring>& listFiles,
+                       const KnownHashBuildOptions& opt,
+                       const std::wstring& outPath,
+                       uint64_t& count,
+                       std::wstring& error);
+
+// Read-only view of a set produced by BuildKnownHashSet. Lookups do not
+// allocate and may run on several threads at once.
+class KnownHashSet {
+public:
+    KnownHashSet();
+    ~KnownHashSet();
+    KnownHashSet(const KnownHashSet&) = delete;
+    KnownHashSet& operator=(const KnownHashSet&) = delete;
+
+    bool Open(const std::wstring& path, std::wstring& error);
+    void Close();
+    bool IsOpen() const { return m_view != nullptr; }
+
+    HashAlgorithm GetAlgorithm() const { return m_algorithm; }
+    size_t GetDigestSize() const { return m_digestSize; }
+    uint64_t GetCount() const { return m_count; }
+
+    // digest holds GetDigestSize() bytes.
+    bool Contains(const uint8_t* digest) const;
+    // Hex text as HashResult::result holds it, in either case; false for
+    // text that is not a digest of this set's width.
+    bool Contains(const std::wstring& hex) const;
+
+private:
+    bool MayContain(const uint8_t* digest) const;
+
+    const uint8_t* m_view = nullptr;
+    uint64_t m_viewSize = 0;
+    HashAlgorithm m_algorithm = HashAlgorithm::SHA1;
+    size_t m_digestSize = 0;
+    uint64_t m_count = 0;
+    const uint64_t* m_fanout = nullptr;
+    const uint8_t* m_bloom = nullptr;
+    uint64_t m_bloomBlocks = 0;
+    uint32_t m_bloomHashes = 0;
+    const uint8_t* m_digests = nullptr;
+};
+
+// Sets HashResult::known on every successful result whose algorithm one of
+// the sets covers (the first such set decides); other results are left
+// unchecked.
+void TagKnownHashes(const std::vector<const KnownHashSet*>& sets, std::vector<HashResult>& results);
+
+// A set built from a mixed list (with duplicates, across several runs) and
+// probed for every listed digest and for digests not listed; error describes
+// the first failure.
+bool RunKnownHashSetSelfTest(std::wstring& error);
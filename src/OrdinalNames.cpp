@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "OrdinalNames.h"
+
+#include "OrdinalNames.generated.h"
+
+namespace {
+
+bool EqualsIgnoreCaseAscii(const char* a, const char* b, size_t bLen) {
+    for (size_t i = 0; i < bLen; ++i) {
+        char x = a[i];
+        char y = b[i];
+        if (x == '\0') {
+            return false;
+        }
+        if (x >= 'A' && x <= 'Z') x = static_cast<char>(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = static_cast<char>(y - 'A' + 'a');
+        if (x != y) {
+            return false;
+        }
+    }
+    return a[bLen] == '\0';
+}
+
+} // namespace
+
+const char* LookupOrdinalName(const char* dllName, size_t dllNameLength, DWORD ordinal) {
+    uint32_t slot = OrdinalTableHash(ordinal_tables::kHashSeed, dllName, dllNameLength) & (ordinal_tables::kSlotCount - 1);
+    int idx = ordinal_tables::kSlots[slot];
+    if (idx < 0) {
+        return nullptr;
+    }
+    const OrdinalNameTable& t = ordinal_tables::kTables[idx];
+    if (!EqualsIgnoreCaseAscii(t.dllName, dllName, dllNameLength)) {
+        return nullptr;
+    }
+    if (ordinal < t.firstOrdinal || ordinal - t.firstOrdinal >= t.count) {
+        return nullptr;
+    }
+    return t.names[ordinal - t.firstOrdinal];
+}
+
+std::string ImportFunctionDisplayName(const std::string& dllName, const PEImportFunction& fn) {
+    if (!fn.isOrdinal) {
+        return fn.name;
+    }
+    const char* name = LookupOrdinalName(dllName, fn.ordinal);
+    if (name == nullptr) {
+        return fn.name;
+    }
+    return fn.name + " (" + name + ")";
+}
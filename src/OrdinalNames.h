@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PEParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct OrdinalNameTable {
+    const char* dllName;
+    uint32_t firstOrdinal;
+    uint32_t count;
+    const char* const* names;
+};
+
+// Case-insensitive FNV-1a; scripts/gen_ordinal_tables.py picks a seed for which
+// every table name lands in its own slot.
+constexpr uint32_t OrdinalTableHash(uint32_t seed, const char* s, size_t len) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; ++i) {
+        char ch = s[i];
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+        h ^= static_cast<uint8_t>(ch);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Returns the export name for an ordinal import from one of the built-in system
+// DLL tables, or nullptr. Does no I/O and no allocation.
+const char* LookupOrdinalName(const char* dllName, size_t dllNameLength, DWORD ordinal);
+
+inline const char* LookupOrdinalName(const std::string& dllName, DWORD ordinal) {
+    return LookupOrdinalName(dllName.data(), dllName.size(), ordinal);
+}
+
+// Import name as shown in reports: "Ordinal: N (name)" when the ordinal is known.
+std::string ImportFunctionDisplayName(const std::string& dllName, const PEImportFunction& fn);
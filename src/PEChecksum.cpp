@@ -0,0 +1,247 @@
+#include "PEChecksum.h"
+
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_CHECKSUM_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_CHECKSUM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Sum of `words` little-endian 16-bit words, without folding. A 64-bit total
+// cannot overflow for any file, and folding it once at the end gives the same
+// one's-complement result as folding after every word.
+typedef uint64_t (*SumWordsFn)(const uint8_t* data, size_t words);
+
+uint64_t SumWordsPortable(const uint8_t* data, size_t words) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < words; ++i) {
+        sum += static_cast<uint64_t>(data[2 * i]) | (static_cast<uint64_t>(data[2 * i + 1]) << 8);
+    }
+    return sum;
+}
+
+// The vector kernels add word pairs into 32-bit lanes, each growing by at
+// most 2 * 0xFFFF per block; the lanes are widened to 64 bits well before
+// they could wrap.
+const size_t kBlocksPerFlush = 16384;
+
+#if defined(PEINFO_CHECKSUM_X86)
+PEINFO_TARGET_SSE2 uint64_t SumWordsSse2(const uint8_t* data, size_t words) {
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    size_t blocks = words / 8;
+    const uint8_t* p = data;
+    while (blocks != 0) {
+        size_t n = std::min<size_t>(blocks, kBlocksPerFlush);
+        blocks -= n;
+        __m128i acc = zero;
+        for (size_t i = 0; i < n; ++i, p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            acc = _mm_add_epi32(acc, _mm_and_si128(v, lowMask));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+        }
+        total = _mm_add_epi64(total, _mm_unpacklo_epi32(acc, zero));
+        total = _mm_add_epi64(total, _mm_unpackhi_epi32(acc, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+    return lanes[0] + lanes[1] + SumWordsPortable(p, words % 8);
+}
+
+PEINFO_TARGET_AVX2 uint64_t SumWordsAvx2(const uint8_t* data, size_t words) {
+    const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    size_t blocks = words / 16;
+    const uint8_t* p = data;
+    while (blocks != 0) {
+        size_t n = std::min<size_t>(blocks, kBlocksPerFlush);
+        blocks -= n;
+        __m256i acc = zero;
+        for (size_t i = 0; i < n; ++i, p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, lowMask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+        }
+        total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(acc, zero));
+        total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(acc, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumWordsPortable(p, words % 16);
+}
+#endif
+
+#if defined(PEINFO_CHECKSUM_NEON)
+uint64_t SumWordsNeon(const uint8_t* data, size_t words) {
+    uint64x2_t total = vdupq_n_u64(0);
+    size_t blocks = words / 8;
+    const uint8_t* p = data;
+    while (blocks != 0) {
+        size_t n = std::min<size_t>(blocks, kBlocksPerFlush);
+        blocks -= n;
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (size_t i = 0; i < n; ++i, p += 16) {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p)));
+        }
+        total = vpadalq_u32(total, acc);
+    }
+    return vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1) + SumWordsPortable(p, words % 8);
+}
+#endif
+
+struct SumWordsImpl {
+    const char* name;
+    SumWordsFn sum;
+};
+
+const SumWordsImpl& GetSumWords() {
+    static const SumWordsImpl active = []() {
+        SumWordsImpl best = {"portable", SumWordsPortable};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_CHECKSUM_X86)
+        if (cpu.avx2) {
+            best = {"avx2", SumWordsAvx2};
+        } else if (cpu.sse2) {
+            best = {"sse2", SumWordsSse2};
+        }
+#elif defined(PEINFO_CHECKSUM_NEON)
+        (void)cpu;
+        best = {"neon", SumWordsNeon};
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+uint32_t Fold(uint64_t sum) {
+    while (sum > 0xFFFF) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<uint32_t>(sum);
+}
+
+} // namespace
+
+PEChecksumSink::PEChecksumSink(uint64_t checkSumOffset) : m_fieldOffset(checkSumOffset) {
+}
+
+void PEChecksumSink::Update(uint64_t offset, const uint8_t* data, size_t size) {
+    // The 4 bytes of the CheckSum field count as zeros, which add nothing.
+    const uint64_t end = offset + size;
+    const uint64_t fieldEnd = m_fieldOffset + sizeof(uint32_t);
+    if (m_fieldOffset >= end || fieldEnd <= offset) {
+        Add(offset, data, size);
+    } else {
+        uint64_t skipFrom = std::max<uint64_t>(offset, m_fieldOffset);
+        uint64_t skipTo = std::min<uint64_t>(end, fieldEnd);
+        Add(offset, data, static_cast<size_t>(skipFrom - offset));
+        Add(skipTo, data + (skipTo - offset), static_cast<size_t>(end - skipTo));
+    }
+    m_length = std::max<uint64_t>(m_length, end);
+}
+
+void PEChecksumSink::Add(uint64_t offset, const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    // A piece starting at an odd offset begins with the high byte of a word.
+    if (offset & 1) {
+        m_sum += static_cast<uint64_t>(data[0]) << 8;
+        ++data;
+        --size;
+    }
+    m_sum += GetSumWords().sum(data, size / 2);
+    // An odd last byte is the low byte of a word whose high byte comes next
+    // (or is the zero padding at the end of the file).
+    if (size & 1) {
+        m_sum += data[size - 1];
+    }
+}
+
+uint32_t PEChecksumSink::Final() const {
+    return Fold(m_sum) + static_cast<uint32_t>(m_length);
+}
+
+uint32_t ComputePEChecksum(const uint8_t* data, size_t size, uint64_t checkSumOffset) {
+    PEChecksumSink sink(checkSumOffset);
+    sink.Update(0, data, size);
+    return sink.Final();
+}
+
+const char* GetPEChecksumImplName() {
+    return GetSumWords().name;
+}
+
+bool RunPEChecksumSelfTest(std::wstring& error) {
+    std::vector<uint8_t> data(70000 * 2 + 7);
+    uint32_t x = 0x12345678;
+    for (auto& b : data) {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+    const SumWordsImpl& active = GetSumWords();
+    const size_t lengths[] = {0, 1, 2, 15, 16, 17, 31, 32, 33, 4095, 70000};
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t words : lengths) {
+            if (active.sum(data.data() + offset, words) != SumWordsPortable(data.data() + offset, words)) {
+                error = L"PE checksum word sum differs from the portable one";
+                return false;
+            }
+        }
+    }
+    // Known answers from the CheckSumMappedFile algorithm: an odd-length DOS
+    // header fragment, and the buffer above with the field at an odd offset
+    // and where a PE32 header keeps it.
+    static const uint8_t kDosHeader[] = {0x4D, 0x5A, 0x90, 0x00, 0x03, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00};
+    struct KnownChecksum {
+        const uint8_t* data;
+        size_t size;
+        uint64_t fieldOffset;
+        uint32_t expected;
+    };
+    const KnownChecksum known[] = {
+        {kDosHeader, sizeof(kDosHeader), 4, 0x5AF0},
+        {data.data(), data.size(), 0x99, 0x2ED2F},
+        {data.data(), data.size(), 0xD8, 0x22311},
+    };
+    for (const KnownChecksum& k : known) {
+        if (ComputePEChecksum(k.data, k.size, k.fieldOffset) != k.expected) {
+            error = L"PE checksum does not match its known answer";
+            return false;
+        }
+    }
+
+    // Split updates, including odd split points and one inside the field.
+    uint32_t whole = ComputePEChecksum(data.data(), data.size(), 0x99);
+    const size_t splits[] = {1, 0x9A, 0x9B, 4097, 100001};
+    for (size_t split : splits) {
+        PEChecksumSink sink(0x99);
+        sink.Update(0, data.data(), split);
+        sink.Update(split, data.data() + split, data.size() - split);
+        if (sink.Final() != whole) {
+            error = L"PE checksum changes with the update split";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "HashEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// PE image checksum as CheckSumMappedFile computes it: the 16-bit
+// one's-complement sum of the file's little-endian words, with the CheckSum
+// field taken as zero, plus the file size. The word sum runs on SSE2, AVX2 or
+// NEON where available. Builds without Windows headers.
+
+struct PEChecksumResult {
+    uint32_t stored = 0;
+    uint32_t computed = 0;
+    // A stored 0 means the image carries no checksum, which the loader only
+    // accepts outside drivers and boot components.
+    bool IsSet() const { return stored != 0; }
+    bool Matches() const { return stored == computed; }
+};
+
+// Fed alongside the digests of a HashEngine pass; the chunks must arrive in
+// file order starting at offset 0.
+class PEChecksumSink : public HashSink {
+public:
+    explicit PEChecksumSink(uint64_t checkSumOffset);
+
+    void Update(uint64_t offset, const uint8_t* data, size_t size) override;
+    uint32_t Final() const;
+
+private:
+    void Add(uint64_t offset, const uint8_t* data, size_t size);
+
+    uint64_t m_fieldOffset;
+    uint64_t m_sum = 0;
+    uint64_t m_length = 0;
+};
+
+uint32_t ComputePEChecksum(const uint8_t* data, size_t size, uint64_t checkSumOffset);
+// "portable", "sse2", "avx2" or "neon".
+const char* GetPEChecksumImplName();
+// Compares the vector kernel with the portable one on awkward lengths and
+// alignments; error describes the first difference.
+bool RunPEChecksumSelfTest(std::wstring& error);
@@ -1,8 +1,12 @@
 #include "stdafx.h"
 #include "PECore.h"
+#include "ReportUtil.h"
 
 #include <wintrust.h>
 
+#include <algorithm>
+#include <memory>
+
 static int ComputeVerifyExitCode(SignatureSource source,
                                  bool presenceReady,
                                  const PESignaturePresence& presence,
@@ -69,11 +73,46 @@ static SignatureSource MapAutoSource(const PESignaturePresence& presence) {
     return SignatureSource::Embedded;
 }
 
+// The headers, each section's raw data and the overlay, clipped to the file.
+// The fields and the certificate table that signing rewrites are left out, so
+// these hashes survive re-signing and timestamping.
+static std::vector<HashRegion> GetPEHashRegions(const PEParser& parser) {
+    std::vector<HashRegion> regions;
+    const uint64_t fileSize = parser.GetFileSize();
+    std::vector<HashSkipRange> signing = GetAuthenticodeSkipRanges(parser);
+
+    HashRegion headers;
+    headers.name = L"headers";
+    headers.size = std::min<uint64_t>(parser.GetHeaderInfo().sizeOfHeaders, fileSize);
+    headers.skip = signing;
+    regions.push_back(headers);
+
+    uint64_t dataEnd = headers.size;
+    for (const auto& s : parser.GetSectionsInfo()) {
+        HashRegion section;
+        section.name = ToWStringUtf8BestEffort(s.name);
+        section.offset = std::min<uint64_t>(s.rawAddress, fileSize);
+        section.size = std::min<uint64_t>(s.rawSize, fileSize - section.offset);
+        dataEnd = std::max<uint64_t>(dataEnd, section.offset + section.size);
+        regions.push_back(section);
+    }
+
+    if (dataEnd < fileSize) {
+        HashRegion overlay;
+        overlay.name = L"overlay";
+        overlay.offset = dataEnd;
+        overlay.size = fileSize - dataEnd;
+        overlay.skip = signing;
+        regions.push_back(overlay);
+    }
+    return regions;
+}
+
 bool AnalyzePeFile(const std::wstring& filePath, const PEAnalysisOptions& opt, PEAnalysisResult& out, std::wstring& error) {
     out = {};
     out.filePath = filePath;
 
-    bool isPeValid = out.parser.LoadFile(filePath);
+    bool isPeValid = out.parser.LoadFile(filePath, opt.cachePolicy);
     if (!isPeValid) {
         if (!out.parser.IsLoaded()) {
             error = out.parser.GetLastError();
@@ -122,19 +161,65 @@ bool AnalyzePeFile(const std::wstring& filePath, const PEAnalysisOptions& opt, P
     }
 
     if (opt.computeHashes) {
-        HashCalculator calc;
-        calc.SetChunkSize(4u << 20);
-        if (opt.hashCancel) {
-            calc.SetCancelFlag(opt.hashCancel);
-        }
-        if (opt.hashProgress) {
-            calc.SetProgressCallback(opt.hashProgress);
-        }
+        HashEngineOptions hashOptions;
+        hashOptions.chunkSize = 4u << 20;
+        hashOptions.cancel = opt.hashCancel;
+        hashOptions.progress = opt.hashProgress;
         std::vector<HashAlgorithm> algs = opt.hashAlgorithms;
         if (algs.empty()) {
             algs = {HashAlgorithm::SHA256};
         }
-        out.hashes = calc.CalculateFileHashes(filePath, algs);
+        std::vector<HashRequest> requests;
+        for (HashAlgorithm alg : algs) {
+            requests.push_back({alg, {}});
+        }
+        const size_t fuzzyCount = opt.computeFuzzyHashes ? 2 : 0;
+        if (opt.computeFuzzyHashes) {
+            requests.push_back({HashAlgorithm::SSDEEP, {}});
+            requests.push_back({HashAlgorithm::TLSH, {}});
+        }
+        std::unique_ptr<PEChecksumSink> checksum;
+        std::unique_ptr<RegionHashSink> regions;
+        std::unique_ptr<ContentChunkSink> chunks;
+        std::vector<HashSink*> sinks;
+        DWORD checkSumOffset = 0;
+        DWORD securityEntryOffset = 0;
+        if (isPeValid) {
+            std::vector<HashSkipRange> skip = GetAuthenticodeSkipRanges(out.parser);
+            requests.push_back({HashAlgorithm::SHA1, skip});
+            requests.push_back({HashAlgorithm::SHA256, skip});
+            if (out.parser.GetChecksumFieldOffsets(checkSumOffset, securityEntryOffset)) {
+                checksum.reset(new PEChecksumSink(checkSumOffset));
+                sinks.push_back(checksum.get());
+            }
+            std::vector<HashRegion> hashRegions = GetPEHashRegions(out.parser);
+            regions.reset(new RegionHashSink(hashRegions, algs));
+            sinks.push_back(regions.get());
+            if (opt.computeSectionChunks) {
+                // The section regions sit between the headers and the overlay.
+                const size_t sectionCount = out.parser.GetSectionsInfo().size();
+                std::vector<HashRegion> sections(hashRegions.begin() + 1, hashRegions.begin() + 1 + sectionCount);
+                chunks.reset(new ContentChunkSink(sections));
+                sinks.push_back(chunks.get());
+            }
+        }
+        // The parser already holds the whole file; hash that copy rather than
+        // reading the file a second time.
+        HashSource source = HashSource::FromMemory(out.parser.GetFileData(), out.parser.GetFileSize());
+        out.hashes = HashEngine(hashOptions).Hash(source, requests, sinks);
+        if (checksum && !out.hashes.empty() && out.hashes.front().success) {
+            out.checksum = PEChecksumResult{static_cast<uint32_t>(out.parser.GetHeaderInfo().checksum), checksum->Final()};
+        }
+        if (regions && !out.hashes.empty() && out.hashes.front().success) {
+            out.regionHashes = regions->Final();
+        }
+        if (chunks && !out.hashes.empty() && out.hashes.front().success) {
+            out.sectionChunks = chunks->Final();
+        }
+        out.fuzzyHashes.assign(out.hashes.begin() + algs.size(), out.hashes.begin() + algs.size() + fuzzyCount);
+        out.authentihashes.assign(out.hashes.begin() + algs.size() + fuzzyCount, out.hashes.end());
+        out.hashes.resize(algs.size());
+        TagKnownHashes(opt.knownHashSets, out.hashes);
         for (const auto& r : out.hashes) {
             if (r.success && r.algorithm == L"SHA256") {
                 out.reportHash = r;
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "ChunkHash.h"
 #include "HashCalculator.h"
+#include "KnownHashSet.h"
+#include "PEChecksum.h"
 #include "PEDebugInfo.h"
 #include "PEParser.h"
 #include "PESignature.h"
+#include "RegionHash.h"
 #include "ReportTypes.h"
 
 #include <optional>
@@ -26,9 +30,20 @@ struct PEAnalysisOptions {
     SignatureSource sigSource = SignatureSource::Auto;
     bool computeHashes = false;
     std::vector<HashAlgorithm> hashAlgorithms;
+    // Also SSDEEP and TLSH of the whole file, from the same pass.
+    bool computeFuzzyHashes = false;
+    // Also content-defined chunk lists of each section, from the same pass.
+    bool computeSectionChunks = false;
     ReportTimeFormat timeFormat = ReportTimeFormat::Local;
+    // (processed, total)
     std::function<void(uint64_t, uint64_t)> hashProgress;
     std::atomic<bool>* hashCancel = nullptr;
+    // Sets the whole-file hashes are looked up in, to mark them known or
+    // unknown (HashResult::known); not owned.
+    std::vector<const KnownHashSet*> knownHashSets;
+    // What reading the file leaves in the page cache; it is read once, and
+    // hashed from memory.
+    PageCachePolicy cachePolicy = PageCachePolicy::Cached;
 };
 
 struct PEAnalysisResult {
@@ -44,6 +59,21 @@ struct PEAnalysisResult {
 
     std::vector<HashResult> hashes;
     std::optional<HashResult> reportHash;
+    // Authenticode image hashes (SHA1, SHA256) for valid PE files, computed
+    // in the same pass as hashes.
+    std::vector<HashResult> authentihashes;
+    // SSDEEP and TLSH when computeFuzzyHashes is set.
+    std::vector<HashResult> fuzzyHashes;
+    // Optional-header CheckSum against the recomputed one, for valid PE
+    // files; also from the hashing pass.
+    std::optional<PEChecksumResult> checksum;
+    // Hashes of the headers, each section's raw data and the overlay, with
+    // the same algorithms as hashes; signing fields and the certificate table
+    // are left out so that they are stable across re-signing.
+    std::vector<RegionHashResult> regionHashes;
+    // Content-defined chunks of each section's raw data when
+    // computeSectionChunks is set; compare with CompareChunkLists.
+    std::vector<RegionChunks> sectionChunks;
 
     int verifyExitCode = 0;
 };
@@ -94,3 +94,48 @@ std::optional<PEPdbInfo> ExtractPdbInfo(const PEParser& parser) {
 
     return std::nullopt;
 }
+
+std::vector<PEDebugEntry> EnumerateDebugEntries(const PEParser& parser) {
+    std::vector<PEDebugEntry> out;
+    DWORD dirRva = 0;
+    DWORD dirSize = 0;
+    if (!parser.GetDebugDirectory(dirRva, dirSize)) {
+        return out;
+    }
+    DWORD dirOffset = parser.RVAToFileOffsetPublic(dirRva);
+    if (dirOffset == 0) {
+        return out;
+    }
+
+    DWORD count = dirSize / static_cast<DWORD>(sizeof(IMAGE_DEBUG_DIRECTORY));
+    for (DWORD i = 0; i < count; ++i) {
+        IMAGE_DEBUG_DIRECTORY entry = {};
+        if (!parser.ReadBytes(dirOffset + i * static_cast<DWORD>(sizeof(IMAGE_DEBUG_DIRECTORY)), &entry, sizeof(entry))) {
+            break;
+        }
+        PEDebugEntry e = {};
+        e.type = entry.Type;
+        e.characteristics = entry.Characteristics;
+        e.timeDateStamp = entry.TimeDateStamp;
+        e.majorVersion = entry.MajorVersion;
+        e.minorVersion = entry.MinorVersion;
+        e.sizeOfData = entry.SizeOfData;
+        e.addressOfRawData = entry.AddressOfRawData;
+        e.pointerToRawData = entry.PointerToRawData;
+        out.push_back(e);
+    }
+    return out;
+}
+
+std::string DebugTypeName(DWORD type) {
+    // Numbers rather than IMAGE_DEBUG_TYPE_* so that older SDKs, which lack
+    // the newer types, build too.
+    static const char* kNames[] = {"UNKNOWN", "COFF", "CODEVIEW", "FPO", "MISC", "EXCEPTION", "FIXUP",
+                                   "OMAP_TO_SRC", "OMAP_FROM_SRC", "BORLAND", "RESERVED10", "CLSID",
+                                   "VC_FEATURE", "POGO", "ILTCG", "MPX", "REPRO", "EMBEDDED_PORTABLE_PDB",
+                                   "SPGO", "PDBCHECKSUM", "EX_DLLCHARACTERISTICS"};
+    if (type < sizeof(kNames) / sizeof(kNames[0])) {
+        return kNames[type];
+    }
+    return std::to_string(type);
+}
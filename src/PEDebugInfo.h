@@ -4,6 +4,7 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 struct PEPdbInfo {
     bool hasRsds;
@@ -12,6 +13,23 @@ struct PEPdbInfo {
     std::string pdbPath;
 };
 
+// One IMAGE_DEBUG_DIRECTORY entry.
+struct PEDebugEntry {
+    DWORD type;
+    DWORD characteristics;
+    DWORD timeDateStamp;
+    WORD majorVersion;
+    WORD minorVersion;
+    DWORD sizeOfData;
+    DWORD addressOfRawData;
+    DWORD pointerToRawData;
+};
+
 std::optional<PEPdbInfo> ExtractPdbInfo(const PEParser& parser);
+// Every entry of the debug directory, in directory order; empty when there
+// is none or it cannot be read.
+std::vector<PEDebugEntry> EnumerateDebugEntries(const PEParser& parser);
+// "CODEVIEW", "POGO", "REPRO", "VC_FEATURE", ... or the type number.
+std::string DebugTypeName(DWORD type);
 std::string FormatGuidLower(const GUID& guid);
 
@@ -0,0 +1,416 @@
+#include "stdafx.h"
+#include "PEDependencyGraph.h"
+
+#include "JsonReader.h"
+#include "ReportUtil.h"
+#include "WorkerPool.h"
+
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+namespace {
+
+struct ParsedImage {
+    std::vector<PEImportDLL> imports;
+    std::vector<PEImportDLL> delayImports;
+    std::shared_ptr<const PEModuleExports> exports;
+};
+
+struct EdgeSource {
+    int node = -1;
+    size_t edge = 0;
+    bool delayLoad = false;
+    size_t dllIndex = 0;
+    // The same edge in the previous graph when the importer was reused.
+    const PEDependencyEdge* previous = nullptr;
+};
+
+std::string ToLowerAscii(std::string s) {
+    for (char& ch : s) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+    return s;
+}
+
+std::wstring ToLowerPath(std::wstring s) {
+    for (wchar_t& ch : s) {
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    }
+    return s;
+}
+
+std::wstring DirectoryOf(const std::wstring& path) {
+    size_t slash = path.find_last_of(L"\\/");
+    return (slash == std::wstring::npos) ? std::wstring() : path.substr(0, slash);
+}
+
+std::string BaseNameLower(const std::wstring& path) {
+    size_t slash = path.find_last_of(L"\\/");
+    return ToLowerAscii(WStringToUtf8((slash == std::wstring::npos) ? path : path.substr(slash + 1)));
+}
+
+std::wstring JoinPath(const std::wstring& dir, const std::string& name) {
+    std::wstring out = dir;
+    if (!out.empty() && out.back() != L'\\' && out.back() != L'/') {
+        out.push_back(L'\\');
+    }
+    return out + ToWStringUtf8BestEffort(name);
+}
+
+bool IsRegularFile(const std::wstring& path) {
+    DWORD attr = GetFileAttributesW(path.c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+bool GetFileStamp(const std::wstring& path, uint64_t& size, uint64_t& lastWriteTime) {
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+        return false;
+    }
+    size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    lastWriteTime = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+bool ParseImage(const PEDependencyNode& node, ParsedImage& image, std::wstring& error) {
+    PEParser parser;
+    if (!parser.LoadFile(node.filePath)) {
+        error = parser.GetLastError();
+        return false;
+    }
+    image.imports = parser.GetImports();
+    image.delayImports = parser.GetDelayImports();
+    image.exports = ExtractModuleExports(parser, node.name, node.filePath);
+    return true;
+}
+
+std::string JsonString(const JsonValue& object, const char* key) {
+    const JsonValue* v = object.Find(key);
+    return (v != nullptr && v->type == JsonValue::Type::String) ? v->text : std::string();
+}
+
+bool JsonBool(const JsonValue& object, const char* key) {
+    const JsonValue* v = object.Find(key);
+    return v != nullptr && v->IsTrue();
+}
+
+uint64_t JsonUint(const JsonValue& object, const char* key) {
+    const JsonValue* v = object.Find(key);
+    uint64_t n = 0;
+    if (v == nullptr || !v->ToUint64(n)) {
+        return 0;
+    }
+    return n;
+}
+
+} // namespace
+
+bool BuildDependencyGraph(const std::vector<std::wstring>& roots,
+                          const PEDependencyOptions& opt,
+                          PEDependencyGraph& out,
+                          std::wstring& error) {
+    out = PEDependencyGraph();
+    if (roots.empty()) {
+        error = L"No input files";
+        return false;
+    }
+
+    std::unordered_map<std::wstring, int> byPath;
+    std::vector<ParsedImage> images;
+    std::vector<EdgeSource> edgeSources;
+    std::set<std::string> missing;
+    out.includeDelayImports = opt.includeDelayImports;
+
+    // Edges recorded without delay imports cannot stand in for a run that
+    // wants them.
+    const PEDependencyGraph* previous = opt.previous;
+    if (previous != nullptr && opt.includeDelayImports && !previous->includeDelayImports) {
+        previous = nullptr;
+    }
+    std::unordered_map<std::wstring, const PEDependencyNode*> previousByPath;
+    if (previous != nullptr) {
+        for (const auto& node : previous->nodes) {
+            if (node.parsed) {
+                previousByPath.emplace(ToLowerPath(node.filePath), &node);
+            }
+        }
+    }
+    // Per node: its entry in the previous graph when it was reused.
+    std::vector<const PEDependencyNode*> previousOf;
+
+    // Returns the node index and whether the node was newly added.
+    auto addNode = [&](const std::wstring& path, bool isRoot) -> std::pair<int, bool> {
+        std::wstring key = ToLowerPath(path);
+        auto it = byPath.find(key);
+        if (it != byPath.end()) {
+            out.nodes[static_cast<size_t>(it->second)].isRoot |= isRoot;
+            return {it->second, false};
+        }
+        PEDependencyNode node;
+        node.name = BaseNameLower(path);
+        node.filePath = path;
+        node.isRoot = isRoot;
+        out.nodes.push_back(std::move(node));
+        int idx = static_cast<int>(out.nodes.size() - 1);
+        byPath.emplace(key, idx);
+        return {idx, true};
+    };
+
+    std::vector<int> frontier;
+    for (const auto& root : roots) {
+        auto added = addNode(root, true);
+        if (added.second) {
+            frontier.push_back(added.first);
+        }
+    }
+
+    while (!frontier.empty()) {
+        images.resize(out.nodes.size());
+        previousOf.resize(out.nodes.size());
+        RunParallel(frontier.size(), opt.threadCount, [&](size_t k) {
+            size_t idx = static_cast<size_t>(frontier[k]);
+            PEDependencyNode& node = out.nodes[idx];
+            auto prev = previousByPath.find(ToLowerPath(node.filePath));
+            if (prev != previousByPath.end()) {
+                uint64_t size = 0;
+                uint64_t lastWriteTime = 0;
+                if (GetFileStamp(node.filePath, size, lastWriteTime) && size == prev->second->fileSize &&
+                    lastWriteTime == prev->second->lastWriteTime) {
+                    node.parsed = true;
+                    node.reused = true;
+                    node.fileSize = size;
+                    node.lastWriteTime = lastWriteTime;
+                    previousOf[idx] = prev->second;
+                    return;
+                }
+            }
+            if (!ParseImage(node, images[idx], node.error)) {
+                return;
+            }
+            node.parsed = true;
+            GetFileStamp(node.filePath, node.fileSize, node.lastWriteTime);
+        });
+
+        // Resolution runs on one thread in frontier order so node numbering is
+        // stable from run to run.
+        std::vector<int> next;
+        for (int idx : frontier) {
+            if (!out.nodes[static_cast<size_t>(idx)].parsed) {
+                continue;
+            }
+            std::wstring ownDir = DirectoryOf(out.nodes[static_cast<size_t>(idx)].filePath);
+
+            // Paths are resolved again even for reused nodes: a DLL may have
+            // appeared in or left one of the search directories.
+            auto addEdge = [&](PEDependencyEdge edge, size_t dllIndex, const PEDependencyEdge* previousEdge) {
+                if (IsApiSetName(edge.dllName)) {
+                    edge.apiSet = true;
+                } else {
+                    std::wstring found;
+                    if (IsRegularFile(JoinPath(ownDir, edge.dllName))) {
+                        found = JoinPath(ownDir, edge.dllName);
+                    } else {
+                        for (const auto& dir : opt.searchDirectories) {
+                            std::wstring candidate = JoinPath(dir, edge.dllName);
+                            if (IsRegularFile(candidate)) {
+                                found = candidate;
+                                break;
+                            }
+                        }
+                    }
+                    if (found.empty()) {
+                        missing.insert(edge.dllName);
+                    } else {
+                        auto added = addNode(found, false);
+                        if (added.second) {
+                            next.push_back(added.first);
+                        }
+                        edge.target = added.first;
+                    }
+                }
+
+                auto& edges = out.nodes[static_cast<size_t>(idx)].edges;
+                if (edge.target >= 0) {
+                    edgeSources.push_back(EdgeSource{idx, edges.size(), edge.delayLoad, dllIndex, previousEdge});
+                }
+                edges.push_back(std::move(edge));
+            };
+
+            if (const PEDependencyNode* prev = previousOf[static_cast<size_t>(idx)]) {
+                // Edges were recorded imports first, then delay imports, one
+                // per DLL entry, so counting them gives the entry index.
+                size_t dllIndex[2] = {0, 0};
+                for (const auto& prevEdge : prev->edges) {
+                    if (prevEdge.delayLoad && !opt.includeDelayImports) {
+                        continue;
+                    }
+                    PEDependencyEdge edge;
+                    edge.dllName = prevEdge.dllName;
+                    edge.delayLoad = prevEdge.delayLoad;
+                    edge.importCount = prevEdge.importCount;
+                    addEdge(std::move(edge), dllIndex[prevEdge.delayLoad ? 1 : 0]++, &prevEdge);
+                }
+            } else {
+                auto addEdges = [&](const std::vector<PEImportDLL>& dlls, bool delayLoad) {
+                    for (size_t d = 0; d < dlls.size(); ++d) {
+                        PEDependencyEdge edge;
+                        edge.dllName = ToLowerAscii(dlls[d].dllName);
+                        edge.delayLoad = delayLoad;
+                        edge.importCount = dlls[d].functions.size();
+                        addEdge(std::move(edge), d, nullptr);
+                    }
+                };
+                addEdges(images[static_cast<size_t>(idx)].imports, false);
+                if (opt.includeDelayImports) {
+                    addEdges(images[static_cast<size_t>(idx)].delayImports, true);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+
+    // An edge between two unchanged files keeps its earlier unresolved
+    // imports. Any other edge needs the importer's import list and the
+    // target's exports, so reused nodes at either end are parsed after all.
+    images.resize(out.nodes.size());
+    previousOf.resize(out.nodes.size());
+    std::vector<EdgeSource> toCheck;
+    std::vector<char> needsImage(out.nodes.size(), 0);
+    for (const EdgeSource& src : edgeSources) {
+        PEDependencyEdge& edge = out.nodes[static_cast<size_t>(src.node)].edges[src.edge];
+        const PEDependencyNode* target = previousOf[static_cast<size_t>(edge.target)];
+        if (src.previous != nullptr && target != nullptr && src.previous->target >= 0 &&
+            &previous->nodes[static_cast<size_t>(src.previous->target)] == target) {
+            edge.unresolvedImports = src.previous->unresolvedImports;
+            continue;
+        }
+        if (previousOf[static_cast<size_t>(src.node)] != nullptr) {
+            needsImage[static_cast<size_t>(src.node)] = 1;
+        }
+        if (target != nullptr) {
+            needsImage[static_cast<size_t>(edge.target)] = 1;
+        }
+        toCheck.push_back(src);
+    }
+    std::vector<size_t> lateParse;
+    for (size_t i = 0; i < needsImage.size(); ++i) {
+        if (needsImage[i]) {
+            lateParse.push_back(i);
+        }
+    }
+    RunParallel(lateParse.size(), opt.threadCount, [&](size_t k) {
+        size_t idx = lateParse[k];
+        std::wstring ignored;
+        ParseImage(out.nodes[idx], images[idx], ignored);
+    });
+
+    RunParallel(toCheck.size(), opt.threadCount, [&](size_t i) {
+        const EdgeSource& src = toCheck[i];
+        PEDependencyEdge& edge = out.nodes[static_cast<size_t>(src.node)].edges[src.edge];
+        const ParsedImage& importer = images[static_cast<size_t>(src.node)];
+        const auto& dlls = src.delayLoad ? importer.delayImports : importer.imports;
+        const auto& exports = images[static_cast<size_t>(edge.target)].exports;
+        // A reused file that no longer parses leaves the edge unchecked.
+        if (!exports || src.dllIndex >= dlls.size()) {
+            return;
+        }
+        for (const auto& f : dlls[src.dllIndex].functions) {
+            const PEExportFunction* e = f.isOrdinal ? exports->FindByOrdinal(f.ordinal) : exports->FindByName(f.name);
+            if (e == nullptr) {
+                edge.unresolvedImports.push_back(f.isOrdinal ? "#" + std::to_string(f.ordinal) : f.name);
+            }
+        }
+    });
+
+    for (const auto& node : out.nodes) {
+        for (const auto& edge : node.edges) {
+            out.unresolvedImportCount += edge.unresolvedImports.size();
+        }
+    }
+    out.missingDlls.assign(missing.begin(), missing.end());
+    return true;
+}
+
+bool LoadDependencyGraph(const std::wstring& path, PEDependencyGraph& out, std::wstring& error) {
+    out = PEDependencyGraph();
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) {
+        error = L"Failed to open dependency graph: " + path;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        error = L"Failed to read dependency graph: " + path;
+        return false;
+    }
+
+    JsonValue root;
+    size_t errorLine = 0;
+    std::wstring what;
+    if (!ParseJson(text, root, errorLine, what)) {
+        error = L"Dependency graph line " + std::to_wstring(errorLine) + L": " + what;
+        return false;
+    }
+    const JsonValue* nodes = root.Find("nodes");
+    if (root.type != JsonValue::Type::Object || nodes == nullptr || nodes->type != JsonValue::Type::Array) {
+        error = L"Dependency graph has no \"nodes\" array";
+        return false;
+    }
+
+    // Graphs that do not say were written before delay imports were recorded
+    // as optional; treat them as incomplete.
+    out.includeDelayImports = JsonBool(root, "includeDelayImports");
+    for (const JsonValue& item : nodes->items) {
+        const JsonValue* edges = item.Find("edges");
+        std::string filePath = JsonString(item, "path");
+        if (item.type != JsonValue::Type::Object || filePath.empty() || edges == nullptr || edges->type != JsonValue::Type::Array) {
+            error = L"Dependency graph line " + std::to_wstring(item.line) + L": expected a node with \"path\" and \"edges\"";
+            return false;
+        }
+        PEDependencyNode node;
+        node.name = JsonString(item, "name");
+        node.filePath = ToWStringUtf8BestEffort(filePath);
+        node.isRoot = JsonBool(item, "root");
+        node.parsed = JsonBool(item, "parsed");
+        node.error = ToWStringUtf8BestEffort(JsonString(item, "error"));
+        node.fileSize = JsonUint(item, "size");
+        node.lastWriteTime = JsonUint(item, "lastWriteTime");
+        for (const JsonValue& e : edges->items) {
+            PEDependencyEdge edge;
+            edge.dllName = JsonString(e, "dll");
+            edge.delayLoad = JsonBool(e, "delayLoad");
+            edge.apiSet = JsonBool(e, "apiSet");
+            edge.importCount = static_cast<size_t>(JsonUint(e, "importCount"));
+            const JsonValue* target = e.Find("target");
+            uint64_t targetIndex = 0;
+            if (target != nullptr && target->ToUint64(targetIndex) && targetIndex < nodes->items.size()) {
+                edge.target = static_cast<int>(targetIndex);
+            }
+            const JsonValue* unresolved = e.Find("unresolvedImports");
+            if (unresolved != nullptr) {
+                for (const JsonValue& name : unresolved->items) {
+                    if (name.type == JsonValue::Type::String) {
+                        edge.unresolvedImports.push_back(name.text);
+                    }
+                }
+            }
+            out.unresolvedImportCount += edge.unresolvedImports.size();
+            node.edges.push_back(std::move(edge));
+        }
+        out.nodes.push_back(std::move(node));
+    }
+    const JsonValue* missing = root.Find("missingDlls");
+    if (missing != nullptr) {
+        for (const JsonValue& name : missing->items) {
+            if (name.type == JsonValue::Type::String) {
+                out.missingDlls.push_back(name.text);
+            }
+        }
+    }
+    return true;
+}
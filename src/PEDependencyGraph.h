@@ -0,0 +1,66 @@
+#pragma once
+
+#include "PEForwarderResolver.h"
+#include "PEParser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct PEDependencyGraph;
+
+struct PEDependencyOptions {
+    // Searched in order after the importing module's own directory.
+    std::vector<std::wstring> searchDirectories;
+    bool includeDelayImports = true;
+    size_t threadCount = 0;
+    // Graph from an earlier run (see LoadDependencyGraph). A node whose file
+    // still has the recorded size and last-write time is not parsed again: its
+    // edges come from the previous graph, and so do their unresolved imports
+    // while the target is unchanged as well. Ignored when it was built without
+    // delay imports and this run includes them.
+    const PEDependencyGraph* previous = nullptr;
+};
+
+struct PEDependencyEdge {
+    std::string dllName;
+    bool delayLoad = false;
+    // API set contracts are resolved by the loader, not by a file on disk.
+    bool apiSet = false;
+    int target = -1;
+    size_t importCount = 0;
+    std::vector<std::string> unresolvedImports;
+};
+
+struct PEDependencyNode {
+    std::string name;
+    std::wstring filePath;
+    bool isRoot = false;
+    bool parsed = false;
+    std::wstring error;
+    uint64_t fileSize = 0;
+    uint64_t lastWriteTime = 0;
+    // Taken from PEDependencyOptions::previous instead of being parsed.
+    bool reused = false;
+    std::vector<PEDependencyEdge> edges;
+};
+
+struct PEDependencyGraph {
+    bool includeDelayImports = true;
+    std::vector<PEDependencyNode> nodes;
+    std::vector<std::string> missingDlls;
+    size_t unresolvedImportCount = 0;
+};
+
+// Walks imports (and optionally delay imports) from the roots, resolving each
+// DLL name the way the loader's safe search order would for the given
+// directories. Every image is parsed once per run; newly discovered DLLs are
+// parsed a level at a time on a worker pool.
+bool BuildDependencyGraph(const std::vector<std::wstring>& roots,
+                          const PEDependencyOptions& opt,
+                          PEDependencyGraph& out,
+                          std::wstring& error);
+
+// Reads a graph written by BuildJsonDependencyReport, for use as
+// PEDependencyOptions::previous.
+bool LoadDependencyGraph(const std::wstring& path, PEDependencyGraph& out, std::wstring& error);
@@ -0,0 +1,610 @@
+#include "stdafx.h"
+#include "PEDiff.h"
+
+#include "HashCalculator.h"
+#include "PEDebugInfo.h"
+#include "PEResource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+typedef std::vector<std::pair<const char*, std::string>> FieldList;
+
+std::string HexValue(uint64_t v, int width) {
+    std::ostringstream oss;
+    oss << "0x" << std::hex << std::setw(width) << std::setfill('0') << v;
+    return oss.str();
+}
+
+void CollectHeaderFields(const PEHeaderInfo& h, FieldList& out) {
+    out.clear();
+    out.emplace_back("Machine", HexValue(h.machine, 4));
+    out.emplace_back("NumberOfSections", std::to_string(h.numberOfSections));
+    out.emplace_back("TimeDateStamp", HexValue(h.timeDateStamp, 8));
+    out.emplace_back("PointerToSymbolTable", HexValue(h.pointerToSymbolTable, 8));
+    out.emplace_back("NumberOfSymbols", std::to_string(h.numberOfSymbols));
+    out.emplace_back("SizeOfOptionalHeader", HexValue(h.sizeOfOptionalHeader, 4));
+    out.emplace_back("Characteristics", HexValue(h.characteristics, 4));
+    out.emplace_back("OptionalMagic", HexValue(h.peOptionalMagic, 4));
+    out.emplace_back("LinkerVersion", std::to_string(h.majorLinkerVersion) + "." + std::to_string(h.minorLinkerVersion));
+    out.emplace_back("SizeOfCode", HexValue(h.sizeOfCode, 8));
+    out.emplace_back("SizeOfInitializedData", HexValue(h.sizeOfInitializedData, 8));
+    out.emplace_back("SizeOfUninitializedData", HexValue(h.sizeOfUninitializedData, 8));
+    out.emplace_back("AddressOfEntryPoint", HexValue(h.entryPoint, 8));
+    out.emplace_back("BaseOfCode", HexValue(h.baseOfCode, 8));
+    out.emplace_back("BaseOfData", HexValue(h.baseOfData, 8));
+    out.emplace_back("ImageBase", HexValue(h.imageBase, 16));
+    out.emplace_back("SectionAlignment", HexValue(h.sectionAlignment, 8));
+    out.emplace_back("FileAlignment", HexValue(h.fileAlignment, 8));
+    out.emplace_back("OperatingSystemVersion", std::to_string(h.majorOperatingSystemVersion) + "." + std::to_string(h.minorOperatingSystemVersion));
+    out.emplace_back("ImageVersion", std::to_string(h.majorImageVersion) + "." + std::to_string(h.minorImageVersion));
+    out.emplace_back("SubsystemVersion", std::to_string(h.majorSubsystemVersion) + "." + std::to_string(h.minorSubsystemVersion));
+    out.emplace_back("Win32VersionValue", HexValue(h.win32VersionValue, 8));
+    out.emplace_back("SizeOfImage", HexValue(h.sizeOfImage, 8));
+    out.emplace_back("SizeOfHeaders", HexValue(h.sizeOfHeaders, 8));
+    out.emplace_back("CheckSum", HexValue(h.checksum, 8));
+    out.emplace_back("Subsystem", HexValue(h.subsystemValue, 4));
+    out.emplace_back("DllCharacteristics", HexValue(h.dllCharacteristics, 4));
+    out.emplace_back("SizeOfStackReserve", HexValue(h.sizeOfStackReserve, 16));
+    out.emplace_back("SizeOfStackCommit", HexValue(h.sizeOfStackCommit, 16));
+    out.emplace_back("SizeOfHeapReserve", HexValue(h.sizeOfHeapReserve, 16));
+    out.emplace_back("SizeOfHeapCommit", HexValue(h.sizeOfHeapCommit, 16));
+    out.emplace_back("LoaderFlags", HexValue(h.loaderFlags, 8));
+    out.emplace_back("NumberOfRvaAndSizes", std::to_string(h.numberOfRvaAndSizes));
+
+    static const char* kDirNames[IMAGE_NUMBEROF_DIRECTORY_ENTRIES] = {
+        "Export", "Import", "Resource", "Exception", "Security", "BaseReloc", "Debug", "Architecture",
+        "GlobalPtr", "TLS", "LoadConfig", "BoundImport", "IAT", "DelayImport", "ComDescriptor", "Reserved"};
+    // Only the directories NumberOfRvaAndSizes covers; the loader ignores the
+    // rest of the array.
+    size_t dirCount = std::min<size_t>(h.numberOfRvaAndSizes, h.dataDirectories.size());
+    for (size_t i = 0; i < dirCount; ++i) {
+        const auto& d = h.dataDirectories[i];
+        out.emplace_back(kDirNames[i], HexValue(d.VirtualAddress, 8) + "/" + HexValue(d.Size, 8));
+    }
+}
+
+// Lists can differ in length (NumberOfRvaAndSizes); fields only one side has
+// are reported with an empty value on the other.
+void DiffFieldLists(const FieldList& a, const FieldList& b, std::vector<PEDiffField>& out) {
+    size_t n = std::max<size_t>(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        if (i >= b.size()) {
+            out.push_back(PEDiffField{a[i].first, a[i].second, std::string()});
+        } else if (i >= a.size()) {
+            out.push_back(PEDiffField{b[i].first, std::string(), b[i].second});
+        } else if (a[i].second != b[i].second) {
+            out.push_back(PEDiffField{a[i].first, a[i].second, b[i].second});
+        }
+    }
+}
+
+void AddFieldIfDifferent(std::vector<PEDiffField>& out, const char* name, uint64_t a, uint64_t b, int width) {
+    if (a != b) {
+        out.push_back(PEDiffField{name, HexValue(a, width), HexValue(b, width)});
+    }
+}
+
+std::string ToLowerAscii(const std::string& s) {
+    std::string out = s;
+    for (auto& ch : out) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+    return out;
+}
+
+// ---- Sections ----
+
+struct SectionKey {
+    std::string name;
+    uint32_t occurrence = 0;
+    size_t index = 0;
+};
+
+std::vector<SectionKey> BuildSectionKeys(const std::vector<PESectionInfo>& sections) {
+    std::vector<SectionKey> keys;
+    keys.reserve(sections.size());
+    // Running count per name: there can be up to 65535 sections.
+    std::unordered_map<std::string, uint32_t> seen;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        SectionKey k;
+        k.name = sections[i].name;
+        k.index = i;
+        k.occurrence = seen[k.name]++;
+        keys.push_back(std::move(k));
+    }
+    std::sort(keys.begin(), keys.end(), [](const SectionKey& a, const SectionKey& b) {
+        if (a.name != b.name) return a.name < b.name;
+        return a.occurrence < b.occurrence;
+    });
+    return keys;
+}
+
+// The section's raw data, clipped to the file.
+std::pair<const uint8_t*, size_t> GetSectionData(const PEParser& parser, const PESectionInfo& s) {
+    size_t fileSize = parser.GetFileSize();
+    uint64_t start = s.rawAddress;
+    uint64_t end = start + s.rawSize;
+    if (start > fileSize) {
+        start = fileSize;
+    }
+    if (end > fileSize) {
+        end = fileSize;
+    }
+    return {parser.GetFileData() + start, static_cast<size_t>(end - start)};
+}
+
+std::wstring HashSectionData(HashCalculator& calc, const PEParser& parser, const PESectionInfo& s) {
+    std::pair<const uint8_t*, size_t> data = GetSectionData(parser, s);
+    HashResult r = calc.CalculateBufferHash(data.first, data.second, HashAlgorithm::SHA256);
+    return r.success ? r.result : std::wstring();
+}
+
+ChunkCompareResult CompareSectionChunks(const PEParser& oldImage, const PESectionInfo& a, const PEParser& newImage, const PESectionInfo& b) {
+    std::pair<const uint8_t*, size_t> oldData = GetSectionData(oldImage, a);
+    std::pair<const uint8_t*, size_t> newData = GetSectionData(newImage, b);
+    return CompareChunkLists(ChunkBuffer(oldData.first, oldData.second, a.rawAddress),
+                             ChunkBuffer(newData.first, newData.second, b.rawAddress));
+}
+
+void DiffSections(const PEParser& oldImage, const PEParser& newImage, PEDiffResult& out) {
+    std::vector<PESectionInfo> oldSections = oldImage.GetSectionsInfo();
+    std::vector<PESectionInfo> newSections = newImage.GetSectionsInfo();
+    std::vector<SectionKey> oldKeys = BuildSectionKeys(oldSections);
+    std::vector<SectionKey> newKeys = BuildSectionKeys(newSections);
+
+    HashCalculator calc;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < oldKeys.size() || j < newKeys.size()) {
+        int cmp = 0;
+        if (i >= oldKeys.size()) {
+            cmp = 1;
+        } else if (j >= newKeys.size()) {
+            cmp = -1;
+        } else if (oldKeys[i].name != newKeys[j].name) {
+            cmp = oldKeys[i].name < newKeys[j].name ? -1 : 1;
+        } else if (oldKeys[i].occurrence != newKeys[j].occurrence) {
+            cmp = oldKeys[i].occurrence < newKeys[j].occurrence ? -1 : 1;
+        }
+
+        PESectionDiff d;
+        if (cmp < 0) {
+            const auto& s = oldSections[oldKeys[i].index];
+            d.change = PEDiffChange::Removed;
+            d.name = s.name;
+            d.occurrence = oldKeys[i].occurrence;
+            d.oldInfo = s;
+            d.oldHash = HashSectionData(calc, oldImage, s);
+            out.sections.push_back(std::move(d));
+            ++i;
+            continue;
+        }
+        if (cmp > 0) {
+            const auto& s = newSections[newKeys[j].index];
+            d.change = PEDiffChange::Added;
+            d.name = s.name;
+            d.occurrence = newKeys[j].occurrence;
+            d.newInfo = s;
+            d.newHash = HashSectionData(calc, newImage, s);
+            out.sections.push_back(std::move(d));
+            ++j;
+            continue;
+        }
+
+        const auto& a = oldSections[oldKeys[i].index];
+        const auto& b = newSections[newKeys[j].index];
+        d.change = PEDiffChange::Modified;
+        d.name = a.name;
+        d.occurrence = oldKeys[i].occurrence;
+        d.oldInfo = a;
+        d.newInfo = b;
+        d.oldHash = HashSectionData(calc, oldImage, a);
+        d.newHash = HashSectionData(calc, newImage, b);
+        d.contentChanged = d.oldHash.empty() || d.oldHash != d.newHash;
+        if (d.contentChanged) {
+            d.chunks = CompareSectionChunks(oldImage, a, newImage, b);
+        }
+        AddFieldIfDifferent(d.fields, "VirtualAddress", a.virtualAddress, b.virtualAddress, 8);
+        AddFieldIfDifferent(d.fields, "VirtualSize", a.virtualSize, b.virtualSize, 8);
+        AddFieldIfDifferent(d.fields, "PointerToRawData", a.rawAddress, b.rawAddress, 8);
+        AddFieldIfDifferent(d.fields, "SizeOfRawData", a.rawSize, b.rawSize, 8);
+        AddFieldIfDifferent(d.fields, "Characteristics", a.characteristics, b.characteristics, 8);
+        if (d.contentChanged || !d.fields.empty()) {
+            out.sections.push_back(std::move(d));
+        } else {
+            ++out.sectionsIdentical;
+        }
+        ++i;
+        ++j;
+    }
+}
+
+// ---- Imports ----
+
+struct ImportKey {
+    std::string dllLower;
+    const PEImportDLL* dll = nullptr;
+    const PEImportFunction* fn = nullptr;
+};
+
+std::vector<ImportKey> BuildImportKeys(const std::vector<PEImportDLL>& dlls) {
+    std::vector<ImportKey> keys;
+    size_t total = 0;
+    for (const auto& d : dlls) {
+        total += d.functions.size();
+    }
+    keys.reserve(total);
+    for (const auto& d : dlls) {
+        std::string lower = ToLowerAscii(d.dllName);
+        for (const auto& fn : d.functions) {
+            keys.push_back(ImportKey{lower, &d, &fn});
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [](const ImportKey& a, const ImportKey& b) {
+        if (a.dllLower != b.dllLower) return a.dllLower < b.dllLower;
+        return a.fn->name < b.fn->name;
+    });
+    keys.erase(std::unique(keys.begin(), keys.end(), [](const ImportKey& a, const ImportKey& b) {
+                   return a.dllLower == b.dllLower && a.fn->name == b.fn->name;
+               }),
+               keys.end());
+    return keys;
+}
+
+void DiffImportTables(const std::vector<PEImportDLL>& oldDlls, const std::vector<PEImportDLL>& newDlls, std::vector<PEImportDiff>& out) {
+    std::vector<ImportKey> a = BuildImportKeys(oldDlls);
+    std::vector<ImportKey> b = BuildImportKeys(newDlls);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        int cmp = 0;
+        if (i >= a.size()) {
+            cmp = 1;
+        } else if (j >= b.size()) {
+            cmp = -1;
+        } else {
+            cmp = a[i].dllLower.compare(b[j].dllLower);
+            if (cmp == 0) {
+                cmp = a[i].fn->name.compare(b[j].fn->name);
+            }
+        }
+        if (cmp < 0) {
+            out.push_back(PEImportDiff{PEDiffChange::Removed, a[i].dll->dllName, a[i].fn->name});
+            ++i;
+        } else if (cmp > 0) {
+            out.push_back(PEImportDiff{PEDiffChange::Added, b[j].dll->dllName, b[j].fn->name});
+            ++j;
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// ---- Exports ----
+
+struct ExportKey {
+    std::string key;
+    const PEExportFunction* fn = nullptr;
+};
+
+std::vector<ExportKey> BuildExportKeys(const std::vector<PEExportFunction>& exports) {
+    std::vector<ExportKey> keys;
+    keys.reserve(exports.size());
+    for (const auto& e : exports) {
+        if (e.rva == 0 && !e.hasName) {
+            continue;
+        }
+        keys.push_back(ExportKey{e.hasName ? e.name : ("#" + std::to_string(e.ordinal)), &e});
+    }
+    std::sort(keys.begin(), keys.end(), [](const ExportKey& a, const ExportKey& b) { return a.key < b.key; });
+    return keys;
+}
+
+void DiffExports(const PEParser& oldImage, const PEParser& newImage, std::vector<PEExportDiff>& out) {
+    std::vector<ExportKey> a = BuildExportKeys(oldImage.GetExports());
+    std::vector<ExportKey> b = BuildExportKeys(newImage.GetExports());
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        int cmp = 0;
+        if (i >= a.size()) {
+            cmp = 1;
+        } else if (j >= b.size()) {
+            cmp = -1;
+        } else {
+            cmp = a[i].key.compare(b[j].key);
+        }
+
+        PEExportDiff d;
+        if (cmp < 0) {
+            d.change = PEDiffChange::Removed;
+            d.key = a[i].key;
+            d.oldExport = *a[i].fn;
+            out.push_back(std::move(d));
+            ++i;
+            continue;
+        }
+        if (cmp > 0) {
+            d.change = PEDiffChange::Added;
+            d.key = b[j].key;
+            d.newExport = *b[j].fn;
+            out.push_back(std::move(d));
+            ++j;
+            continue;
+        }
+
+        const PEExportFunction& x = *a[i].fn;
+        const PEExportFunction& y = *b[j].fn;
+        AddFieldIfDifferent(d.fields, "Ordinal", x.ordinal, y.ordinal, 4);
+        AddFieldIfDifferent(d.fields, "RVA", x.rva, y.rva, 8);
+        if (x.isForwarded != y.isForwarded || x.forwarder != y.forwarder) {
+            d.fields.push_back(PEDiffField{"Forwarder", x.forwarder, y.forwarder});
+        }
+        if (!d.fields.empty()) {
+            d.change = PEDiffChange::Modified;
+            d.key = a[i].key;
+            d.oldExport = x;
+            d.newExport = y;
+            out.push_back(std::move(d));
+        }
+        ++i;
+        ++j;
+    }
+}
+
+// ---- Resources ----
+
+std::wstring ResourceIdKey(const PEResourceNameOrId& id) {
+    if (id.isString) {
+        return id.name;
+    }
+    return L"#" + std::to_wstring(id.id);
+}
+
+struct ResourceKey {
+    std::wstring type;
+    std::wstring name;
+    WORD language = 0;
+    const PEResourceItem* item = nullptr;
+};
+
+std::vector<ResourceKey> BuildResourceKeys(const std::vector<PEResourceItem>& items) {
+    std::vector<ResourceKey> keys;
+    keys.reserve(items.size());
+    for (const auto& it : items) {
+        keys.push_back(ResourceKey{ResourceIdKey(it.type), ResourceIdKey(it.name), it.language, &it});
+    }
+    std::sort(keys.begin(), keys.end(), [](const ResourceKey& a, const ResourceKey& b) {
+        if (a.type != b.type) return a.type < b.type;
+        if (a.name != b.name) return a.name < b.name;
+        return a.language < b.language;
+    });
+    return keys;
+}
+
+bool ResourceBytesEqual(const PEParser& oldImage, const PEResourceItem& a, const PEParser& newImage, const PEResourceItem& b) {
+    if (a.size != b.size) {
+        return false;
+    }
+    if (a.size == 0) {
+        return true;
+    }
+    uint64_t aEnd = static_cast<uint64_t>(a.rawOffset) + a.size;
+    uint64_t bEnd = static_cast<uint64_t>(b.rawOffset) + b.size;
+    if (a.rawOffset == 0 || b.rawOffset == 0 || aEnd > oldImage.GetFileSize() || bEnd > newImage.GetFileSize()) {
+        return false;
+    }
+    return memcmp(oldImage.GetFileData() + a.rawOffset, newImage.GetFileData() + b.rawOffset, a.size) == 0;
+}
+
+void DiffResources(const PEParser& oldImage, const PEParser& newImage, std::vector<PEResourceDiff>& out) {
+    std::vector<PEResourceItem> oldItems;
+    std::vector<PEResourceItem> newItems;
+    std::wstring err;
+    DWORD rva = 0;
+    DWORD size = 0;
+    if (oldImage.GetResourceDirectory(rva, size)) {
+        EnumerateResources(oldImage, oldItems, err);
+    }
+    if (newImage.GetResourceDirectory(rva, size)) {
+        EnumerateResources(newImage, newItems, err);
+    }
+
+    std::vector<ResourceKey> a = BuildResourceKeys(oldItems);
+    std::vector<ResourceKey> b = BuildResourceKeys(newItems);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        int cmp = 0;
+        if (i >= a.size()) {
+            cmp = 1;
+        } else if (j >= b.size()) {
+            cmp = -1;
+        } else if (a[i].type != b[j].type) {
+            cmp = a[i].type < b[j].type ? -1 : 1;
+        } else if (a[i].name != b[j].name) {
+            cmp = a[i].name < b[j].name ? -1 : 1;
+        } else if (a[i].language != b[j].language) {
+            cmp = a[i].language < b[j].language ? -1 : 1;
+        }
+
+        if (cmp < 0) {
+            out.push_back(PEResourceDiff{PEDiffChange::Removed, a[i].type, a[i].name, a[i].language, a[i].item->size, 0});
+            ++i;
+        } else if (cmp > 0) {
+            out.push_back(PEResourceDiff{PEDiffChange::Added, b[j].type, b[j].name, b[j].language, 0, b[j].item->size});
+            ++j;
+        } else {
+            if (!ResourceBytesEqual(oldImage, *a[i].item, newImage, *b[j].item)) {
+                out.push_back(PEResourceDiff{PEDiffChange::Modified, a[i].type, a[i].name, a[i].language, a[i].item->size, b[j].item->size});
+            }
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// ---- Debug ----
+
+struct DebugEntryKey {
+    DWORD type = 0;
+    uint32_t occurrence = 0;
+    size_t index = 0;
+};
+
+std::vector<DebugEntryKey> BuildDebugEntryKeys(const std::vector<PEDebugEntry>& entries) {
+    std::vector<DebugEntryKey> keys;
+    keys.reserve(entries.size());
+    std::unordered_map<DWORD, uint32_t> seen;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        DebugEntryKey k;
+        k.type = entries[i].type;
+        k.index = i;
+        k.occurrence = seen[k.type]++;
+        keys.push_back(k);
+    }
+    std::sort(keys.begin(), keys.end(), [](const DebugEntryKey& a, const DebugEntryKey& b) {
+        if (a.type != b.type) return a.type < b.type;
+        return a.occurrence < b.occurrence;
+    });
+    return keys;
+}
+
+std::wstring HashDebugData(HashCalculator& calc, const PEParser& parser, const PEDebugEntry& e) {
+    DWORD offset = e.pointerToRawData;
+    if (offset == 0 && e.addressOfRawData != 0) {
+        offset = parser.RVAToFileOffsetPublic(e.addressOfRawData);
+    }
+    if (offset == 0 || static_cast<uint64_t>(offset) + e.sizeOfData > parser.GetFileSize()) {
+        return std::wstring();
+    }
+    HashResult r = calc.CalculateBufferHash(parser.GetFileData() + offset, e.sizeOfData, HashAlgorithm::SHA256);
+    return r.success ? r.result : std::wstring();
+}
+
+// Entries are compared by type, header fields and data digest; where the
+// data sits is left out, as it moves with any layout change.
+void DiffDebugEntries(const PEParser& oldImage, const PEParser& newImage, std::vector<PEDebugEntryDiff>& out) {
+    std::vector<PEDebugEntry> oldEntries = EnumerateDebugEntries(oldImage);
+    std::vector<PEDebugEntry> newEntries = EnumerateDebugEntries(newImage);
+    std::vector<DebugEntryKey> oldKeys = BuildDebugEntryKeys(oldEntries);
+    std::vector<DebugEntryKey> newKeys = BuildDebugEntryKeys(newEntries);
+
+    HashCalculator calc;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < oldKeys.size() || j < newKeys.size()) {
+        int cmp = 0;
+        if (i >= oldKeys.size()) {
+            cmp = 1;
+        } else if (j >= newKeys.size()) {
+            cmp = -1;
+        } else if (oldKeys[i].type != newKeys[j].type) {
+            cmp = oldKeys[i].type < newKeys[j].type ? -1 : 1;
+        } else if (oldKeys[i].occurrence != newKeys[j].occurrence) {
+            cmp = oldKeys[i].occurrence < newKeys[j].occurrence ? -1 : 1;
+        }
+
+        PEDebugEntryDiff d;
+        if (cmp < 0) {
+            d.change = PEDiffChange::Removed;
+            d.type = DebugTypeName(oldKeys[i].type);
+            d.occurrence = oldKeys[i].occurrence;
+            d.oldEntry = oldEntries[oldKeys[i].index];
+            d.oldHash = HashDebugData(calc, oldImage, d.oldEntry);
+            out.push_back(std::move(d));
+            ++i;
+            continue;
+        }
+        if (cmp > 0) {
+            d.change = PEDiffChange::Added;
+            d.type = DebugTypeName(newKeys[j].type);
+            d.occurrence = newKeys[j].occurrence;
+            d.newEntry = newEntries[newKeys[j].index];
+            d.newHash = HashDebugData(calc, newImage, d.newEntry);
+            out.push_back(std::move(d));
+            ++j;
+            continue;
+        }
+
+        const PEDebugEntry& a = oldEntries[oldKeys[i].index];
+        const PEDebugEntry& b = newEntries[newKeys[j].index];
+        d.change = PEDiffChange::Modified;
+        d.type = DebugTypeName(a.type);
+        d.occurrence = oldKeys[i].occurrence;
+        d.oldEntry = a;
+        d.newEntry = b;
+        d.oldHash = HashDebugData(calc, oldImage, a);
+        d.newHash = HashDebugData(calc, newImage, b);
+        AddFieldIfDifferent(d.fields, "Characteristics", a.characteristics, b.characteristics, 8);
+        AddFieldIfDifferent(d.fields, "TimeDateStamp", a.timeDateStamp, b.timeDateStamp, 8);
+        AddFieldIfDifferent(d.fields, "MajorVersion", a.majorVersion, b.majorVersion, 4);
+        AddFieldIfDifferent(d.fields, "MinorVersion", a.minorVersion, b.minorVersion, 4);
+        AddFieldIfDifferent(d.fields, "SizeOfData", a.sizeOfData, b.sizeOfData, 8);
+        if (d.oldHash != d.newHash) {
+            std::string oldHash(d.oldHash.begin(), d.oldHash.end());
+            std::string newHash(d.newHash.begin(), d.newHash.end());
+            d.fields.push_back(PEDiffField{"Data.SHA256", oldHash, newHash});
+        }
+        if (!d.fields.empty()) {
+            out.push_back(std::move(d));
+        }
+        ++i;
+        ++j;
+    }
+}
+
+void CollectDebugFields(const PEParser& parser, FieldList& out) {
+    out.clear();
+    std::optional<PEPdbInfo> pdb = ExtractPdbInfo(parser);
+    bool has = pdb.has_value() && pdb->hasRsds;
+    out.emplace_back("Pdb.Present", has ? "true" : "false");
+    out.emplace_back("Pdb.Guid", has ? FormatGuidLower(pdb->guid) : std::string());
+    out.emplace_back("Pdb.Age", has ? std::to_string(pdb->age) : std::string());
+    out.emplace_back("Pdb.Path", has ? pdb->pdbPath : std::string());
+}
+
+} // namespace
+
+std::string PEDiffChangeName(PEDiffChange change) {
+    switch (change) {
+        case PEDiffChange::Added: return "added";
+        case PEDiffChange::Removed: return "removed";
+        case PEDiffChange::Modified: return "modified";
+    }
+    return "unknown";
+}
+
+bool DiffPeImages(const PEParser& oldImage, const PEParser& newImage, PEDiffResult& out, std::wstring& error) {
+    out = {};
+    if (!oldImage.IsValidPE() || !newImage.IsValidPE()) {
+        error = L"Both inputs must be valid PE files";
+        return false;
+    }
+
+    FieldList a;
+    FieldList b;
+    CollectHeaderFields(oldImage.GetHeaderInfo(), a);
+    CollectHeaderFields(newImage.GetHeaderInfo(), b);
+    DiffFieldLists(a, b, out.headers);
+
+    DiffSections(oldImage, newImage, out);
+    DiffImportTables(oldImage.GetImports(), newImage.GetImports(), out.imports);
+    DiffImportTables(oldImage.GetDelayImports(), newImage.GetDelayImports(), out.delayImports);
+    DiffExports(oldImage, newImage, out.exports);
+    DiffResources(oldImage, newImage, out.resources);
+
+    DiffDebugEntries(oldImage, newImage, out.debugEntries);
+    CollectDebugFields(oldImage, a);
+    CollectDebugFields(newImage, b);
+    DiffFieldLists(a, b, out.debug);
+    return true;
+}
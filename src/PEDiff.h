@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ChunkHash.h"
+#include "PEDebugInfo.h"
+#include "PEParser.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class PEDiffChange {
+    Added,
+    Removed,
+    Modified
+};
+
+struct PEDiffField {
+    std::string name;
+    std::string oldValue;
+    std::string newValue;
+};
+
+struct PESectionDiff {
+    PEDiffChange change = PEDiffChange::Modified;
+    std::string name;
+    uint32_t occurrence = 0;
+    PESectionInfo oldInfo = {};
+    PESectionInfo newInfo = {};
+    std::wstring oldHash;
+    std::wstring newHash;
+    bool contentChanged = false;
+    // Content-defined chunks shared and changed between the two versions,
+    // for sections whose content changed.
+    ChunkCompareResult chunks;
+    std::vector<PEDiffField> fields;
+};
+
+struct PEImportDiff {
+    PEDiffChange change = PEDiffChange::Added;
+    std::string dllName;
+    std::string function;
+};
+
+struct PEExportDiff {
+    PEDiffChange change = PEDiffChange::Modified;
+    std::string key;
+    PEExportFunction oldExport = {};
+    PEExportFunction newExport = {};
+    std::vector<PEDiffField> fields;
+};
+
+struct PEResourceDiff {
+    PEDiffChange change = PEDiffChange::Modified;
+    std::wstring type;
+    std::wstring name;
+    WORD language = 0;
+    DWORD oldSize = 0;
+    DWORD newSize = 0;
+};
+
+// A debug directory entry, matched by type and its occurrence among the
+// entries of that type.
+struct PEDebugEntryDiff {
+    PEDiffChange change = PEDiffChange::Modified;
+    std::string type;
+    uint32_t occurrence = 0;
+    PEDebugEntry oldEntry = {};
+    PEDebugEntry newEntry = {};
+    // SHA-256 of the entry's data; empty when it is not in the file.
+    std::wstring oldHash;
+    std::wstring newHash;
+    std::vector<PEDiffField> fields;
+};
+
+struct PEDiffResult {
+    std::vector<PEDiffField> headers;
+    std::vector<PESectionDiff> sections;
+    uint32_t sectionsIdentical = 0;
+    std::vector<PEImportDiff> imports;
+    std::vector<PEImportDiff> delayImports;
+    std::vector<PEExportDiff> exports;
+    std::vector<PEResourceDiff> resources;
+    std::vector<PEDebugEntryDiff> debugEntries;
+    // CodeView RSDS details: PDB GUID, age and path.
+    std::vector<PEDiffField> debug;
+
+    bool IsIdentical() const {
+        return headers.empty() && sections.empty() && imports.empty() && delayImports.empty() && exports.empty() &&
+               resources.empty() && debugEntries.empty() && debug.empty();
+    }
+};
+
+std::string PEDiffChangeName(PEDiffChange change);
+
+// Compares two already-parsed images. All tables are matched with sorted merges;
+// section contents are compared through their SHA-256 digests, and changed
+// ones through their content-defined chunk lists.
+bool DiffPeImages(const PEParser& oldImage, const PEParser& newImage, PEDiffResult& out, std::wstring& error);
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "PEForwarderResolver.h"
+
+#include "ReportUtil.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+const size_t kMaxForwarderHops = 32;
+
+std::string ToLowerAscii(std::string s) {
+    for (char& ch : s) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+    return s;
+}
+
+// Forwarder strings name the target module without its extension
+// ("NTDLL.RtlAllocateHeap"), so the cache key always carries one.
+std::string NormalizeDllKey(const std::string& dllName) {
+    std::string key = ToLowerAscii(dllName);
+    size_t slash = key.find_last_of("\\/");
+    if (slash != std::string::npos) {
+        key = key.substr(slash + 1);
+    }
+    if (key.find('.') == std::string::npos) {
+        key += ".dll";
+    }
+    return key;
+}
+
+std::string ExportKey(const PEExportFunction& e) {
+    if (e.hasName && !e.name.empty()) {
+        return e.name;
+    }
+    return "#" + std::to_string(e.ordinal);
+}
+
+std::string DllNameFromPath(const std::wstring& path) {
+    size_t slash = path.find_last_of(L"\\/");
+    std::wstring base = (slash == std::wstring::npos) ? path : path.substr(slash + 1);
+    return WStringToUtf8(base);
+}
+
+} // namespace
+
+const PEExportFunction* PEModuleExports::FindByName(const std::string& name) const {
+    auto it = std::lower_bound(byName.begin(), byName.end(), name, [&](uint32_t idx, const std::string& key) {
+        return exports[idx].name < key;
+    });
+    if (it == byName.end() || exports[*it].name != name) {
+        return nullptr;
+    }
+    return &exports[*it];
+}
+
+const PEExportFunction* PEModuleExports::FindByOrdinal(DWORD ordinal) const {
+    if (ordinal < ordinalBase) {
+        return nullptr;
+    }
+    size_t idx = static_cast<size_t>(ordinal - ordinalBase);
+    if (idx >= exports.size() || exports[idx].rva == 0) {
+        return nullptr;
+    }
+    return &exports[idx];
+}
+
+PEExportCache::PEExportCache(const std::wstring& directory) : m_directory(directory) {
+    while (!m_directory.empty() && (m_directory.back() == L'\\' || m_directory.back() == L'/')) {
+        m_directory.pop_back();
+    }
+}
+
+std::shared_ptr<const PEModuleExports> PEExportCache::Get(const std::string& dllName) {
+    std::string key = NormalizeDllKey(dllName);
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& slot = m_entries[key];
+        if (!slot) {
+            slot = std::make_shared<Entry>();
+        }
+        entry = slot;
+    }
+
+    bool loadedHere = false;
+    std::call_once(entry->once, [&]() {
+        entry->exports = Load(key);
+        loadedHere = true;
+    });
+    if (loadedHere) {
+        m_loads.fetch_add(1);
+    } else {
+        m_hits.fetch_add(1);
+    }
+    return entry->exports;
+}
+
+std::shared_ptr<const PEModuleExports> PEExportCache::Load(const std::string& key) const {
+    std::wstring path = m_directory + L"\\" + ToWStringUtf8BestEffort(key);
+    PEParser parser;
+    if (!parser.LoadFile(path) || !parser.IsValidPE()) {
+        return nullptr;
+    }
+
+    return ExtractModuleExports(parser, key, path);
+}
+
+std::shared_ptr<const PEModuleExports> ExtractModuleExports(const PEParser& parser,
+                                                            const std::string& dllName,
+                                                            const std::wstring& filePath) {
+    auto mod = std::make_shared<PEModuleExports>();
+    mod->dllName = dllName;
+    mod->filePath = filePath;
+    const auto& dirInfo = parser.GetExportDirectoryInfo();
+    mod->ordinalBase = dirInfo.has_value() ? dirInfo->base : 0;
+    mod->exports = parser.GetExports();
+
+    mod->byName.reserve(mod->exports.size());
+    for (size_t i = 0; i < mod->exports.size(); ++i) {
+        if (mod->exports[i].hasName) {
+            mod->byName.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(mod->byName.begin(), mod->byName.end(), [&](uint32_t a, uint32_t b) {
+        return mod->exports[a].name < mod->exports[b].name;
+    });
+    return mod;
+}
+
+std::string PEForwarderStatusName(PEForwarderStatus status) {
+    switch (status) {
+        case PEForwarderStatus::Resolved: return "resolved";
+        case PEForwarderStatus::MissingDll: return "missingDll";
+        case PEForwarderStatus::ApiSet: return "apiSet";
+        case PEForwarderStatus::MissingExport: return "missingExport";
+        case PEForwarderStatus::Cycle: return "cycle";
+        case PEForwarderStatus::TooDeep: return "tooDeep";
+    }
+    return "unknown";
+}
+
+bool IsApiSetName(const std::string& lowerName) {
+    return lowerName.compare(0, 7, "api-ms-") == 0 || lowerName.compare(0, 7, "ext-ms-") == 0;
+}
+
+PEForwarderResolution ResolveExportForwarder(PEExportCache& cache, const std::string& dllName, const PEExportFunction& e) {
+    PEForwarderResolution r;
+    r.exportKey = ExportKey(e);
+
+    std::string curDll = NormalizeDllKey(dllName);
+    std::shared_ptr<const PEModuleExports> curModule;
+    const PEExportFunction* cur = &e;
+
+    std::unordered_set<std::string> visited;
+    std::string hop = curDll + "!" + r.exportKey;
+    visited.insert(hop);
+    r.chain.push_back(hop);
+
+    while (cur->isForwarded) {
+        if (r.chain.size() > kMaxForwarderHops) {
+            r.status = PEForwarderStatus::TooDeep;
+            return r;
+        }
+
+        std::string nextDll = NormalizeDllKey(cur->forwarderDll);
+        std::string symbol = cur->forwarderIsOrdinal ? "#" + std::to_string(cur->forwarderOrdinal) : cur->forwarderName;
+        hop = nextDll + "!" + symbol;
+        r.chain.push_back(hop);
+        r.finalDll = nextDll;
+        r.finalName = symbol;
+
+        if (!visited.insert(hop).second) {
+            r.status = PEForwarderStatus::Cycle;
+            return r;
+        }
+
+        if (IsApiSetName(nextDll)) {
+            r.status = PEForwarderStatus::ApiSet;
+            return r;
+        }
+
+        auto nextModule = cache.Get(nextDll);
+        if (!nextModule) {
+            r.status = PEForwarderStatus::MissingDll;
+            return r;
+        }
+        const PEExportFunction* next = cur->forwarderIsOrdinal ? nextModule->FindByOrdinal(cur->forwarderOrdinal)
+                                                               : nextModule->FindByName(cur->forwarderName);
+        if (next == nullptr) {
+            r.status = PEForwarderStatus::MissingExport;
+            return r;
+        }
+
+        // Keep the module alive while its export entry is referenced.
+        curModule = nextModule;
+        curDll = nextDll;
+        cur = next;
+    }
+
+    r.status = PEForwarderStatus::Resolved;
+    r.finalDll = curDll;
+    r.finalName = ExportKey(*cur);
+    r.finalOrdinal = cur->ordinal;
+    r.finalRva = cur->rva;
+    return r;
+}
+
+std::vector<PEForwarderResolution> ResolveImageForwarders(PEExportCache& cache, const std::string& dllName, const PEParser& parser) {
+    std::vector<PEForwarderResolution> out;
+    for (const auto& e : parser.GetExports()) {
+        if (e.isForwarded) {
+            out.push_back(ResolveExportForwarder(cache, dllName, e));
+        }
+    }
+    return out;
+}
+
+void ResolveForwardersForFiles(PEExportCache& cache,
+                               const std::vector<std::wstring>& files,
+                               std::vector<PEForwarderImageResult>& out) {
+    out.clear();
+    out.resize(files.size());
+
+    RunParallel(files.size(), 0, [&](size_t i) {
+        PEForwarderImageResult& item = out[i];
+        item.filePath = files[i];
+        item.dllName = DllNameFromPath(files[i]);
+
+        PEParser parser;
+        if (!parser.LoadFile(files[i])) {
+            item.error = parser.GetLastError();
+            return;
+        }
+        item.loaded = true;
+        item.forwarders = ResolveImageForwarders(cache, item.dllName, parser);
+    });
+}
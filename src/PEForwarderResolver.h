@@ -0,0 +1,109 @@
+#pragma once
+
+#include "PEParser.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Export table of one DLL, detached from the parser that produced it. Only the
+// export entries are kept so the cache does not pin whole file images.
+struct PEModuleExports {
+    std::string dllName;
+    std::wstring filePath;
+    DWORD ordinalBase = 0;
+    std::vector<PEExportFunction> exports;
+    std::vector<uint32_t> byName;
+
+    const PEExportFunction* FindByName(const std::string& name) const;
+    const PEExportFunction* FindByOrdinal(DWORD ordinal) const;
+};
+
+std::shared_ptr<const PEModuleExports> ExtractModuleExports(const PEParser& parser,
+                                                            const std::string& dllName,
+                                                            const std::wstring& filePath);
+
+// Thread-safe cache of export tables for the DLLs in one directory. Each DLL is
+// parsed at most once; concurrent requests for the same DLL wait for the first.
+class PEExportCache {
+public:
+    explicit PEExportCache(const std::wstring& directory);
+    PEExportCache(const PEExportCache&) = delete;
+    PEExportCache& operator=(const PEExportCache&) = delete;
+
+    // Returns nullptr when the DLL does not exist in the directory or has no
+    // parseable export table. Names are matched case-insensitively and ".dll"
+    // is appended when the name has no extension, as the loader does.
+    std::shared_ptr<const PEModuleExports> Get(const std::string& dllName);
+
+    const std::wstring& GetDirectory() const { return m_directory; }
+    uint64_t GetHitCount() const { return m_hits.load(); }
+    uint64_t GetLoadCount() const { return m_loads.load(); }
+
+private:
+    struct Entry {
+        std::once_flag once;
+        std::shared_ptr<const PEModuleExports> exports;
+    };
+
+    std::shared_ptr<const PEModuleExports> Load(const std::string& key) const;
+
+    std::wstring m_directory;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> m_entries;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_loads{0};
+};
+
+enum class PEForwarderStatus {
+    Resolved,
+    MissingDll,
+    // Target is an API set contract; the loader maps it to a host DLL, so the
+    // chain cannot be followed from the files in the directory.
+    ApiSet,
+    MissingExport,
+    Cycle,
+    TooDeep
+};
+
+struct PEForwarderResolution {
+    PEForwarderStatus status = PEForwarderStatus::Resolved;
+    std::string exportKey;
+    // Every hop as "dll!symbol", starting with the export being resolved.
+    std::vector<std::string> chain;
+    std::string finalDll;
+    std::string finalName;
+    DWORD finalOrdinal = 0;
+    DWORD finalRva = 0;
+};
+
+struct PEForwarderImageResult {
+    std::wstring filePath;
+    std::string dllName;
+    bool loaded = false;
+    std::wstring error;
+    std::vector<PEForwarderResolution> forwarders;
+};
+
+std::string PEForwarderStatusName(PEForwarderStatus status);
+
+// True for API set contract names ("api-ms-win-...", "ext-ms-..."). Expects a
+// lower-case name.
+bool IsApiSetName(const std::string& lowerName);
+
+// Follows the forwarder chain of one export until it reaches an export that is
+// implemented in its own DLL. dllName is the module that exports e.
+PEForwarderResolution ResolveExportForwarder(PEExportCache& cache, const std::string& dllName, const PEExportFunction& e);
+
+// Resolves every forwarded export of an already-parsed image.
+std::vector<PEForwarderResolution> ResolveImageForwarders(PEExportCache& cache, const std::string& dllName, const PEParser& parser);
+
+// Parses the files on a small worker pool and resolves their forwarders
+// against the shared cache. Results are returned in input order.
+void ResolveForwardersForFiles(PEExportCache& cache,
+                               const std::vector<std::wstring>& files,
+                               std::vector<PEForwarderImageResult>& out);
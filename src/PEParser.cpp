@@ -17,21 +17,19 @@ PEParser::~PEParser() {
 }
 
 bool PEParser::LoadFile(const std::wstring& filePath) {
-    UnloadFile();
-    
-    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        m_lastError = L"Failed to open file: " + filePath;
-        return false;
-    }
+    return LoadFile(filePath, PageCachePolicy::Cached);
+}
 
-    std::streampos pos = file.tellg();
-    size_t fileSize = static_cast<size_t>(pos);
-    file.seekg(0, std::ios::beg);
+bool PEParser::LoadFile(const std::wstring& filePath, PageCachePolicy cachePolicy) {
+    UnloadFile();
 
-    m_fileData.resize(fileSize);
-    if (!file.read(reinterpret_cast<char*>(m_fileData.data()), fileSize)) {
-        m_lastError = L"Failed to read file";
+    bool tooLarge = false;
+    std::wstring error;
+    // Other processes may keep the file open for writing, as they could
+    // when this was read through an ifstream.
+    if (!ReadWholeFile(filePath, cachePolicy, SIZE_MAX, m_fileData, tooLarge, error, true)) {
+        m_fileData.clear();
+        m_lastError = error + L": " + filePath;
         return false;
     }
 
@@ -894,3 +892,31 @@ bool PEParser::GetSecurityDirectory(DWORD& fileOffset, DWORD& size) const {
     size = dir.Size;
     return true;
 }
+
+bool PEParser::GetChecksumFieldOffsets(DWORD& checkSumOffset, DWORD& securityEntryOffset) const {
+    checkSumOffset = 0;
+    securityEntryOffset = 0;
+    if (!m_isValidPE || m_dosHeader == nullptr) {
+        return false;
+    }
+
+    DWORD optionalHeader = static_cast<DWORD>(m_dosHeader->e_lfanew) + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+    DWORD directories = 0;
+    DWORD count = 0;
+    if (m_isPE32Plus && m_ntHeaders64 != nullptr) {
+        checkSumOffset = optionalHeader + offsetof(IMAGE_OPTIONAL_HEADER64, CheckSum);
+        directories = optionalHeader + offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory);
+        count = m_ntHeaders64->OptionalHeader.NumberOfRvaAndSizes;
+    } else if (!m_isPE32Plus && m_ntHeaders32 != nullptr) {
+        checkSumOffset = optionalHeader + offsetof(IMAGE_OPTIONAL_HEADER32, CheckSum);
+        directories = optionalHeader + offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory);
+        count = m_ntHeaders32->OptionalHeader.NumberOfRvaAndSizes;
+    } else {
+        return false;
+    }
+
+    if (count > IMAGE_DIRECTORY_ENTRY_SECURITY) {
+        securityEntryOffset = directories + IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY);
+    }
+    return true;
+}
@@ -6,6 +6,8 @@
 #include <memory>
 #include <array>
 #include <optional>
+
+#include "PageCacheIo.h"
 
 struct PEImportFunction {
     std::string name;
@@ -137,7 +139,12 @@ public:
     ~PEParser();
 
     bool LoadFile(const std::wstring& filePath);
+    // Reads the file under the given page-cache policy; the overload above
+    // reads it cached.
+    bool LoadFile(const std::wstring& filePath, PageCachePolicy cachePolicy);
     bool IsLoaded() const { return !m_fileData.empty(); }
+    const BYTE* GetFileData() const { return m_fileData.data(); }
+    size_t GetFileSize() const { return m_fileData.size(); }
     void UnloadFile();
     
     bool IsValidPE() const { return m_isValidPE; }
@@ -154,6 +161,10 @@ public:
     bool GetDebugDirectory(DWORD& rva, DWORD& size) const;
     bool GetResourceDirectory(DWORD& rva, DWORD& size) const;
     bool GetSecurityDirectory(DWORD& fileOffset, DWORD& size) const;
+    // File offsets of OptionalHeader.CheckSum and of the security data
+    // directory entry. securityEntryOffset is 0 when NumberOfRvaAndSizes
+    // leaves the entry out.
+    bool GetChecksumFieldOffsets(DWORD& checkSumOffset, DWORD& securityEntryOffset) const;
 
 private:
     bool ParsePE();
@@ -223,6 +223,26 @@ static bool FindCatalogForFile(const std::wstring& filePath, std::wstring& catal
     return FindCatalogForFileShaAlg(filePath, nullptr, catalogPathOut, memberTagOut);
 }
 
+std::vector<HashSkipRange> GetAuthenticodeSkipRanges(const PEParser& parser) {
+    std::vector<HashSkipRange> skip;
+    DWORD checkSumOffset = 0;
+    DWORD securityEntryOffset = 0;
+    if (!parser.GetChecksumFieldOffsets(checkSumOffset, securityEntryOffset)) {
+        return skip;
+    }
+    skip.push_back({checkSumOffset, sizeof(DWORD)});
+    if (securityEntryOffset != 0) {
+        skip.push_back({securityEntryOffset, sizeof(IMAGE_DATA_DIRECTORY)});
+    }
+    // The certificate table is a file offset, not an RVA.
+    DWORD secOff = 0;
+    DWORD secSize = 0;
+    if (parser.GetSecurityDirectory(secOff, secSize) && secOff < parser.GetFileSize()) {
+        skip.push_back({secOff, secSize});
+    }
+    return skip;
+}
+
 PESignaturePresence DetectSignaturePresence(const std::wstring& filePath, const PEParser& parser) {
     PESignaturePresence p = {};
     DWORD secOff = 0;
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "HashEngine.h"
 #include "PEParser.h"
 
 #include <string>
+#include <vector>
 
 enum class PESignatureVerifyStatus {
     Valid,
@@ -32,6 +34,11 @@ struct PESignatureVerifyResult {
     std::wstring catalogPath;
 };
 
+// Bytes the Authenticode image hash leaves out: the CheckSum field, the
+// security directory entry and the certificate table it points to. Hashing
+// the file with these skipped gives the authentihash. Empty for non-PE files.
+std::vector<HashSkipRange> GetAuthenticodeSkipRanges(const PEParser& parser);
+
 PESignaturePresence DetectSignaturePresence(const std::wstring& filePath, const PEParser& parser);
 PESignatureVerifyResult VerifyEmbeddedSignature(const std::wstring& filePath);
 PESignatureVerifyResult VerifyCatalogSignature(const std::wstring& filePath);
@@ -0,0 +1,461 @@
+#include "PageCacheIo.h"
+
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <malloc.h>
+#include <psapi.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kWholeFilePiece = 1u << 20;
+
+#if defined(_WIN32)
+const NativeFileHandle kNoFile = INVALID_HANDLE_VALUE;
+#else
+const NativeFileHandle kNoFile = -1;
+#endif
+
+uint64_t AlignDown(uint64_t value) {
+    return value / kDirectIoAlignment * kDirectIoAlignment;
+}
+
+uint64_t AlignUp(uint64_t value) {
+    return (value + kDirectIoAlignment - 1) / kDirectIoAlignment * kDirectIoAlignment;
+}
+
+bool IsAligned(uint64_t offset, const uint8_t* buffer, size_t size) {
+    return offset % kDirectIoAlignment == 0 && reinterpret_cast<uintptr_t>(buffer) % kDirectIoAlignment == 0 &&
+           size % kDirectIoAlignment == 0;
+}
+
+// Positioned read; bytesRead == 0 at the end of the file.
+bool ReadRaw(NativeFileHandle file, uint64_t offset, uint8_t* buffer, size_t size, size_t& bytesRead) {
+    bytesRead = 0;
+#if defined(_WIN32)
+    OVERLAPPED ov = {};
+    ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD got = 0;
+    if (!ReadFile(file, buffer, static_cast<DWORD>(size), &got, &ov)) {
+        DWORD err = GetLastError();
+        // A handle opened for overlapped I/O completes later.
+        if (err == ERROR_IO_PENDING && GetOverlappedResult(file, &ov, &got, TRUE)) {
+            err = ERROR_SUCCESS;
+        } else if (err == ERROR_IO_PENDING) {
+            err = GetLastError();
+        }
+        if (err != ERROR_SUCCESS && err != ERROR_HANDLE_EOF) {
+            return false;
+        }
+    }
+    bytesRead = got;
+#else
+    ssize_t got = 0;
+    do {
+        got = pread(file, buffer, size, static_cast<off_t>(offset));
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        return false;
+    }
+    bytesRead = static_cast<size_t>(got);
+#endif
+    return true;
+}
+
+#if defined(_WIN32)
+HANDLE OpenWithFlags(const std::wstring& path, DWORD flags, bool allowWriters) {
+    DWORD share = FILE_SHARE_READ | FILE_SHARE_DELETE | (allowWriters ? FILE_SHARE_WRITE : 0);
+    return CreateFileW(path.c_str(), GENERIC_READ, share, nullptr, OPEN_EXISTING, flags, nullptr);
+}
+#endif
+
+} // namespace
+
+const char* GetPageCachePolicyName(PageCachePolicy policy) {
+    switch (policy) {
+        case PageCachePolicy::Cached: return "cached";
+        case PageCachePolicy::DropBehind: return "dropbehind";
+        case PageCachePolicy::Direct: return "direct";
+        default: return "unknown";
+    }
+}
+
+bool ParsePageCachePolicyName(const std::string& name, PageCachePolicy& out) {
+    const PageCachePolicy all[] = {PageCachePolicy::Cached, PageCachePolicy::DropBehind, PageCachePolicy::Direct};
+    for (PageCachePolicy policy : all) {
+        if (name == GetPageCachePolicyName(policy)) {
+            out = policy;
+            return true;
+        }
+    }
+    return false;
+}
+
+AlignedBuffer::~AlignedBuffer() {
+#if defined(_WIN32)
+    _aligned_free(m_data);
+#else
+    free(m_data);
+#endif
+}
+
+bool AlignedBuffer::Resize(size_t bytes) {
+    bytes = static_cast<size_t>(AlignUp(bytes));
+    if (bytes <= m_size) {
+        return true;
+    }
+#if defined(_WIN32)
+    _aligned_free(m_data);
+    m_data = static_cast<uint8_t*>(_aligned_malloc(bytes, kDirectIoAlignment));
+#else
+    free(m_data);
+    void* p = nullptr;
+    m_data = posix_memalign(&p, kDirectIoAlignment, bytes) == 0 ? static_cast<uint8_t*>(p) : nullptr;
+#endif
+    m_size = m_data != nullptr ? bytes : 0;
+    return m_data != nullptr;
+}
+
+PageCacheFile::~PageCacheFile() {
+    Close();
+}
+
+bool PageCacheFile::Open(const std::wstring& path, PageCachePolicy policy, std::wstring& error, bool allowWriters) {
+    Close();
+    NativeFileHandle file = kNoFile;
+#if defined(_WIN32)
+    if (policy == PageCachePolicy::Direct) {
+        file = OpenWithFlags(path, FILE_FLAG_NO_BUFFERING, allowWriters);
+        if (file == kNoFile && GetLastError() == ERROR_INVALID_PARAMETER) {
+            policy = PageCachePolicy::DropBehind;
+        }
+    }
+    if (policy != PageCachePolicy::Direct) {
+        file = OpenWithFlags(path, FILE_FLAG_SEQUENTIAL_SCAN, allowWriters);
+    }
+#else
+    (void)allowWriters;
+    const std::string native = ToNativePath(path);
+    if (policy == PageCachePolicy::Direct) {
+#if defined(O_DIRECT)
+        file = open(native.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if (file < 0 && errno == EINVAL) {
+            policy = PageCachePolicy::DropBehind;
+        }
+#elif defined(F_NOCACHE)
+        file = open(native.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file >= 0 && fcntl(file, F_NOCACHE, 1) != 0) {
+            policy = PageCachePolicy::DropBehind;
+        }
+#else
+        policy = PageCachePolicy::DropBehind;
+#endif
+    }
+    if (policy != PageCachePolicy::Direct && file < 0) {
+        file = open(native.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+#endif
+    if (file == kNoFile) {
+        error = L"Failed to open file";
+        return false;
+    }
+    m_file = file;
+    m_open = true;
+    m_owned = true;
+    m_path = path;
+    m_policy = policy;
+    m_prefetched = 0;
+    m_dropped = 0;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (policy != PageCachePolicy::Direct) {
+        posix_fadvise(m_file, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return true;
+}
+
+void PageCacheFile::Attach(NativeFileHandle file, PageCachePolicy policy) {
+    Close();
+    m_file = file;
+    m_open = true;
+    m_owned = false;
+    m_path.clear();
+    m_policy = policy == PageCachePolicy::Direct ? PageCachePolicy::DropBehind : policy;
+    m_prefetched = 0;
+    m_dropped = 0;
+}
+
+void PageCacheFile::Close() {
+    if (!m_open) {
+        return;
+    }
+#if defined(POSIX_FADV_DONTNEED)
+    if (m_policy == PageCachePolicy::DropBehind) {
+        posix_fadvise(m_file, static_cast<off_t>(m_dropped), 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+    if (m_owned) {
+#if defined(_WIN32)
+        CloseHandle(m_file);
+#else
+        close(m_file);
+#endif
+    }
+#if defined(_WIN32)
+    // No per-range drop on Windows: the file's pages go once it is closed.
+    if (m_policy == PageCachePolicy::DropBehind && !m_path.empty()) {
+        EvictFromPageCache(m_path);
+    }
+#endif
+    m_open = false;
+    m_owned = false;
+    m_file = kNoFile;
+}
+
+bool PageCacheFile::GetSize(uint64_t& size) const {
+#if defined(_WIN32)
+    LARGE_INTEGER li = {};
+    if (!GetFileSizeEx(m_file, &li)) {
+        return false;
+    }
+    size = static_cast<uint64_t>(li.QuadPart);
+#else
+    struct stat st;
+    if (fstat(m_file, &st) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+#endif
+    return true;
+}
+
+bool PageCacheFile::ReadAt(uint64_t offset, uint8_t* buffer, size_t size, size_t& bytesRead) {
+    if (m_policy == PageCachePolicy::Direct) {
+        return ReadDirect(offset, buffer, size, bytesRead);
+    }
+    if (!ReadRaw(m_file, offset, buffer, size, bytesRead)) {
+        return false;
+    }
+    Hint(offset, bytesRead);
+    return true;
+}
+
+bool PageCacheFile::ReadDirect(uint64_t offset, uint8_t* buffer, size_t size, size_t& bytesRead) {
+    bytesRead = 0;
+    bool ok = false;
+    if (IsAligned(offset, buffer, size)) {
+        ok = ReadRaw(m_file, offset, buffer, size, bytesRead);
+    } else {
+        // The aligned range around the request, then the requested part of
+        // it.
+        const uint64_t start = AlignDown(offset);
+        const size_t span = static_cast<size_t>(AlignUp(offset + size) - start);
+        if (!m_bounce.Resize(span)) {
+            return false;
+        }
+        size_t got = 0;
+        ok = ReadRaw(m_file, start, m_bounce.Data(), span, got);
+        const size_t skip = static_cast<size_t>(offset - start);
+        if (ok && got > skip) {
+            bytesRead = std::min<size_t>(size, got - skip);
+            std::memcpy(buffer, m_bounce.Data() + skip, bytesRead);
+        }
+    }
+#if defined(O_DIRECT)
+    // Some file systems accept O_DIRECT at open and refuse it on read.
+    if (!ok && errno == EINVAL) {
+        int flags = fcntl(m_file, F_GETFL);
+        if (flags >= 0 && fcntl(m_file, F_SETFL, flags & ~O_DIRECT) == 0) {
+            m_policy = PageCachePolicy::DropBehind;
+            return ReadAt(offset, buffer, size, bytesRead);
+        }
+    }
+#endif
+    return ok;
+}
+
+// After a cached read of [offset, offset + size): the next window of the same
+// size is prefetched, and under DropBehind the range just read is dropped.
+void PageCacheFile::Hint(uint64_t offset, size_t size) {
+#if defined(POSIX_FADV_WILLNEED)
+    if (size == 0) {
+        return;
+    }
+    const uint64_t end = offset + size;
+    if (end + size > m_prefetched) {
+        const uint64_t from = std::max<uint64_t>(end, m_prefetched);
+        posix_fadvise(m_file, static_cast<off_t>(from), static_cast<off_t>(end + size - from), POSIX_FADV_WILLNEED);
+        m_prefetched = end + size;
+    }
+    Release(offset, size);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+void PageCacheFile::Release(uint64_t offset, uint64_t size) {
+#if defined(POSIX_FADV_DONTNEED)
+    const uint64_t end = (offset + size) / kDropBlock * kDropBlock;
+    if (m_policy != PageCachePolicy::Cached && end > m_dropped) {
+        posix_fadvise(m_file, static_cast<off_t>(m_dropped), static_cast<off_t>(end - m_dropped), POSIX_FADV_DONTNEED);
+        m_dropped = end;
+    }
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
+
+void PageCacheFile::AdviseMapped(const uint8_t* view, uint64_t size) {
+    // The view reads through the cache whatever the handle does.
+    if (m_policy == PageCachePolicy::Direct) {
+        m_policy = PageCachePolicy::DropBehind;
+    }
+#if defined(_WIN32)
+    (void)view;
+    (void)size;
+#else
+    void* base = const_cast<uint8_t*>(view);
+    madvise(base, static_cast<size_t>(size), MADV_SEQUENTIAL);
+    madvise(base, static_cast<size_t>(std::min<uint64_t>(size, 8u << 20)), MADV_WILLNEED);
+#endif
+}
+
+void PageCacheFile::ReleaseMapped(const uint8_t* view, uint64_t offset, uint64_t size) {
+    if (m_policy == PageCachePolicy::Cached || size == 0) {
+        return;
+    }
+    // Whole pages only; the view itself starts on one.
+    const uint64_t start = AlignUp(offset);
+    const uint64_t end = offset + size;
+    if (end > start) {
+#if defined(_WIN32)
+        // Unlocking pages that are not locked takes them out of the working
+        // set.
+        VirtualUnlock(const_cast<uint8_t*>(view + start), static_cast<SIZE_T>(end - start));
+#else
+        madvise(const_cast<uint8_t*>(view + start), static_cast<size_t>(end - start), MADV_DONTNEED);
+#endif
+    }
+    Release(offset, size);
+}
+
+bool ReadWholeFile(const std::wstring& path,
+                   PageCachePolicy policy,
+                   uint64_t maxSize,
+                   std::vector<uint8_t>& data,
+                   bool& tooLarge,
+                   std::wstring& error,
+                   bool allowWriters) {
+    tooLarge = false;
+    PageCacheFile file;
+    if (!file.Open(path, policy, error, allowWriters)) {
+        return false;
+    }
+    uint64_t size = 0;
+    if (!file.GetSize(size)) {
+        error = L"Failed to get file size";
+        return false;
+    }
+    if (size > maxSize || size > SIZE_MAX) {
+        tooLarge = true;
+        error = L"File too large";
+        return false;
+    }
+    data.resize(static_cast<size_t>(size));
+    size_t done = 0;
+    while (done < data.size()) {
+        size_t got = 0;
+        size_t piece = std::min<size_t>(kWholeFilePiece, data.size() - done);
+        if (!file.ReadAt(done, data.data() + done, piece, got) || got == 0) {
+            error = L"Failed to read file";
+            return false;
+        }
+        done += got;
+    }
+    return true;
+}
+
+bool EvictFromPageCache(const std::wstring& path) {
+#if defined(_WIN32)
+    // Opening a file unbuffered flushes and purges its cached pages.
+    HANDLE file = OpenWithFlags(path, FILE_FLAG_NO_BUFFERING, true);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    CloseHandle(file);
+    return true;
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // Dirty pages stay cached until written.
+    fsync(fd);
+    bool ok = true;
+#if defined(POSIX_FADV_DONTNEED)
+    ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+#endif
+    close(fd);
+    return ok;
+#endif
+}
+
+bool GetCachedBytes(const std::wstring& path, uint64_t& bytes) {
+    bytes = 0;
+#if defined(_WIN32)
+    (void)path;
+    PERFORMANCE_INFORMATION info = {};
+    info.cb = sizeof(info);
+    if (!GetPerformanceInfo(&info, sizeof(info))) {
+        return false;
+    }
+    bytes = static_cast<uint64_t>(info.SystemCache) * info.PageSize;
+    return true;
+#else
+    int fd = open(ToNativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    const uint64_t size = ok ? static_cast<uint64_t>(st.st_size) : 0;
+    if (!ok || size == 0 || size > SIZE_MAX) {
+        close(fd);
+        return ok && size == 0;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> resident(static_cast<size_t>((size + page - 1) / page));
+#if defined(__APPLE__)
+    ok = mincore(view, static_cast<size_t>(size), reinterpret_cast<char*>(resident.data())) == 0;
+#else
+    ok = mincore(view, static_cast<size_t>(size), resident.data()) == 0;
+#endif
+    munmap(view, static_cast<size_t>(size));
+    for (size_t i = 0; ok && i < resident.size(); ++i) {
+        if (resident[i] & 1) {
+            bytes += std::min<uint64_t>(page, size - static_cast<uint64_t>(i) * page);
+        }
+    }
+    return ok;
+#endif
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What file reads leave behind in the OS page cache. Scanning a large tree
+// through the cache evicts everything else the machine had cached, for data
+// that is read once; the other policies keep the scan's footprint to about
+// one read window. Used by HashEngine, HashCalculator, StringsScanner and
+// PEParser::LoadFile. Builds without Windows headers on other platforms.
+
+enum class PageCachePolicy {
+    // Ordinary cached reads with a sequential hint: fastest when the file is
+    // read again soon.
+    Cached,
+    // Cached reads, with the next window prefetched and every range dropped
+    // from the cache once read (POSIX_FADV_WILLNEED/DONTNEED, MADV_DONTNEED
+    // for mapped views). Windows has no per-range drop; the file's pages are
+    // purged when it is closed instead.
+    DropBehind,
+    // Unbuffered reads into page-aligned buffers (O_DIRECT,
+    // FILE_FLAG_NO_BUFFERING) that bypass the cache. Files the OS refuses to
+    // open that way (tmpfs, some network file systems) are read with
+    // DropBehind; mapped views and handles opened elsewhere get DropBehind
+    // too.
+    Direct
+};
+
+#if defined(_WIN32)
+typedef void* NativeFileHandle;
+#else
+typedef int NativeFileHandle;
+#endif
+
+// "cached", "dropbehind" or "direct".
+const char* GetPageCachePolicyName(PageCachePolicy policy);
+bool ParsePageCachePolicyName(const std::string& name, PageCachePolicy& out);
+
+// Buffer address, file offset and length granularity of Direct reads; a
+// multiple of the sector size of every disk in use.
+const size_t kDirectIoAlignment = 4096;
+
+// Granularity of dropping pages behind reads. The cache may hold a file in
+// naturally aligned blocks of pages up to this size, and a drop leaves alone
+// any block it only partly covers.
+const uint64_t kDropBlock = 2u << 20;
+
+// Page-aligned heap buffer.
+class AlignedBuffer {
+public:
+    AlignedBuffer() {}
+    explicit AlignedBuffer(size_t bytes) { Resize(bytes); }
+    ~AlignedBuffer();
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    // Contents are not kept. Sizes are rounded up to kDirectIoAlignment;
+    // false when out of memory.
+    bool Resize(size_t bytes);
+    uint8_t* Data() { return m_data; }
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// A file read under a PageCachePolicy. ReadAt takes any offset, size and
+// buffer; Direct reads that are not aligned go through a bounce buffer, so
+// callers that want them zero-copy pass aligned ones.
+class PageCacheFile {
+public:
+    PageCacheFile() {}
+    ~PageCacheFile();
+    PageCacheFile(const PageCacheFile&) = delete;
+    PageCacheFile& operator=(const PageCacheFile&) = delete;
+
+    // allowWriters lets other processes keep the file open for writing.
+    bool Open(const std::wstring& path, PageCachePolicy policy, std::wstring& error, bool allowWriters = false);
+    // Reads a file opened elsewhere, which stays open after Close. Direct
+    // becomes DropBehind.
+    void Attach(NativeFileHandle file, PageCachePolicy policy);
+    void Close();
+    bool IsOpen() const { return m_open; }
+
+    NativeFileHandle GetHandle() const { return m_file; }
+    // The policy in effect, after any fallback.
+    PageCachePolicy GetPolicy() const { return m_policy; }
+    bool GetSize(uint64_t& size) const;
+
+    // Positioned read; bytesRead == 0 at the end of the file.
+    bool ReadAt(uint64_t offset, uint8_t* buffer, size_t size, size_t& bytesRead);
+
+    // Done with the file up to offset + size, for data read in file order
+    // through another handle to the same file (ReadAt does this itself): under
+    // DropBehind and Direct it leaves the cache, in whole blocks of
+    // kDropBlock; Close drops the rest.
+    void Release(uint64_t offset, uint64_t size);
+
+    // A mapped view of the whole file: sequential access hint, and the first
+    // window prefetched.
+    void AdviseMapped(const uint8_t* view, uint64_t size);
+    // Done with [offset, offset + size) of a mapped view of the file: under
+    // DropBehind and Direct the pages leave the process and the cache.
+    void ReleaseMapped(const uint8_t* view, uint64_t offset, uint64_t size);
+
+private:
+    void Hint(uint64_t offset, size_t size);
+    bool ReadDirect(uint64_t offset, uint8_t* buffer, size_t size, size_t& bytesRead);
+
+    NativeFileHandle m_file = NativeFileHandle();
+    bool m_open = false;
+    bool m_owned = false;
+    PageCachePolicy m_policy = PageCachePolicy::Cached;
+    std::wstring m_path;
+    // End of the range last prefetched, and of the range dropped.
+    uint64_t m_prefetched = 0;
+    uint64_t m_dropped = 0;
+    AlignedBuffer m_bounce;
+};
+
+// The whole file, read under the policy. Fails with tooLarge set, without
+// reading, when the file is larger than maxSize. allowWriters is passed on to
+// PageCacheFile::Open.
+bool ReadWholeFile(const std::wstring& path,
+                   PageCachePolicy policy,
+                   uint64_t maxSize,
+                   std::vector<uint8_t>& data,
+                   bool& tooLarge,
+                   std::wstring& error,
+                   bool allowWriters = false);
+
+// Drops the file's pages from the cache, so the next read comes from the
+// disk (pages another process has mapped may stay).
+bool EvictFromPageCache(const std::wstring& path);
+
+// Bytes of the file resident in the page cache (mincore). Windows cannot
+// tell per file and reports the size of the whole system file cache; compare
+// two readings taken around a run.
+bool GetCachedBytes(const std::wstring& path, uint64_t& bytes);
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "RegionHash.h"
+
+#include <algorithm>
+
+RegionHashSink::RegionHashSink(const std::vector<HashRegion>& regions, const std::vector<HashAlgorithm>& algorithms)
+    : m_regions(regions), m_algorithms(algorithms) {
+    for (size_t r = 0; r < m_regions.size(); ++r) {
+        const HashRegion& region = m_regions[r];
+        std::vector<HashSkipRange> skip = region.skip;
+        std::sort(skip.begin(), skip.end(), [](const HashSkipRange& a, const HashSkipRange& b) { return a.offset < b.offset; });
+        const uint64_t end = region.offset + region.size;
+        uint64_t pos = region.offset;
+        for (const auto& s : skip) {
+            if (s.offset >= end) {
+                break;
+            }
+            if (s.offset > pos) {
+                m_pieces.push_back({pos, s.offset, r});
+            }
+            pos = std::max<uint64_t>(pos, std::min<uint64_t>(s.offset + s.size, end));
+        }
+        if (pos < end) {
+            m_pieces.push_back({pos, end, r});
+        }
+        for (HashAlgorithm algorithm : m_algorithms) {
+            m_digests.emplace_back(algorithm);
+            // Regions are small next to the file; the tree hashes would only
+            // start threads for them.
+            m_digests.back().SetThreadCount(1);
+        }
+    }
+    std::stable_sort(m_pieces.begin(), m_pieces.end(), [](const Piece& a, const Piece& b) { return a.begin < b.begin; });
+}
+
+void RegionHashSink::Update(uint64_t offset, const uint8_t* data, size_t size) {
+    const uint64_t end = offset + size;
+    while (m_next < m_pieces.size() && m_pieces[m_next].end <= offset) {
+        ++m_next;
+    }
+    // Overlapping regions can leave finished pieces past m_next; they are
+    // passed over below.
+    for (size_t i = m_next; i < m_pieces.size() && m_pieces[i].begin < end; ++i) {
+        const Piece& piece = m_pieces[i];
+        uint64_t from = std::max<uint64_t>(piece.begin, offset);
+        uint64_t to = std::min<uint64_t>(piece.end, end);
+        if (from >= to) {
+            continue;
+        }
+        Digest* digests = &m_digests[piece.region * m_algorithms.size()];
+        for (size_t a = 0; a < m_algorithms.size(); ++a) {
+            digests[a].Update(data + (from - offset), static_cast<size_t>(to - from));
+        }
+    }
+}
+
+std::vector<RegionHashResult> RegionHashSink::Final() {
+    std::vector<RegionHashResult> results;
+    results.reserve(m_regions.size());
+    for (size_t r = 0; r < m_regions.size(); ++r) {
+        RegionHashResult result;
+        result.name = m_regions[r].name;
+        result.offset = m_regions[r].offset;
+        result.size = m_regions[r].size;
+        for (size_t a = 0; a < m_algorithms.size(); ++a) {
+            HashResult h;
+            h.success = true;
+            h.result = m_digests[r * m_algorithms.size() + a].FinalText();
+            h.algorithm = GetHashAlgorithmName(m_algorithms[a]);
+            h.calculationTime = 0.0;
+            h.standard = IsStandardHashAlgorithm(m_algorithms[a]);
+            result.hashes.push_back(h);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
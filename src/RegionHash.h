@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Digest.h"
+#include "HashEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Digests of parts of a file (PE sections, headers, overlay) fed from the
+// whole-file HashEngine pass: every chunk is routed to the contexts of the
+// regions it overlaps, so each region's bytes are hashed once more and the
+// file is still read once. Builds without Windows headers.
+
+struct HashRegion {
+    std::wstring name;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // Bytes inside the region left out of its digests (fields rewritten by
+    // signing, for example).
+    std::vector<HashSkipRange> skip;
+};
+
+struct RegionHashResult {
+    std::wstring name;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // One per algorithm, in the order given to the sink.
+    std::vector<HashResult> hashes;
+};
+
+// Regions may overlap and need not be sorted. The chunks must arrive in file
+// order.
+class RegionHashSink : public HashSink {
+public:
+    RegionHashSink(const std::vector<HashRegion>& regions, const std::vector<HashAlgorithm>& algorithms);
+
+    void Update(uint64_t offset, const uint8_t* data, size_t size) override;
+    // One result per region, in the order given. Call once, after the pass.
+    std::vector<RegionHashResult> Final();
+
+private:
+    // A hashed byte range [begin, end) of one region.
+    struct Piece {
+        uint64_t begin;
+        uint64_t end;
+        size_t region;
+    };
+
+    std::vector<HashRegion> m_regions;
+    std::vector<HashAlgorithm> m_algorithms;
+    // Sorted by begin; m_next is the first piece the stream has not passed.
+    std::vector<Piece> m_pieces;
+    size_t m_next = 0;
+    // m_algorithms.size() contexts per region.
+    std::vector<Digest> m_digests;
+};
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "ReportJsonWriter.h"
+#include "CpuFeatures.h"
+#include "OrdinalNames.h"
 #include "PEResource.h"
 #include "ReportUtil.h"
 
@@ -60,7 +62,12 @@ std::string BuildJsonReport(const ReportOptions& opt,
                             const PESignaturePresence* sigPresence,
                             const std::optional<PESignatureVerifyResult>* embedded,
                             const std::optional<PESignatureVerifyResult>* catalog,
-                            const std::optional<HashResult>* hashResult) {
+                            const std::optional<HashResult>* hashResult,
+                            const std::vector<HashResult>* authentihashes,
+                            const std::optional<PEChecksumResult>* checksum,
+                            const std::vector<RegionHashResult>* regionHashes,
+                            const std::vector<HashResult>* fuzzyHashes,
+                            const std::vector<RegionChunks>* sectionChunks) {
     std::ostringstream oss;
     oss << "{";
     oss << "\"file\":" << JsonQuoteWide(filePath);
@@ -134,6 +141,19 @@ std::string BuildJsonReport(const ReportOptions& opt,
                         oss << JsonQuoteUtf8(d.functions[j].name);
                     }
                     oss << "]";
+                    bool anyOrdinalName = false;
+                    for (const auto& fn : d.functions) {
+                        const char* name = fn.isOrdinal ? LookupOrdinalName(d.dllName, fn.ordinal) : nullptr;
+                        if (name == nullptr) {
+                            continue;
+                        }
+                        oss << (anyOrdinalName ? "," : ",\"ordinalNames\":{");
+                        oss << "\"" << fn.ordinal << "\":" << JsonQuoteUtf8(name);
+                        anyOrdinalName = true;
+                    }
+                    if (anyOrdinalName) {
+                        oss << "}";
+                    }
                 }
                 oss << "}";
             }
@@ -419,11 +439,474 @@ std::string BuildJsonReport(const ReportOptions& opt,
         oss << ",\"hash\":{";
         oss << "\"algorithm\":" << JsonQuoteWide(hashResult->value().algorithm);
         oss << ",\"value\":" << JsonQuoteWide(hashResult->value().result);
+        oss << ",\"standard\":" << (hashResult->value().standard ? "true" : "false");
+        if (hashResult->value().known != HashKnownState::Unchecked) {
+            oss << ",\"known\":" << (hashResult->value().known == HashKnownState::Known ? "true" : "false");
+        }
         oss << ",\"ms\":" << hashResult->value().calculationTime;
         oss << "}";
     }
 
+    if (authentihashes != nullptr && !authentihashes->empty()) {
+        oss << ",\"authentihash\":{";
+        bool first = true;
+        for (const auto& h : *authentihashes) {
+            if (!h.success) {
+                continue;
+            }
+            if (!first) oss << ",";
+            first = false;
+            oss << JsonQuoteWide(h.algorithm) << ":" << JsonQuoteWide(h.result);
+        }
+        oss << "}";
+    }
+
+    if (fuzzyHashes != nullptr && !fuzzyHashes->empty()) {
+        oss << ",\"fuzzy\":{";
+        bool first = true;
+        for (const auto& h : *fuzzyHashes) {
+            if (!h.success) {
+                continue;
+            }
+            if (!first) oss << ",";
+            first = false;
+            oss << JsonQuoteWide(h.algorithm) << ":" << JsonQuoteWide(h.result);
+        }
+        oss << "}";
+    }
+
+    if (checksum != nullptr && checksum->has_value()) {
+        const PEChecksumResult& c = checksum->value();
+        std::ostringstream stored;
+        stored << "0x" << std::hex << std::setw(8) << std::setfill('0') << c.stored;
+        std::ostringstream computed;
+        computed << "0x" << std::hex << std::setw(8) << std::setfill('0') << c.computed;
+        oss << ",\"checksum\":{";
+        oss << "\"stored\":" << JsonQuoteUtf8(stored.str());
+        oss << ",\"computed\":" << JsonQuoteUtf8(computed.str());
+        oss << ",\"set\":" << (c.IsSet() ? "true" : "false");
+        oss << ",\"valid\":" << (c.Matches() ? "true" : "false");
+        oss << "}";
+    }
+
+    if (regionHashes != nullptr && !regionHashes->empty()) {
+        oss << ",\"regionHashes\":[";
+        for (size_t i = 0; i < regionHashes->size(); ++i) {
+            const RegionHashResult& r = (*regionHashes)[i];
+            if (i) oss << ",";
+            oss << "{";
+            oss << "\"name\":" << JsonQuoteWide(r.name);
+            oss << ",\"offset\":" << r.offset;
+            oss << ",\"size\":" << r.size;
+            oss << ",\"hashes\":{";
+            bool first = true;
+            for (const auto& h : r.hashes) {
+                if (!h.success) {
+                    continue;
+                }
+                if (!first) oss << ",";
+                first = false;
+                oss << JsonQuoteWide(h.algorithm) << ":" << JsonQuoteWide(h.result);
+            }
+            oss << "}}";
+        }
+        oss << "]";
+    }
+
+    if (sectionChunks != nullptr && !sectionChunks->empty()) {
+        oss << ",\"sectionChunks\":[";
+        for (size_t i = 0; i < sectionChunks->size(); ++i) {
+            const RegionChunks& r = (*sectionChunks)[i];
+            if (i) oss << ",";
+            oss << "{";
+            oss << "\"name\":" << JsonQuoteWide(r.name);
+            oss << ",\"offset\":" << r.offset;
+            oss << ",\"size\":" << r.size;
+            oss << ",\"chunks\":[";
+            for (size_t j = 0; j < r.chunks.size(); ++j) {
+                const ContentChunk& c = r.chunks[j];
+                if (j) oss << ",";
+                oss << "{\"offset\":" << c.offset << ",\"size\":" << c.size;
+                oss << ",\"hash\":" << JsonQuoteUtf8(DigestToHexA(c.digest, kChunkDigestSize)) << "}";
+            }
+            oss << "]}";
+        }
+        oss << "]";
+    }
+
+    oss << "}";
+    return oss.str();
+}
+
+std::string BuildJsonDiffReport(const std::wstring& oldPath,
+                                const std::wstring& newPath,
+                                const PEDiffResult& diff) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"old\":" << JsonQuoteWide(oldPath);
+    oss << ",\"new\":" << JsonQuoteWide(newPath);
+    oss << ",\"identical\":" << (diff.IsIdentical() ? "true" : "false");
+
+    auto writeFields = [&](const std::vector<PEDiffField>& fields) {
+        oss << "[";
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (i) oss << ",";
+            oss << "{";
+            oss << "\"field\":" << JsonQuoteUtf8(fields[i].name);
+            oss << ",\"old\":" << JsonQuoteUtf8(fields[i].oldValue);
+            oss << ",\"new\":" << JsonQuoteUtf8(fields[i].newValue);
+            oss << "}";
+        }
+        oss << "]";
+    };
+
+    oss << ",\"headers\":";
+    writeFields(diff.headers);
+
+    oss << ",\"sectionsIdentical\":" << diff.sectionsIdentical;
+    oss << ",\"sections\":[";
+    for (size_t i = 0; i < diff.sections.size(); ++i) {
+        const auto& s = diff.sections[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"change\":" << JsonQuoteUtf8(PEDiffChangeName(s.change));
+        oss << ",\"name\":" << JsonQuoteUtf8(s.name);
+        oss << ",\"occurrence\":" << s.occurrence;
+        if (s.change != PEDiffChange::Added) {
+            oss << ",\"oldSha256\":" << JsonQuoteWide(s.oldHash);
+        }
+        if (s.change != PEDiffChange::Removed) {
+            oss << ",\"newSha256\":" << JsonQuoteWide(s.newHash);
+        }
+        if (s.change == PEDiffChange::Modified) {
+            oss << ",\"contentChanged\":" << (s.contentChanged ? "true" : "false");
+            if (s.contentChanged) {
+                oss << ",\"chunks\":{";
+                oss << "\"shared\":" << s.chunks.sharedChunks;
+                oss << ",\"sharedBytes\":" << s.chunks.sharedBytes;
+                oss << ",\"removed\":" << s.chunks.oldOnlyChunks;
+                oss << ",\"removedBytes\":" << s.chunks.oldOnlyBytes;
+                oss << ",\"added\":" << s.chunks.newOnlyChunks;
+                oss << ",\"addedBytes\":" << s.chunks.newOnlyBytes;
+                oss << "}";
+            }
+            oss << ",\"fields\":";
+            writeFields(s.fields);
+        }
+        oss << "}";
+    }
+    oss << "]";
+
+    auto writeImports = [&](const char* key, const std::vector<PEImportDiff>& items) {
+        oss << ",\"" << key << "\":[";
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (i) oss << ",";
+            oss << "{";
+            oss << "\"change\":" << JsonQuoteUtf8(PEDiffChangeName(items[i].change));
+            oss << ",\"dll\":" << JsonQuoteUtf8(items[i].dllName);
+            oss << ",\"function\":" << JsonQuoteUtf8(items[i].function);
+            oss << "}";
+        }
+        oss << "]";
+    };
+    writeImports("imports", diff.imports);
+    writeImports("delayImports", diff.delayImports);
+
+    oss << ",\"exports\":[";
+    for (size_t i = 0; i < diff.exports.size(); ++i) {
+        const auto& e = diff.exports[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"change\":" << JsonQuoteUtf8(PEDiffChangeName(e.change));
+        oss << ",\"key\":" << JsonQuoteUtf8(e.key);
+        if (e.change == PEDiffChange::Modified) {
+            oss << ",\"fields\":";
+            writeFields(e.fields);
+        } else {
+            const PEExportFunction& x = (e.change == PEDiffChange::Added) ? e.newExport : e.oldExport;
+            oss << ",\"ordinal\":" << x.ordinal;
+            oss << ",\"rva\":" << x.rva;
+            if (x.isForwarded) {
+                oss << ",\"forwarder\":" << JsonQuoteUtf8(x.forwarder);
+            }
+        }
+        oss << "}";
+    }
+    oss << "]";
+
+    oss << ",\"resources\":[";
+    for (size_t i = 0; i < diff.resources.size(); ++i) {
+        const auto& r = diff.resources[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"change\":" << JsonQuoteUtf8(PEDiffChangeName(r.change));
+        oss << ",\"type\":" << JsonQuoteWide(r.type);
+        oss << ",\"name\":" << JsonQuoteWide(r.name);
+        oss << ",\"langId\":" << r.language;
+        oss << ",\"oldSize\":" << r.oldSize;
+        oss << ",\"newSize\":" << r.newSize;
+        oss << "}";
+    }
+    oss << "]";
+
+    oss << ",\"debugEntries\":[";
+    for (size_t i = 0; i < diff.debugEntries.size(); ++i) {
+        const auto& d = diff.debugEntries[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"change\":" << JsonQuoteUtf8(PEDiffChangeName(d.change));
+        oss << ",\"type\":" << JsonQuoteUtf8(d.type);
+        oss << ",\"occurrence\":" << d.occurrence;
+        if (d.change == PEDiffChange::Modified) {
+            oss << ",\"fields\":";
+            writeFields(d.fields);
+        } else {
+            const PEDebugEntry& e = (d.change == PEDiffChange::Added) ? d.newEntry : d.oldEntry;
+            oss << ",\"timeDateStamp\":" << e.timeDateStamp;
+            oss << ",\"sizeOfData\":" << e.sizeOfData;
+            oss << ",\"sha256\":" << JsonQuoteWide(d.change == PEDiffChange::Added ? d.newHash : d.oldHash);
+        }
+        oss << "}";
+    }
+    oss << "]";
+
+    oss << ",\"debug\":";
+    writeFields(diff.debug);
+
+    oss << "}";
+    return oss.str();
+}
+
+std::string BuildJsonForwarderReport(const PEExportCache& cache,
+                                     const std::vector<PEForwarderImageResult>& images) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"dllDirectory\":" << JsonQuoteWide(cache.GetDirectory());
+    oss << ",\"cache\":{\"loads\":" << cache.GetLoadCount() << ",\"hits\":" << cache.GetHitCount() << "}";
+    oss << ",\"files\":[";
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto& img = images[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"path\":" << JsonQuoteWide(img.filePath);
+        oss << ",\"loaded\":" << (img.loaded ? "true" : "false");
+        if (!img.loaded) {
+            oss << ",\"error\":" << JsonQuoteWide(img.error);
+        }
+        oss << ",\"forwarders\":[";
+        for (size_t j = 0; j < img.forwarders.size(); ++j) {
+            const auto& f = img.forwarders[j];
+            if (j) oss << ",";
+            oss << "{";
+            oss << "\"export\":" << JsonQuoteUtf8(f.exportKey);
+            oss << ",\"status\":" << JsonQuoteUtf8(PEForwarderStatusName(f.status));
+            oss << ",\"chain\":[";
+            for (size_t k = 0; k < f.chain.size(); ++k) {
+                if (k) oss << ",";
+                oss << JsonQuoteUtf8(f.chain[k]);
+            }
+            oss << "]";
+            oss << ",\"finalDll\":" << JsonQuoteUtf8(f.finalDll);
+            oss << ",\"finalName\":" << JsonQuoteUtf8(f.finalName);
+            if (f.status == PEForwarderStatus::Resolved) {
+                oss << ",\"finalOrdinal\":" << f.finalOrdinal;
+                oss << ",\"finalRva\":" << f.finalRva;
+            }
+            oss << "}";
+        }
+        oss << "]";
+        oss << "}";
+    }
+    oss << "]";
+    oss << "}";
+    return oss.str();
+}
+
+std::string BuildJsonDependencyReport(const PEDependencyGraph& graph) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"formatVersion\":1";
+    oss << ",\"includeDelayImports\":" << (graph.includeDelayImports ? "true" : "false");
+    oss << ",\"nodes\":[";
+    for (size_t i = 0; i < graph.nodes.size(); ++i) {
+        const auto& n = graph.nodes[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"id\":" << i;
+        oss << ",\"name\":" << JsonQuoteUtf8(n.name);
+        oss << ",\"path\":" << JsonQuoteWide(n.filePath);
+        oss << ",\"root\":" << (n.isRoot ? "true" : "false");
+        oss << ",\"parsed\":" << (n.parsed ? "true" : "false");
+        oss << ",\"reused\":" << (n.reused ? "true" : "false");
+        if (!n.parsed) {
+            oss << ",\"error\":" << JsonQuoteWide(n.error);
+        }
+        oss << ",\"size\":" << n.fileSize;
+        oss << ",\"lastWriteTime\":" << n.lastWriteTime;
+        oss << ",\"edges\":[";
+        for (size_t j = 0; j < n.edges.size(); ++j) {
+            const auto& e = n.edges[j];
+            if (j) oss << ",";
+            oss << "{";
+            oss << "\"dll\":" << JsonQuoteUtf8(e.dllName);
+            oss << ",\"delayLoad\":" << (e.delayLoad ? "true" : "false");
+            oss << ",\"apiSet\":" << (e.apiSet ? "true" : "false");
+            oss << ",\"target\":";
+            if (e.target >= 0) {
+                oss << e.target;
+            } else {
+                oss << "null";
+            }
+            oss << ",\"importCount\":" << e.importCount;
+            oss << ",\"unresolvedImports\":[";
+            for (size_t k = 0; k < e.unresolvedImports.size(); ++k) {
+                if (k) oss << ",";
+                oss << JsonQuoteUtf8(e.unresolvedImports[k]);
+            }
+            oss << "]";
+            oss << "}";
+        }
+        oss << "]";
+        oss << "}";
+    }
+    oss << "]";
+    oss << ",\"missingDlls\":[";
+    for (size_t i = 0; i < graph.missingDlls.size(); ++i) {
+        if (i) oss << ",";
+        oss << JsonQuoteUtf8(graph.missingDlls[i]);
+    }
+    oss << "]";
+    oss << ",\"unresolvedImportCount\":" << graph.unresolvedImportCount;
+    oss << "}";
+    return oss.str();
+}
+
+std::string BuildJsonDigestBenchmark(const std::wstring& selfTestError,
+                                     const std::vector<DigestBenchmarkResult>& results,
+                                     size_t multiBufferMessageSize,
+                                     const std::vector<Sha256MultiBufferBenchmark>& multiBuffer) {
+    const CpuFeatures& cpu = GetCpuFeatures();
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"formatVersion\":1";
+    oss << ",\"cpu\":{";
+    oss << "\"sse2\":" << (cpu.sse2 ? "true" : "false");
+    oss << ",\"ssse3\":" << (cpu.ssse3 ? "true" : "false");
+    oss << ",\"sse41\":" << (cpu.sse41 ? "true" : "false");
+    oss << ",\"sse42\":" << (cpu.sse42 ? "true" : "false");
+    oss << ",\"avx2\":" << (cpu.avx2 ? "true" : "false");
+    oss << ",\"avx512f\":" << (cpu.avx512f ? "true" : "false");
+    oss << ",\"shaNi\":" << (cpu.shaNi ? "true" : "false");
+    oss << ",\"armSha1\":" << (cpu.armSha1 ? "true" : "false");
+    oss << ",\"armSha2\":" << (cpu.armSha2 ? "true" : "false");
+    oss << ",\"armCrc32\":" << (cpu.armCrc32 ? "true" : "false");
+    oss << "}";
+    oss << ",\"active\":{";
+    oss << "\"MD5\":" << JsonQuoteUtf8(GetActiveDigestImplName(HashAlgorithm::MD5));
+    oss << ",\"SHA1\":" << JsonQuoteUtf8(GetActiveDigestImplName(HashAlgorithm::SHA1));
+    oss << ",\"SHA256\":" << JsonQuoteUtf8(GetActiveDigestImplName(HashAlgorithm::SHA256));
+    oss << ",\"XXH3\":" << JsonQuoteUtf8(GetActiveDigestImplName(HashAlgorithm::XXH3_64));
+    oss << ",\"CRC32C\":" << JsonQuoteUtf8(GetActiveDigestImplName(HashAlgorithm::CRC32C));
+    oss << ",\"SHA256MultiBuffer\":" << JsonQuoteUtf8(GetSha256MultiBufferImplName());
+    oss << ",\"SHA256MultiBufferPreferred\":" << (IsSha256MultiBufferPreferred() ? "true" : "false");
+    oss << ",\"PEChecksum\":" << JsonQuoteUtf8(GetPEChecksumImplName());
+    oss << ",\"FuzzyCompare\":" << JsonQuoteUtf8(GetFuzzyCompareImplName());
+    oss << "}";
+    oss << ",\"selfTest\":{";
+    oss << "\"passed\":" << (selfTestError.empty() ? "true" : "false");
+    if (!selfTestError.empty()) {
+        oss << ",\"error\":" << JsonQuoteWide(selfTestError);
+    }
+    oss << "}";
+    oss << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"algorithm\":" << JsonQuoteUtf8(r.algorithm);
+        oss << ",\"impl\":" << JsonQuoteUtf8(r.impl);
+        oss << ",\"bytes\":" << r.bytes;
+        oss << ",\"seconds\":" << std::fixed << std::setprecision(6) << r.seconds;
+        oss << ",\"megabytesPerSecond\":" << std::setprecision(1) << r.megabytesPerSecond;
+        oss << "}";
+    }
+    oss << "]";
+    oss << ",\"multiBuffer\":{";
+    oss << "\"messageSize\":" << multiBufferMessageSize;
+    oss << ",\"results\":[";
+    for (size_t i = 0; i < multiBuffer.size(); ++i) {
+        const auto& r = multiBuffer[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"impl\":" << JsonQuoteUtf8(r.impl);
+        oss << ",\"lanes\":" << r.lanes;
+        oss << ",\"bytes\":" << r.bytes;
+        oss << ",\"seconds\":" << std::fixed << std::setprecision(6) << r.seconds;
+        oss << ",\"megabytesPerSecond\":" << std::setprecision(1) << r.megabytesPerSecond;
+        oss << "}";
+    }
+    oss << "]";
+    oss << "}";
+    oss << "}";
+    return oss.str();
+}
+
+std::string BuildJsonAsyncReadBenchmark(const std::wstring& filePath, const std::vector<AsyncReadBenchmarkResult>& results) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"formatVersion\":1";
+    oss << ",\"file\":" << JsonQuoteWide(filePath);
+    oss << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"backend\":" << JsonQuoteUtf8(r.backend);
+        oss << ",\"algorithm\":" << JsonQuoteUtf8(r.algorithm);
+        oss << ",\"tuned\":" << ((r.chunkSize == 0 && r.queueDepth == 0) ? "true" : "false");
+        oss << ",\"chunkSize\":" << r.stats.chunkSize;
+        oss << ",\"queueDepth\":" << r.stats.queueDepth;
+        oss << ",\"reads\":" << r.stats.reads;
+        oss << ",\"bytes\":" << r.stats.bytes;
+        oss << ",\"seconds\":" << std::fixed << std::setprecision(6) << r.stats.seconds;
+        oss << ",\"megabytesPerSecond\":" << std::setprecision(1) << r.megabytesPerSecond;
+        if (r.error.empty()) {
+            oss << ",\"digest\":" << JsonQuoteUtf8(r.digest);
+        } else {
+            oss << ",\"error\":" << JsonQuoteUtf8(r.error);
+        }
+        oss << "}";
+    }
+    oss << "]";
     oss << "}";
     return oss.str();
 }
 
+std::string BuildJsonPageCacheBenchmark(const std::wstring& filePath, const std::vector<PageCacheBenchmarkResult>& results) {
+    std::ostringstream oss;
+    oss << "{";
+    oss << "\"formatVersion\":1";
+    oss << ",\"file\":" << JsonQuoteWide(filePath);
+    oss << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        if (i) oss << ",";
+        oss << "{";
+        oss << "\"cachePolicy\":" << JsonQuoteUtf8(r.cachePolicy);
+        oss << ",\"ioPolicy\":" << JsonQuoteUtf8(r.ioPolicy);
+        oss << ",\"algorithm\":" << JsonQuoteUtf8(r.algorithm);
+        oss << ",\"bytes\":" << r.bytes;
+        oss << ",\"cacheGrowthBytes\":" << r.cacheGrowthBytes;
+        oss << ",\"seconds\":" << std::fixed << std::setprecision(6) << r.seconds;
+        oss << ",\"megabytesPerSecond\":" << std::setprecision(1) << r.megabytesPerSecond;
+        if (r.error.empty()) {
+            oss << ",\"digest\":" << JsonQuoteUtf8(r.digest);
+        } else {
+            oss << ",\"error\":" << JsonQuoteUtf8(r.error);
+        }
+        oss << "}";
+    }
+    oss << "]";
+    oss << "}";
+    return oss.str();
+}
@@ -2,10 +2,20 @@
 
 #include "ReportTypes.h"
 
+#include "AsyncFileReader.h"
+#include "ChunkHash.h"
+#include "Digest.h"
 #include "HashCalculator.h"
+#include "FuzzyHash.h"
+#include "PEChecksum.h"
+#include "RegionHash.h"
 #include "PEDebugInfo.h"
+#include "PEDependencyGraph.h"
+#include "PEDiff.h"
+#include "PEForwarderResolver.h"
 #include "PEParser.h"
 #include "PESignature.h"
+#include "Sha256MultiBuffer.h"
 
 #include <optional>
 #include <string>
@@ -17,5 +27,31 @@ std::string BuildJsonReport(const ReportOptions& opt,
                             const PESignaturePresence* sigPresence,
                             const std::optional<PESignatureVerifyResult>* embedded,
                             const std::optional<PESignatureVerifyResult>* catalog,
-                            const std::optional<HashResult>* hashResult);
+                            const std::optional<HashResult>* hashResult,
+                            const std::vector<HashResult>* authentihashes = nullptr,
+                            const std::optional<PEChecksumResult>* checksum = nullptr,
+                            const std::vector<RegionHashResult>* regionHashes = nullptr,
+                            const std::vector<HashResult>* fuzzyHashes = nullptr,
+                            const std::vector<RegionChunks>* sectionChunks = nullptr);
 
+std::string BuildJsonDiffReport(const std::wstring& oldPath,
+                                const std::wstring& newPath,
+                                const PEDiffResult& diff);
+
+std::string BuildJsonForwarderReport(const PEExportCache& cache,
+                                     const std::vector<PEForwarderImageResult>& images);
+
+// Node ids are indexes into "nodes"; each node carries its file size and last
+// write time so a later run can tell which entries are still current.
+std::string BuildJsonDependencyReport(const PEDependencyGraph& graph);
+
+
+// selfTestError is empty when the known-answer tests passed.
+std::string BuildJsonDigestBenchmark(const std::wstring& selfTestError,
+                                     const std::vector<DigestBenchmarkResult>& results,
+                                     size_t multiBufferMessageSize,
+                                     const std::vector<Sha256MultiBufferBenchmark>& multiBuffer);
+
+std::string BuildJsonAsyncReadBenchmark(const std::wstring& filePath, const std::vector<AsyncReadBenchmarkResult>& results);
+
+std::string BuildJsonPageCacheBenchmark(const std::wstring& filePath, const std::vector<PageCacheBenchmarkResult>& results);
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "ReportTextWriter.h"
+#include "OrdinalNames.h"
 #include "PEResource.h"
 #include "ReportUtil.h"
 
@@ -35,6 +36,34 @@ static void PrintHeaderInfo(std::wostream& os, const PEHeaderInfo& h, const Repo
     os << L"  Subsystem: " << ToWStringUtf8BestEffort(h.subsystem) << L"\n";
 }
 
+static const wchar_t* KnownStateSuffix(HashKnownState known) {
+    switch (known) {
+    case HashKnownState::Known:
+        return L" (known)";
+    case HashKnownState::Unknown:
+        return L" (unknown)";
+    default:
+        return L"";
+    }
+}
+
+static void PrintRegionHashes(std::wostream& os, const std::vector<RegionHashResult>& regions) {
+    os << L"Region Hashes:\n";
+    os << L"  Name     Offset    Size\n";
+    for (const auto& r : regions) {
+        std::wstring name = r.name;
+        if (name.size() > 8) {
+            name.resize(8);
+        }
+        os << L"  " << std::left << std::setw(8) << std::setfill(L' ') << name << std::right
+           << L" " << HexU64(r.offset, 8)
+           << L" " << HexU64(r.size, 8) << L"\n";
+        for (const auto& h : r.hashes) {
+            os << L"    " << h.algorithm << (h.standard ? L"" : L" (non-standard)") << L"  " << h.result << L"\n";
+        }
+    }
+}
+
 static void PrintSectionsSummary(std::wostream& os, const std::vector<PESectionInfo>& sections) {
     if (sections.empty()) {
         os << L"Sections: (none)\n";
@@ -78,7 +107,7 @@ static void PrintImportsSummary(std::wostream& os, const std::wstring& title, co
                 os << L"    ...\n";
                 break;
             }
-            os << L"    " << ToWStringUtf8BestEffort(fn.name) << L"\n";
+            os << L"    " << ToWStringUtf8BestEffort(ImportFunctionDisplayName(dll.dllName, fn)) << L"\n";
             ++shown;
         }
     }
@@ -381,6 +410,10 @@ std::wstring BuildTextReport(const ReportOptions& opt,
                              const std::optional<PESignatureVerifyResult>& embedded,
                              const std::optional<PESignatureVerifyResult>& catalog,
                              const std::optional<HashResult>& hashResult,
+                             const std::vector<HashResult>& authentihashes,
+                             const std::optional<PEChecksumResult>& checksum,
+                             const std::vector<RegionHashResult>& regionHashes,
+                             const std::vector<HashResult>& fuzzyHashes,
                              size_t importMaxPerDll,
                              size_t maxExports) {
     std::wostringstream out;
@@ -410,7 +443,25 @@ std::wstring BuildTextReport(const ReportOptions& opt,
             PrintSignatureText(out, *sigPresence, embedded, catalog);
         }
         if (hashResult.has_value()) {
-            out << hashResult->algorithm << L"  " << hashResult->result << L"  " << std::fixed << std::setprecision(3) << hashResult->calculationTime << L" ms\n";
+            out << hashResult->algorithm << (hashResult->standard ? L"" : L" (non-standard)") << L"  " << hashResult->result << L"  " << std::fixed << std::setprecision(3) << hashResult->calculationTime << L" ms"
+                << KnownStateSuffix(hashResult->known) << L"\n";
+        }
+        for (const auto& h : authentihashes) {
+            if (h.success) {
+                out << L"Authentihash " << h.algorithm << L"  " << h.result << L"\n";
+            }
+        }
+        for (const auto& h : fuzzyHashes) {
+            if (h.success) {
+                out << h.algorithm << L"  " << h.result << L"\n";
+            }
+        }
+        if (checksum.has_value()) {
+            out << L"CheckSum  stored " << HexU32(checksum->stored, 8) << L"  computed " << HexU32(checksum->computed, 8) << L"  "
+                << (checksum->Matches() ? L"OK" : (checksum->IsSet() ? L"MISMATCH" : L"not set")) << L"\n";
+        }
+        if (!regionHashes.empty()) {
+            PrintRegionHashes(out, regionHashes);
         }
     } else {
         out << filePath;
@@ -424,6 +475,23 @@ std::wstring BuildTextReport(const ReportOptions& opt,
         }
         if (hashResult.has_value()) {
             out << L"  " << hashResult->algorithm << L"=" << hashResult->result;
+            if (!hashResult->standard) {
+                out << L" (non-standard)";
+            }
+            out << KnownStateSuffix(hashResult->known);
+        }
+        for (const auto& h : authentihashes) {
+            if (h.success) {
+                out << L"  authentihash-" << h.algorithm << L"=" << h.result;
+            }
+        }
+        for (const auto& h : fuzzyHashes) {
+            if (h.success) {
+                out << L"  " << h.algorithm << L"=" << h.result;
+            }
+        }
+        if (checksum.has_value()) {
+            out << L"  checksum=" << (checksum->Matches() ? L"ok" : (checksum->IsSet() ? L"mismatch" : L"unset"));
         }
         out << L"\n";
     }
@@ -431,3 +499,133 @@ std::wstring BuildTextReport(const ReportOptions& opt,
     return out.str();
 }
 
+namespace {
+
+const wchar_t* DiffMarker(PEDiffChange change) {
+    switch (change) {
+        case PEDiffChange::Added: return L"+";
+        case PEDiffChange::Removed: return L"-";
+        case PEDiffChange::Modified: return L"~";
+    }
+    return L"?";
+}
+
+void PrintDiffFields(std::wostream& os, const wchar_t* indent, const std::vector<PEDiffField>& fields) {
+    for (const auto& f : fields) {
+        os << indent << ToWStringUtf8BestEffort(f.name) << L": " << ToWStringUtf8BestEffort(f.oldValue)
+           << L" -> " << ToWStringUtf8BestEffort(f.newValue) << L"\n";
+    }
+}
+
+void PrintImportDiffs(std::wostream& os, const std::wstring& title, const std::vector<PEImportDiff>& items) {
+    if (items.empty()) {
+        os << title << L": (no changes)\n";
+        return;
+    }
+    os << title << L": " << items.size() << L" changes\n";
+    for (const auto& d : items) {
+        os << L"  " << DiffMarker(d.change) << L" " << ToWStringUtf8BestEffort(d.dllName) << L"!"
+           << ToWStringUtf8BestEffort(d.function) << L"\n";
+    }
+}
+
+} // namespace
+
+std::wstring BuildTextDiffReport(const std::wstring& oldPath,
+                                 const std::wstring& newPath,
+                                 const PEDiffResult& diff) {
+    std::wostringstream out;
+    out << L"Old: " << oldPath << L"\n";
+    out << L"New: " << newPath << L"\n";
+    if (diff.IsIdentical()) {
+        out << L"Result: identical\n";
+        return out.str();
+    }
+
+    if (diff.headers.empty()) {
+        out << L"Headers: (no changes)\n";
+    } else {
+        out << L"Headers:\n";
+        PrintDiffFields(out, L"  ", diff.headers);
+    }
+
+    if (diff.sections.empty()) {
+        out << L"Sections: (no changes, " << diff.sectionsIdentical << L" identical)\n";
+    } else {
+        out << L"Sections: (" << diff.sectionsIdentical << L" identical)\n";
+        for (const auto& s : diff.sections) {
+            out << L"  " << DiffMarker(s.change) << L" " << ToWStringUtf8BestEffort(s.name);
+            if (s.occurrence > 0) {
+                out << L"#" << s.occurrence;
+            }
+            if (s.change == PEDiffChange::Modified) {
+                out << (s.contentChanged ? L"  content changed" : L"  content identical") << L"\n";
+                if (s.contentChanged) {
+                    out << L"    SHA256: " << s.oldHash << L" -> " << s.newHash << L"\n";
+                    out << L"    Chunks: " << s.chunks.sharedChunks << L" shared (" << s.chunks.sharedBytes << L" bytes), "
+                        << s.chunks.oldOnlyChunks << L" removed (" << s.chunks.oldOnlyBytes << L" bytes), "
+                        << s.chunks.newOnlyChunks << L" added (" << s.chunks.newOnlyBytes << L" bytes)\n";
+                }
+                PrintDiffFields(out, L"    ", s.fields);
+            } else {
+                const PESectionInfo& info = (s.change == PEDiffChange::Added) ? s.newInfo : s.oldInfo;
+                out << L"  RVA " << HexU32(info.virtualAddress, 8) << L"  RawSz " << HexU32(info.rawSize, 8) << L"\n";
+            }
+        }
+    }
+
+    PrintImportDiffs(out, L"Imports", diff.imports);
+    PrintImportDiffs(out, L"Delay-Imports", diff.delayImports);
+
+    if (diff.exports.empty()) {
+        out << L"Exports: (no changes)\n";
+    } else {
+        out << L"Exports: " << diff.exports.size() << L" changes\n";
+        for (const auto& e : diff.exports) {
+            out << L"  " << DiffMarker(e.change) << L" " << ToWStringUtf8BestEffort(e.key);
+            if (e.change == PEDiffChange::Modified) {
+                out << L"\n";
+                PrintDiffFields(out, L"    ", e.fields);
+            } else {
+                const PEExportFunction& x = (e.change == PEDiffChange::Added) ? e.newExport : e.oldExport;
+                out << L"  ordinal " << x.ordinal << L"  RVA " << HexU32(x.rva, 8);
+                if (x.isForwarded) {
+                    out << L"  -> " << ToWStringUtf8BestEffort(x.forwarder);
+                }
+                out << L"\n";
+            }
+        }
+    }
+
+    if (diff.resources.empty()) {
+        out << L"Resources: (no changes)\n";
+    } else {
+        out << L"Resources: " << diff.resources.size() << L" changes\n";
+        for (const auto& r : diff.resources) {
+            out << L"  " << DiffMarker(r.change) << L" " << r.type << L"/" << r.name << L" (lang " << HexU32(r.language, 4) << L")  "
+                << r.oldSize << L" -> " << r.newSize << L" bytes\n";
+        }
+    }
+
+    if (diff.debugEntries.empty() && diff.debug.empty()) {
+        out << L"Debug: (no changes)\n";
+    } else {
+        out << L"Debug:\n";
+        for (const auto& d : diff.debugEntries) {
+            out << L"  " << DiffMarker(d.change) << L" " << ToWStringUtf8BestEffort(d.type);
+            if (d.occurrence > 0) {
+                out << L"#" << d.occurrence;
+            }
+            if (d.change == PEDiffChange::Modified) {
+                out << L"\n";
+                PrintDiffFields(out, L"    ", d.fields);
+            } else {
+                const PEDebugEntry& e = (d.change == PEDiffChange::Added) ? d.newEntry : d.oldEntry;
+                out << L"  TimeDateStamp " << HexU32(e.timeDateStamp, 8) << L"  SizeOfData " << HexU32(e.sizeOfData, 8) << L"\n";
+            }
+        }
+        PrintDiffFields(out, L"  ", diff.debug);
+    }
+
+    return out.str();
+}
@@ -3,7 +3,10 @@
 #include "ReportTypes.h"
 
 #include "HashCalculator.h"
+#include "PEChecksum.h"
+#include "RegionHash.h"
 #include "PEDebugInfo.h"
+#include "PEDiff.h"
 #include "PEParser.h"
 #include "PESignature.h"
 
@@ -18,6 +21,14 @@ std::wstring BuildTextReport(const ReportOptions& opt,
                              const std::optional<PESignatureVerifyResult>& embedded,
                              const std::optional<PESignatureVerifyResult>& catalog,
                              const std::optional<HashResult>& hashResult,
+                             const std::vector<HashResult>& authentihashes = {},
+                             const std::optional<PEChecksumResult>& checksum = std::nullopt,
+                             const std::vector<RegionHashResult>& regionHashes = {},
+                             const std::vector<HashResult>& fuzzyHashes = {},
                              size_t importMaxPerDll = 50,
                              size_t maxExports = 500);
 
+std::wstring BuildTextDiffReport(const std::wstring& oldPath,
+                                 const std::wstring& newPath,
+                                 const PEDiffResult& diff);
+
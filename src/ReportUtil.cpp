@@ -6,13 +6,13 @@
 #include <iomanip>
 #include <sstream>
 
-std::wstring GetPeInfoSettingsIniPath() {
-    PWSTR roaming = nullptr;
-    if (FAILED(SHGetKnownFolderPath(FOLDERID_RoamingAppData, KF_FLAG_DEFAULT, nullptr, &roaming)) || roaming == nullptr) {
+static std::wstring GetPeInfoDataPath(const KNOWNFOLDERID& folder, const wchar_t* fileName) {
+    PWSTR root = nullptr;
+    if (FAILED(SHGetKnownFolderPath(folder, KF_FLAG_DEFAULT, nullptr, &root)) || root == nullptr) {
         return {};
     }
-    std::wstring base = roaming;
-    CoTaskMemFree(roaming);
+    std::wstring base = root;
+    CoTaskMemFree(root);
 
     std::wstring dir = base;
     if (!dir.empty() && dir.back() != L'\\') {
@@ -21,9 +21,20 @@ std::wstring GetPeInfoSettingsIniPath() {
     dir += L"PEInfo";
     SHCreateDirectoryExW(nullptr, dir.c_str(), nullptr);
 
-    std::wstring ini = dir;
-    ini += L"\\settings.ini";
-    return ini;
+    std::wstring path = dir;
+    path += L'\\';
+    path += fileName;
+    return path;
+}
+
+std::wstring GetPeInfoSettingsIniPath() {
+    return GetPeInfoDataPath(FOLDERID_RoamingAppData, L"settings.ini");
+}
+
+std::wstring GetPeInfoHashCachePath() {
+    // Local, not roaming: the cache is large and its file IDs only make sense
+    // on this machine.
+    return GetPeInfoDataPath(FOLDERID_LocalAppData, L"hashcache.dat");
 }
 
 std::wstring ToWStringUtf8BestEffort(const std::string& s) {
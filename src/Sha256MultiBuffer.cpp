@@ -0,0 +1,778 @@
+#include "Sha256MultiBuffer.h"
+
+#include "CpuFeatures.h"
+#include "Digest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_MB_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#define PEINFO_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#define PEINFO_TARGET_AVX512
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_MB_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Lane-major state: word i of lane l lives at state[i * lanes + l]. Lane l
+// reads its count consecutive blocks starting at blocks[l].
+typedef void (*Sha256LanesFn)(uint32_t* state, const uint8_t* const* blocks, size_t count);
+
+struct LaneImpl {
+    const char* name;
+    size_t lanes;
+    Sha256LanesFn blocks;
+};
+
+inline uint32_t LoadBe32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+#if defined(PEINFO_MB_X86)
+namespace sse2 {
+
+PEINFO_TARGET_SSE2
+inline __m128i Add(__m128i x, __m128i y) {
+    return _mm_add_epi32(x, y);
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i Xor(__m128i x, __m128i y) {
+    return _mm_xor_si128(x, y);
+}
+
+template <int n>
+PEINFO_TARGET_SSE2
+inline __m128i Rotr(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n));
+}
+
+template <int n>
+PEINFO_TARGET_SSE2
+inline __m128i Shr(__m128i x) {
+    return _mm_srli_epi32(x, n);
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i BigSigma0(__m128i x) {
+    return Xor(Xor(Rotr<2>(x), Rotr<13>(x)), Rotr<22>(x));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i BigSigma1(__m128i x) {
+    return Xor(Xor(Rotr<6>(x), Rotr<11>(x)), Rotr<25>(x));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i SmallSigma0(__m128i x) {
+    return Xor(Xor(Rotr<7>(x), Rotr<18>(x)), Shr<3>(x));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i SmallSigma1(__m128i x) {
+    return Xor(Xor(Rotr<17>(x), Rotr<19>(x)), Shr<10>(x));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i Ch(__m128i e, __m128i f, __m128i g) {
+    return Xor(_mm_and_si128(e, f), _mm_andnot_si128(e, g));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i Maj(__m128i a, __m128i b, __m128i c) {
+    return _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, _mm_or_si128(a, b)));
+}
+
+PEINFO_TARGET_SSE2
+inline __m128i LoadWord(const uint8_t* const* blocks, size_t offset) {
+    return _mm_set_epi32(
+        static_cast<int>(LoadBe32(blocks[3] + offset)), static_cast<int>(LoadBe32(blocks[2] + offset)),
+        static_cast<int>(LoadBe32(blocks[1] + offset)), static_cast<int>(LoadBe32(blocks[0] + offset)));
+}
+
+PEINFO_TARGET_SSE2
+void Blocks(uint32_t* state, const uint8_t* const* blocks, size_t count) {
+    __m128i s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + i * 4));
+    }
+    for (size_t blk = 0; blk < count; ++blk) {
+        __m128i w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadWord(blocks, blk * 64 + 4 * static_cast<size_t>(i));
+        }
+        __m128i a = s[0];
+        __m128i b = s[1];
+        __m128i c = s[2];
+        __m128i d = s[3];
+        __m128i e = s[4];
+        __m128i f = s[5];
+        __m128i g = s[6];
+        __m128i h = s[7];
+        for (int i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] = Add(Add(w[i & 15], SmallSigma0(w[(i + 1) & 15])), Add(w[(i + 9) & 15], SmallSigma1(w[(i + 14) & 15])));
+            }
+            __m128i t1 = Add(Add(h, BigSigma1(e)), Add(Ch(e, f, g), Add(_mm_set1_epi32(static_cast<int>(kSha256K[i])), w[i & 15])));
+            __m128i t2 = Add(BigSigma0(a), Maj(a, b, c));
+            h = g;
+            g = f;
+            f = e;
+            e = Add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = Add(t1, t2);
+        }
+        s[0] = Add(s[0], a);
+        s[1] = Add(s[1], b);
+        s[2] = Add(s[2], c);
+        s[3] = Add(s[3], d);
+        s[4] = Add(s[4], e);
+        s[5] = Add(s[5], f);
+        s[6] = Add(s[6], g);
+        s[7] = Add(s[7], h);
+    }
+    for (int i = 0; i < 8; ++i) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + i * 4), s[i]);
+    }
+}
+
+} // namespace sse2
+
+namespace avx2 {
+
+PEINFO_TARGET_AVX2
+inline __m256i Add(__m256i x, __m256i y) {
+    return _mm256_add_epi32(x, y);
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i Xor(__m256i x, __m256i y) {
+    return _mm256_xor_si256(x, y);
+}
+
+template <int n>
+PEINFO_TARGET_AVX2
+inline __m256i Rotr(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+template <int n>
+PEINFO_TARGET_AVX2
+inline __m256i Shr(__m256i x) {
+    return _mm256_srli_epi32(x, n);
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i BigSigma0(__m256i x) {
+    return Xor(Xor(Rotr<2>(x), Rotr<13>(x)), Rotr<22>(x));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i BigSigma1(__m256i x) {
+    return Xor(Xor(Rotr<6>(x), Rotr<11>(x)), Rotr<25>(x));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i SmallSigma0(__m256i x) {
+    return Xor(Xor(Rotr<7>(x), Rotr<18>(x)), Shr<3>(x));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i SmallSigma1(__m256i x) {
+    return Xor(Xor(Rotr<17>(x), Rotr<19>(x)), Shr<10>(x));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i Ch(__m256i e, __m256i f, __m256i g) {
+    return Xor(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i Maj(__m256i a, __m256i b, __m256i c) {
+    return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+}
+
+PEINFO_TARGET_AVX2
+inline __m256i LoadWord(const uint8_t* const* blocks, size_t offset) {
+    return _mm256_set_epi32(
+        static_cast<int>(LoadBe32(blocks[7] + offset)), static_cast<int>(LoadBe32(blocks[6] + offset)),
+        static_cast<int>(LoadBe32(blocks[5] + offset)), static_cast<int>(LoadBe32(blocks[4] + offset)),
+        static_cast<int>(LoadBe32(blocks[3] + offset)), static_cast<int>(LoadBe32(blocks[2] + offset)),
+        static_cast<int>(LoadBe32(blocks[1] + offset)), static_cast<int>(LoadBe32(blocks[0] + offset)));
+}
+
+PEINFO_TARGET_AVX2
+void Blocks(uint32_t* state, const uint8_t* const* blocks, size_t count) {
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + i * 8));
+    }
+    for (size_t blk = 0; blk < count; ++blk) {
+        __m256i w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadWord(blocks, blk * 64 + 4 * static_cast<size_t>(i));
+        }
+        __m256i a = s[0];
+        __m256i b = s[1];
+        __m256i c = s[2];
+        __m256i d = s[3];
+        __m256i e = s[4];
+        __m256i f = s[5];
+        __m256i g = s[6];
+        __m256i h = s[7];
+        for (int i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] = Add(Add(w[i & 15], SmallSigma0(w[(i + 1) & 15])), Add(w[(i + 9) & 15], SmallSigma1(w[(i + 14) & 15])));
+            }
+            __m256i t1 = Add(Add(h, BigSigma1(e)), Add(Ch(e, f, g), Add(_mm256_set1_epi32(static_cast<int>(kSha256K[i])), w[i & 15])));
+            __m256i t2 = Add(BigSigma0(a), Maj(a, b, c));
+            h = g;
+            g = f;
+            f = e;
+            e = Add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = Add(t1, t2);
+        }
+        s[0] = Add(s[0], a);
+        s[1] = Add(s[1], b);
+        s[2] = Add(s[2], c);
+        s[3] = Add(s[3], d);
+        s[4] = Add(s[4], e);
+        s[5] = Add(s[5], f);
+        s[6] = Add(s[6], g);
+        s[7] = Add(s[7], h);
+    }
+    for (int i = 0; i < 8; ++i) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + i * 8), s[i]);
+    }
+}
+
+} // namespace avx2
+
+namespace avx512 {
+
+PEINFO_TARGET_AVX512
+inline __m512i Add(__m512i x, __m512i y) {
+    return _mm512_add_epi32(x, y);
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i Xor(__m512i x, __m512i y) {
+    return _mm512_xor_si512(x, y);
+}
+
+template <int n>
+PEINFO_TARGET_AVX512
+inline __m512i Rotr(__m512i x) {
+    return _mm512_ror_epi32(x, n);
+}
+
+template <int n>
+PEINFO_TARGET_AVX512
+inline __m512i Shr(__m512i x) {
+    return _mm512_srli_epi32(x, n);
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i BigSigma0(__m512i x) {
+    return Xor(Xor(Rotr<2>(x), Rotr<13>(x)), Rotr<22>(x));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i BigSigma1(__m512i x) {
+    return Xor(Xor(Rotr<6>(x), Rotr<11>(x)), Rotr<25>(x));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i SmallSigma0(__m512i x) {
+    return Xor(Xor(Rotr<7>(x), Rotr<18>(x)), Shr<3>(x));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i SmallSigma1(__m512i x) {
+    return Xor(Xor(Rotr<17>(x), Rotr<19>(x)), Shr<10>(x));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i Ch(__m512i e, __m512i f, __m512i g) {
+    return Xor(_mm512_and_si512(e, f), _mm512_andnot_si512(e, g));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i Maj(__m512i a, __m512i b, __m512i c) {
+    return _mm512_or_si512(_mm512_and_si512(a, b), _mm512_and_si512(c, _mm512_or_si512(a, b)));
+}
+
+PEINFO_TARGET_AVX512
+inline __m512i LoadWord(const uint8_t* const* blocks, size_t offset) {
+    return _mm512_set_epi32(
+        static_cast<int>(LoadBe32(blocks[15] + offset)), static_cast<int>(LoadBe32(blocks[14] + offset)),
+        static_cast<int>(LoadBe32(blocks[13] + offset)), static_cast<int>(LoadBe32(blocks[12] + offset)),
+        static_cast<int>(LoadBe32(blocks[11] + offset)), static_cast<int>(LoadBe32(blocks[10] + offset)),
+        static_cast<int>(LoadBe32(blocks[9] + offset)), static_cast<int>(LoadBe32(blocks[8] + offset)),
+        static_cast<int>(LoadBe32(blocks[7] + offset)), static_cast<int>(LoadBe32(blocks[6] + offset)),
+        static_cast<int>(LoadBe32(blocks[5] + offset)), static_cast<int>(LoadBe32(blocks[4] + offset)),
+        static_cast<int>(LoadBe32(blocks[3] + offset)), static_cast<int>(LoadBe32(blocks[2] + offset)),
+        static_cast<int>(LoadBe32(blocks[1] + offset)), static_cast<int>(LoadBe32(blocks[0] + offset)));
+}
+
+PEINFO_TARGET_AVX512
+void Blocks(uint32_t* state, const uint8_t* const* blocks, size_t count) {
+    __m512i s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = _mm512_loadu_si512(state + i * 16);
+    }
+    for (size_t blk = 0; blk < count; ++blk) {
+        __m512i w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadWord(blocks, blk * 64 + 4 * static_cast<size_t>(i));
+        }
+        __m512i a = s[0];
+        __m512i b = s[1];
+        __m512i c = s[2];
+        __m512i d = s[3];
+        __m512i e = s[4];
+        __m512i f = s[5];
+        __m512i g = s[6];
+        __m512i h = s[7];
+        for (int i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] = Add(Add(w[i & 15], SmallSigma0(w[(i + 1) & 15])), Add(w[(i + 9) & 15], SmallSigma1(w[(i + 14) & 15])));
+            }
+            __m512i t1 = Add(Add(h, BigSigma1(e)), Add(Ch(e, f, g), Add(_mm512_set1_epi32(static_cast<int>(kSha256K[i])), w[i & 15])));
+            __m512i t2 = Add(BigSigma0(a), Maj(a, b, c));
+            h = g;
+            g = f;
+            f = e;
+            e = Add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = Add(t1, t2);
+        }
+        s[0] = Add(s[0], a);
+        s[1] = Add(s[1], b);
+        s[2] = Add(s[2], c);
+        s[3] = Add(s[3], d);
+        s[4] = Add(s[4], e);
+        s[5] = Add(s[5], f);
+        s[6] = Add(s[6], g);
+        s[7] = Add(s[7], h);
+    }
+    for (int i = 0; i < 8; ++i) {
+        _mm512_storeu_si512(state + i * 16, s[i]);
+    }
+}
+
+} // namespace avx512
+#endif
+
+#if defined(PEINFO_MB_NEON)
+namespace neon {
+
+inline uint32x4_t Add(uint32x4_t x, uint32x4_t y) {
+    return vaddq_u32(x, y);
+}
+
+inline uint32x4_t Xor(uint32x4_t x, uint32x4_t y) {
+    return veorq_u32(x, y);
+}
+
+template <int n>
+inline uint32x4_t Rotr(uint32x4_t x) {
+    return vsriq_n_u32(vshlq_n_u32(x, 32 - n), x, n);
+}
+
+template <int n>
+inline uint32x4_t Shr(uint32x4_t x) {
+    return vshrq_n_u32(x, n);
+}
+
+inline uint32x4_t BigSigma0(uint32x4_t x) {
+    return Xor(Xor(Rotr<2>(x), Rotr<13>(x)), Rotr<22>(x));
+}
+
+inline uint32x4_t BigSigma1(uint32x4_t x) {
+    return Xor(Xor(Rotr<6>(x), Rotr<11>(x)), Rotr<25>(x));
+}
+
+inline uint32x4_t SmallSigma0(uint32x4_t x) {
+    return Xor(Xor(Rotr<7>(x), Rotr<18>(x)), Shr<3>(x));
+}
+
+inline uint32x4_t SmallSigma1(uint32x4_t x) {
+    return Xor(Xor(Rotr<17>(x), Rotr<19>(x)), Shr<10>(x));
+}
+
+inline uint32x4_t Ch(uint32x4_t e, uint32x4_t f, uint32x4_t g) {
+    return Xor(vandq_u32(e, f), vbicq_u32(g, e));
+}
+
+inline uint32x4_t Maj(uint32x4_t a, uint32x4_t b, uint32x4_t c) {
+    return vorrq_u32(vandq_u32(a, b), vandq_u32(c, vorrq_u32(a, b)));
+}
+
+inline uint32x4_t LoadWord(const uint8_t* const* blocks, size_t offset) {
+    uint32_t w[4];
+    for (int i = 0; i < 4; ++i) {
+        w[i] = LoadBe32(blocks[i] + offset);
+    }
+    return vld1q_u32(w);
+}
+
+void Blocks(uint32_t* state, const uint8_t* const* blocks, size_t count) {
+    uint32x4_t s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = vld1q_u32(state + i * 4);
+    }
+    for (size_t blk = 0; blk < count; ++blk) {
+        uint32x4_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = LoadWord(blocks, blk * 64 + 4 * static_cast<size_t>(i));
+        }
+        uint32x4_t a = s[0];
+        uint32x4_t b = s[1];
+        uint32x4_t c = s[2];
+        uint32x4_t d = s[3];
+        uint32x4_t e = s[4];
+        uint32x4_t f = s[5];
+        uint32x4_t g = s[6];
+        uint32x4_t h = s[7];
+        for (int i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] = Add(Add(w[i & 15], SmallSigma0(w[(i + 1) & 15])), Add(w[(i + 9) & 15], SmallSigma1(w[(i + 14) & 15])));
+            }
+            uint32x4_t t1 = Add(Add(h, BigSigma1(e)), Add(Ch(e, f, g), Add(vdupq_n_u32(kSha256K[i]), w[i & 15])));
+            uint32x4_t t2 = Add(BigSigma0(a), Maj(a, b, c));
+            h = g;
+            g = f;
+            f = e;
+            e = Add(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = Add(t1, t2);
+        }
+        s[0] = Add(s[0], a);
+        s[1] = Add(s[1], b);
+        s[2] = Add(s[2], c);
+        s[3] = Add(s[3], d);
+        s[4] = Add(s[4], e);
+        s[5] = Add(s[5], f);
+        s[6] = Add(s[6], g);
+        s[7] = Add(s[7], h);
+    }
+    for (int i = 0; i < 8; ++i) {
+        vst1q_u32(state + i * 4, s[i]);
+    }
+}
+
+} // namespace neon
+#endif
+
+std::vector<LaneImpl> GetLaneImpls() {
+    std::vector<LaneImpl> impls;
+#if defined(PEINFO_MB_X86)
+    const CpuFeatures& cpu = GetCpuFeatures();
+    if (cpu.sse2) {
+        impls.push_back({"sse2x4", 4, sse2::Blocks});
+    }
+    if (cpu.avx2) {
+        impls.push_back({"avx2x8", 8, avx2::Blocks});
+    }
+    if (cpu.avx512f) {
+        impls.push_back({"avx512x16", 16, avx512::Blocks});
+    }
+#elif defined(PEINFO_MB_NEON)
+    impls.push_back({"neonx4", 4, neon::Blocks});
+#endif
+    return impls;
+}
+
+const LaneImpl* ActiveLaneImpl() {
+    static const std::vector<LaneImpl> impls = GetLaneImpls();
+    return impls.empty() ? nullptr : &impls.back();
+}
+
+struct Lane {
+    size_t job = SIZE_MAX;
+    const uint8_t* ptr = nullptr;
+    size_t blocksLeft = 0;
+    bool inTail = false;
+    size_t tailBlocks = 0;
+    uint8_t tail[128];
+};
+
+// Final one or two blocks: the partial tail of the message, 0x80, zeros and
+// the bit length.
+void PrepareTail(Lane& lane, const Sha256Job& job) {
+    size_t full = job.size / 64;
+    size_t rem = job.size % 64;
+    std::memset(lane.tail, 0, sizeof(lane.tail));
+    if (rem != 0) {
+        std::memcpy(lane.tail, job.data + full * 64, rem);
+    }
+    lane.tail[rem] = 0x80;
+    lane.tailBlocks = (rem + 9 <= 64) ? 1 : 2;
+    uint64_t bits = static_cast<uint64_t>(job.size) * 8;
+    uint8_t* len = lane.tail + lane.tailBlocks * 64 - 8;
+    for (int i = 0; i < 8; ++i) {
+        len[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    if (full != 0) {
+        lane.ptr = job.data;
+        lane.blocksLeft = full;
+        lane.inTail = false;
+    } else {
+        lane.ptr = lane.tail;
+        lane.blocksLeft = lane.tailBlocks;
+        lane.inTail = true;
+    }
+}
+
+void StoreDigest(uint8_t* out, const uint32_t* words) {
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(words[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(words[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(words[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(words[i]);
+    }
+}
+
+void HashSingle(Sha256Job* jobs, size_t count) {
+    Digest digest(HashAlgorithm::SHA256);
+    for (size_t i = 0; i < count; ++i) {
+        digest.Reset();
+        digest.Update(jobs[i].data, jobs[i].size);
+        digest.Final(jobs[i].digest);
+    }
+}
+
+void HashLanes(const LaneImpl& impl, Sha256Job* jobs, size_t count) {
+    const size_t lanes = impl.lanes;
+    const DigestBlockFn single = GetActiveDigestBlocks(HashAlgorithm::SHA256);
+    std::vector<uint32_t> state(8 * lanes);
+    std::vector<Lane> lane(lanes);
+    std::vector<const uint8_t*> ptrs(lanes);
+    size_t next = 0;
+
+    auto start = [&](size_t l) {
+        if (next >= count) {
+            lane[l].job = SIZE_MAX;
+            return;
+        }
+        lane[l].job = next;
+        PrepareTail(lane[l], jobs[next]);
+        for (int i = 0; i < 8; ++i) {
+            state[i * lanes + l] = kSha256Init[i];
+        }
+        ++next;
+    };
+    auto finish = [&](size_t l) {
+        uint32_t words[8];
+        for (int i = 0; i < 8; ++i) {
+            words[i] = state[i * lanes + l];
+        }
+        StoreDigest(jobs[lane[l].job].digest, words);
+    };
+
+    for (size_t l = 0; l < lanes; ++l) {
+        start(l);
+    }
+    for (;;) {
+        size_t active = 0;
+        size_t any = 0;
+        size_t step = SIZE_MAX;
+        for (size_t l = 0; l < lanes; ++l) {
+            if (lane[l].job != SIZE_MAX) {
+                ++active;
+                any = l;
+                step = std::min(step, lane[l].blocksLeft);
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+
+        // Once the queue is empty and only a few long messages remain, the
+        // single-stream code is faster than running mostly idle lanes.
+        if (next >= count && active * 4 <= lanes) {
+            for (size_t l = 0; l < lanes; ++l) {
+                if (lane[l].job == SIZE_MAX) {
+                    continue;
+                }
+                uint32_t words[8];
+                for (int i = 0; i < 8; ++i) {
+                    words[i] = state[i * lanes + l];
+                }
+                single(words, lane[l].ptr, lane[l].blocksLeft);
+                if (!lane[l].inTail) {
+                    single(words, lane[l].tail, lane[l].tailBlocks);
+                }
+                StoreDigest(jobs[lane[l].job].digest, words);
+                lane[l].job = SIZE_MAX;
+            }
+            break;
+        }
+
+        // Idle lanes repeat an active lane's input; their state is ignored.
+        for (size_t l = 0; l < lanes; ++l) {
+            ptrs[l] = (lane[l].job != SIZE_MAX) ? lane[l].ptr : lane[any].ptr;
+        }
+        impl.blocks(state.data(), ptrs.data(), step);
+
+        for (size_t l = 0; l < lanes; ++l) {
+            Lane& ln = lane[l];
+            if (ln.job == SIZE_MAX) {
+                continue;
+            }
+            ln.ptr += step * 64;
+            ln.blocksLeft -= step;
+            if (ln.blocksLeft != 0) {
+                continue;
+            }
+            if (!ln.inTail) {
+                ln.ptr = ln.tail;
+                ln.blocksLeft = ln.tailBlocks;
+                ln.inTail = true;
+                continue;
+            }
+            finish(l);
+            start(l);
+        }
+    }
+}
+
+} // namespace
+
+size_t GetSha256MultiBufferLanes() {
+    const LaneImpl* impl = ActiveLaneImpl();
+    return impl ? impl->lanes : 0;
+}
+
+const char* GetSha256MultiBufferImplName() {
+    const LaneImpl* impl = ActiveLaneImpl();
+    return impl ? impl->name : "single";
+}
+
+bool IsSha256MultiBufferPreferred() {
+    size_t lanes = GetSha256MultiBufferLanes();
+    if (lanes == 0) {
+        return false;
+    }
+    const CpuFeatures& cpu = GetCpuFeatures();
+    if (cpu.shaNi || cpu.armSha2) {
+        return lanes >= 16;
+    }
+    return true;
+}
+
+void Sha256MultiBuffer(Sha256Job* jobs, size_t count) {
+    const LaneImpl* impl = ActiveLaneImpl();
+    if (impl == nullptr || count < 2) {
+        HashSingle(jobs, count);
+        return;
+    }
+    HashLanes(*impl, jobs, count);
+}
+
+bool RunSha256MultiBufferSelfTest(std::wstring& error) {
+    std::vector<uint8_t> data(70000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i * 7) ^ (i >> 5));
+    }
+    // Sizes around the one/two padding block boundary, plus a few long ones
+    // so that lanes finish at different times and get refilled.
+    std::vector<size_t> sizes;
+    for (size_t s = 0; s <= 200; ++s) {
+        sizes.push_back(s);
+    }
+    sizes.push_back(4095);
+    sizes.push_back(4096);
+    sizes.push_back(65537);
+    sizes.push_back(1);
+    sizes.push_back(69999);
+
+    std::vector<Sha256Job> expected(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        expected[i].data = data.data() + (i % 13);
+        expected[i].size = std::min(sizes[i], data.size() - (i % 13));
+    }
+    HashSingle(expected.data(), expected.size());
+
+    for (const auto& impl : GetLaneImpls()) {
+        std::vector<Sha256Job> jobs = expected;
+        for (auto& j : jobs) {
+            std::memset(j.digest, 0, sizeof(j.digest));
+        }
+        HashLanes(impl, jobs.data(), jobs.size());
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (std::memcmp(jobs[i].digest, expected[i].digest, sizeof(jobs[i].digest)) != 0) {
+                std::string msg = std::string("SHA256 (") + impl.name + "): wrong digest for a " +
+                                  std::to_string(jobs[i].size) + "-byte message";
+                error.assign(msg.begin(), msg.end());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<Sha256MultiBufferBenchmark> RunSha256MultiBufferBenchmark(size_t messageSize, size_t messageCount) {
+    std::vector<uint8_t> data(messageSize * messageCount);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+    }
+    std::vector<Sha256Job> jobs(messageCount);
+    for (size_t i = 0; i < messageCount; ++i) {
+        jobs[i].data = data.data() + i * messageSize;
+        jobs[i].size = messageSize;
+    }
+
+    std::vector<Sha256MultiBufferBenchmark> results;
+    auto measure = [&](const char* name, size_t lanes, const LaneImpl* impl) {
+        double best = 0.0;
+        for (int r = 0; r < 3; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            if (impl) {
+                HashLanes(*impl, jobs.data(), jobs.size());
+            } else {
+                HashSingle(jobs.data(), jobs.size());
+            }
+            std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+            if (r == 0 || diff.count() < best) {
+                best = diff.count();
+            }
+        }
+        Sha256MultiBufferBenchmark res;
+        res.impl = name;
+        res.lanes = lanes;
+        res.bytes = data.size();
+        res.seconds = best;
+        res.megabytesPerSecond = best > 0.0 ? (static_cast<double>(data.size()) / 1e6) / best : 0.0;
+        results.push_back(res);
+    };
+
+    measure("single", 1, nullptr);
+    for (const auto& impl : GetLaneImpls()) {
+        measure(impl.name, impl.lanes, &impl);
+    }
+    return results;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SHA-256 over many independent messages at once, one message per SIMD lane:
+// 4 lanes with SSE2 or NEON, 8 with AVX2, 16 with AVX-512. A lane is refilled
+// as soon as its message ends, so mixed sizes keep the lanes busy. Builds
+// without Windows headers.
+
+struct Sha256Job {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint8_t digest[32] = {};
+};
+
+// Lane count of the implementation in use; 0 when there is none and
+// Sha256MultiBuffer hashes the jobs one at a time.
+size_t GetSha256MultiBufferLanes();
+const char* GetSha256MultiBufferImplName();
+
+// Whether batching beats the single-stream implementation on this CPU. A core
+// with SHA extensions outruns 4- and 8-lane SIMD, so only AVX-512 wins there.
+bool IsSha256MultiBufferPreferred();
+
+void Sha256MultiBuffer(Sha256Job* jobs, size_t count);
+
+// Compares every available lane width against the single-stream digest over a
+// spread of message sizes.
+bool RunSha256MultiBufferSelfTest(std::wstring& error);
+
+struct Sha256MultiBufferBenchmark {
+    std::string impl;
+    size_t lanes = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+// Hashes messageCount messages of messageSize bytes with each available lane
+// width; "single" is the single-stream baseline on the same jobs.
+std::vector<Sha256MultiBufferBenchmark> RunSha256MultiBufferBenchmark(size_t messageSize, size_t messageCount);
@@ -0,0 +1,127 @@
+#include "Sha256Tree.h"
+
+#include "Digest.h"
+#include "HashState.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// Leaves gathered before a parallel round.
+const size_t kBatchLeaves = 16;
+
+const uint8_t kLeafPrefix = 0x00;
+const uint8_t kRootPrefix = 0x01;
+
+void HashLeaf(const uint8_t* data, size_t size, uint8_t* out) {
+    Digest digest(HashAlgorithm::SHA256);
+    digest.Update(&kLeafPrefix, 1);
+    digest.Update(data, size);
+    digest.Final(out);
+}
+
+} // namespace
+
+Sha256TreeHasher::Sha256TreeHasher() : m_length(0), m_threads(0) {
+}
+
+void Sha256TreeHasher::Reset() {
+    m_leafDigests.clear();
+    m_pending.clear();
+    m_length = 0;
+}
+
+void Sha256TreeHasher::HashLeaves(const uint8_t* data, size_t leaves) {
+    size_t first = m_leafDigests.size();
+    m_leafDigests.resize(first + leaves * kOutLen);
+    uint8_t* out = m_leafDigests.data() + first;
+    auto hashOne = [&](size_t i) {
+        HashLeaf(data + i * kLeafSize, kLeafSize, out + i * kOutLen);
+    };
+    if (m_threads == 1 || leaves == 1) {
+        for (size_t i = 0; i < leaves; ++i) {
+            hashOne(i);
+        }
+    } else {
+        RunParallel(leaves, m_threads, hashOne);
+    }
+}
+
+void Sha256TreeHasher::Update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    m_length += size;
+    const size_t batchBytes = kBatchLeaves * kLeafSize;
+
+    if (!m_pending.empty()) {
+        size_t take = std::min(size, batchBytes - m_pending.size());
+        m_pending.insert(m_pending.end(), p, p + take);
+        p += take;
+        size -= take;
+        if (m_pending.size() < batchBytes) {
+            return;
+        }
+        HashLeaves(m_pending.data(), kBatchLeaves);
+        m_pending.clear();
+    }
+    // A leaf is only hashed once more input follows it, so a final partial
+    // leaf always ends up in m_pending.
+    while (size > batchBytes) {
+        HashLeaves(p, kBatchLeaves);
+        p += batchBytes;
+        size -= batchBytes;
+    }
+    if (size != 0) {
+        m_pending.reserve(batchBytes);
+        m_pending.assign(p, p + size);
+    }
+}
+
+void Sha256TreeHasher::SaveState(HashStateWriter& out) {
+    // A whole leaf hashes the same whether or not more input follows it.
+    size_t fullLeaves = m_pending.size() / kLeafSize;
+    if (fullLeaves != 0) {
+        HashLeaves(m_pending.data(), fullLeaves);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + fullLeaves * kLeafSize);
+    }
+    out.U64(m_length);
+    out.Blob(m_leafDigests);
+    out.Blob(m_pending);
+}
+
+bool Sha256TreeHasher::LoadState(HashStateReader& in) {
+    Reset();
+    m_length = in.U64();
+    in.Blob(m_leafDigests, SIZE_MAX);
+    in.Blob(m_pending, kLeafSize - 1);
+    const uint64_t leaves = m_leafDigests.size() / kOutLen;
+    if (!in.Ok() || m_leafDigests.size() % kOutLen != 0 || leaves * kLeafSize + m_pending.size() != m_length) {
+        Reset();
+        return false;
+    }
+    return true;
+}
+
+void Sha256TreeHasher::Final(uint8_t* out) {
+    size_t fullLeaves = m_pending.size() / kLeafSize;
+    size_t tail = m_pending.size() % kLeafSize;
+    if (fullLeaves != 0) {
+        HashLeaves(m_pending.data(), fullLeaves);
+    }
+    if (tail != 0) {
+        size_t first = m_leafDigests.size();
+        m_leafDigests.resize(first + kOutLen);
+        HashLeaf(m_pending.data() + fullLeaves * kLeafSize, tail, m_leafDigests.data() + first);
+    }
+    m_pending.clear();
+
+    uint8_t length[8];
+    for (int i = 0; i < 8; ++i) {
+        length[i] = static_cast<uint8_t>(m_length >> (56 - 8 * i));
+    }
+    Digest root(HashAlgorithm::SHA256);
+    root.Update(&kRootPrefix, 1);
+    root.Update(m_leafDigests.data(), m_leafDigests.size());
+    root.Update(length, sizeof(length));
+    root.Final(out);
+}
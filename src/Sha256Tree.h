@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class HashStateReader;
+class HashStateWriter;
+
+// "SHA256-TREE": a PEInfo-specific tree hash over SHA-256, NOT a standard
+// digest. It never matches sha256sum; use it only to compare against other
+// values produced by this tool.
+//
+// The input is cut into 1 MiB leaves (the last one may be shorter; empty
+// input has no leaves). Each leaf digest is SHA-256(0x00 || leaf) and the
+// result is SHA-256(0x01 || leaf digests in order || total length as a
+// big-endian 64-bit integer). Leaves are hashed on several threads.
+class Sha256TreeHasher {
+public:
+    static const size_t kLeafSize = 1u << 20;
+    static const size_t kOutLen = 32;
+
+    Sha256TreeHasher();
+
+    // 0 = hardware concurrency, 1 = hash on the calling thread only.
+    void SetThreadCount(size_t threads) { m_threads = threads; }
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    void Final(uint8_t* out);
+
+    // Checkpoint state: the leaf digests and the partial leaf. Saving hashes
+    // the whole leaves held back for a parallel batch first.
+    void SaveState(HashStateWriter& out);
+    bool LoadState(HashStateReader& in);
+
+private:
+    void HashLeaves(const uint8_t* data, size_t leaves);
+
+    std::vector<uint8_t> m_leafDigests;
+    std::vector<uint8_t> m_pending;
+    uint64_t m_length;
+    size_t m_threads;
+};
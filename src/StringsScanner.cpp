@@ -1,314 +1,514 @@
-#include "stdafx.h"
-
 #include "StringsScanner.h"
 
+#include "CpuFeatures.h"
+
 #include <algorithm>
+#include <chrono>
+#include <deque>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_STRINGS_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_STRINGS_NEON 1
+#include <arm_neon.h>
+#endif
 
 static bool IsAsciiPrintable(uint8_t b) {
     return (b >= 0x20 && b <= 0x7E) || b == 0x09 || b == 0x0A || b == 0x0D;
 }
 
 static constexpr size_t kRepeatRunLimit = 8;
+static constexpr size_t kBlock = 1u << 20;
 
+// A run of limit equal characters covers a multiple of limit - 1, so only
+// those positions are looked at, each by scanning outwards.
 template <typename CharT>
 static bool HasRepeatRun(const std::basic_string<CharT>& s, size_t limit) {
     if (limit <= 1) {
         return !s.empty();
     }
-    size_t run = 1;
-    for (size_t i = 1; i < s.size(); ++i) {
-        if (s[i] == s[i - 1]) {
-            ++run;
-            if (run >= limit) {
-                return true;
-            }
-        } else {
-            run = 1;
+    for (size_t j = 0; j < s.size(); j += limit - 1) {
+        size_t lo = j;
+        size_t hi = j + 1;
+        while (lo > 0 && s[lo - 1] == s[j]) {
+            --lo;
+        }
+        while (hi < s.size() && s[hi] == s[j]) {
+            ++hi;
+        }
+        if (hi - lo >= limit) {
+            return true;
         }
     }
     return false;
 }
 
-static void AppendAsciiHitIfNeeded(const StringsScanOptions& opt,
-                                   std::vector<StringsHit>& outHits,
-                                   uint64_t startOffset,
-                                   const std::string& bytes) {
-    if (bytes.size() < static_cast<size_t>(opt.minLen)) {
-        return;
+static unsigned CountTrailingZeros(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<uint32_t>(v))) {
+        return index;
     }
-    if (HasRepeatRun(bytes, kRepeatRunLimit)) {
-        return;
+    _BitScanForward(&index, static_cast<uint32_t>(v >> 32));
+    return index + 32;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+static unsigned HighestBit(uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, static_cast<uint32_t>(v >> 32))) {
+        return index + 32;
     }
-    StringsHit hit;
-    hit.type = StringsHitType::Ascii;
-    hit.fileOffset = startOffset;
-    hit.text.assign(bytes.begin(), bytes.end());
-    if (hit.text.size() > static_cast<size_t>(opt.maxLen)) {
-        hit.text.resize(static_cast<size_t>(opt.maxLen));
+    _BitScanReverse(&index, static_cast<uint32_t>(v));
+    return index;
+#else
+    return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#endif
+}
+
+// Bits pos..63.
+static uint64_t BitsFrom(size_t pos) {
+    return pos >= 64 ? 0 : ~0ull << pos;
+}
+
+// Bits 0..pos-1.
+static uint64_t BitsBelow(size_t pos) {
+    return pos >= 64 ? ~0ull : (1ull << pos) - 1;
+}
+
+// v >> shift with ones shifted in: what lies past the chunk is unknown.
+static uint64_t ShiftInOnes(uint64_t v, size_t shift) {
+    return shift >= 64 ? ~0ull : (v >> shift) | ~(~0ull >> shift);
+}
+
+// Classifiers: bit i of printable / zero for p[i], for any n <= 64.
+static void ClassifyBytes(const uint8_t* p, size_t n, uint64_t& printable, uint64_t& zero) {
+    printable = 0;
+    zero = 0;
+    for (size_t i = 0; i < n; ++i) {
+        printable |= static_cast<uint64_t>(IsAsciiPrintable(p[i])) << i;
+        zero |= static_cast<uint64_t>(p[i] == 0x00) << i;
     }
-    outHits.push_back(std::move(hit));
 }
 
-static void AppendUtf16HitIfNeeded(const StringsScanOptions& opt,
-                                   std::vector<StringsHit>& outHits,
-                                   uint64_t startOffset,
-                                   const std::wstring& w) {
-    if (w.size() < static_cast<size_t>(opt.minLen)) {
-        return;
+static void ClassifyPortable(const uint8_t* p, uint64_t& printable, uint64_t& zero) {
+    ClassifyBytes(p, 64, printable, zero);
+}
+
+#if defined(PEINFO_STRINGS_X86)
+namespace sse2 {
+
+// Adding 0x60 maps 0x20..0x7E, and nothing else, to -128..-34.
+PEINFO_TARGET_SSE2
+static void Classify(const uint8_t* p, uint64_t& printable, uint64_t& zero) {
+    const __m128i bias = _mm_set1_epi8(0x60);
+    const __m128i limit = _mm_set1_epi8(-33);
+    const __m128i tab = _mm_set1_epi8(0x09);
+    const __m128i lf = _mm_set1_epi8(0x0A);
+    const __m128i cr = _mm_set1_epi8(0x0D);
+    const __m128i nul = _mm_setzero_si128();
+    printable = 0;
+    zero = 0;
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + i);
+        __m128i print = _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit);
+        print = _mm_or_si128(print, _mm_cmpeq_epi8(v, tab));
+        print = _mm_or_si128(print, _mm_cmpeq_epi8(v, lf));
+        print = _mm_or_si128(print, _mm_cmpeq_epi8(v, cr));
+        printable |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(print))) << (16 * i);
+        zero |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul)))) << (16 * i);
     }
-    if (HasRepeatRun(w, kRepeatRunLimit)) {
-        return;
+}
+
+} // namespace sse2
+
+namespace avx2 {
+
+PEINFO_TARGET_AVX2
+static void Classify(const uint8_t* p, uint64_t& printable, uint64_t& zero) {
+    const __m256i bias = _mm256_set1_epi8(0x60);
+    const __m256i limit = _mm256_set1_epi8(-33);
+    const __m256i tab = _mm256_set1_epi8(0x09);
+    const __m256i lf = _mm256_set1_epi8(0x0A);
+    const __m256i cr = _mm256_set1_epi8(0x0D);
+    const __m256i nul = _mm256_setzero_si256();
+    printable = 0;
+    zero = 0;
+    for (int i = 0; i < 2; ++i) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p) + i);
+        __m256i print = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, bias));
+        print = _mm256_or_si256(print, _mm256_cmpeq_epi8(v, tab));
+        print = _mm256_or_si256(print, _mm256_cmpeq_epi8(v, lf));
+        print = _mm256_or_si256(print, _mm256_cmpeq_epi8(v, cr));
+        printable |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(print))) << (32 * i);
+        zero |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nul)))) << (32 * i);
     }
-    StringsHit hit;
-    hit.type = StringsHitType::Utf16Le;
-    hit.fileOffset = startOffset;
-    hit.text = w;
-    if (hit.text.size() > static_cast<size_t>(opt.maxLen)) {
-        hit.text.resize(static_cast<size_t>(opt.maxLen));
+}
+
+} // namespace avx2
+#elif defined(PEINFO_STRINGS_NEON)
+namespace neon {
+
+// One bit per byte of four all-ones/all-zeros vectors, like x86 movemask.
+static uint64_t MoveMask(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+    static const uint8_t kBits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t bits = vld1q_u8(kBits);
+    uint8x16_t s = vpaddq_u8(vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits)),
+                             vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits)));
+    s = vpaddq_u8(s, s);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s), 0);
+}
+
+static void Classify(const uint8_t* p, uint64_t& printable, uint64_t& zero) {
+    uint8x16_t print[4];
+    uint8x16_t nul[4];
+    for (int i = 0; i < 4; ++i) {
+        const uint8x16_t v = vld1q_u8(p + 16 * i);
+        uint8x16_t m = vcltq_u8(vsubq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8(0x5F));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(0x09)));
+        m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(0x0A)));
+        print[i] = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(0x0D)));
+        nul[i] = vceqq_u8(v, vdupq_n_u8(0x00));
     }
-    outHits.push_back(std::move(hit));
+    printable = MoveMask(print[0], print[1], print[2], print[3]);
+    zero = MoveMask(nul[0], nul[1], nul[2], nul[3]);
 }
 
-static bool GetFileSize64(HANDLE h, uint64_t& outSize) {
-    LARGE_INTEGER li = {};
-    if (!GetFileSizeEx(h, &li)) {
-        return false;
+} // namespace neon
+#endif
+
+static const StringsClassifierInfo& GetActiveClassifier() {
+    static const StringsClassifierInfo active = []() {
+        StringsClassifierInfo best = {"portable", ClassifyPortable};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_STRINGS_X86)
+        if (cpu.avx2) {
+            best = {"avx2", avx2::Classify};
+        } else if (cpu.sse2) {
+            best = {"sse2", sse2::Classify};
+        }
+#elif defined(PEINFO_STRINGS_NEON)
+        (void)cpu;
+        best = {"neon", neon::Classify};
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+std::vector<StringsClassifierInfo> GetAvailableStringsClassifiers() {
+    std::vector<StringsClassifierInfo> out;
+    out.push_back({"portable", ClassifyPortable});
+    const CpuFeatures& cpu = GetCpuFeatures();
+    (void)cpu;
+#if defined(PEINFO_STRINGS_X86)
+    if (cpu.sse2) {
+        out.push_back({"sse2", sse2::Classify});
     }
-    if (li.QuadPart < 0) {
-        return false;
+    if (cpu.avx2) {
+        out.push_back({"avx2", avx2::Classify});
     }
-    outSize = static_cast<uint64_t>(li.QuadPart);
-    return true;
+#elif defined(PEINFO_STRINGS_NEON)
+    out.push_back({"neon", neon::Classify});
+#endif
+    return out;
 }
 
-static bool SeekFile64(HANDLE h, uint64_t offset) {
-    LARGE_INTEGER li = {};
-    li.QuadPart = static_cast<LONGLONG>(offset);
-    return SetFilePointerEx(h, li, nullptr, FILE_BEGIN) != 0;
+const char* GetActiveStringsClassifierName() {
+    return GetActiveClassifier().name;
 }
 
-static bool ScanAsciiStream(HANDLE h,
-                            uint64_t total,
-                            const StringsScanOptions& opt,
-                            std::vector<StringsHit>& outHits,
-                            std::wstring& error,
-                            std::atomic<bool>* cancel,
-                            const std::function<void(uint64_t processed, uint64_t total)>& progress,
-                            bool* truncated) {
-    const DWORD kBlock = 1u << 20;
-    std::vector<uint8_t> buf(kBlock);
-    uint64_t fileOffset = 0;
-    uint64_t lastProgressReport = 0;
-
-    std::string cur;
-    cur.reserve(static_cast<size_t>(std::min<uint64_t>(total, 256)));
-    uint64_t curStart = 0;
+// One run detector: ASCII bytes, or UTF-16LE code units starting at even or
+// at odd file offsets. Hits it finds wait in pending until no other run
+// detector can still report an earlier one.
+struct RunState {
+    StringsHitType type = StringsHitType::Ascii;
+    std::wstring text;
+    uint64_t start = 0;
     bool inRun = false;
+    std::deque<StringsHit> pending;
+};
 
-    while (fileOffset < total) {
-        if (cancel && cancel->load()) {
-            error = L"\u5df2\u53d6\u6d88";
-            return false;
+static void EndRun(const StringsScanOptions& opt, RunState& s) {
+    s.inRun = false;
+    if (s.text.size() < static_cast<size_t>(opt.minLen) || HasRepeatRun(s.text, kRepeatRunLimit)) {
+        return;
+    }
+    StringsHit hit;
+    hit.type = s.type;
+    hit.fileOffset = s.start;
+    hit.text = s.text;
+    if (hit.text.size() > static_cast<size_t>(opt.maxLen)) {
+        hit.text.resize(static_cast<size_t>(opt.maxLen));
+    }
+    s.pending.push_back(std::move(hit));
+}
+
+static void Feed(const StringsScanOptions& opt, RunState& s, uint64_t offset, bool printable, uint8_t ch) {
+    if (printable) {
+        if (!s.inRun) {
+            s.inRun = true;
+            s.start = offset;
+            s.text.clear();
         }
-        if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-            if (truncated) {
-                *truncated = true;
+        s.text.push_back(static_cast<wchar_t>(ch));
+        if (s.text.size() >= static_cast<size_t>(opt.maxLen)) {
+            EndRun(opt, s);
+        }
+    } else if (s.inRun) {
+        EndRun(opt, s);
+    }
+}
+
+// Runs in one 64-byte chunk from its masks. slots marks the bits where this
+// detector's units start (every bit for ASCII, every other bit for
+// UTF-16LE), good those of printable units; only bits below limit count. A
+// run is extended a whole stretch at a time, up to the next slot that is
+// not good. New runs start only where the chunk can hold minLen units, so
+// that the short runs of binary data cost nothing.
+static void ScanRuns(const StringsScanOptions& opt,
+                     RunState& s,
+                     const uint8_t* p,
+                     uint64_t chunkOffset,
+                     uint64_t good,
+                     uint64_t slots,
+                     size_t limit,
+                     size_t step) {
+    const size_t maxLen = static_cast<size_t>(std::max(opt.maxLen, 1));
+    slots &= limit >= 64 ? ~0ull : (1ull << limit) - 1;
+    good &= slots;
+    const uint64_t bad = slots & ~good;
+    // Bit i survives when the minLen units from bit i on are all good or
+    // lie past limit: erosion by doubling shifts.
+    uint64_t longRuns = good | ~BitsBelow(limit);
+    for (size_t len = 1, minLen = static_cast<size_t>(opt.minLen); len < minLen;) {
+        const size_t shift = std::min(len, minLen - len);
+        longRuns &= ShiftInOnes(longRuns, shift * step);
+        len += shift;
+    }
+    longRuns &= good;
+    size_t pos = slots != 0 ? CountTrailingZeros(slots) : 64;
+    for (;;) {
+        if (!s.inRun) {
+            const uint64_t next = longRuns & BitsFrom(pos);
+            if (next == 0) {
+                return;
             }
-            return true;
+            // The run holding that bit starts after the last bad slot before it.
+            const size_t at = CountTrailingZeros(next);
+            const uint64_t before = bad & BitsFrom(pos) & BitsBelow(at);
+            pos = before != 0 ? HighestBit(before) + step : pos;
+            s.inRun = true;
+            s.start = chunkOffset + pos;
+            s.text.clear();
         }
-        DWORD toRead = static_cast<DWORD>(std::min<uint64_t>(kBlock, total - fileOffset));
-        DWORD read = 0;
-        if (!ReadFile(h, buf.data(), toRead, &read, nullptr)) {
-            error = L"\u8bfb\u53d6\u5931\u8d25";
-            return false;
+        const uint64_t stop = bad & BitsFrom(pos);
+        const size_t end = stop != 0 ? CountTrailingZeros(stop) : std::max(limit, pos);
+        size_t count = (end - pos + step - 1) / step;
+        const size_t room = maxLen - std::min(maxLen, s.text.size());
+        const bool full = count >= room;
+        if (full) {
+            count = room;
         }
-        if (read == 0) {
-            break;
+        const size_t used = s.text.size();
+        s.text.resize(used + count);
+        wchar_t* out = &s.text[0] + used;
+        for (size_t k = 0; k < count; ++k) {
+            out[k] = static_cast<wchar_t>(p[pos + k * step]);
         }
-
-        for (DWORD i = 0; i < read; ++i) {
-            uint8_t b = buf[i];
-            if (IsAsciiPrintable(b)) {
-                if (!inRun) {
-                    inRun = true;
-                    curStart = fileOffset + i;
-                    cur.clear();
-                }
-                cur.push_back(static_cast<char>(b));
-                if (cur.size() >= static_cast<size_t>(opt.maxLen)) {
-                    AppendAsciiHitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
-            } else {
-                if (inRun) {
-                    AppendAsciiHitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
-            }
-            if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-                if (truncated) {
-                    *truncated = true;
-                }
-                return true;
-            }
+        pos += count * step;
+        if (full) {
+            EndRun(opt, s);
+            continue;
         }
-
-        fileOffset += read;
-        if (progress && (fileOffset - lastProgressReport) >= (4ull << 20)) {
-            lastProgressReport = fileOffset;
-            progress(fileOffset, total);
+        if (stop == 0) {
+            return;
         }
+        EndRun(opt, s);
+        pos = end + step;
     }
+}
 
-    if (inRun) {
-        AppendAsciiHitIfNeeded(opt, outHits, curStart, cur);
-        if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-            if (truncated) {
-                *truncated = true;
-            }
-            return true;
+// The whole scan: ASCII, and UTF-16LE at both byte phases, over blocks fed in
+// file order. states[0] is ASCII when it is scanned, so that it wins ties
+// in MergePending; utf16[p] serves units at offsets of parity p.
+struct ScanState {
+    StringsClassifyFn classify = nullptr;
+    std::vector<RunState> states;
+    RunState* ascii = nullptr;
+    RunState* utf16[2] = {};
+    std::vector<uint64_t> bounds;
+    uint64_t offset = 0;
+    bool haveCarry = false;
+    uint8_t carry = 0;
+};
+
+static void InitScan(const StringsScanOptions& opt, StringsClassifyFn classify, ScanState& scan) {
+    scan.classify = classify;
+    scan.states.reserve(3);
+    if (opt.scanAscii) {
+        scan.states.emplace_back();
+        scan.states.back().type = StringsHitType::Ascii;
+    }
+    if (opt.scanUtf16Le) {
+        for (int phase = 0; phase < 2; ++phase) {
+            scan.states.emplace_back();
+            scan.states.back().type = StringsHitType::Utf16Le;
         }
     }
-
-    if (progress) {
-        progress(total, total);
+    for (size_t k = 0; k < scan.states.size(); ++k) {
+        scan.states[k].text.reserve(256);
     }
-    return true;
+    if (opt.scanAscii) {
+        scan.ascii = &scan.states[0];
+    }
+    if (opt.scanUtf16Le) {
+        scan.utf16[0] = &scan.states[scan.states.size() - 2];
+        scan.utf16[1] = &scan.states[scan.states.size() - 1];
+    }
+    scan.bounds.assign(scan.states.size(), 0);
 }
 
-static bool ScanUtf16LeStream(HANDLE h,
-                              uint64_t total,
-                              const StringsScanOptions& opt,
-                              std::vector<StringsHit>& outHits,
-                              std::wstring& error,
-                              std::atomic<bool>* cancel,
-                              const std::function<void(uint64_t processed, uint64_t total)>& progress,
-                              bool* truncated) {
-    const DWORD kBlock = 1u << 20;
-    std::vector<uint8_t> buf(kBlock + 1);
-    uint64_t fileOffset = 0;
-    uint64_t lastProgressReport = 0;
-
-    std::wstring cur;
-    cur.reserve(256);
-    uint64_t curStart = 0;
-    bool inRun = false;
-    bool haveCarry = false;
-    uint8_t carry = 0;
-
-    while (fileOffset < total) {
-        if (cancel && cancel->load()) {
-            error = L"\u5df2\u53d6\u6d88";
-            return false;
+// Byte at a time; what the classifiers are tested and measured against.
+static void ScanBlockBytewise(const StringsScanOptions& opt, ScanState& scan, const uint8_t* data, size_t size) {
+    if (scan.ascii) {
+        for (size_t i = 0; i < size; ++i) {
+            Feed(opt, *scan.ascii, scan.offset + i, IsAsciiPrintable(data[i]), data[i]);
         }
-        if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-            if (truncated) {
-                *truncated = true;
-            }
-            return true;
+    }
+    if (scan.utf16[0]) {
+        for (size_t i = 0; i + 1 < size; ++i) {
+            Feed(opt, *scan.utf16[(scan.offset + i) & 1], scan.offset + i,
+                 data[i + 1] == 0x00 && IsAsciiPrintable(data[i]), data[i]);
         }
-        DWORD toRead = static_cast<DWORD>(std::min<uint64_t>(kBlock, total - fileOffset));
-        DWORD read = 0;
-        if (!ReadFile(h, buf.data(), toRead, &read, nullptr)) {
-            error = L"\u8bfb\u53d6\u5931\u8d25";
-            return false;
+    }
+}
+
+static void ScanBlockMasked(const StringsScanOptions& opt, ScanState& scan, const uint8_t* data, size_t size) {
+    const uint64_t kEvenBits = 0x5555555555555555ull;
+    for (size_t c = 0; c < size; c += 64) {
+        const size_t n = std::min<size_t>(64, size - c);
+        const uint8_t* p = data + c;
+        const uint64_t chunkOffset = scan.offset + c;
+        uint64_t printable = 0;
+        uint64_t zero = 0;
+        if (n == 64) {
+            scan.classify(p, printable, zero);
+        } else {
+            ClassifyBytes(p, n, printable, zero);
         }
-        if (read == 0) {
-            break;
+        if (scan.ascii) {
+            ScanRuns(opt, *scan.ascii, p, chunkOffset, printable, ~0ull, n, 1);
         }
-
-        DWORD i = 0;
-        if (haveCarry) {
-            uint8_t lo = carry;
-            uint8_t hi = buf[0];
-            if (hi == 0x00 && IsAsciiPrintable(lo)) {
-                if (!inRun) {
-                    inRun = true;
-                    curStart = fileOffset - 1;
-                    cur.clear();
-                }
-                cur.push_back(static_cast<wchar_t>(lo));
-                if (cur.size() >= static_cast<size_t>(opt.maxLen)) {
-                    AppendUtf16HitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
-            } else {
-                if (inRun) {
-                    AppendUtf16HitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
-            }
-            haveCarry = false;
-            i = 1;
-            if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-                if (truncated) {
-                    *truncated = true;
-                }
-                return true;
+        if (scan.utf16[0]) {
+            // A unit at bit i is printable when byte i is and byte i + 1 is
+            // zero; the unit at the block's last byte is fed with the next
+            // block.
+            uint64_t highZero = zero >> 1;
+            size_t limit = n - 1;
+            if (c + 64 < size) {
+                highZero |= static_cast<uint64_t>(p[64] == 0x00) << 63;
+                limit = 64;
             }
+            const uint64_t units = printable & highZero;
+            const uint64_t even = (chunkOffset & 1) == 0 ? kEvenBits : ~kEvenBits;
+            ScanRuns(opt, *scan.utf16[0], p, chunkOffset, units, even, limit, 2);
+            ScanRuns(opt, *scan.utf16[1], p, chunkOffset, units, ~even, limit, 2);
         }
+    }
+}
 
-        while (i + 1 < read) {
-            uint8_t lo = buf[i];
-            uint8_t hi = buf[i + 1];
-            if (hi == 0x00 && IsAsciiPrintable(lo)) {
-                if (!inRun) {
-                    inRun = true;
-                    curStart = fileOffset + i;
-                    cur.clear();
-                }
-                cur.push_back(static_cast<wchar_t>(lo));
-                if (cur.size() >= static_cast<size_t>(opt.maxLen)) {
-                    AppendUtf16HitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
-            } else {
-                if (inRun) {
-                    AppendUtf16HitIfNeeded(opt, outHits, curStart, cur);
-                    inRun = false;
-                    cur.clear();
-                }
+// Moves pending hits to outHits in offset order (ASCII first on a tie). A
+// hit is final once it starts before everything the other detectors can
+// still report: their open run, or else the next unit they have not seen.
+// Returns false once maxHits is reached.
+static bool MergePending(const StringsScanOptions& opt, ScanState& scan, std::vector<StringsHit>& outHits) {
+    std::vector<RunState>& states = scan.states;
+    for (;;) {
+        size_t best = states.size();
+        for (size_t k = 0; k < states.size(); ++k) {
+            if (!states[k].pending.empty() &&
+                (best == states.size() || states[k].pending.front().fileOffset < states[best].pending.front().fileOffset)) {
+                best = k;
             }
-            i += 2;
-            if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-                if (truncated) {
-                    *truncated = true;
-                }
+        }
+        if (best == states.size()) {
+            return true;
+        }
+        const uint64_t offset = states[best].pending.front().fileOffset;
+        for (size_t j = 0; j < states.size(); ++j) {
+            if (j == best) {
+                continue;
+            }
+            const uint64_t bound = states[j].inRun ? states[j].start : scan.bounds[j];
+            if (offset > bound || (offset == bound && j < best)) {
                 return true;
             }
         }
-
-        if (i < read) {
-            carry = buf[i];
-            haveCarry = true;
+        if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
+            return false;
         }
+        outHits.push_back(std::move(states[best].pending.front()));
+        states[best].pending.pop_front();
+    }
+}
 
-        fileOffset += read;
-        if (progress && (fileOffset - lastProgressReport) >= (4ull << 20)) {
-            lastProgressReport = fileOffset;
-            progress(fileOffset, total);
-        }
+// Scans the next block of the file; false once maxHits is reached.
+static bool ScanBlock(const StringsScanOptions& opt, ScanState& scan, const uint8_t* data, size_t size, std::vector<StringsHit>& outHits) {
+    if (scan.utf16[0] && scan.haveCarry) {
+        const uint64_t unit = scan.offset - 1;
+        Feed(opt, *scan.utf16[unit & 1], unit, data[0] == 0x00 && IsAsciiPrintable(scan.carry), scan.carry);
+    }
+    if (scan.classify) {
+        ScanBlockMasked(opt, scan, data, size);
+    } else {
+        ScanBlockBytewise(opt, scan, data, size);
     }
+    scan.carry = data[size - 1];
+    scan.haveCarry = true;
+    scan.offset += size;
 
-    if (inRun) {
-        AppendUtf16HitIfNeeded(opt, outHits, curStart, cur);
-        if (opt.maxHits > 0 && outHits.size() >= opt.maxHits) {
-            if (truncated) {
-                *truncated = true;
-            }
-            return true;
-        }
+    // Without an open run, ASCII can next report scan.offset and UTF-16LE
+    // the unit that begins at the block's last byte.
+    for (size_t k = 0; k < scan.states.size(); ++k) {
+        scan.bounds[k] = &scan.states[k] == scan.ascii ? scan.offset : scan.offset - 1;
     }
+    return MergePending(opt, scan, outHits);
+}
 
-    if (progress) {
-        progress(total, total);
+static bool FinishScan(const StringsScanOptions& opt, ScanState& scan, std::vector<StringsHit>& outHits) {
+    for (size_t k = 0; k < scan.states.size(); ++k) {
+        if (scan.states[k].inRun) {
+            EndRun(opt, scan.states[k]);
+        }
+        scan.bounds[k] = UINT64_MAX;
     }
-    return true;
+    return MergePending(opt, scan, outHits);
 }
 
 bool ScanStringsFromFile(const std::wstring& filePath,
@@ -329,51 +529,221 @@ bool ScanStringsFromFile(const std::wstring& filePath,
         return false;
     }
 
-    HANDLE h = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (h == INVALID_HANDLE_VALUE) {
+    PageCacheFile file;
+    std::wstring openError;
+    if (!file.Open(filePath, opt.cachePolicy, openError, true)) {
         error = L"\u6253\u5f00\u6587\u4ef6\u5931\u8d25";
         return false;
     }
     uint64_t total = 0;
-    if (!GetFileSize64(h, total)) {
-        CloseHandle(h);
+    if (!file.GetSize(total)) {
         error = L"\u83b7\u53d6\u6587\u4ef6\u5927\u5c0f\u5931\u8d25";
         return false;
     }
 
-    bool ok = true;
-    if (opt.scanAscii) {
-        if (!SeekFile64(h, 0)) {
-            CloseHandle(h);
-            error = L"\u8bfb\u53d6\u5931\u8d25";
+    ScanState scan;
+    InitScan(opt, GetActiveClassifier().classify, scan);
+
+    AlignedBuffer buf(kBlock);
+    uint64_t lastProgressReport = 0;
+
+    while (scan.offset < total) {
+        if (cancel && cancel->load()) {
+            error = L"\u5df2\u53d6\u6d88";
             return false;
         }
-        ok = ScanAsciiStream(h, total, opt, outHits, error, cancel, progress, truncated);
-        if (!ok) {
-            CloseHandle(h);
+        const size_t toRead = static_cast<size_t>(std::min<uint64_t>(kBlock, total - scan.offset));
+        size_t got = 0;
+        if (buf.Data() == nullptr || !file.ReadAt(scan.offset, buf.Data(), toRead, got)) {
+            error = L"\u8bfb\u53d6\u5931\u8d25";
             return false;
         }
-        if (truncated && *truncated) {
-            CloseHandle(h);
-            std::stable_sort(outHits.begin(), outHits.end(), [](const StringsHit& a, const StringsHit& b) { return a.fileOffset < b.fileOffset; });
+        if (got == 0) {
+            break;
+        }
+        if (!ScanBlock(opt, scan, buf.Data(), got, outHits)) {
+            if (truncated) {
+                *truncated = true;
+            }
             return true;
         }
+
+        if (progress && (scan.offset - lastProgressReport) >= (4ull << 20)) {
+            lastProgressReport = scan.offset;
+            progress(scan.offset, total);
+        }
     }
 
-    if (opt.scanUtf16Le) {
-        if (!SeekFile64(h, 0)) {
-            CloseHandle(h);
-            error = L"\u8bfb\u53d6\u5931\u8d25";
-            return false;
+    if (!FinishScan(opt, scan, outHits)) {
+        if (truncated) {
+            *truncated = true;
         }
-        ok = ScanUtf16LeStream(h, total, opt, outHits, error, cancel, progress, truncated);
-        if (!ok) {
-            CloseHandle(h);
+        return true;
+    }
+
+    if (progress) {
+        progress(total, total);
+    }
+    return true;
+}
+
+void ScanStringsFromBuffer(const uint8_t* data,
+                           size_t size,
+                           const StringsScanOptions& opt,
+                           StringsClassifyFn classify,
+                           std::vector<StringsHit>& outHits,
+                           bool* truncated) {
+    outHits.clear();
+    if (truncated) {
+        *truncated = false;
+    }
+    ScanState scan;
+    InitScan(opt, classify, scan);
+    bool complete = true;
+    for (size_t off = 0; complete && off < size; off += kBlock) {
+        complete = ScanBlock(opt, scan, data + off, std::min(kBlock, size - off), outHits);
+    }
+    if (complete) {
+        complete = FinishScan(opt, scan, outHits);
+    }
+    if (truncated) {
+        *truncated = !complete;
+    }
+}
+
+// Benchmark and self-test inputs. "random": high-entropy bytes, where nearly
+// every byte ends a run. "text": ASCII prose, where nearly every byte extends
+// one. "utf16": UTF-16LE prose. "mixed": stretches of all three, as in an
+// executable with resources.
+static std::vector<uint8_t> MakeStringsInput(const std::string& kind, size_t size) {
+    static const char kWords[] = "the quick brown fox jumps over a lazy dog while PE files carry import names, "
+                                 "resource strings and version info; C:\\Windows\\System32\\kernel32.dll\r\n";
+    const size_t wordsLen = sizeof(kWords) - 1;
+    std::vector<uint8_t> out(size);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    auto next = [&x]() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+    size_t i = 0;
+    int mode = kind == "text" ? 1 : (kind == "utf16" ? 2 : 0);
+    while (i < size) {
+        if (kind == "mixed") {
+            mode = static_cast<int>(next() % 3);
+        }
+        const size_t stretch = kind == "mixed" ? 16 + static_cast<size_t>(next() % 1024) : size;
+        for (size_t k = 0; k < stretch && i < size; ++k, ++i) {
+            if (mode == 0) {
+                out[i] = static_cast<uint8_t>(next() >> 24);
+            } else if (mode == 1) {
+                out[i] = static_cast<uint8_t>(kWords[i % wordsLen]);
+            } else {
+                out[i] = (i & 1) == 0 ? static_cast<uint8_t>(kWords[(i / 2) % wordsLen]) : 0x00;
+            }
+        }
+    }
+    return out;
+}
+
+static bool SameHits(const std::vector<StringsHit>& a, const std::vector<StringsHit>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].fileOffset != b[i].fileOffset || a[i].text != b[i].text) {
             return false;
         }
     }
+    return true;
+}
 
-    CloseHandle(h);
-    std::stable_sort(outHits.begin(), outHits.end(), [](const StringsHit& a, const StringsHit& b) { return a.fileOffset < b.fileOffset; });
+bool RunStringsScannerSelfTest(std::wstring& error) {
+    struct Case {
+        const char* input;
+        size_t size;
+        int minLen;
+        int maxLen;
+        bool scanAscii;
+        bool scanUtf16Le;
+        size_t maxHits;
+    };
+    // Sizes straddle a block boundary by an odd byte count, so that UTF-16LE
+    // units are split between blocks.
+    const Case cases[] = {
+        {"mixed", kBlock + 4097, 5, 4096, true, true, 0},
+        {"mixed", kBlock + 4097, 1, 3, true, true, 0},
+        {"mixed", 100000, 4, 4096, false, true, 0},
+        {"mixed", 100000, 2, 7, true, false, 0},
+        {"mixed", 100000, 5, 4096, true, true, 50},
+        {"text", kBlock + 63, 5, 100, true, true, 0},
+        {"utf16", kBlock + 65, 5, 100, true, true, 0},
+        {"random", 100000, 3, 4096, true, true, 0},
+    };
+    for (const Case& c : cases) {
+        const std::vector<uint8_t> input = MakeStringsInput(c.input, c.size);
+        StringsScanOptions opt;
+        opt.minLen = c.minLen;
+        opt.maxLen = c.maxLen;
+        opt.scanAscii = c.scanAscii;
+        opt.scanUtf16Le = c.scanUtf16Le;
+        opt.maxHits = c.maxHits;
+        std::vector<StringsHit> expected;
+        bool expectedTruncated = false;
+        ScanStringsFromBuffer(input.data(), input.size(), opt, nullptr, expected, &expectedTruncated);
+        for (const auto& impl : GetAvailableStringsClassifiers()) {
+            std::vector<StringsHit> hits;
+            bool truncated = false;
+            ScanStringsFromBuffer(input.data(), input.size(), opt, impl.classify, hits, &truncated);
+            if (!SameHits(hits, expected) || truncated != expectedTruncated) {
+                std::string msg = std::string("strings (") + impl.name + "): hits differ from the bytewise scan for \"" +
+                                  c.input + "\" input, minLen " + std::to_string(c.minLen) + ", maxLen " +
+                                  std::to_string(c.maxLen);
+                error.assign(msg.begin(), msg.end());
+                return false;
+            }
+        }
+    }
     return true;
 }
+
+std::vector<StringsScanBenchmarkResult> RunStringsScanBenchmark(size_t bufferBytes, int rounds) {
+    if (rounds < 1) {
+        rounds = 1;
+    }
+    std::vector<StringsClassifierInfo> impls;
+    impls.push_back({"bytewise", nullptr});
+    for (const auto& impl : GetAvailableStringsClassifiers()) {
+        impls.push_back(impl);
+    }
+    StringsScanOptions opt;
+    opt.maxHits = 0;
+
+    std::vector<StringsScanBenchmarkResult> results;
+    const char* kinds[] = {"random", "text", "utf16", "mixed"};
+    for (const char* kind : kinds) {
+        const std::vector<uint8_t> input = MakeStringsInput(kind, bufferBytes);
+        for (const auto& impl : impls) {
+            std::vector<StringsHit> hits;
+            double best = 0.0;
+            for (int r = 0; r < rounds; ++r) {
+                auto start = std::chrono::steady_clock::now();
+                ScanStringsFromBuffer(input.data(), input.size(), opt, impl.classify, hits);
+                std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+                if (r == 0 || diff.count() < best) {
+                    best = diff.count();
+                }
+            }
+            StringsScanBenchmarkResult res;
+            res.input = kind;
+            res.impl = impl.name;
+            res.bytes = bufferBytes;
+            res.hits = hits.size();
+            res.seconds = best;
+            res.megabytesPerSecond = best > 0.0 ? (static_cast<double>(bufferBytes) / 1e6) / best : 0.0;
+            results.push_back(res);
+        }
+    }
+    return results;
+}
@@ -1,11 +1,17 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
 
+#include "PageCacheIo.h"
+
+// Builds without Windows headers, so that scripts/hash_bench can measure the
+// scan on other platforms.
+
 enum class StringsHitType {
     Ascii,
     Utf16Le
@@ -21,10 +27,15 @@ struct StringsScanOptions {
     int minLen = 5;
     int maxLen = 4096;
     bool scanAscii = true;
+    // Code units at even and at odd file offsets alike.
     bool scanUtf16Le = true;
     size_t maxHits = 3000000;
+    // What the scan leaves in the page cache; see PageCachePolicy.
+    PageCachePolicy cachePolicy = PageCachePolicy::Cached;
 };
 
+// Reads the file once; hits come out in file offset order (ASCII first when
+// two start at the same offset), at most maxHits of them.
 bool ScanStringsFromFile(const std::wstring& filePath,
                          const StringsScanOptions& opt,
                          std::vector<StringsHit>& outHits,
@@ -32,3 +43,48 @@ bool ScanStringsFromFile(const std::wstring& filePath,
                          std::atomic<bool>* cancel = nullptr,
                          const std::function<void(uint64_t processed, uint64_t total)>& progress = {},
                          bool* truncated = nullptr);
+
+// Classifies 64 bytes at p: bit i of printable is set when p[i] is printable
+// ASCII, tab, LF or CR, bit i of zero when p[i] is 0. The scan finds run
+// boundaries in these masks instead of testing byte by byte.
+typedef void (*StringsClassifyFn)(const uint8_t* p, uint64_t& printable, uint64_t& zero);
+
+struct StringsClassifierInfo {
+    // "portable", "sse2", "avx2" or "neon".
+    const char* name;
+    StringsClassifyFn classify;
+};
+
+// Every classifier compiled into this binary that the CPU can run, portable
+// first. ScanStringsFromFile uses the last one.
+std::vector<StringsClassifierInfo> GetAvailableStringsClassifiers();
+const char* GetActiveStringsClassifierName();
+
+// Scans a buffer as ScanStringsFromFile scans a file, with the given
+// classifier; nullptr tests one byte at a time. For self-tests and
+// benchmarks.
+void ScanStringsFromBuffer(const uint8_t* data,
+                           size_t size,
+                           const StringsScanOptions& opt,
+                           StringsClassifyFn classify,
+                           std::vector<StringsHit>& outHits,
+                           bool* truncated = nullptr);
+
+// Every available classifier must find what the bytewise scan finds, on
+// inputs that split runs and UTF-16LE units across blocks.
+bool RunStringsScannerSelfTest(std::wstring& error);
+
+struct StringsScanBenchmarkResult {
+    // "random", "text", "utf16" or "mixed".
+    std::string input;
+    // A classifier name, or "bytewise".
+    std::string impl;
+    uint64_t bytes = 0;
+    size_t hits = 0;
+    double seconds = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+// Scans generated buffers of the given size with the bytewise loop and every
+// available classifier, keeping the best of several rounds.
+std::vector<StringsScanBenchmarkResult> RunStringsScanBenchmark(size_t bufferBytes, int rounds);
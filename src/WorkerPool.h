@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs fn(index) for every index in [0, count) on up to threadCount threads
+// (0 = hardware concurrency). Items are handed out one at a time, so uneven
+// item costs balance themselves. The calling thread takes part in the work.
+template <typename Fn>
+void RunParallel(size_t count, size_t threadCount, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (threadCount == 0) {
+        threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> nextIndex{0};
+    auto worker = [&]() {
+        for (;;) {
+            size_t i = nextIndex.fetch_add(1);
+            if (i >= count) {
+                return;
+            }
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (size_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : threads) {
+        th.join();
+    }
+}
@@ -0,0 +1,610 @@
+#include "Xxh3.h"
+
+#include "CpuFeatures.h"
+#include "HashState.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PEINFO_XXH3_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define PEINFO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEINFO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PEINFO_TARGET_SSE2
+#define PEINFO_TARGET_AVX2
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PEINFO_XXH3_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const size_t kStripeLen = 64;
+// Secret bytes consumed per stripe.
+const size_t kSecretConsumeRate = 8;
+const size_t kSecretSize = 192;
+const size_t kSecretSizeMin = 136;
+const size_t kSecretLimit = kSecretSize - kStripeLen;
+const size_t kStripesPerBlock = kSecretLimit / kSecretConsumeRate;
+const size_t kMidSizeMax = 240;
+const size_t kMidSizeStartOffset = 3;
+const size_t kMidSizeLastOffset = 17;
+const size_t kSecretLastAccStart = 7;
+const size_t kSecretMergeAccsStart = 11;
+
+const uint32_t kPrime32_1 = 0x9E3779B1u;
+const uint32_t kPrime32_2 = 0x85EBCA77u;
+const uint32_t kPrime32_3 = 0xC2B2AE3Du;
+const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
+const uint64_t kPrimeMx1 = 0x165667919E3779F9ull;
+const uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ull;
+
+const uint64_t kInitAcc[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+
+// The default secret, taken from FARSH.
+alignas(64) const uint8_t kSecret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+struct Hash128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+inline uint32_t LoadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t LoadLe64(const uint8_t* p) {
+    return static_cast<uint64_t>(LoadLe32(p)) | (static_cast<uint64_t>(LoadLe32(p + 4)) << 32);
+}
+
+inline void StoreBe64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+    }
+}
+
+inline uint32_t Swap32(uint32_t x) {
+    return ((x << 24) & 0xff000000u) | ((x << 8) & 0x00ff0000u) | ((x >> 8) & 0x0000ff00u) | ((x >> 24) & 0x000000ffu);
+}
+
+inline uint64_t Swap64(uint64_t x) {
+    return (static_cast<uint64_t>(Swap32(static_cast<uint32_t>(x))) << 32) | Swap32(static_cast<uint32_t>(x >> 32));
+}
+
+inline uint32_t Rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+inline uint64_t Rotl64(uint64_t x, int n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+inline Hash128 Mul64To128(uint64_t a, uint64_t b) {
+    Hash128 r;
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+    r.low = static_cast<uint64_t>(p);
+    r.high = static_cast<uint64_t>(p >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    r.low = _umul128(a, b, &r.high);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    r.low = a * b;
+    r.high = __umulh(a, b);
+#else
+    const uint64_t loLo = (a & 0xFFFFFFFFu) * (b & 0xFFFFFFFFu);
+    const uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFFu);
+    const uint64_t loHi = (a & 0xFFFFFFFFu) * (b >> 32);
+    const uint64_t hiHi = (a >> 32) * (b >> 32);
+    const uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFFu) + loHi;
+    r.high = (hiLo >> 32) + (cross >> 32) + hiHi;
+    r.low = (cross << 32) | (loLo & 0xFFFFFFFFu);
+#endif
+    return r;
+}
+
+inline uint64_t Mul128Fold64(uint64_t a, uint64_t b) {
+    Hash128 p = Mul64To128(a, b);
+    return p.low ^ p.high;
+}
+
+inline uint64_t XorShift64(uint64_t v, int shift) {
+    return v ^ (v >> shift);
+}
+
+uint64_t Xxh64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime64_2;
+    h ^= h >> 29;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t Avalanche(uint64_t h) {
+    h = XorShift64(h, 37);
+    h *= kPrimeMx1;
+    return XorShift64(h, 32);
+}
+
+uint64_t Rrmxmx(uint64_t h, uint64_t len) {
+    h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+    h *= kPrimeMx2;
+    h ^= (h >> 35) + len;
+    h *= kPrimeMx2;
+    return XorShift64(h, 28);
+}
+
+uint64_t Mix16B(const uint8_t* input, const uint8_t* secret) {
+    return Mul128Fold64(LoadLe64(input) ^ LoadLe64(secret), LoadLe64(input + 8) ^ LoadLe64(secret + 8));
+}
+
+// Inputs of up to 240 bytes are hashed in one go, without the stripe loop.
+
+uint64_t Hash64Short(const uint8_t* input, size_t len) {
+    const uint8_t* secret = kSecret;
+    if (len > 128) {
+        uint64_t acc = len * kPrime64_1;
+        for (size_t i = 0; i < 8; ++i) {
+            acc += Mix16B(input + 16 * i, secret + 16 * i);
+        }
+        uint64_t accEnd = Mix16B(input + len - 16, secret + kSecretSizeMin - kMidSizeLastOffset);
+        acc = Avalanche(acc);
+        for (size_t i = 8; i < len / 16; ++i) {
+            accEnd += Mix16B(input + 16 * i, secret + 16 * (i - 8) + kMidSizeStartOffset);
+        }
+        return Avalanche(acc + accEnd);
+    }
+    if (len > 16) {
+        uint64_t acc = len * kPrime64_1;
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += Mix16B(input + 48, secret + 96);
+                    acc += Mix16B(input + len - 64, secret + 112);
+                }
+                acc += Mix16B(input + 32, secret + 64);
+                acc += Mix16B(input + len - 48, secret + 80);
+            }
+            acc += Mix16B(input + 16, secret + 32);
+            acc += Mix16B(input + len - 32, secret + 48);
+        }
+        acc += Mix16B(input, secret);
+        acc += Mix16B(input + len - 16, secret + 16);
+        return Avalanche(acc);
+    }
+    if (len > 8) {
+        const uint64_t lo = LoadLe64(input) ^ (LoadLe64(secret + 24) ^ LoadLe64(secret + 32));
+        const uint64_t hi = LoadLe64(input + len - 8) ^ (LoadLe64(secret + 40) ^ LoadLe64(secret + 48));
+        return Avalanche(len + Swap64(lo) + hi + Mul128Fold64(lo, hi));
+    }
+    if (len >= 4) {
+        const uint64_t input64 = LoadLe32(input + len - 4) + (static_cast<uint64_t>(LoadLe32(input)) << 32);
+        return Rrmxmx(input64 ^ (LoadLe64(secret + 8) ^ LoadLe64(secret + 16)), len);
+    }
+    if (len != 0) {
+        const uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[len >> 1]) << 24) |
+                                  static_cast<uint32_t>(input[len - 1]) | (static_cast<uint32_t>(len) << 8);
+        return Xxh64Avalanche(combined ^ static_cast<uint64_t>(LoadLe32(secret) ^ LoadLe32(secret + 4)));
+    }
+    return Xxh64Avalanche(LoadLe64(secret + 56) ^ LoadLe64(secret + 64));
+}
+
+Hash128 Mix32B(Hash128 acc, const uint8_t* input1, const uint8_t* input2, const uint8_t* secret, uint64_t seed) {
+    acc.low += Mul128Fold64(LoadLe64(input1) ^ (LoadLe64(secret) + seed), LoadLe64(input1 + 8) ^ (LoadLe64(secret + 8) - seed));
+    acc.low ^= LoadLe64(input2) + LoadLe64(input2 + 8);
+    acc.high +=
+        Mul128Fold64(LoadLe64(input2) ^ (LoadLe64(secret + 16) + seed), LoadLe64(input2 + 8) ^ (LoadLe64(secret + 24) - seed));
+    acc.high ^= LoadLe64(input1) + LoadLe64(input1 + 8);
+    return acc;
+}
+
+Hash128 Finish128(Hash128 acc, size_t len) {
+    Hash128 h;
+    h.low = Avalanche(acc.low + acc.high);
+    h.high = 0 - Avalanche(acc.low * kPrime64_1 + acc.high * kPrime64_4 + len * kPrime64_2);
+    return h;
+}
+
+Hash128 Hash128Short(const uint8_t* input, size_t len) {
+    const uint8_t* secret = kSecret;
+    if (len > 128) {
+        Hash128 acc = {len * kPrime64_1, 0};
+        for (size_t i = 32; i < 160; i += 32) {
+            acc = Mix32B(acc, input + i - 32, input + i - 16, secret + i - 32, 0);
+        }
+        acc.low = Avalanche(acc.low);
+        acc.high = Avalanche(acc.high);
+        for (size_t i = 160; i <= len; i += 32) {
+            acc = Mix32B(acc, input + i - 32, input + i - 16, secret + kMidSizeStartOffset + i - 160, 0);
+        }
+        acc = Mix32B(acc, input + len - 16, input + len - 32, secret + kSecretSizeMin - kMidSizeLastOffset - 16, 0);
+        return Finish128(acc, len);
+    }
+    if (len > 16) {
+        Hash128 acc = {len * kPrime64_1, 0};
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc = Mix32B(acc, input + 48, input + len - 64, secret + 96, 0);
+                }
+                acc = Mix32B(acc, input + 32, input + len - 48, secret + 64, 0);
+            }
+            acc = Mix32B(acc, input + 16, input + len - 32, secret + 32, 0);
+        }
+        acc = Mix32B(acc, input, input + len - 16, secret, 0);
+        return Finish128(acc, len);
+    }
+    if (len > 8) {
+        const uint64_t lo = LoadLe64(input);
+        const uint64_t hi = LoadLe64(input + len - 8) ^ (LoadLe64(secret + 48) ^ LoadLe64(secret + 56));
+        Hash128 m = Mul64To128(lo ^ LoadLe64(input + len - 8) ^ (LoadLe64(secret + 32) ^ LoadLe64(secret + 40)), kPrime64_1);
+        m.low += static_cast<uint64_t>(len - 1) << 54;
+        m.high += hi + static_cast<uint64_t>(static_cast<uint32_t>(hi)) * (kPrime32_2 - 1);
+        m.low ^= Swap64(m.high);
+        Hash128 h = Mul64To128(m.low, kPrime64_2);
+        h.high += m.high * kPrime64_2;
+        h.low = Avalanche(h.low);
+        h.high = Avalanche(h.high);
+        return h;
+    }
+    if (len >= 4) {
+        const uint64_t input64 = LoadLe32(input) + (static_cast<uint64_t>(LoadLe32(input + len - 4)) << 32);
+        const uint64_t keyed = input64 ^ (LoadLe64(secret + 16) ^ LoadLe64(secret + 24));
+        Hash128 m = Mul64To128(keyed, kPrime64_1 + (len << 2));
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+        m.low = XorShift64(m.low, 35);
+        m.low *= kPrimeMx2;
+        m.low = XorShift64(m.low, 28);
+        m.high = Avalanche(m.high);
+        return m;
+    }
+    if (len != 0) {
+        const uint32_t combinedLow = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[len >> 1]) << 24) |
+                                     static_cast<uint32_t>(input[len - 1]) | (static_cast<uint32_t>(len) << 8);
+        const uint32_t combinedHigh = Rotl32(Swap32(combinedLow), 13);
+        Hash128 h;
+        h.low = Xxh64Avalanche(combinedLow ^ static_cast<uint64_t>(LoadLe32(secret) ^ LoadLe32(secret + 4)));
+        h.high = Xxh64Avalanche(combinedHigh ^ static_cast<uint64_t>(LoadLe32(secret + 8) ^ LoadLe32(secret + 12)));
+        return h;
+    }
+    Hash128 h;
+    h.low = Xxh64Avalanche(LoadLe64(secret + 64) ^ LoadLe64(secret + 72));
+    h.high = Xxh64Avalanche(LoadLe64(secret + 80) ^ LoadLe64(secret + 88));
+    return h;
+}
+
+// Long inputs: eight 64-bit lanes accumulate 64-byte stripes, each against
+// the secret shifted by 8 bytes, and are scrambled after every block of 16
+// stripes.
+
+typedef void (*AccumulateFn)(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes);
+typedef void (*ScrambleFn)(uint64_t* acc, const uint8_t* secret);
+
+void AccumulateScalar(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+    for (size_t s = 0; s < stripes; ++s) {
+        const uint8_t* in = input + s * kStripeLen;
+        const uint8_t* key = secret + s * kSecretConsumeRate;
+        for (size_t i = 0; i < 8; ++i) {
+            const uint64_t data = LoadLe64(in + 8 * i);
+            const uint64_t dataKey = data ^ LoadLe64(key + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (dataKey & 0xFFFFFFFFu) * (dataKey >> 32);
+        }
+    }
+}
+
+void ScrambleScalar(uint64_t* acc, const uint8_t* secret) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t a = XorShift64(acc[i], 47);
+        a ^= LoadLe64(secret + 8 * i);
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+#if defined(PEINFO_XXH3_X86)
+namespace sse2 {
+
+PEINFO_TARGET_SSE2
+void Accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+    __m128i a[4];
+    for (int i = 0; i < 4; ++i) {
+        a[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(acc) + i);
+    }
+    for (size_t s = 0; s < stripes; ++s) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(input + s * kStripeLen);
+        const __m128i* key = reinterpret_cast<const __m128i*>(secret + s * kSecretConsumeRate);
+        for (int i = 0; i < 4; ++i) {
+            const __m128i data = _mm_loadu_si128(in + i);
+            const __m128i dataKey = _mm_xor_si128(data, _mm_loadu_si128(key + i));
+            const __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[i] = _mm_add_epi64(a[i], product);
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(acc) + i, a[i]);
+    }
+}
+
+PEINFO_TARGET_SSE2
+void Scramble(uint64_t* acc, const uint8_t* secret) {
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+    for (int i = 0; i < 4; ++i) {
+        __m128i* a = reinterpret_cast<__m128i*>(acc) + i;
+        __m128i v = _mm_xor_si128(*a, _mm_srli_epi64(*a, 47));
+        v = _mm_xor_si128(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+        const __m128i low = _mm_mul_epu32(v, prime);
+        const __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(v, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        *a = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+}
+
+} // namespace sse2
+
+namespace avx2 {
+
+PEINFO_TARGET_AVX2
+void Accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+    __m256i a0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i a1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc) + 1);
+    for (size_t s = 0; s < stripes; ++s) {
+        const __m256i* in = reinterpret_cast<const __m256i*>(input + s * kStripeLen);
+        const __m256i* key = reinterpret_cast<const __m256i*>(secret + s * kSecretConsumeRate);
+        const __m256i d0 = _mm256_loadu_si256(in);
+        const __m256i d1 = _mm256_loadu_si256(in + 1);
+        const __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(key));
+        const __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(key + 1));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc), a0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(acc) + 1, a1);
+}
+
+PEINFO_TARGET_AVX2
+void Scramble(uint64_t* acc, const uint8_t* secret) {
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+    for (int i = 0; i < 2; ++i) {
+        __m256i* a = reinterpret_cast<__m256i*>(acc) + i;
+        __m256i v = _mm256_xor_si256(*a, _mm256_srli_epi64(*a, 47));
+        v = _mm256_xor_si256(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+        const __m256i low = _mm256_mul_epu32(v, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), prime);
+        *a = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+}
+
+} // namespace avx2
+#elif defined(PEINFO_XXH3_NEON)
+namespace neon {
+
+void Accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+    uint64x2_t a[4];
+    for (int i = 0; i < 4; ++i) {
+        a[i] = vld1q_u64(acc + 2 * i);
+    }
+    for (size_t s = 0; s < stripes; ++s) {
+        const uint8_t* in = input + s * kStripeLen;
+        const uint8_t* key = secret + s * kSecretConsumeRate;
+        for (int i = 0; i < 4; ++i) {
+            const uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8(in + 16 * i));
+            const uint64x2_t dataKey = veorq_u64(data, vreinterpretq_u64_u8(vld1q_u8(key + 16 * i)));
+            a[i] = vaddq_u64(a[i], vextq_u64(data, data, 1));
+            a[i] = vmlal_u32(a[i], vmovn_u64(dataKey), vshrn_n_u64(dataKey, 32));
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        vst1q_u64(acc + 2 * i, a[i]);
+    }
+}
+
+void Scramble(uint64_t* acc, const uint8_t* secret) {
+    const uint32x2_t prime = vdup_n_u32(kPrime32_1);
+    for (int i = 0; i < 4; ++i) {
+        uint64x2_t v = vld1q_u64(acc + 2 * i);
+        v = veorq_u64(v, vshrq_n_u64(v, 47));
+        v = veorq_u64(v, vreinterpretq_u64_u8(vld1q_u8(secret + 16 * i)));
+        const uint64x2_t high = vshlq_n_u64(vmull_u32(vshrn_n_u64(v, 32), prime), 32);
+        vst1q_u64(acc + 2 * i, vmlal_u32(high, vmovn_u64(v), prime));
+    }
+}
+
+} // namespace neon
+#endif
+
+struct StripeImpl {
+    const char* name;
+    AccumulateFn accumulate;
+    ScrambleFn scramble;
+};
+
+const StripeImpl& GetStripeImpl() {
+    static const StripeImpl active = []() {
+        StripeImpl best = {"portable", AccumulateScalar, ScrambleScalar};
+        const CpuFeatures& cpu = GetCpuFeatures();
+#if defined(PEINFO_XXH3_X86)
+        if (cpu.avx2) {
+            best = {"avx2", avx2::Accumulate, avx2::Scramble};
+        } else if (cpu.sse2) {
+            best = {"sse2", sse2::Accumulate, sse2::Scramble};
+        }
+#elif defined(PEINFO_XXH3_NEON)
+        (void)cpu;
+        best = {"neon", neon::Accumulate, neon::Scramble};
+#else
+        (void)cpu;
+#endif
+        return best;
+    }();
+    return active;
+}
+
+// Consumes whole stripes, scrambling at every block boundary.
+void ConsumeStripes(uint64_t* acc, size_t& stripesSoFar, const uint8_t* input, size_t stripes) {
+    const StripeImpl& impl = GetStripeImpl();
+    while (stripes != 0) {
+        const size_t take = std::min(stripes, kStripesPerBlock - stripesSoFar);
+        impl.accumulate(acc, input, kSecret + stripesSoFar * kSecretConsumeRate, take);
+        input += take * kStripeLen;
+        stripes -= take;
+        stripesSoFar += take;
+        if (stripesSoFar == kStripesPerBlock) {
+            impl.scramble(acc, kSecret + kSecretLimit);
+            stripesSoFar = 0;
+        }
+    }
+}
+
+uint64_t MergeAccs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; ++i) {
+        result += Mul128Fold64(acc[2 * i] ^ LoadLe64(secret + 16 * i), acc[2 * i + 1] ^ LoadLe64(secret + 16 * i + 8));
+    }
+    return Avalanche(result);
+}
+
+} // namespace
+
+const char* GetXxh3ImplName() {
+    return GetStripeImpl().name;
+}
+
+Xxh3Hasher::Xxh3Hasher(size_t outLen) : m_outLen(outLen == 16 ? 16 : 8) {
+    Reset();
+}
+
+void Xxh3Hasher::Reset() {
+    std::memcpy(m_acc, kInitAcc, sizeof(kInitAcc));
+    m_bufferLen = 0;
+    m_stripesSoFar = 0;
+    m_totalLen = 0;
+}
+
+void Xxh3Hasher::Update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    m_totalLen += size;
+    if (size <= kBufferSize - m_bufferLen) {
+        std::memcpy(m_buffer + m_bufferLen, p, size);
+        m_bufferLen += size;
+        return;
+    }
+    // The buffer is only consumed once more input follows, so that Final
+    // always has the last stripe at hand.
+    if (m_bufferLen != 0) {
+        const size_t take = kBufferSize - m_bufferLen;
+        std::memcpy(m_buffer + m_bufferLen, p, take);
+        p += take;
+        size -= take;
+        ConsumeStripes(m_acc, m_stripesSoFar, m_buffer, kBufferSize / kStripeLen);
+        m_bufferLen = 0;
+    }
+    if (size > kBufferSize) {
+        const size_t stripes = (size - 1) / kStripeLen;
+        ConsumeStripes(m_acc, m_stripesSoFar, p, stripes);
+        p += stripes * kStripeLen;
+        size -= stripes * kStripeLen;
+        // Final may need the bytes just before the tail.
+        std::memcpy(m_buffer + kBufferSize - kStripeLen, p - kStripeLen, kStripeLen);
+    }
+    std::memcpy(m_buffer, p, size);
+    m_bufferLen = size;
+}
+
+void Xxh3Hasher::Final(uint8_t* out) const {
+    if (m_totalLen <= kMidSizeMax) {
+        const size_t len = static_cast<size_t>(m_totalLen);
+        if (m_outLen == 8) {
+            StoreBe64(out, Hash64Short(m_buffer, len));
+        } else {
+            Hash128 h = Hash128Short(m_buffer, len);
+            StoreBe64(out, h.high);
+            StoreBe64(out + 8, h.low);
+        }
+        return;
+    }
+
+    alignas(32) uint64_t acc[8];
+    std::memcpy(acc, m_acc, sizeof(acc));
+    uint8_t lastStripe[kStripeLen];
+    const uint8_t* last = nullptr;
+    if (m_bufferLen >= kStripeLen) {
+        size_t stripesSoFar = m_stripesSoFar;
+        ConsumeStripes(acc, stripesSoFar, m_buffer, (m_bufferLen - 1) / kStripeLen);
+        last = m_buffer + m_bufferLen - kStripeLen;
+    } else {
+        const size_t catchUp = kStripeLen - m_bufferLen;
+        std::memcpy(lastStripe, m_buffer + kBufferSize - catchUp, catchUp);
+        std::memcpy(lastStripe + catchUp, m_buffer, m_bufferLen);
+        last = lastStripe;
+    }
+    GetStripeImpl().accumulate(acc, last, kSecret + kSecretLimit - kSecretLastAccStart, 1);
+
+    const uint64_t low = MergeAccs(acc, kSecret + kSecretMergeAccsStart, m_totalLen * kPrime64_1);
+    if (m_outLen == 8) {
+        StoreBe64(out, low);
+        return;
+    }
+    const uint64_t high = MergeAccs(acc, kSecret + kSecretSize - sizeof(acc) - kSecretMergeAccsStart, ~(m_totalLen * kPrime64_2));
+    StoreBe64(out, high);
+    StoreBe64(out + 8, low);
+}
+
+void Xxh3Hasher::SaveState(HashStateWriter& out) const {
+    for (uint64_t word : m_acc) {
+        out.U64(word);
+    }
+    out.U64(m_totalLen);
+    out.U32(static_cast<uint32_t>(m_stripesSoFar));
+    out.U32(static_cast<uint32_t>(m_bufferLen));
+    // All of it: Final reads the end of the previous buffer load.
+    out.Bytes(m_buffer, sizeof(m_buffer));
+}
+
+bool Xxh3Hasher::LoadState(HashStateReader& in) {
+    Reset();
+    for (uint64_t& word : m_acc) {
+        word = in.U64();
+    }
+    m_totalLen = in.U64();
+    m_stripesSoFar = in.U32();
+    m_bufferLen = in.U32();
+    in.Bytes(m_buffer, sizeof(m_buffer));
+    if (m_stripesSoFar >= kStripesPerBlock || m_bufferLen > kBufferSize || m_bufferLen > m_totalLen ||
+        (m_totalLen > kBufferSize && m_bufferLen == 0)) {
+        in.Fail();
+    }
+    if (!in.Ok()) {
+        Reset();
+        return false;
+    }
+    return true;
+}
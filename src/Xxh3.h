@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class HashStateReader;
+class HashStateWriter;
+
+// XXH3 with the default secret and seed 0, 64- or 128-bit: a non-cryptographic
+// digest for dedup and change detection that runs at memory speed. Stripes
+// are accumulated with SSE2, AVX2 or NEON where the CPU has them; results are
+// the same as the reference implementation's, written big-endian as xxhsum
+// prints them.
+class Xxh3Hasher {
+public:
+    // outLen is 8 (XXH3-64) or 16 (XXH3-128).
+    explicit Xxh3Hasher(size_t outLen);
+
+    void Reset();
+    void Update(const void* data, size_t size);
+    // Does not change the state.
+    void Final(uint8_t* out) const;
+    size_t OutLen() const { return m_outLen; }
+
+    void SaveState(HashStateWriter& out) const;
+    bool LoadState(HashStateReader& in);
+
+private:
+    static const size_t kBufferSize = 256;
+
+    size_t m_outLen;
+    alignas(32) uint64_t m_acc[8];
+    uint8_t m_buffer[kBufferSize];
+    size_t m_bufferLen;
+    size_t m_stripesSoFar;
+    uint64_t m_totalLen;
+};
+
+// Stripe code in use: "portable", "sse2", "avx2" or "neon".
+const char* GetXxh3ImplName();